@@ -0,0 +1,113 @@
+/****************************************************************
+*                                                               *
+*   Adafruit_INA219.h                                           *
+*                                                               *
+*   Host stand-in for the Adafruit INA219 driver.               *
+*                                                               *
+*****************************************************************/
+// Serves whatever readings were last set with `Adafruit_INA219::SetReadings()` (all `0` until then), quantized to the
+// register units of the driver's default calibration (`setCalibration_32V_2A()`): `4 mV` bus voltage, `10 µV` shunt
+// voltage, `0.1 mA` current and `2 mW` power. As with the real driver, the float getters scale the raw registers, and
+// the raw getters are private; the registers themselves are served on the host's I2C bus (see `Wire.h`) at the
+// object's address, for code reading them directly.
+// Readings and failure injection are per thread (not per object), so parallel simulations don't interfere.
+#ifndef HOST_ADAFRUIT_INA219_H
+#define HOST_ADAFRUIT_INA219_H
+
+#include <stdint.h>
+#include <math.h>
+#include <Wire.h>
+
+
+
+class Adafruit_INA219 {
+public:
+    // ## HostReadings
+    // What every simulated INA219 on the calling thread currently reads.
+    struct HostReadings {
+        float bus_voltage_V = 0.f;
+        float shunt_voltage_mV = 0.f;
+        float current_mA = 0.f;
+        float power_mW = 0.f;
+        bool failing = false;           // Whether transactions fail (not acknowledged, and `success()` returns `false`).
+    };
+
+    // ### `Adafruit_INA219::Readings()`
+    // Returns the calling thread's simulated readings, for a simulator to update.
+    static HostReadings& Readings() {
+        static thread_local HostReadings readings;
+        return readings;
+    }
+
+    // ### `Adafruit_INA219::SetReadings()`
+    // Sets what the calling thread's simulated INA219s read.
+    static void SetReadings(float bus_voltage_V, float shunt_voltage_mV, float current_mA, float power_mW) {
+        HostReadings& readings = Readings();
+        readings.bus_voltage_V = bus_voltage_V;
+        readings.shunt_voltage_mV = shunt_voltage_mV;
+        readings.current_mA = current_mA;
+        readings.power_mW = power_mW;
+    }
+
+    Adafruit_INA219(uint8_t addr = 0x40) {
+        TwoWire::Attach(addr, &HostRegister);
+    }
+
+    bool begin(TwoWire* wire = &Wire) { (void)wire; return !Readings().failing; }
+    bool success() { return !Readings().failing; }
+
+    void setCalibration_32V_2A() { }
+    void setCalibration_32V_1A() { }
+    void setCalibration_16V_400mA() { }
+
+    float getBusVoltage_V() { return getBusVoltage_raw() * 0.001; }
+    float getShuntVoltage_mV() { return getShuntVoltage_raw() * 0.01; }
+    float getCurrent_mA() { return getCurrent_raw() / 10.f; }
+    float getPower_mW() { return getPower_raw() * 2.f; }
+
+private:
+    static int16_t getBusVoltage_raw() {    // In `mV` (the 13-bit register shifted into place, as the driver returns it)
+        int16_t units = Register(Readings().bus_voltage_V * 250);
+        return (units < 0 ? 0 : units > 8191 ? 8191 : units) * 4;
+    }
+    static int16_t getShuntVoltage_raw() { return Register(Readings().shunt_voltage_mV * 100); }
+    static int16_t getCurrent_raw() { return Register(Readings().current_mA * 10); }
+    static int16_t getPower_raw() {         // Unsigned on the chip (the magnitude, whatever the current's sign), returned as the driver's `int16_t`
+        double units = fabs(Readings().power_mW / 2);
+        return (int16_t)(uint16_t)(units > 65535 ? 65535 : lround(units));
+    }
+
+    // Rounds a reading to register units and saturates it as the 16-bit register would
+    static int16_t Register(double units) {
+        if (units > 32767) {
+            return 32767;
+        }
+        return units < -32768 ? -32768 : (int16_t)lround(units);
+    }
+
+    // Serves the registers on the host's I2C bus: the configuration and calibration as `setCalibration_32V_2A()` writes
+    // them (writes are acknowledged and ignored), and the readings as the chip holds them (the bus voltage shifted past
+    // its conversion-ready and overflow flags).
+    static bool HostRegister(uint8_t reg, uint16_t& value, bool write) {
+        if (Readings().failing) {
+            return false;
+        }
+        if (write) {
+            return true;
+        }
+        switch (reg) {
+            case 0x00: value = 0x399F; break;
+            case 0x01: value = (uint16_t)getShuntVoltage_raw(); break;
+            case 0x02: value = (uint16_t)(getBusVoltage_raw() / 4 << 3 | 0x2); break;
+            case 0x03: value = (uint16_t)getPower_raw(); break;
+            case 0x04: value = (uint16_t)getCurrent_raw(); break;
+            case 0x05: value = 4096; break;
+            default: return false;
+        }
+        return true;
+    }
+};
+
+
+
+#endif // HOST_ADAFRUIT_INA219_H
\ No newline at end of file
@@ -0,0 +1,261 @@
+/****************************************************************
+*                                                               *
+*   Arduino.h                                                   *
+*                                                               *
+*   Minimal host stand-in for the Arduino core.                 *
+*                                                               *
+*****************************************************************/
+// Just enough of the Arduino API for the firmware's headers to compile unchanged on the host
+// (the `native` PlatformIO environment, and the CMake build of the tools and benchmarks).
+// Never used by the firmware build. Pin levels are simulated per thread, so parallel simulations don't interfere.
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <chrono>
+#include <string>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT  0x00
+#define OUTPUT 0x01
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define IRAM_ATTR
+
+#define TIM_DIV1   0
+#define TIM_DIV16  1
+#define TIM_DIV256 3
+#define TIM_EDGE   0
+#define TIM_LEVEL  1
+#define TIM_SINGLE 0
+#define TIM_LOOP   1
+
+
+
+// ### `micros()` / `millis()`
+// Time since the program started, from the host's monotonic clock (wrapping like the real ones).
+inline unsigned long micros() {
+    static const auto start = std::chrono::steady_clock::now();
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+inline unsigned long millis() {
+    static const auto start = std::chrono::steady_clock::now();
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline void yield() { }
+inline void delay(unsigned long) { }
+
+// Interrupt handlers only run from `HostSetPin()` and the clock's advance, never in between, so there is nothing to mask
+inline void noInterrupts() { }
+inline void interrupts() { }
+
+
+
+// ### `HOST_PIN_COUNT`
+// Number of simulated GPIO pins.
+#define HOST_PIN_COUNT 32
+
+// ### `HostPins()`
+// Returns the calling thread's simulated pin levels.
+inline uint8_t* HostPins() {
+    static thread_local uint8_t pins[HOST_PIN_COUNT] = {};
+    return pins;
+}
+
+// ## HostInterrupt
+// A handler attached to a simulated pin with `attachInterruptArg()`.
+struct HostInterrupt {
+    void (*handler)(void*);
+    void* argument;
+    int mode;
+};
+
+// ### `HostInterrupts()`
+// Returns the calling thread's attached pin interrupts.
+inline HostInterrupt* HostInterrupts() {
+    static thread_local HostInterrupt interrupts[HOST_PIN_COUNT] = {};
+    return interrupts;
+}
+
+// ### `HostSetPin()`
+// Drives a simulated input pin (what `digitalRead()` returns for it from now on).
+// A change of level calls the pin's interrupt handler at once, if one is attached for that edge.
+inline void HostSetPin(uint8_t pin, uint8_t level) {
+    if (pin >= HOST_PIN_COUNT) {
+        return;
+    }
+    uint8_t previous = HostPins()[pin];
+    HostPins()[pin] = level ? HIGH : LOW;
+    const HostInterrupt& interrupt = HostInterrupts()[pin];
+    if (interrupt.handler != nullptr && HostPins()[pin] != previous
+        && (interrupt.mode & (HostPins()[pin] == HIGH ? RISING : FALLING))) {
+        interrupt.handler(interrupt.argument);
+    }
+}
+
+inline uint8_t digitalPinToInterrupt(uint8_t pin) {
+    return pin;
+}
+
+inline void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* argument, int mode) {
+    if (pin < HOST_PIN_COUNT) {
+        HostInterrupts()[pin] = {handler, argument, mode};
+    }
+}
+
+inline void detachInterrupt(uint8_t pin) {
+    if (pin < HOST_PIN_COUNT) {
+        HostInterrupts()[pin] = {nullptr, nullptr, 0};
+    }
+}
+
+inline void pinMode(uint8_t, uint8_t) { }
+
+inline int digitalRead(uint8_t pin) {
+    return pin < HOST_PIN_COUNT ? HostPins()[pin] : LOW;
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+    HostSetPin(pin, level);
+}
+
+
+
+// ## HostTimer1
+// State of the simulated ESP8266 hardware timer 1 (`80 MHz` divided by `1`, `16` or `256`).
+// `timer1_write()` only records the count; the next `Ticker::RunDue()` or `AdvanceClock()` (see `Ticker.h`) starts
+// it from the clock's time then, and calls the handler when it runs out, in order with the tickers.
+struct HostTimer1 {
+    void (*handler)();
+    uint8_t divider;        // `TIM_DIV1`, `TIM_DIV16` or `TIM_DIV256`.
+    bool enabled;
+    bool loop;              // `TIM_LOOP`: reload with `ticks` each time it runs out.
+    uint32_t ticks;         // Last value written.
+    bool written;           // Written, but not yet started.
+    bool running;
+    uint32_t deadline;      // When a running timer runs out (`ClockMicros()`), in `µs`.
+};
+
+typedef void (*timercallback)(void);
+
+// ### `HostTimer1State()`
+// Returns the calling thread's timer 1.
+inline HostTimer1& HostTimer1State() {
+    static thread_local HostTimer1 timer = {};
+    return timer;
+}
+
+inline void timer1_isr_init() { }
+
+inline void timer1_attachInterrupt(timercallback handler) {
+    HostTimer1State().handler = handler;
+}
+
+inline void timer1_detachInterrupt() {
+    HostTimer1State().handler = nullptr;
+}
+
+inline void timer1_enable(uint8_t divider, uint8_t, uint8_t reload) {
+    HostTimer1& timer = HostTimer1State();
+    timer.divider = divider;
+    timer.loop = reload == TIM_LOOP;
+    timer.enabled = true;
+}
+
+inline void timer1_disable() {
+    HostTimer1& timer = HostTimer1State();
+    timer.enabled = timer.written = timer.running = false;
+}
+
+inline void timer1_write(uint32_t ticks) {
+    HostTimer1& timer = HostTimer1State();
+    timer.ticks = ticks;
+    timer.written = true;
+    timer.running = false;
+}
+
+
+
+// ## String
+// Arduino `String`, backed by `std::string`.
+class String : public std::string {
+public:
+    String() { }
+    String(const char* s) : std::string(s) { }
+    String(const std::string& s) : std::string(s) { }
+};
+
+
+
+// ## Print
+// Arduino `Print`: formatted output on top of a single `write()`.
+class Print {
+public:
+    virtual ~Print() { }
+
+    virtual size_t write(uint8_t c) = 0;
+
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size--) {
+            n += write(*buffer++);
+        }
+        return n;
+    }
+
+    size_t print(const char* s) {
+        return write((const uint8_t*)s, strlen(s));
+    }
+
+    size_t println(const char* s = "") {
+        return print(s) + print("\n");
+    }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length < 0) {
+            return 0;
+        }
+        return write((const uint8_t*)buffer, (size_t)length < sizeof(buffer) ? (size_t)length : sizeof(buffer) - 1);
+    }
+};
+
+
+
+// ## HardwareSerial
+// Arduino `Serial`, writing to `stderr` (so tools can keep `stdout` for their output) without any rate limit.
+// Simulations derive from it to model a real UART (see `host/sim/Session.hpp`).
+class HardwareSerial : public Print {
+public:
+    using Print::write;
+
+    virtual void begin(unsigned long) { }
+
+    size_t write(uint8_t c) override {
+        return fputc(c, stderr) == EOF ? 0 : 1;
+    }
+
+    virtual int availableForWrite() {
+        return 4096;
+    }
+};
+
+inline HardwareSerial Serial;
+
+
+
+#endif // HOST_ARDUINO_H
\ No newline at end of file
@@ -0,0 +1,243 @@
+/****************************************************************
+*                                                               *
+*   Ticker.h                                                    *
+*                                                               *
+*   Host stand-in for the ESP8266 Ticker library.               *
+*                                                               *
+*****************************************************************/
+// Attached tickers are kept in a per-thread schedule driven by the active `Clock`: nothing fires on its own.
+// Call `Ticker::RunDue()` to fire every ticker whose time has come, or `AdvanceClock()` to move a `VirtualClock`
+// forward and fire tickers at their exact deadlines on the way (as the ESP8266 would).
+// Both also run the simulated hardware timer 1 (`timer1_write()`, see `Arduino.h`) in order with the tickers.
+#ifndef HOST_TICKER_H
+#define HOST_TICKER_H
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <Arduino.h>
+#include "Clock/Clock.hpp"
+
+
+
+class Ticker {
+private:
+    std::function<void(void)> callback;
+    void (*invoke)(void (*)(), void*) = nullptr;    // Calls `function(argument)`, for tickers attached with an argument.
+    void (*function)() = nullptr;
+    void* argument = nullptr;
+    uint32_t interval = 0;      // Period, in `µs`.
+    uint32_t next = 0;          // Next deadline (`ClockMicros()`), in `µs`.
+    bool repeat = false;
+
+    // ### `Ticker.Schedule()`
+    // Private function returning the calling thread's attached tickers.
+    static std::vector<Ticker*>& Schedule() {
+        static thread_local std::vector<Ticker*> tickers;
+        return tickers;
+    }
+
+    // Casts `function` and `argument` back to their attached types and makes the call.
+    template <typename TArg>
+    static void Invoke(void (*function)(), void* argument) {
+        ((void (*)(TArg*))function)((TArg*)argument);
+    }
+
+    void Attach(uint32_t us, bool repeating, std::function<void(void)> function) {
+        detach();
+        callback = function;
+        Start(us, repeating);
+    }
+
+    template <typename TArg>
+    void Attach(uint32_t us, bool repeating, void (*call)(TArg*), TArg* arg) {
+        detach();
+        invoke = &Invoke<TArg>;
+        function = (void (*)())call;
+        argument = (void*)arg;
+        Start(us, repeating);
+    }
+
+    void Start(uint32_t us, bool repeating) {
+        interval = us;
+        repeat = repeating;
+        next = ClockMicros() + us;
+        Schedule().push_back(this);
+    }
+
+    // ### `Ticker.Fire()`
+    // Private function that calls the callback and reschedules (or detaches) the ticker.
+    // Tickers attached with a function and argument are called without copying (or allocating) anything.
+    void Fire() {
+        // The callback may re-attach or detach this ticker
+        void (*call)(void (*)(), void*) = invoke;
+        void (*raw)() = function;
+        void* arg = argument;
+        std::function<void(void)> copy;
+        if (call == nullptr) {
+            copy = callback;
+        }
+        if (repeat) {
+            next += interval;
+        }
+        else {
+            detach();
+        }
+        if (call != nullptr) {
+            call(raw, arg);
+        }
+        else {
+            copy();
+        }
+    }
+
+    // Returns the time timer 1 takes to run out from its written count, in `µs` (at least `1`).
+    static uint32_t Timer1Micros(const HostTimer1& timer) {
+        uint32_t divider = timer.divider == TIM_DIV256 ? 256 : timer.divider == TIM_DIV16 ? 16 : 1;
+        uint32_t us = (uint32_t)(((uint64_t)timer.ticks * divider + 79) / 80);      // `80 MHz`, rounded up
+        return us > 0 ? us : 1;
+    }
+
+    // ### `Ticker::Due()`
+    // Private function returning whether anything is scheduled, and the earliest deadline in `deadline`: that of the
+    // returned ticker, or of timer 1 if it returns `nullptr`. Timer 1 is started first if it was written since.
+    static bool Due(uint32_t& deadline, Ticker*& ticker) {
+        HostTimer1& timer = HostTimer1State();
+        if (timer.written && timer.enabled) {
+            timer.written = false;
+            timer.running = true;
+            timer.deadline = ClockMicros() + Timer1Micros(timer);
+        }
+        ticker = Next(deadline);
+        if (timer.running && timer.enabled && (ticker == nullptr || Clock::Before(timer.deadline, deadline))) {
+            ticker = nullptr;
+            deadline = timer.deadline;
+            return true;
+        }
+        return ticker != nullptr;
+    }
+
+    // ### `Ticker::Fire()`
+    // Private function firing `ticker`, or timer 1 if it is `nullptr` (reloading or stopping it first).
+    static void Fire(Ticker* ticker) {
+        if (ticker != nullptr) {
+            ticker->Fire();
+            return;
+        }
+        HostTimer1& timer = HostTimer1State();
+        if (timer.loop) {
+            timer.deadline += Timer1Micros(timer);
+        }
+        else {
+            timer.running = false;
+        }
+        if (timer.handler != nullptr) {
+            timer.handler();
+        }
+    }
+
+public:
+    Ticker() { }
+    Ticker(const Ticker&) = delete;
+    Ticker& operator=(const Ticker&) = delete;
+
+    ~Ticker() {
+        detach();
+    }
+
+    void attach(float seconds, std::function<void(void)> function) {
+        Attach((uint32_t)(seconds * 1000000), true, function);
+    }
+
+    void attach_ms(uint32_t milliseconds, std::function<void(void)> function) {
+        Attach(milliseconds * 1000, true, function);
+    }
+
+    // As on the ESP8266, `function(arg)` is called: a plain function and pointer are stored, so nothing is allocated.
+    template <typename TArg>
+    void attach_ms(uint32_t milliseconds, void (*function)(TArg*), TArg* arg) {
+        Attach(milliseconds * 1000, true, function, arg);
+    }
+
+    void once(float seconds, std::function<void(void)> function) {
+        Attach((uint32_t)(seconds * 1000000), false, function);
+    }
+
+    void once_ms(uint32_t milliseconds, std::function<void(void)> function) {
+        Attach(milliseconds * 1000, false, function);
+    }
+
+    void detach() {
+        std::vector<Ticker*>& tickers = Schedule();
+        tickers.erase(std::remove(tickers.begin(), tickers.end(), this), tickers.end());
+        callback = nullptr;
+        invoke = nullptr;
+    }
+
+    bool active() {
+        return (bool)callback || invoke != nullptr;
+    }
+
+    // ### `Ticker.Next()`
+    // Returns the attached ticker with the earliest deadline (`nullptr` if none), and its deadline in `deadline`.
+    static Ticker* Next(uint32_t& deadline) {
+        Ticker* earliest = nullptr;
+        for (Ticker* ticker : Schedule()) {
+            if (earliest == nullptr || Clock::Before(ticker->next, earliest->next)) {
+                earliest = ticker;
+            }
+        }
+        if (earliest != nullptr) {
+            deadline = earliest->next;
+        }
+        return earliest;
+    }
+
+    // ### `Ticker.RunDue()`
+    // Fires every ticker (and timer 1) whose deadline has been reached by the active clock, earliest first.
+    // Returns the number of callbacks made.
+    static size_t RunDue() {
+        size_t fired = 0;
+        uint32_t deadline;
+        Ticker* ticker;
+        while (Due(deadline, ticker) && Clock::Reached(ClockMicros(), deadline)) {
+            Fire(ticker);
+            fired++;
+        }
+        return fired;
+    }
+
+    friend size_t AdvanceClock(VirtualClock& clock, uint64_t us);
+};
+
+
+
+// ### `AdvanceClock()`
+// Moves a `VirtualClock` forward by `us` microseconds, stopping at each ticker (and timer 1) deadline on the way to
+// fire it, so every callback sees the clock at exactly its scheduled time. Returns the number of callbacks made.
+// The clock should be the active one (see `ClockScope`).
+inline size_t AdvanceClock(VirtualClock& clock, uint64_t us) {
+    uint64_t end = clock.Now() + us;
+    size_t fired = 0;
+    uint32_t deadline;
+    Ticker* ticker;
+    while (Ticker::Due(deadline, ticker)) {
+        uint64_t at = clock.Now();
+        if (!Clock::Before(deadline, clock.Micros())) {
+            at += Clock::Elapsed(clock.Micros(), deadline);
+        }
+        if (at > end) {
+            break;
+        }
+        clock.Set(at);
+        Ticker::Fire(ticker);
+        fired++;
+    }
+    clock.Set(end);
+    return fired;
+}
+
+
+
+#endif // HOST_TICKER_H
\ No newline at end of file
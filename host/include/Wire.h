@@ -0,0 +1,114 @@
+/****************************************************************
+*                                                               *
+*   Wire.h                                                      *
+*                                                               *
+*   Minimal host stand-in for the Arduino Wire (I2C) library.   *
+*                                                               *
+*****************************************************************/
+// There is no I2C bus on the host: a transaction goes to whatever function is attached at its address (see
+// `TwoWire::Attach()`), which serves the device's 16-bit registers, as the INA219 stand-in (`Adafruit_INA219.h`) does.
+// Only what register-oriented drivers use is modelled: setting the register pointer (and writing a register) with
+// `beginTransmission()`/`write()`/`endTransmission()`, and reading the register it points to with `requestFrom()`.
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+
+// ## HostI2CDevice
+// A device on the host's I2C bus: reads (`write` false) or writes one of its registers, returning `false` if it
+// doesn't acknowledge.
+typedef bool (*HostI2CDevice)(uint8_t reg, uint16_t& value, bool write);
+
+
+
+class TwoWire {
+private:
+    uint8_t address = 0;
+    uint8_t sent[3] = {};           // Register pointer, then the value to write (high byte first).
+    size_t sent_length = 0;
+    uint8_t received[2] = {};
+    size_t received_length = 0;
+    size_t received_index = 0;
+    uint8_t pointers[128] = {};     // Each device's register pointer.
+
+    static HostI2CDevice& Device(uint8_t address) {
+        static HostI2CDevice devices[128] = {};
+        return devices[address & 127];
+    }
+
+public:
+    // ### `TwoWire::Attach()`
+    // Puts a device on the bus at `address` (on every `TwoWire`).
+    static void Attach(uint8_t address, HostI2CDevice device) {
+        Device(address) = device;
+    }
+
+    void begin() { }
+    void begin(int, int) { }
+    void setClock(unsigned long) { }
+
+    void beginTransmission(uint8_t address) {
+        this->address = address & 127;
+        sent_length = 0;
+    }
+
+    size_t write(uint8_t data) {
+        if (sent_length == sizeof(sent)) {
+            return 0;
+        }
+        sent[sent_length++] = data;
+        return 1;
+    }
+
+    // Returns `0` on success, or `2` if no device acknowledged (as the Arduino library does).
+    uint8_t endTransmission(bool stop = true) {
+        (void)stop;
+        HostI2CDevice device = Device(address);
+        if (device == nullptr) {
+            return 2;
+        }
+        if (sent_length == 0) {
+            uint16_t value = 0;
+            return device(pointers[address], value, false) ? 0 : 2;    // An address probe
+        }
+        pointers[address] = sent[0];
+        uint16_t value = (uint16_t)(sent[1] << 8 | sent[2]);
+        if (!device(sent[0], value, sent_length == 3)) {
+            return 2;
+        }
+        return 0;
+    }
+
+    // Reads up to two bytes of the register the device's pointer is at; returns how many were read (`0` if it didn't
+    // acknowledge).
+    uint8_t requestFrom(uint8_t address, uint8_t quantity) {
+        address &= 127;
+        HostI2CDevice device = Device(address);
+        uint16_t value = 0;
+        received_index = received_length = 0;
+        if (device == nullptr || !device(pointers[address], value, false)) {
+            return 0;
+        }
+        received[0] = (uint8_t)(value >> 8);
+        received[1] = (uint8_t)value;
+        received_length = quantity < 2 ? quantity : 2;
+        return (uint8_t)received_length;
+    }
+
+    int available() {
+        return (int)(received_length - received_index);
+    }
+
+    int read() {
+        return received_index < received_length ? received[received_index++] : -1;
+    }
+};
+
+inline TwoWire Wire;
+
+
+
+#endif // HOST_WIRE_H
\ No newline at end of file
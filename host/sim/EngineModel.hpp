@@ -0,0 +1,229 @@
+/****************************************************************
+*                                                               *
+*   EngineModel.hpp                                             *
+*                                                               *
+*   Physics model of the solenoid engine, for host simulation.  *
+*                                                               *
+*****************************************************************/
+#ifndef ENGINE_MODEL_HPP
+#define ENGINE_MODEL_HPP
+
+#include <math.h>
+#include <stdint.h>
+#include <random>
+#include "Sensors/INA219.hpp"
+#include "Engine/StrokeMath.hpp"
+
+
+
+// ### `ENGINE_LOAD_COEFFICIENT`
+// Load torque per speed squared, in `N·m·s²/rad²`, that the crank must deliver for the firmware's power-out formula
+// (`rpm³·x_avg/1829397` in `W`, see `ComputeStrokeData()`) to be the mechanical power the model actually produces:
+// `P = k·ω³` with `ω = rpm·π/30`. With any other load, the reported efficiency isn't the model's.
+#define ENGINE_LOAD_COEFFICIENT (float)(STROKE_AVERAGE_DISPLACEMENT * (30 / M_PI) * (30 / M_PI) * (30 / M_PI) / 1829397.0)
+
+
+
+// ## EngineParameters
+// Physical parameters of the simulated engine. The defaults approximate the bench engine (~740 RPM at `6.6 V`, ~30%
+// efficient). The coil's thermal constants are the ones `INA219` uses to infer its temperature, so the firmware's
+// inference is exact apart from measurement noise.
+struct EngineParameters {
+    float supply_voltage = 6.6f;                                    // Open-circuit supply voltage, in `V`.
+    float source_resistance = 0.2f;                                 // Supply and wiring resistance, in `Ω`.
+    float shunt_resistance = 0.1f;                                  // INA219 shunt, in `Ω`.
+    float coil_resistance = INA219::reference_resistance;           // Coil resistance at `INA219::reference_temperature`, in `Ω`.
+    float temperature_coefficient = INA219::temperature_coefficient;    // Coil resistance temperature coefficient, in `1/°C`.
+    float coil_inductance = 0.005f;                                 // In `H`.
+    float flyback_voltage = 0.7f;                                   // Flyback diode drop, in `V`.
+    float force_constant = 8.f;                                     // Plunger force per ampere squared, in `N/A²`.
+    float crank_radius = STROKE_AVERAGE_DISPLACEMENT / 2;           // In `m`.
+    float inertia = 1e-4f;                                          // Crank, flywheel and piston, in `kg·m²`.
+    float load_coefficient = ENGINE_LOAD_COEFFICIENT;               // Load torque per speed squared, in `N·m·s²/rad²`.
+    float viscous_friction = 0;                                     // Losses outside the load, in `N·m·s/rad`.
+    float coulomb_friction = 1e-3f;                                 // In `N·m`.
+    float ambient_temperature = INA219::reference_temperature;      // In `°C`.
+    float initial_temperature = INA219::reference_temperature;      // Coil temperature at the start, in `°C`.
+    float thermal_resistance = 15.f;                                // Coil to ambient, in `°C/W`.
+    float thermal_capacitance = 20.f;                               // Coil, in `J/°C`.
+    float initial_angle = 0.3f;                                     // Crank angle at the start, in `rad`.
+    float initial_speed = 20.f;                                     // Hand start, in `rad/s`.
+    float current_noise = 0.5f;                                     // INA219 current noise, in `mA` rms.
+    float voltage_noise = 2.f;                                      // INA219 bus voltage noise, in `mV` rms.
+    uint32_t seed = 1;                                              // Seed of the measurement noise.
+};
+
+
+
+// ## EngineModel
+// Lumped model of the engine, integrated in fixed time steps:
+// - Crank: `J·dω/dt = F·r·sin(θ) − a·ω² − b·ω − c`, where the plunger force is `F = k·i²` and `a·ω²` is the load the
+//   firmware's power-out formula assumes (`ENGINE_LOAD_COEFFICIENT`). The switch is closed (HIGH) while
+//   `0 ≤ θ < π`, which is when the coil is connected to the supply; each switch edge is one stroke (half a revolution).
+//   Once `DriveCoil()` is called, the coil is connected by a controller instead (the switch is then only sensed).
+// - Coil: `L·di/dt = V − i·(R(T) + R_source + R_shunt)` while connected; afterwards the current decays through the
+//   flyback diode, outside the INA219's shunt. `R(T) = R_ref·(1 + α·(T − T_ref))`.
+// - Thermal: `C·dT/dt = i²·R(T) − (T − T_ambient)/R_thermal`.
+// The plunger's back-EMF and the supply's own dynamics are neglected: the coil draws the same current at any speed,
+// so the efficiency grows with the supply voltage (the input power goes as `V²`, the speed as `V`). Exact switch edge times are interpolated
+// within a step, so the firmware's timing error can be measured against them.
+class EngineModel {
+private:
+    EngineParameters parameters;
+    std::mt19937 random;
+    std::normal_distribution<float> noise{0.f, 1.f};
+
+    double time = 0;            // Simulated time, in `s`.
+    double angle;               // Crank angle, in `rad` (`0 ≤ angle < 2π`).
+    double speed;               // In `rad/s`.
+    double current = 0;         // Coil current, in `A`.
+    double temperature;         // Coil temperature, in `°C`.
+    bool driven = false;        // Whether the coil is switched by `DriveCoil()` rather than the switch.
+    bool jammed = false;        // Whether the crank is seized (see `Jam()`).
+    double fouling = 0;         // Switch contact resistance over part of the stroke (see `Foul()`), in `Ω`.
+    bool coil_on = false;
+
+    // ### `EngineModel.Quantize()`
+    // Private function rounding a value to a multiple of an INA219 register's LSB.
+    static float Quantize(float value, float lsb) {
+        return roundf(value / lsb) * lsb;
+    }
+
+public:
+    // ### `EngineModel.edge`
+    // Set by `Step()` when the switch changed state during the step: its new state and exact time, in `s`.
+    struct Edge {
+        bool happened;
+        bool state;
+        double time;
+    } edge = {false, false, 0};
+
+    // ## EngineModel
+    // Lumped model of the engine.
+    // ### Parameters
+    // - `parameters` - The engine's physical parameters.
+    EngineModel(const EngineParameters& parameters)
+        : parameters(parameters),
+          random(parameters.seed),
+          angle(parameters.initial_angle),
+          speed(parameters.initial_speed),
+          temperature(parameters.initial_temperature) { }
+
+    // ### `EngineModel.SwitchClosed()`
+    // Checks if the switch is currently closed (HIGH), i.e. the coil is connected to the supply.
+    bool SwitchClosed() const {
+        return angle < M_PI;
+    }
+
+    // ### `EngineModel.DriveCoil()`
+    // Connects (`on`) or disconnects the coil from the supply, as a controller's MOSFET would, from now on in place of
+    // the switch.
+    void DriveCoil(bool on) {
+        driven = true;
+        coil_on = on;
+    }
+
+    // ### `EngineModel.Jam()`
+    // Seizes the crank where it is (e.g. a failing bearing), holding it there from now on.
+    void Jam() {
+        jammed = true;
+        speed = 0;
+    }
+
+    // ### `EngineModel.Foul()`
+    // Adds `resistance` to the switch's contact over the middle third of the stroke (e.g. a pitted or dirty contact),
+    // from now on. The switch still reads closed, so only the current shows it.
+    void Foul(double resistance) {
+        fouling = resistance;
+    }
+
+    // ### `EngineModel.Connected()`
+    // Checks if the coil is currently connected to the supply (by the switch, or the controller once driven).
+    bool Connected() const {
+        return driven ? coil_on : SwitchClosed();
+    }
+
+    // ### `EngineModel.CoilResistance()`
+    // Returns the coil's resistance at its current temperature, in `Ω`.
+    double CoilResistance() const {
+        return parameters.coil_resistance * (1 + parameters.temperature_coefficient * (temperature - INA219::reference_temperature));
+    }
+
+    double Time() const { return time; }                        // In `s`.
+    double Speed() const { return speed; }                      // In `rad/s`.
+    double Rpm() const { return speed * 30 / M_PI; }
+    double Current() const { return current; }                  // Coil current, in `A`.
+    double Temperature() const { return temperature; }          // Coil temperature, in `°C`.
+
+    // ### `EngineModel.SupplyCurrent()`
+    // Returns the current through the INA219's shunt, in `A` (zero while the coil is disconnected).
+    double SupplyCurrent() const {
+        return Connected() ? current : 0;
+    }
+
+    // ### `EngineModel.Step()`
+    // Advances the model by `dt` seconds, setting `edge` if the switch changed state.
+    void Step(double dt) {
+        const EngineParameters& p = parameters;
+        bool closed = SwitchClosed();
+        double resistance = CoilResistance();
+
+        if (Connected()) {
+            double contact = !driven && angle >= M_PI / 3 && angle < 2 * M_PI / 3 ? fouling : 0;
+            current += (p.supply_voltage - current * (resistance + contact + p.source_resistance + p.shunt_resistance)) / p.coil_inductance * dt;
+        }
+        else if (current > 0) {
+            current -= (current * resistance + p.flyback_voltage) / p.coil_inductance * dt;
+            if (current < 0) {
+                current = 0;
+            }
+        }
+
+        double torque = p.force_constant * current * current * p.crank_radius * sin(angle);
+        if (speed > 0) {
+            torque -= (p.load_coefficient * speed + p.viscous_friction) * speed + p.coulomb_friction;
+        }
+        speed += torque / p.inertia * dt;
+        if (speed < 0 || jammed) {
+            speed = 0;          // Stalled (the crank doesn't run backwards)
+        }
+
+        temperature += (current * current * resistance - (temperature - p.ambient_temperature) / p.thermal_resistance) / p.thermal_capacitance * dt;
+
+        double previous = angle;
+        angle += speed * dt;
+        double boundary = closed ? M_PI : 2 * M_PI;
+        edge.happened = previous < boundary && angle >= boundary;
+        if (edge.happened) {
+            edge.state = !closed;
+            edge.time = time + dt * (boundary - previous) / (angle - previous);
+        }
+        if (angle >= 2 * M_PI) {
+            angle -= 2 * M_PI;
+        }
+        time += dt;
+    }
+
+    // ### `EngineModel.UpdateReadings()`
+    // Sets what the (shimmed) INA219 reads now, with noise and register quantization
+    // (the `32V_2A` calibration: `4 mV` bus, `10 µV` shunt, `0.1 mA` current and `2 mW` power LSBs).
+    void UpdateReadings() {
+        const EngineParameters& p = parameters;
+        double supply_current = SupplyCurrent();
+        float current_mA = supply_current * 1000 + p.current_noise * noise(random);
+        float bus_V = p.supply_voltage - supply_current * (p.source_resistance + p.shunt_resistance) + p.voltage_noise / 1000 * noise(random);
+        float shunt_mV = current_mA * p.shunt_resistance;
+        current_mA = Quantize(current_mA, 0.1f);
+        bus_V = Quantize(bus_V, 0.004f);
+        Adafruit_INA219::SetReadings(
+            bus_V,
+            Quantize(shunt_mV, 0.01f),
+            current_mA,
+            Quantize(bus_V * current_mA, 2.f)
+        );
+    }
+};
+
+
+
+#endif // ENGINE_MODEL_HPP
\ No newline at end of file
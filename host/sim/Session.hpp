@@ -0,0 +1,565 @@
+/****************************************************************
+*                                                               *
+*   Session.hpp                                                 *
+*                                                               *
+*   One simulated run of the firmware pipeline on the host.     *
+*                                                               *
+*****************************************************************/
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include <stdint.h>
+#include <memory>
+#include <functional>
+#include "EngineModel.hpp"
+#include "Statistic.hpp"
+#include "Clock.h"
+#include "Events.h"
+#include "Sensors.h"
+#include "Controllers.h"
+#include "Engine/StrokeAnalyzer.hpp"
+#include "Engine/CrankProfile.hpp"
+#include "Engine/Watchdog.hpp"
+#include "Engine/EngineState.hpp"
+#include "Engine/ThermalModel.hpp"
+#include "Engine/SpectralMonitor.hpp"
+#include "Telemetry/Metrics.hpp"
+#include "Telemetry/SerialTelemetry.hpp"
+#include "WebServer/Data.hpp"
+
+// ### `SIM_SWITCH_PIN`
+// GPIO pin of the simulated switch (`SWITCH1_PIN` in the firmware).
+#define SIM_SWITCH_PIN 14
+
+// ### `SIM_COIL_PIN`
+// GPIO pin of the simulated coil MOSFET (`COIL_PIN` in the firmware), driven by the `SolenoidController`.
+#define SIM_COIL_PIN 12
+
+// ### `SIM_UART_FIFO_SIZE`
+// Size of the ESP8266 UART's transmit FIFO, in bytes (there is no other transmit buffer).
+#define SIM_UART_FIFO_SIZE 128
+
+
+
+// ## SimulatedUart
+// A serial port that drains its transmit FIFO at the configured baud rate (10 bits per byte) as the active clock
+// advances, so `SerialTelemetry` sees the same back-pressure as on the ESP8266. What is written is discarded.
+class SimulatedUart : public HardwareSerial {
+private:
+    unsigned long baud = 0;
+    size_t queued = 0;              // Bytes waiting in the FIFO.
+    uint32_t drained_at = 0;        // Time (`ClockMicros()`) up to which the FIFO has been drained, in `µs`.
+
+    void Drain() {
+        uint32_t now = ClockMicros();
+        if (queued == 0 || baud == 0) {
+            queued = 0;
+            drained_at = now;
+            return;
+        }
+        uint64_t bytes = (uint64_t)Clock::Elapsed(drained_at, now) * baud / 10000000;
+        if (bytes >= queued) {
+            queued = 0;
+            drained_at = now;
+        }
+        else {
+            queued -= bytes;
+            drained_at += (uint32_t)(bytes * 10000000 / baud);
+        }
+    }
+
+public:
+    using HardwareSerial::write;
+
+    // ### `SimulatedUart.written`
+    // Total bytes accepted for transmission.
+    uint64_t written = 0;
+
+    void begin(unsigned long rate) override {
+        baud = rate;
+        queued = 0;
+        drained_at = ClockMicros();
+    }
+
+    size_t write(uint8_t) override {
+        Drain();
+        if (baud != 0 && queued >= SIM_UART_FIFO_SIZE) {
+            return 0;
+        }
+        queued++;
+        written++;
+        return 1;
+    }
+
+    int availableForWrite() override {
+        Drain();
+        return baud == 0 ? SIM_UART_FIFO_SIZE : (int)(SIM_UART_FIFO_SIZE - queued);
+    }
+};
+
+
+
+// ## SessionConfig
+// What to simulate, and how the firmware is set up.
+struct SessionConfig {
+    EngineParameters engine;
+    double duration = 60;                                   // Simulated time, in `s`.
+    uint32_t step = 5;                                      // Integration step, in `µs`.
+    uint32_t switch_interval = 1;                           // `switch1.Begin()` interval, in `ms` (cranking, running or over-temperature).
+    uint32_t switch_phase = 0;                              // Delay before the switch is first polled, in `µs` (its phase against the crank).
+    uint32_t sample_interval = 2;                           // `ina219.Begin()` interval, in `ms` (likewise).
+    uint32_t tachometer_interval = 5;                       // `tachometer.Begin()` interval, in `ms` (likewise).
+    size_t tachometer_window = TACHOMETER_WINDOW;           // Revolutions the tachometer averages over.
+    size_t sensor_buffer_size = 20;                         // Size of each `SensorBuffer` in `ina219.measurements` (not used by strokes).
+    uint32_t loop_interval = 200;                           // Time between `loop()` iterations, in `µs`.
+    bool telemetry = false;                                 // Whether the serial telemetry sink is enabled.
+    unsigned long telemetry_baud = SERIAL_TELEMETRY_BAUD;
+    uint64_t start_time = 0;                                // Initial clock value, in `µs` (e.g. just before a `micros()` wrap).
+    bool capture = false;                                   // Whether to arm a `BurstCapture`.
+    BurstTrigger capture_trigger = BurstTrigger::RISING_EDGE;
+    int32_t capture_level = 0;                              // Its trigger level (`µA` or hundredths of a `°F`).
+    double capture_at = 1;                                  // When to arm it, in `s`.
+    bool controller = false;                                // Whether a `SolenoidController` drives the coil (instead of the switch).
+    float controller_advance = 0;                           // Its advance and dwell, in `controller_timing` units.
+    float controller_dwell = 180;
+    CoilTiming controller_timing = CoilTiming::DEGREES;
+    uint32_t controller_interval = 100;                     // `controller.Begin()` interval, in `ms`.
+    bool tuner = false;                                     // Whether a `TimingTuner` tunes the controller (if `controller`).
+    double jam_at = -1;                                     // When to jam the crank (at the next rising edge, so the coil stays on), in `s` (`< 0` = never).
+    double i2c_fail_at = -1;                                // When the INA219's transactions start failing, in `s` (`< 0` = never).
+    double foul_at = -1;                                    // When the switch's contact fouls, in `s` (`< 0` = never),
+    float foul_resistance = 1.5f;                           // adding this much over the middle of the stroke, in `Ω`.
+};
+
+
+
+// ## SimulatedStroke
+// One stroke as the firmware computed it, with the model's exact values for comparison.
+struct SimulatedStroke {
+    StrokeRecord record;        // What the firmware computed (and would serve/record).
+    double true_rpm;            // From the model's exact switch edge times.
+    double edge_delay;          // Time from the true falling edge to the firmware's detection of it, in `µs`.
+    uint32_t samples;           // INA219 readings taken during the stroke.
+    float energy;               // Electrical energy drawn during the stroke, in `J`.
+    float peak_current;         // Highest current read during the stroke, in `A`.
+};
+
+
+
+// ## SessionStats
+// Summary of a simulated run.
+struct SessionStats {
+    uint32_t true_strokes = 0;          // Strokes the model completed.
+    uint32_t strokes = 0;               // Strokes the firmware detected.
+    Statistic true_rpm;
+    Statistic rpm;                      // As computed by the firmware.
+    Statistic rpm_error;                // Firmware relative to true rpm, in `%`.
+    Statistic tachometer_rpm;           // As estimated by the `Tachometer`.
+    Statistic tachometer_rpm_error;     // Relative to the true mean rpm over the same revolutions, in `%`.
+    Statistic tachometer_acceleration;  // In `rad/s²`.
+    Statistic edge_delay;               // In `µs`.
+    Statistic samples;                  // INA219 readings per stroke.
+    Statistic efficiency;               // As computed by the firmware, in `%`.
+    uint32_t telemetry_sent = 0;
+    uint32_t telemetry_dropped = 0;
+    uint32_t ticker_callbacks = 0;
+    uint32_t coil_pulses = 0;           // Completed by the `SolenoidController` (if `config.controller`).
+    uint32_t coil_pulses_late = 0;
+    uint32_t coil_latency_max = 0;      // Longest turn-on latency, in `ns`.
+    float tuned_advance = 0;            // Best timing found by the `TimingTuner` (if `config.tuner`), in degrees.
+    float tuned_dwell = 0;
+    uint32_t tuner_windows = 0;
+    uint32_t tuner_improvements = 0;
+    uint32_t stalls = 0;                // Faults raised by the `Watchdog`.
+    uint32_t overruns = 0;
+    uint32_t silences = 0;
+    uint32_t i2c_faults = 0;
+    double stall_delay = -1;            // From the jam (if `config.jam_at`) to the first `ENGINE_STALL`, in `s` (`< 0` = none).
+    bool polling = false;               // Whether the INA219 was still being polled at the end.
+    double state_time[(size_t)EngineState::ENGINE_STATE_COUNT] = {};   // Time spent in each `EngineState`, in `s`.
+    uint32_t state_changes = 0;
+    Statistic temperature_error;        // `ThermalModel` temperature relative to the model's, at each stroke, in `°C`.
+    Statistic stroke_temperature_error; // The strokes' inferred temperature relative to the model's (what it filters), in `°C`.
+    uint32_t overheat_warnings = 0;     // `OVERHEAT_PREDICTED` events.
+    double overheat_predicted_at = -1;  // Time of the first one, in `s` (`< 0` = none).
+    double overheat_at = -1;            // Time the model's coil first reached `THERMAL_LIMIT`, in `s` (`< 0` = never).
+    double estimated_temperature = 0;   // `ThermalModel` coil temperature at the end, in `°C`.
+    uint32_t spectral_blocks = 0;       // Blocks completed by the `SpectralMonitor`.
+    uint32_t spectral_alerts = 0;       // `SPECTRAL_BAND_EXCEEDED` events.
+    double spectral_alert_at = -1;      // Time of the first one, in `s` (`< 0` = none),
+    float spectral_alert_order = 0;     // and its band's order.
+    SpectralBand spectral_bands[SPECTRAL_BANDS] = {};  // At the end.
+    double final_rpm = 0;               // Model speed at the end.
+    double final_temperature = 0;       // Model coil temperature at the end, in `°C`.
+};
+
+
+
+// ## Session
+// Runs the real firmware pipeline (`Switch`, `Tachometer`, `INA219`, `StrokeAnalyzer`, `CrankProfile`, `Watchdog`,
+// `EngineStateMachine`, `ThermalModel`, `SpectralMonitor`, the stroke, state and overheat handlers of `main.cpp` and optionally
+// `SerialTelemetry` and a `SolenoidController` driving the coil) against an `EngineModel`, on a `VirtualClock` and the host shim's pins, tickers and INA219,
+// as fast as the host allows. Everything runs on the calling thread, and everything it touches (including `Metrics`,
+// which it resets) is per thread, so sessions on different threads are independent.
+// ```c++
+// SessionConfig config;
+// config.engine.supply_voltage = 12;
+// SessionStats stats = Session(config).Run();
+// ```
+class Session {
+private:
+    SessionConfig config;
+
+public:
+    // ### `Session.on_stroke`
+    // Optional callback receiving every stroke the firmware computes.
+    std::function<void(const SimulatedStroke&)> on_stroke;
+
+    // ### `Session.on_profile`
+    // Optional callback receiving the `CrankProfile` of the whole run, at its end.
+    std::function<void(const CrankProfile&)> on_profile;
+
+    // ### `Session.on_tuner`
+    // Optional callback receiving the `TimingTuner` at the end of the run (if `config.tuner`).
+    std::function<void(const TimingTuner&)> on_tuner;
+
+    // ### `Session.on_capture`
+    // Optional callback receiving the `BurstCapture` at the end of the run (if `config.capture`, whatever its state).
+    std::function<void(const BurstCapture&)> on_capture;
+
+    Session(const SessionConfig& config) : config(config) { }
+
+    // ### `Session.Run()`
+    // Simulates `config.duration` seconds and returns the summary.
+    SessionStats Run() {
+        SessionStats stats;
+        VirtualClock clock(config.start_time);
+        ClockScope scope(clock);
+        EngineModel model(config.engine);
+        HostSetPin(SIM_SWITCH_PIN, model.SwitchClosed());
+        model.UpdateReadings();
+
+        EventEmitter event_emitter;
+        Switch switch1(event_emitter, SIM_SWITCH_PIN);
+        EngineStateMachine engine(event_emitter);           // Before the objects whose handlers read its state
+        for (EngineState state : {EngineState::CRANKING, EngineState::RUNNING, EngineState::OVER_TEMPERATURE}) {
+            EngineStateProfile profile = engine.Profile(state);
+            profile.switch_interval = config.switch_interval;
+            profile.sample_interval = config.sample_interval;
+            profile.tachometer_interval = config.tachometer_interval;
+            engine.SetProfile(state, profile);
+        }
+        INA219 ina219(event_emitter, 4, 5);
+        ina219.measurements.power.Resize(config.sensor_buffer_size);
+        ina219.measurements.voltage.Resize(config.sensor_buffer_size);
+        ina219.measurements.current.Resize(config.sensor_buffer_size);
+        ina219.measurements.resistance.Resize(config.sensor_buffer_size);
+        ina219.measurements.temperature.Resize(config.sensor_buffer_size);
+        SimulatedUart uart;
+        std::unique_ptr<SerialTelemetry> telemetry;         // Only listening for edges when enabled
+        if (config.telemetry) {
+            telemetry.reset(new SerialTelemetry(event_emitter, uart));
+            telemetry->Begin(config.telemetry_baud);
+            ina219.AddSampleListener(telemetry.get());
+        }
+        StrokeAnalyzer stroke_analyzer(event_emitter);
+        ina219.AddSampleListener(&stroke_analyzer);
+        CrankProfile crank_profile(event_emitter);
+        ina219.AddSampleListener(&crank_profile);
+        BurstCapture burst_capture(event_emitter, ina219);
+        uint64_t capture_step = (uint64_t)(config.capture_at * 1000000 / config.step);
+        std::unique_ptr<SolenoidController> controller;    // Only driving the coil when enabled
+        if (config.controller) {
+            controller.reset(new SolenoidController(event_emitter, SIM_SWITCH_PIN, SIM_COIL_PIN));
+            controller->SetTiming(config.controller_advance, config.controller_dwell, config.controller_timing);
+        }
+        std::unique_ptr<TimingTuner> tuner;
+        if (controller && config.tuner) {
+            tuner.reset(new TimingTuner(event_emitter, *controller, config.controller_advance, config.controller_dwell));
+        }
+        Watchdog watchdog(event_emitter, ina219);
+        ina219.AddSampleListener(&watchdog);
+        ThermalModel thermal(event_emitter);
+        thermal.SetParameters(config.engine.thermal_resistance, config.engine.thermal_capacitance);
+        thermal.SetAmbient(config.engine.ambient_temperature);
+        ina219.AddSampleListener(&thermal);
+        SpectralMonitor spectral(event_emitter);
+        ina219.AddSampleListener(&spectral);
+        if (telemetry) {
+            spectral.SetOnBand([&](const SpectralBand& band, size_t index) { telemetry->OnBand(band, index); });
+        }
+        Responder spectral_listener(event_emitter, {EventType::SPECTRAL_BAND_EXCEEDED});
+        spectral_listener.SetOnEvent([&](const Event& event) {
+            if (stats.spectral_alert_at < 0) {
+                stats.spectral_alert_at = (clock.Now() - config.start_time) / 1000000.0;
+                stats.spectral_alert_order = event.value;
+            }
+        });
+        const double limit = (THERMAL_LIMIT - 32) * 5 / 9.0;       // In `°C`
+        uint64_t jam_step = config.jam_at < 0 ? UINT64_MAX : (uint64_t)(config.jam_at * 1000000 / config.step);
+        uint64_t i2c_fail_step = config.i2c_fail_at < 0 ? UINT64_MAX : (uint64_t)(config.i2c_fail_at * 1000000 / config.step);
+        uint64_t foul_step = config.foul_at < 0 ? UINT64_MAX : (uint64_t)(config.foul_at * 1000000 / config.step);
+        double jammed_at = -1;
+        Responder watchdog_listener(event_emitter, {EventType::ENGINE_STALL});
+        watchdog_listener.SetOnEvent([&](const Event&) {
+            if (jammed_at >= 0 && stats.stall_delay < 0) {
+                stats.stall_delay = (clock.Now() - config.start_time) / 1000000.0 - jammed_at;
+            }
+        });
+
+        Metrics::Reset();
+
+        // Exact edge times from the model, in `µs` since the start
+        double true_rise = -1, true_fall = -1, previous_rise = -1;
+        double true_rises[TACHOMETER_MAX_WINDOW + 1];      // The last rising edges, newest at `true_rise_count % size`
+        size_t true_rise_count = 0;
+
+        // The tachometer on the same pin, checked against the true mean rpm over the revolutions it averaged
+        Tachometer tachometer(event_emitter, SIM_SWITCH_PIN, config.tachometer_window);
+        Responder tachometer_listener(event_emitter, {EventType::TACHOMETER_RPM, EventType::TACHOMETER_ACCELERATION});
+        tachometer_listener.SetOnEvent([&](const Event& event) {
+            if (event.type == EventType::TACHOMETER_ACCELERATION) {
+                stats.tachometer_acceleration.Add(event.value);
+                return;
+            }
+            size_t periods = tachometer.periods;
+            if (event.value == 0 || periods == 0 || true_rise_count <= periods) {
+                return;
+            }
+            const size_t size = TACHOMETER_MAX_WINDOW + 1;
+            double span = true_rises[(true_rise_count - 1) % size] - true_rises[(true_rise_count - 1 - periods) % size];
+            double true_rpm = 60.0 * periods / (span / 1000000.0);
+            stats.tachometer_rpm.Add(event.value);
+            stats.tachometer_rpm_error.Add((event.value - true_rpm) / true_rpm * 100);
+        });
+
+        // Same as `engine_OnEvent()`, `thermal_OnEvent()`, `ina219_OnEvent()` and `stroke_analyzer_OnStroke()` in
+        // main.cpp (with a controller, the INA219 is polled continuously, from the first edge after a stall)
+        EngineState timed_state = engine.State();           // The state `state_entered` is the start of
+        uint64_t state_entered = clock.Now();
+        Responder engine_listener(event_emitter, {EventType::ENGINE_STATE_CHANGE});
+        engine_listener.SetOnEvent([&](const Event& event) {
+            const EngineStateProfile& profile = engine.Profile();
+            stats.state_time[(size_t)timed_state] += (clock.Now() - state_entered) / 1000000.0;
+            state_entered = clock.Now();
+            timed_state = (EngineState)event.value;
+            switch1.Begin(profile.switch_interval);
+            if (profile.sample_interval == 0) {
+                ina219.StopPolling();
+            }
+            tachometer.Begin(profile.tachometer_interval, !controller);
+            if (profile.watchdog_interval == 0) {
+                watchdog.StopPolling();
+            }
+            else if (!watchdog.IsPolling()) {
+                watchdog.Begin(profile.watchdog_interval);
+            }
+            thermal.Begin(profile.thermal_interval);
+            crank_profile.enabled = profile.accumulate;
+            spectral.enabled = profile.accumulate;
+            if (tuner) {
+                tuner->enabled = profile.accumulate;
+            }
+        });
+        Responder thermal_listener(event_emitter, {EventType::OVERHEAT_PREDICTED, EventType::OVERHEAT_CLEARED});
+        thermal_listener.SetOnEvent([&](const Event& event) {
+            if (event.type == EventType::OVERHEAT_PREDICTED) {
+                stats.overheat_warnings++;
+                if (stats.overheat_predicted_at < 0) {
+                    stats.overheat_predicted_at = (clock.Now() - config.start_time) / 1000000.0;
+                }
+            }
+            if (tuner) {
+                tuner->SetDwellLimit(event.type == EventType::OVERHEAT_PREDICTED ? TIMING_TUNER_HOT_DWELL : TIMING_TUNER_MAX_DWELL);
+            }
+        });
+        ina219.RegisterForEvents({
+            EventType::SWITCH1_STATE_CHANGE_TO_LOW,
+            EventType::SWITCH1_STATE_CHANGE_TO_HIGH
+        });
+        ina219.SetOnEvent([&](const Event& event) {
+            if (event.type == EventType::SWITCH1_STATE_CHANGE_TO_LOW) {
+                if (!controller) {
+                    ina219.StopPolling();
+                }
+            }
+            else if (event.type == EventType::SWITCH1_STATE_CHANGE_TO_HIGH) {
+                ina219.reading_began = event.time;
+                if (!controller && engine.Profile().sample_interval != 0) {
+                    ina219.Begin(engine.Profile().sample_interval);
+                }
+            }
+            if (controller && !ina219.IsPolling() && engine.Profile().sample_interval != 0) {
+                ina219.Begin(engine.Profile().sample_interval);
+            }
+        });
+        stroke_analyzer.SetOnStroke([&](const StrokeAnalysis& analysis) {
+            double now = (double)(clock.Now() - config.start_time);
+            SimulatedStroke stroke;
+            stroke.record.time = analysis.time;
+            stroke.record.data = analysis.data;
+            double rise = true_fall > true_rise ? true_rise : previous_rise;
+            stroke.true_rpm = (true_fall >= 0 && rise >= 0) ? 30.0 / ((true_fall - rise) / 1000000.0) : 0;
+            stroke.edge_delay = true_fall >= 0 ? now - true_fall : 0;
+            stroke.samples = analysis.samples;
+            stroke.energy = analysis.energy;
+            stroke.peak_current = analysis.peak_current;
+
+            stats.strokes++;
+            stats.rpm.Add(stroke.record.data.speed);
+            stats.edge_delay.Add(stroke.edge_delay);
+            stats.samples.Add(stroke.samples);
+            stats.efficiency.Add(stroke.record.data.efficiency);
+            if (stroke.true_rpm > 0) {
+                stats.true_rpm.Add(stroke.true_rpm);
+                stats.rpm_error.Add((stroke.record.data.speed - stroke.true_rpm) / stroke.true_rpm * 100);
+            }
+            if (analysis.samples >= ENGINE_TEMPERATURE_SAMPLES) {
+                stats.stroke_temperature_error.Add((analysis.data.temperature - 32) * 5 / 9.0 - model.Temperature());
+            }
+            stats.temperature_error.Add((thermal.Temperature() - 32) * 5 / 9.0 - model.Temperature());
+            engine.OnTemperature(thermal.Temperature(), analysis.time);
+            if (tuner) {
+                tuner->OnStroke(analysis);
+            }
+            if (on_stroke) {
+                on_stroke(stroke);
+            }
+        });
+        uint64_t switch_step = config.switch_phase / config.step;
+        if (switch_step == 0) {
+            switch1.Begin(engine.Profile().switch_interval);
+        }
+        crank_profile.enabled = engine.Profile().accumulate;
+        spectral.enabled = engine.Profile().accumulate;
+        if (tuner) {
+            tuner->enabled = engine.Profile().accumulate;
+        }
+        if (controller) {
+            controller->SetTachometer(&tachometer);     // One interrupt handler per pin, as on the ESP8266
+        }
+        tachometer.Begin(engine.Profile().tachometer_interval, !controller);
+        if (controller) {
+            controller->Begin(config.controller_interval);
+        }
+        if (tuner) {
+            tuner->Begin(config.controller_interval);
+        }
+        if (engine.Profile().watchdog_interval != 0) {
+            watchdog.Begin(engine.Profile().watchdog_interval);
+        }
+        thermal.Begin(engine.Profile().thermal_interval);
+        if (switch1.last_state == 1) {          // As `setup()` does, for a stroke already under way
+            ina219.reading_began = ClockMicros();
+            engine.Input(EngineInput::EDGE, ina219.reading_began);
+            stroke_analyzer.Open(ina219.reading_began);
+            crank_profile.Open(ina219.reading_began);
+            ina219.Begin(engine.Profile().sample_interval);
+        }
+
+        uint64_t steps = (uint64_t)(config.duration * 1000000 / config.step);
+        uint64_t next_loop = clock.Now();
+        for (uint64_t i = 0; i < steps; i++) {
+            if (i == switch_step && i > 0) {
+                switch1.Begin(engine.Profile().switch_interval);
+            }
+            if (config.capture && i == capture_step) {
+                burst_capture.Arm(config.capture_trigger, config.capture_level);
+            }
+            if (i == i2c_fail_step) {
+                Adafruit_INA219::Readings().failing = true;
+            }
+            if (i == foul_step) {
+                model.Foul(config.foul_resistance);
+            }
+            if (controller) {
+                model.DriveCoil(HostPins()[SIM_COIL_PIN] == HIGH);
+            }
+            model.Step(config.step / 1000000.0);
+            if (stats.overheat_at < 0 && model.Temperature() >= limit) {
+                stats.overheat_at = model.Time();
+            }
+            if (model.edge.happened && model.edge.state && i >= jam_step && jammed_at < 0) {
+                model.Jam();
+                jammed_at = model.edge.time;
+            }
+            if (model.edge.happened) {
+                double at = model.edge.time * 1000000;
+                if (model.edge.state) {
+                    previous_rise = true_rise;
+                    true_rise = at;
+                    true_rises[true_rise_count++ % (TACHOMETER_MAX_WINDOW + 1)] = at;
+                }
+                else {
+                    true_fall = at;
+                    stats.true_strokes++;
+                }
+                HostSetPin(SIM_SWITCH_PIN, model.edge.state);
+            }
+            if (ina219.IsPolling() || burst_capture.IsPolling()) {
+                model.UpdateReadings();
+            }
+            AdvanceClock(clock, config.step);
+            if (clock.Now() >= next_loop) {
+                if (telemetry) {
+                    telemetry->Flush();
+                }
+                next_loop += config.loop_interval;
+            }
+        }
+        stats.state_time[(size_t)engine.State()] += (clock.Now() - state_entered) / 1000000.0;
+        stats.state_changes = engine.changes;
+        stats.polling = ina219.IsPolling();
+        stats.stalls = watchdog.stalls;
+        stats.overruns = watchdog.overruns;
+        stats.silences = watchdog.silences;
+        stats.i2c_faults = watchdog.i2c_faults;
+        watchdog.StopPolling();
+        thermal.StopPolling();
+        stats.estimated_temperature = (thermal.Temperature() - 32) * 5 / 9.0;
+        stats.spectral_blocks = spectral.blocks;
+        stats.spectral_alerts = spectral.alerts;
+        for (size_t band = 0; band < SPECTRAL_BANDS; band++) {
+            stats.spectral_bands[band] = spectral.Band(band);
+        }
+        Adafruit_INA219::Readings().failing = false;
+        switch1.StopPolling();
+        tachometer.StopPolling();
+        ina219.StopPolling();
+        burst_capture.StopPolling();
+        if (tuner) {
+            tuner->Stop();
+            stats.tuned_advance = tuner->Advance();
+            stats.tuned_dwell = tuner->Dwell();
+            stats.tuner_windows = tuner->windows;
+            stats.tuner_improvements = tuner->improvements;
+            if (on_tuner) {
+                on_tuner(*tuner);
+            }
+        }
+        if (controller) {
+            controller->Update();
+            controller->Stop();
+            stats.coil_pulses = controller->pulses;
+            stats.coil_pulses_late = controller->late;
+            stats.coil_latency_max = controller->latency_peak;
+        }
+
+        stats.telemetry_sent = Metrics::Get(Counter::TELEMETRY_PACKETS_SENT);
+        stats.telemetry_dropped = Metrics::Get(Counter::TELEMETRY_PACKETS_DROPPED);
+        stats.ticker_callbacks = Metrics::Get(Counter::TICKER_CALLBACKS);
+        stats.final_rpm = model.Rpm();
+        stats.final_temperature = model.Temperature();
+        if (on_profile) {
+            on_profile(crank_profile);
+        }
+        if (config.capture && on_capture) {
+            on_capture(burst_capture);
+        }
+        return stats;
+    }
+};
+
+
+
+#endif // SESSION_HPP
\ No newline at end of file
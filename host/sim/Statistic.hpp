@@ -0,0 +1,61 @@
+/****************************************************************
+*                                                               *
+*   Statistic.hpp                                               *
+*                                                               *
+*   Running summary statistics of a series, for host tools.     *
+*                                                               *
+*****************************************************************/
+#ifndef STATISTIC_HPP
+#define STATISTIC_HPP
+
+#include <cmath>
+#include <float.h>
+#include <stdint.h>
+
+
+
+// ## Statistic
+// Running count/mean/standard deviation/min/max of a series (Welford's algorithm).
+// Non-finite values (e.g. the efficiency of a stroke with no INA219 readings) are ignored.
+struct Statistic {
+    uint32_t count = 0;
+    double mean = 0;
+    double m2 = 0;
+    double min = DBL_MAX;
+    double max = -DBL_MAX;
+
+    void Add(double value) {
+        if (!std::isfinite(value)) {
+            return;
+        }
+        count++;
+        double delta = value - mean;
+        mean += delta / count;
+        m2 += delta * (value - mean);
+        min = value < min ? value : min;
+        max = value > max ? value : max;
+    }
+
+    // ### `Statistic.Merge()`
+    // Adds every value summarized by `other` (Chan et al.'s parallel combination), e.g. to combine per-thread results.
+    void Merge(const Statistic& other) {
+        if (other.count == 0) {
+            return;
+        }
+        uint32_t total = count + other.count;
+        double delta = other.mean - mean;
+        mean += delta * other.count / total;
+        m2 += other.m2 + delta * delta * ((double)count * other.count / total);
+        count = total;
+        min = other.min < min ? other.min : min;
+        max = other.max > max ? other.max : max;
+    }
+
+    double Deviation() const {
+        return count > 1 ? sqrt(m2 / (count - 1)) : 0;
+    }
+};
+
+
+
+#endif // STATISTIC_HPP
\ No newline at end of file
@@ -0,0 +1,182 @@
+/****************************************************************
+*                                                               *
+*   WorkStealingPool.hpp                                        *
+*                                                               *
+*   Thread pool with per-worker queues and work stealing.       *
+*                                                               *
+*****************************************************************/
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+
+
+// ## WorkStealingPool
+// Runs tasks on a fixed set of worker threads. Each worker has its own queue: it takes work from the back of
+// its own queue and, when that is empty, steals from the front of another worker's, so a worker that drew short
+// tasks doesn't sit idle while others still have a backlog. Tasks are handed out round-robin as they are submitted.
+// ```c++
+// WorkStealingPool pool;                   // One worker per core
+// for (size_t i = 0; i < count; i++) {
+//     pool.Submit([&, i] { results[i] = Session(configs[i]).Run(); });
+// }
+// pool.Wait();
+// ```
+class WorkStealingPool {
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    size_t next = 0;                            // Queue the next submitted task goes to.
+
+    std::mutex mutex;                           // Guards `queued`, `unfinished` and `stopping` for the waits below.
+    std::condition_variable wake;               // Signalled when tasks are queued, or when stopping.
+    std::condition_variable done;               // Signalled when the last unfinished task completes.
+    size_t queued = 0;                          // Tasks in the queues.
+    size_t unfinished = 0;                      // Tasks submitted but not completed.
+    bool stopping = false;
+    std::atomic<uint64_t> steals{0};
+
+    // ### `WorkStealingPool.Take()`
+    // Private function taking a task from the back of `queue` (`own`) or from its front (stealing).
+    bool Take(Queue& queue, bool own, std::function<void()>& task) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        if (own) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        return true;
+    }
+
+    // ### `WorkStealingPool.Find()`
+    // Private function finding a task for worker `index`: its own queue first, then the others' in turn.
+    bool Find(size_t index, std::function<void()>& task) {
+        size_t count = queues.size();
+        for (size_t i = 0; i < count; i++) {
+            if (Take(*queues[(index + i) % count], i == 0, task)) {
+                if (i != 0) {
+                    steals.fetch_add(1, std::memory_order_relaxed);
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Work(size_t index) {
+        std::function<void()> task;
+        while (true) {
+            if (Find(index, task)) {
+                task();
+                task = nullptr;
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--unfinished == 0) {
+                    done.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0) {
+                return;
+            }
+        }
+    }
+
+public:
+    // ## WorkStealingPool
+    // Thread pool with per-worker queues and work stealing.
+    // ### Parameters
+    // - `threads` - Number of worker threads (optional, default = one per hardware thread).
+    WorkStealingPool(size_t threads = 0) {
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+        if (threads == 0) {
+            threads = 1;
+        }
+        for (size_t i = 0; i < threads; i++) {
+            queues.emplace_back(new Queue());
+        }
+        for (size_t i = 0; i < threads; i++) {
+            workers.emplace_back(&WorkStealingPool::Work, this, i);
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // ### `WorkStealingPool.Submit()`
+    // Queues a task to run on one of the workers. Tasks must not throw.
+    void Submit(std::function<void()> task) {
+        Queue& queue = *queues[next];
+        next = (next + 1) % queues.size();
+        {
+            // Counted before it is queued, so a worker taking it at once can't count it off first
+            std::lock_guard<std::mutex> lock(mutex);
+            queued++;
+            unfinished++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    // ### `WorkStealingPool.Wait()`
+    // Blocks until every submitted task has completed.
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return unfinished == 0; });
+    }
+
+    // ### `WorkStealingPool.Size()`
+    // Returns the number of worker threads.
+    size_t Size() const {
+        return workers.size();
+    }
+
+    // ### `WorkStealingPool.Steals()`
+    // Returns the number of tasks a worker took from another worker's queue.
+    uint64_t Steals() const {
+        return steals.load(std::memory_order_relaxed);
+    }
+};
+
+
+
+#endif // WORK_STEALING_POOL_HPP
\ No newline at end of file
@@ -0,0 +1,34 @@
+/****************************************************************
+*                                                               *
+*   core.cpp                                                    *
+*                                                               *
+*   Host build of the platform-independent firmware core.       *
+*                                                               *
+*****************************************************************/
+// Compiles every header of the sensor/event core, the controllers, the LEDs, the clock and the telemetry/history serialization
+// against the host shim (`host/include`), so a change that breaks the host build is caught by the `core` target
+// even when no tool happens to include the header it touched.
+#include "Clock.h"
+#include "Events.h"
+#include "Sensors.h"
+#include "Controllers.h"
+#include "LEDs.h"
+#include "Engine.h"
+#include "Telemetry/Metrics.hpp"
+#include "Telemetry/Protocol.hpp"
+#include "Telemetry/LockFreeRing.hpp"
+#include "Telemetry/SerialTelemetry.hpp"
+#include "Telemetry/RunLogFormat.hpp"
+#include "Telemetry/RunLogReplay.hpp"
+#include "WebServer/Data.hpp"
+#include "WebServer/Serialize.hpp"
+#include "WebServer/HistoryStream.hpp"
+#include "WebServer/DownsampleStream.hpp"
+
+
+
+// Instantiate the history templates the firmware uses, so their bodies are compiled too.
+template class HistoryStream<FixedSample, SAMPLE_HISTORY_SIZE>;
+template class HistoryStream<StrokeRecord, STROKE_HISTORY_SIZE>;
+template class DownsampleStream<FixedSample, SampleHistory>;
+template class DownsampleStream<StrokeRecord, StrokeHistory>;
\ No newline at end of file
@@ -0,0 +1,16 @@
+/****************************************************************
+*                                                               *
+*   Clock.h                                                     *
+*                                                               *
+*   Include file for:                                           *
+*     - Clock.hpp                                               *
+*     - TimerWheel.hpp                                          *
+*                                                               *
+*****************************************************************/
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "Clock/Clock.hpp"
+#include "Clock/TimerWheel.hpp"
+
+#endif // CLOCK_H
\ No newline at end of file
@@ -0,0 +1,221 @@
+/****************************************************************
+*                                                               *
+*   Clock.hpp                                                   *
+*                                                               *
+*   Injectable time source for sensors, LEDs and the web layer. *
+*                                                               *
+*****************************************************************/
+#ifndef CLOCK_HPP
+#define CLOCK_HPP
+
+#include <stdint.h>
+#include <Arduino.h>
+
+// ### `CLOCK_THREAD_LOCAL`
+// Storage class of the active clock: one per thread on the host (so parallel simulations can each run their own
+// virtual time), a plain global on the ESP8266.
+#ifdef ARDUINO
+#define CLOCK_THREAD_LOCAL
+#else
+#define CLOCK_THREAD_LOCAL thread_local
+#endif
+
+// ### `CLOCK_CYCLES_PER_US`
+// CPU cycles per `µs` (`80` at the ESP8266's default 80 MHz), the unit of `ClockCycles()` timestamps.
+#ifndef CLOCK_CYCLES_PER_US
+#ifdef F_CPU
+#define CLOCK_CYCLES_PER_US (F_CPU / 1000000L)
+#else
+#define CLOCK_CYCLES_PER_US 80
+#endif
+#endif
+
+
+
+// ## Clock
+// Interface of a time source with `micros()`/`millis()` semantics: 32-bit timestamps that wrap around
+// (after ~71.6 minutes in `µs`, ~49.7 days in `ms`). Compare timestamps only with the wrap-safe helpers below.
+// Code reads time through `ClockMicros()`/`ClockMillis()` (i.e. `Clock::Active()`), never `micros()`/`millis()`
+// directly, so tests, the simulator and benchmarks can substitute a `VirtualClock`.
+class Clock {
+private:
+    // ### `Clock.ActiveSlot()`
+    // Private function returning the (per-thread on the host) pointer to the active clock (`nullptr` = hardware clock).
+    static Clock*& ActiveSlot() {
+        static CLOCK_THREAD_LOCAL Clock* active = nullptr;
+        return active;
+    }
+
+public:
+    virtual ~Clock() { }
+
+    // ### `Clock.Micros()`
+    // Returns the current time, in `µs`.
+    virtual uint32_t Micros() = 0;
+
+    // ### `Clock.Millis()`
+    // Returns the current time, in `ms`.
+    virtual uint32_t Millis() = 0;
+
+    // ### `Clock.Cycles()`
+    // Returns the current time, in CPU cycles (`CLOCK_CYCLES_PER_US` per `µs`), wrapping like the cycle counter.
+    // Clocks without a finer time source count `Micros()` in cycles.
+    virtual uint32_t Cycles() {
+        return Micros() * (uint32_t)CLOCK_CYCLES_PER_US;
+    }
+
+    // ### `Clock.Active()`
+    // Returns the clock in use (the hardware clock unless another was set with `SetActive()`).
+    static Clock& Active();
+
+    // ### `Clock.SetActive()`
+    // Makes `clock` the clock in use (on the host, for the calling thread only). `nullptr` restores the hardware clock.
+    static void SetActive(Clock* clock) {
+        ActiveSlot() = clock;
+    }
+
+    // ### `Clock.Elapsed()`
+    // Returns the time from `since` to `now` (in the timestamps' unit), correct across one wraparound.
+    static uint32_t Elapsed(uint32_t since, uint32_t now) {
+        return now - since;
+    }
+
+    // ### `Clock.Before()`
+    // Checks if timestamp `a` is earlier than timestamp `b` (valid while they are less than half the range apart).
+    static bool Before(uint32_t a, uint32_t b) {
+        return (int32_t)(a - b) < 0;
+    }
+
+    // ### `Clock.Reached()`
+    // Checks if `now` is at or past `deadline` (valid while they are less than half the range apart).
+    static bool Reached(uint32_t now, uint32_t deadline) {
+        return !Before(now, deadline);
+    }
+};
+
+
+
+// ## HardwareClock
+// The board's own clock (`micros()`/`millis()`).
+class HardwareClock : public Clock {
+public:
+    uint32_t Micros() override {
+        return (uint32_t)micros();
+    }
+
+    uint32_t Millis() override {
+        return (uint32_t)millis();
+    }
+};
+
+
+
+// ## VirtualClock
+// A clock that only moves when told to, for running timing-dependent code deterministically and faster than real time.
+// Keeps a 64-bit time internally and reports it truncated to 32 bits, so it wraps exactly like the hardware clock.
+// ```c++
+// VirtualClock clock;
+// Clock::SetActive(&clock);
+// clock.Advance(2000);                 // 2 ms pass instantly
+// ```
+class VirtualClock : public Clock {
+private:
+    uint64_t now;       // Current time, in `µs`.
+
+public:
+    // ## VirtualClock
+    // A clock that only moves when told to.
+    // ### Parameters
+    // - `start` (optional) - Initial time, in `µs` (e.g. just before a wraparound, to exercise wrap handling).
+    VirtualClock(uint64_t start = 0) : now(start) { }
+
+    uint32_t Micros() override {
+        return (uint32_t)now;
+    }
+
+    uint32_t Millis() override {
+        return (uint32_t)(now / 1000);
+    }
+
+    // ### `VirtualClock.Advance()`
+    // Moves the clock forward by `us` microseconds.
+    void Advance(uint64_t us) {
+        now += us;
+    }
+
+    // ### `VirtualClock.Set()`
+    // Moves the clock to `us` microseconds.
+    void Set(uint64_t us) {
+        now = us;
+    }
+
+    // ### `VirtualClock.Now()`
+    // Returns the current time, in `µs`, without wrapping.
+    uint64_t Now() const {
+        return now;
+    }
+};
+
+
+
+inline Clock& Clock::Active() {
+    static HardwareClock hardware;
+    Clock* active = ActiveSlot();
+    return active != nullptr ? *active : hardware;
+}
+
+
+
+// ## ClockScope
+// Makes a clock the active one for the lifetime of this object, then restores the previous one.
+// ```c++
+// VirtualClock clock;
+// ClockScope scope(clock);
+// ```
+class ClockScope {
+private:
+    Clock* previous;
+
+public:
+    ClockScope(Clock& clock) {
+        previous = &Clock::Active();
+        Clock::SetActive(&clock);
+    }
+
+    ~ClockScope() {
+        Clock::SetActive(previous);
+    }
+
+    ClockScope(const ClockScope&) = delete;
+    ClockScope& operator=(const ClockScope&) = delete;
+};
+
+
+
+// ### `ClockMicros()`
+// Returns the active clock's time, in `µs` (use in place of `micros()`).
+inline uint32_t ClockMicros() {
+    return Clock::Active().Micros();
+}
+
+// ### `ClockMillis()`
+// Returns the active clock's time, in `ms` (use in place of `millis()`).
+inline uint32_t ClockMillis() {
+    return Clock::Active().Millis();
+}
+
+// ### `ClockCycles()`
+// Returns the time in CPU cycles (`CLOCK_CYCLES_PER_US` per `µs`, wrapping every ~53.7 s at 80 MHz).
+// On the ESP8266 this reads the cycle counter itself (one instruction, inlined, bypassing `Clock::Active()`), so it is
+// safe to call from an interrupt handler; on the host it is the active clock's `Cycles()`.
+inline uint32_t ClockCycles() {
+#ifdef ARDUINO
+    return ESP.getCycleCount();
+#else
+    return Clock::Active().Cycles();
+#endif
+}
+
+
+
+#endif // CLOCK_HPP
\ No newline at end of file
@@ -0,0 +1,134 @@
+/****************************************************************
+*                                                               *
+*   TimerWheel.hpp                                              *
+*                                                               *
+*   Hashed timing wheel of O(1) timeouts.                       *
+*                                                               *
+*****************************************************************/
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+// ## WheelTimer
+// One timeout of a `TimerWheel`: a node of the list of its slot, owned (and allocated) by whoever arms it.
+// Identify which one expired by its address.
+struct WheelTimer {
+    WheelTimer* prev = nullptr;     // Neighbours in the slot's list (`nullptr` while not armed).
+    WheelTimer* next = nullptr;
+    uint32_t deadline = 0;          // Tick it expires at.
+
+    // ### `WheelTimer.Armed()`
+    // Checks if the timer is armed (i.e. hasn't expired or been cancelled since).
+    bool Armed() const {
+        return next != nullptr;
+    }
+};
+
+
+
+// ## TimerWheel
+// A hashed timing wheel: a fixed ring of `SLOTS` lists of `WheelTimer`s, the timers of tick `t` kept in slot
+// `t % SLOTS`. Arming, re-arming and cancelling a timer only link or unlink it (`O(1)`, nothing allocated), so a timeout
+// can be pushed back on every event, e.g. on every reading; each tick only walks the timers of one slot. A timer
+// further than `SLOTS` ticks away stays in its slot and is skipped until its round comes.
+// The wheel has no clock of its own: whoever owns it calls `Advance()` once per tick (in whatever unit it chose).
+// ### Parameters
+// - `SLOTS` - The number of slots (a power of two; about the number of ticks the usual timeouts span).
+// ```c++
+// TimerWheel<64> wheel;
+// WheelTimer timeout;
+// wheel.Arm(timeout, 50);                         // Expires on the 50th `Advance()` from now
+// wheel.Advance([&](WheelTimer& timer) { ... });   // Calls back with each timer expiring at the new tick
+// ```
+template <size_t SLOTS>
+class TimerWheel {
+private:
+    static_assert(SLOTS > 0 && (SLOTS & (SLOTS - 1)) == 0, "SLOTS must be a power of two");
+
+    WheelTimer slots[SLOTS];        // Sentinel of each slot's circular list.
+    uint32_t now = 0;               // Current tick.
+
+    void Link(WheelTimer& timer) {
+        WheelTimer& head = slots[timer.deadline & (SLOTS - 1)];
+        timer.prev = head.prev;
+        timer.next = &head;
+        head.prev->next = &timer;
+        head.prev = &timer;
+    }
+
+    void Unlink(WheelTimer& timer) {
+        timer.prev->next = timer.next;
+        timer.next->prev = timer.prev;
+        timer.prev = timer.next = nullptr;
+    }
+
+public:
+    TimerWheel() {
+        for (size_t slot = 0; slot < SLOTS; slot++) {
+            slots[slot].prev = slots[slot].next = &slots[slot];
+        }
+    }
+
+    // The slots' lists point into the wheel itself
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // ### `TimerWheel.Now()`
+    // Returns the current tick (the number of `Advance()` calls, wrapping around).
+    uint32_t Now() const {
+        return now;
+    }
+
+    // ### `TimerWheel.ArmAt()`
+    // Arms `timer` to expire at tick `deadline` (at the next tick if that has passed), re-arming it if it was armed.
+    void ArmAt(WheelTimer& timer, uint32_t deadline) {
+        if (timer.Armed()) {
+            Unlink(timer);
+        }
+        timer.deadline = (int32_t)(deadline - now) > 0 ? deadline : now + 1;
+        Link(timer);
+    }
+
+    // ### `TimerWheel.Arm()`
+    // Arms `timer` to expire `ticks` ticks from now (at least one), re-arming it if it was armed.
+    void Arm(WheelTimer& timer, uint32_t ticks) {
+        ArmAt(timer, now + ticks);
+    }
+
+    // ### `TimerWheel.Cancel()`
+    // Disarms `timer`, if it was armed.
+    void Cancel(WheelTimer& timer) {
+        if (timer.Armed()) {
+            Unlink(timer);
+        }
+    }
+
+    // ### `TimerWheel.Advance()`
+    // Moves on to the next tick, disarming each timer that expires at it and calling `expired(timer)` for it.
+    // `expired` may arm or cancel any timer, including the one it was given.
+    template <typename Callback>
+    void Advance(Callback&& expired) {
+        now++;
+        WheelTimer& head = slots[now & (SLOTS - 1)];
+        for (;;) {
+            // Rescanned after every callback, which may have changed the list
+            WheelTimer* timer = head.next;
+            while (timer != &head && timer->deadline != now) {
+                timer = timer->next;
+            }
+            if (timer == &head) {
+                return;
+            }
+            Unlink(*timer);
+            expired(*timer);
+        }
+    }
+};
+
+
+
+#endif // TIMER_WHEEL_HPP
\ No newline at end of file
@@ -0,0 +1,18 @@
+/****************************************************************
+*                                                               *
+*   Controllers.h                                               *
+*                                                               *
+*   Include file for:                                           *
+*     - Controller.hpp                                          *
+*     - SolenoidController.hpp                                  *
+*     - TimingTuner.hpp                                         *
+*                                                               *
+*****************************************************************/
+#ifndef CONTROLLERS_H
+#define CONTROLLERS_H
+
+#include "Controllers/Controller.hpp"
+#include "Controllers/SolenoidController.hpp"
+#include "Controllers/TimingTuner.hpp"
+
+#endif // CONTROLLERS_H
\ No newline at end of file
@@ -0,0 +1,94 @@
+/****************************************************************
+*                                                               *
+*   Controller.hpp                                              *
+*                                                               *
+*   Controller base-class declaration.                          *
+*   All objects driving the engine inherit from this class.     *
+*                                                               *
+*****************************************************************/
+#ifndef CONTROLLER_HPP
+#define CONTROLLER_HPP
+
+#include <vector>
+#include <functional>
+#include <Ticker.h>
+#include <Arduino.h>
+#include "Events/Event.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Events/EventListener.hpp"
+#include "Telemetry/Metrics.hpp"
+
+
+
+// ## Controller
+// Base class for all objects driving the engine (the counterpart of `Sensor`, which only observes it).
+// A controller acts on the engine from its own interrupt handlers; its `Update()` is called periodically from a
+// `Ticker`, for the work that can wait (publishing what it measured, adjusting its settings).
+// The `events` and `handler` parameters are optional, and if not given, can be set later with the `RegisterForEvents` and `SetOnEvent` functions, respectively.
+// ### Parameters
+// - `e` - The global `EventEmitter` object.
+// - `events` - A list of event types (the controller will be registered to receive events of these types).
+// - `handler` - An `onEvent` function that will be called whenever the controller receives an event it is registered for.
+class Controller : public EventListener {
+protected:
+    // ### `Controller.timer`
+    // Protected `Ticker` object that the controller binds its `Update` method to.
+    Ticker timer;
+
+    // ### `Controller.emitter`
+    // Protected reference to the global `EventEmitter` object, for adding this controller to its vector of listeners during object instantiation.
+    EventEmitter& emitter;
+
+public:
+    // ## Controller
+    // Base class for all objects driving the engine.
+    // ### Parameters
+    // - `e` - The global `EventEmitter` object.
+    // - `events` - A list of event types (the controller will be registered to receive events of these types).
+    // - `handler` - An `onEvent` function that will be called whenever the controller receives an event it is registered for.
+    Controller(
+        EventEmitter& e,
+        const std::vector<EventType>& events = {},
+        std::function<void(const Event&)> handler = nullptr
+    ) : EventListener(events, handler), emitter(e) { emitter.AddEventListener(this); }
+
+    // ### `Controller.Begin()`
+    // Begins the periodic updates of the controller.
+    // ### Parameters
+    // - `update_interval` - How long to wait between each update, in milliseconds.
+    void Begin(float update_interval) {
+        timer.attach_ms(update_interval, &Controller::UpdateTrampoline, this);
+    }
+
+    // ### `Controller.UpdateTrampoline()`
+    // Calls `controller->Poll()` (attached with the controller as the `Ticker`'s argument, so nothing is allocated).
+    static void UpdateTrampoline(Controller* controller) {
+        controller->Poll();
+    }
+
+    // ### `Controller.Poll()`
+    // The function actually bound to the `Ticker`: counts the callback in `Metrics`, then calls `Update()`.
+    void Poll() {
+        Metrics::Increment(Counter::TICKER_CALLBACKS);
+        Update();
+    }
+
+    // ### `Controller.IsRunning()`
+    // Checks if the controller is being updated.
+    bool IsRunning() {
+        return timer.active();
+    }
+
+    // ### `Controller.Stop()`
+    // Stops the periodic updates of the controller.
+    void Stop() {
+        timer.detach();
+    }
+
+    // Pure virtual function to be implemented by derived classes
+    virtual void Update() = 0;
+};
+
+
+
+#endif // CONTROLLER_HPP
\ No newline at end of file
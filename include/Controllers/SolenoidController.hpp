@@ -0,0 +1,454 @@
+/****************************************************************
+*                                                               *
+*   SolenoidController.hpp                                      *
+*                                                               *
+*   Interrupt-driven coil timing (advance and dwell).           *
+*                                                               *
+*****************************************************************/
+#ifndef SOLENOID_CONTROLLER_HPP
+#define SOLENOID_CONTROLLER_HPP
+
+#include <math.h>
+#include <vector>
+#include <functional>
+#include <Arduino.h>
+#include "Controller.hpp"
+#include "Events/Event.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Telemetry/Metrics.hpp"
+#include "Clock/Clock.hpp"
+#include "Sensors/Tachometer.hpp"
+
+// ### `SOLENOID_MIN_PERIOD`
+// Shortest time between rising edges, in `µs`; an edge coming sooner after the last one is taken as contact bounce.
+#ifndef SOLENOID_MIN_PERIOD
+#define SOLENOID_MIN_PERIOD 2000
+#endif
+
+// ### `SOLENOID_STALL_TIME`
+// Time without an edge, in `µs`, after which the last revolution's period is no longer used to place the next pulse.
+#ifndef SOLENOID_STALL_TIME
+#define SOLENOID_STALL_TIME 1000000
+#endif
+
+// ### `SOLENOID_START_PULSE`
+// Longest pulse, in `µs`, while the timing is in degrees but no period is known (at `Begin()`, and after a stall).
+// Such a pulse follows the switch instead, ending at its falling edge, as the mechanical timing would.
+#ifndef SOLENOID_START_PULSE
+#define SOLENOID_START_PULSE 250000
+#endif
+
+// ### `SOLENOID_MIN_DELAY`
+// Shortest delay, in `µs`, worth scheduling on timer 1; a coil switch due sooner than this is made at once.
+#ifndef SOLENOID_MIN_DELAY
+#define SOLENOID_MIN_DELAY 2
+#endif
+
+// Timer 1 runs at `80 MHz / 16` whatever the CPU clock, and counts down at most `2^23 - 1` ticks (`1.67 s`). Its tick
+// must be a power of two of CPU cycles, so converting cycles to ticks is a shift.
+#define SOLENOID_TIMER_TICKS_PER_US 5
+#define SOLENOID_TIMER_MAX_TICKS 0x7FFFFF
+#define SOLENOID_TIMER_CYCLES_PER_TICK (CLOCK_CYCLES_PER_US / SOLENOID_TIMER_TICKS_PER_US)
+static_assert(SOLENOID_TIMER_CYCLES_PER_TICK * SOLENOID_TIMER_TICKS_PER_US == CLOCK_CYCLES_PER_US
+    && (SOLENOID_TIMER_CYCLES_PER_TICK & (SOLENOID_TIMER_CYCLES_PER_TICK - 1)) == 0,
+    "Timer 1's tick must be a power of two of CPU cycles (converting to ticks is then a shift)");
+
+
+
+// ## CoilTiming
+// Unit of a `SolenoidController`'s advance and dwell.
+// ### Defined units:
+// - `MICROSECONDS` - Fixed times, whatever the speed.
+// - `DEGREES` - Crank angles, converted to times with the period of the last revolution.
+enum class CoilTiming {
+    MICROSECONDS,
+    DEGREES,
+};
+
+
+
+// ## SolenoidController
+// Drives the coil through a GPIO pin (and a MOSFET) instead of leaving it to the mechanical switch, so the pulse can
+// start before the switch closes and end before it opens: the timing that lets the engine run faster.
+// Everything happens in interrupt context. The switch's rising edge interrupt timestamps the edge in cycles, measures
+// the revolution since the last one, and places the coil's next turn-on:
+// - `advance < 0` (retard): `|advance|` after the edge, on hardware timer 1
+// - `advance = 0`: at once, in the edge interrupt
+// - `advance > 0`: `advance` before the *next* edge, predicted one revolution (the last one's period) after this one
+// Timer 1's interrupt then turns the coil on, and off again `dwell` later. If the engine speeds up and an edge comes
+// before the pulse predicted for it, the pulse is fired at once and counted late (`COIL_PULSES_LATE`).
+// Until a revolution has been timed, timing in degrees falls back to the switch's own (on at the rising edge, off at
+// the falling edge). The coil is never on for more than one pulse per edge, and each pulse has a time limit, so a
+// stalled engine is never left with the coil on.
+// Every turn-on is timestamped after the pin is written, and its delay behind its target time (the edge itself when
+// firing at the edge) is the controller's latency; the time from the pin change to the edge interrupt's entry is not
+// included. `Update()` publishes the latency and the pulse counts to `Metrics`.
+// Timer 1 is used as a one-shot, so only one `SolenoidController` can run at a time. The switch pin's interrupt is
+// the controller's too (the ESP8266 keeps one handler per pin), so a `Tachometer` on the same pin is given its rising
+// edges with `SetTachometer()`, timestamped once for both.
+// ### Parameters
+// - `e` - The global `EventEmitter` object.
+// - `switch_pin` - The GPIO pin of the switch (interrupt-capable, i.e. not GPIO16).
+// - `coil_pin` - The GPIO pin driving the coil's MOSFET (HIGH is on).
+// ### Example Instantiation
+// ```
+// #define SWITCH_PIN 14
+// #define COIL_PIN 12
+// EventEmitter event_emitter;
+// SolenoidController controller(event_emitter, SWITCH_PIN, COIL_PIN);
+// controller.SetTiming(20, 150, CoilTiming::DEGREES);
+// controller.SetTachometer(&tachometer);
+// tachometer.Begin(5, false);
+// controller.Begin(1000);
+// ```
+class SolenoidController : public Controller {
+private:
+    enum Phase : uint8_t {
+        IDLE,                   // Coil off, nothing scheduled.
+        ON_PENDING,             // Coil off, timer 1 turns it on at `on_at`.
+        ON,                     // Coil on, timer 1 turns it off at `off_at`.
+    };
+
+    // ### `SolenoidController::owner`
+    // The controller timer 1 was attached for (its interrupt handler takes no argument). One per thread on the host,
+    // like the simulated timer 1 itself.
+    static inline CLOCK_THREAD_LOCAL SolenoidController* owner = nullptr;
+
+    const int switch_pin;
+    const int coil_pin;
+    Tachometer* tachometer = nullptr;           // Given the rising edges too (see `SetTachometer()`).
+
+    // Set by `SetTiming()`: in `µs`, or in `1/65536` of a revolution
+    volatile int32_t advance = 0;
+    volatile uint32_t dwell = 0;
+    volatile bool degrees = false;
+
+    // Owned by the interrupt handlers (all times in cycles)
+    volatile Phase phase = IDLE;
+    volatile uint32_t last_edge = 0;
+    volatile bool have_edge = false;
+    volatile uint32_t period = 0;               // Of the last revolution (`0` if unknown).
+    volatile uint32_t on_at = 0;                // Target of the pending turn-on.
+    volatile uint32_t off_at = 0;
+    volatile uint32_t next_on = 0;              // Turn-on placed by an edge while the coil was on.
+    volatile bool next_pending = false;
+    volatile bool following = false;            // Whether the pulse on follows the switch (no period known).
+    volatile bool predicted = false;            // Whether the last edge placed a pulse ahead of this revolution's edge.
+
+    // Counted by the interrupt handlers, taken by `Update()`
+    volatile uint32_t pulses_counted = 0;
+    volatile uint32_t late_counted = 0;
+    volatile uint32_t latency_sum = 0;          // Over the turn-ons since the last update, in cycles.
+    volatile uint32_t latency_count = 0;
+    volatile uint32_t latency_longest = 0;
+
+    // Returns `value` (in the unit of `degrees`) in cycles, with `revolution` cycles per revolution. An angle is below
+    // `2^16`, so the product is split at bit 16 and kept in 32 bits (a 64-bit one would call libgcc, in flash).
+    uint32_t IRAM_ATTR Cycles(uint32_t value, uint32_t revolution) const {
+        if (degrees) {
+            return (revolution >> 16) * value + (((revolution & 0xFFFF) * value) >> 16);
+        }
+        return value * (uint32_t)CLOCK_CYCLES_PER_US;
+    }
+
+    void IRAM_ATTR WriteCoil(bool on) {
+#ifdef ARDUINO
+        if (coil_pin < 16) {
+            if (on) {
+                GPOS = 1 << coil_pin;
+            }
+            else {
+                GPOC = 1 << coil_pin;
+            }
+            return;
+        }
+#endif
+        digitalWrite(coil_pin, on ? HIGH : LOW);
+    }
+
+    // Starts timer 1 to run out at `target` (clamped to its range).
+    static void IRAM_ATTR StartTimer(uint32_t target, uint32_t now) {
+        uint32_t ticks = (target - now) / (uint32_t)SOLENOID_TIMER_CYCLES_PER_TICK;
+        timer1_write(ticks > SOLENOID_TIMER_MAX_TICKS ? SOLENOID_TIMER_MAX_TICKS : ticks < 1 ? 1 : ticks);
+    }
+
+    // ### `SolenoidController.TurnOn()`
+    // Private function turning the coil on for its target time `target`, recording the latency, and scheduling the off.
+    void IRAM_ATTR TurnOn(uint32_t target) {
+        WriteCoil(true);
+        uint32_t now = ClockCycles();
+        int32_t behind = (int32_t)(now - target);
+        uint32_t lag = behind < 0 ? 0 : (uint32_t)behind;
+        latency_sum = latency_sum + lag;
+        latency_count = latency_count + 1;
+        latency_longest = lag > latency_longest ? lag : latency_longest;
+        phase = ON;
+        following = degrees && period == 0;
+        off_at = now + (following ? (uint32_t)SOLENOID_START_PULSE * CLOCK_CYCLES_PER_US : Cycles(dwell, period));
+        StartTimer(off_at, now);
+    }
+
+    // ### `SolenoidController.ScheduleOn()`
+    // Private function turning the coil on at `target`: on timer 1, or at once if it is (nearly) due.
+    void IRAM_ATTR ScheduleOn(uint32_t target) {
+        uint32_t now = ClockCycles();
+        if ((int32_t)(target - now) < (int32_t)(SOLENOID_MIN_DELAY * CLOCK_CYCLES_PER_US)) {
+            TurnOn(target);
+            return;
+        }
+        phase = ON_PENDING;
+        on_at = target;
+        StartTimer(target, now);
+    }
+
+    // ### `SolenoidController::EdgeTrampoline()`
+    // The switch pin's interrupt handler (for both edges): calls `controller->OnEdge()` (and the tachometer's) or
+    // `controller->OnFall()`. All it reaches is in IRAM: these handlers, the core's `digitalRead()`, `digitalWrite()`
+    // and `timer1_write()`, and the tachometer's queue push (inlined); the arithmetic stays in 32 bits.
+    static void IRAM_ATTR EdgeTrampoline(void* controller) {
+        SolenoidController* self = (SolenoidController*)controller;
+        if (digitalRead(self->switch_pin) == HIGH) {
+            uint32_t now = ClockCycles();
+            self->OnEdge(now);
+            if (self->tachometer != nullptr) {
+                self->tachometer->OnEdge(now);
+            }
+        }
+        else {
+            self->OnFall();
+        }
+    }
+
+    // ### `SolenoidController.TurnOff()`
+    // Private function ending the pulse on, and starting the one an edge placed meanwhile (if any).
+    void IRAM_ATTR TurnOff() {
+        WriteCoil(false);
+        phase = IDLE;
+        following = false;
+        pulses_counted = pulses_counted + 1;
+        if (next_pending) {
+            next_pending = false;
+            ScheduleOn(next_on);
+        }
+    }
+
+    // ### `SolenoidController.OnFall()`
+    // Private function handling one falling edge: ends a pulse that follows the switch (timer 1 then finds nothing to do).
+    void IRAM_ATTR OnFall() {
+        if (phase == ON && following) {
+            TurnOff();
+        }
+    }
+
+    // ### `SolenoidController.OnEdge()`
+    // Private function handling one rising edge at `now`, in cycles (in interrupt context: no events, no `Metrics`,
+    // nothing in flash).
+    void IRAM_ATTR OnEdge(uint32_t now) {
+        if (have_edge) {
+            uint32_t since = now - last_edge;
+            if (since < (uint32_t)SOLENOID_MIN_PERIOD * CLOCK_CYCLES_PER_US) {
+                return;
+            }
+            period = since < (uint32_t)SOLENOID_STALL_TIME * CLOCK_CYCLES_PER_US ? since : 0;
+        }
+        last_edge = now;
+        have_edge = true;
+
+        bool covered = predicted;
+        predicted = false;
+        if (phase == ON_PENDING) {
+            late_counted = late_counted + 1;        // The engine came round before the predicted edge
+            TurnOn(now);
+        }
+        uint32_t target = now;
+        int32_t a = advance;
+        if (a < 0) {
+            target = now + Cycles((uint32_t)-a, period);
+        }
+        else if (a > 0 && period != 0) {
+            uint32_t lead = Cycles((uint32_t)a, period);
+            target = lead < period ? now + (period - lead) : now;
+            predicted = true;
+            if (!covered && phase == IDLE) {
+                TurnOn(now);                        // Nothing was placed ahead of this edge (starting, or after a stall)
+            }
+        }
+        if (phase == ON) {
+            // Follows the pulse on, unless that is still on at the target (e.g. just after the timing changed)
+            next_pending = (int32_t)(target - off_at) > 0;
+            next_on = target;
+        }
+        else {
+            ScheduleOn(target);
+        }
+    }
+
+    // ### `SolenoidController::TimerTrampoline()`
+    // Timer 1's interrupt handler: calls `owner->OnTimer()`.
+    static void IRAM_ATTR TimerTrampoline() {
+        if (owner != nullptr) {
+            owner->OnTimer();
+        }
+    }
+
+    // ### `SolenoidController.OnTimer()`
+    // Private function making the coil switch timer 1 was started for.
+    void IRAM_ATTR OnTimer() {
+        if (phase == ON_PENDING) {
+            TurnOn(on_at);
+        }
+        else if (phase == ON) {
+            TurnOff();
+        }
+    }
+
+public:
+    // ### `SolenoidController.pulses`
+    // Coil pulses completed, as of the last `Update()`.
+    uint32_t pulses = 0;
+
+    // ### `SolenoidController.late`
+    // Pulses fired by an edge that came before their scheduled time, as of the last `Update()`.
+    uint32_t late = 0;
+
+    // ### `SolenoidController.latency`
+    // Mean turn-on latency over the last `Update()`'s interval, in `ns` (`0` if there were no turn-ons).
+    uint32_t latency = 0;
+
+    // ### `SolenoidController.latency_max`
+    // Longest turn-on latency over the last `Update()`'s interval, in `ns`.
+    uint32_t latency_max = 0;
+
+    // ### `SolenoidController.latency_peak`
+    // Longest turn-on latency since `Begin()`, in `ns`.
+    uint32_t latency_peak = 0;
+
+    // ## SolenoidController
+    // Drives the coil through a GPIO pin, timed from the switch's rising edges.
+    // ### Parameters
+    // - `e` - The global `EventEmitter` object.
+    // - `switch_pin` - The GPIO pin of the switch (interrupt-capable, i.e. not GPIO16).
+    // - `coil_pin` - The GPIO pin driving the coil's MOSFET (HIGH is on).
+    SolenoidController(
+        EventEmitter& e,
+        int switch_pin,
+        int coil_pin,
+        const std::vector<EventType>& events = {},
+        std::function<void(const Event&)> handler = nullptr
+    ) : Controller(e, events, handler),
+        switch_pin(switch_pin),
+        coil_pin(coil_pin) {
+            pinMode(switch_pin, INPUT);
+            pinMode(coil_pin, OUTPUT);
+            WriteCoil(false);
+            SetTiming(0, 180, CoilTiming::DEGREES);
+    }
+
+    ~SolenoidController() {
+        Stop();
+    }
+
+    // ### `SolenoidController.SetTiming()`
+    // Sets the advance and dwell (taking effect from the next edge; initially `0°` and `180°`, the mechanical timing).
+    // Returns `false`, changing nothing, if `dwell` isn't positive, or if `dwell` or the absolute value of `advance`
+    // isn't below a revolution (`360°`, or `SOLENOID_STALL_TIME` in `µs`).
+    // ### Parameters
+    // - `advance` - How far before the switch's rising edge the coil turns on (negative: after it).
+    // - `dwell` - How long the coil stays on.
+    // - `unit` (optional) - The unit of both: `µs` (default), or crank degrees.
+    bool SetTiming(float advance, float dwell, CoilTiming unit = CoilTiming::MICROSECONDS) {
+        bool in_degrees = unit == CoilTiming::DEGREES;
+        float revolution = in_degrees ? 360.f : (float)SOLENOID_STALL_TIME;
+        if (!(dwell > 0) || dwell >= revolution || !(advance > -revolution && advance < revolution)) {
+            return false;
+        }
+        float scale = in_degrees ? 65536.f / 360 : 1.f;
+        noInterrupts();
+        this->advance = (int32_t)lroundf(advance * scale);
+        this->dwell = (uint32_t)lroundf(dwell * scale);
+        degrees = in_degrees;
+        interrupts();
+        return true;
+    }
+
+    // ### `SolenoidController.SetTachometer()`
+    // Passes the switch's rising edges on to `tachometer`, from this controller's pin interrupt (begin it with `attach`
+    // as `false`, so it doesn't take the pin's interrupt over). `nullptr` stops passing them on.
+    void SetTachometer(Tachometer* tachometer) {
+        noInterrupts();
+        this->tachometer = tachometer;
+        interrupts();
+    }
+
+    // ### `SolenoidController.Begin()`
+    // Attaches the switch and timer 1 interrupts, and begins the periodic updates. If the switch is already closed,
+    // the coil is fired at once, as for an edge (so a hand start gets its first stroke).
+    // Returns `false` if another `SolenoidController` is running.
+    // ### Parameters
+    // - `update_interval` - How long to wait between each update, in milliseconds.
+    bool Begin(float update_interval) {
+        if (owner != nullptr && owner != this) {
+            return false;
+        }
+        owner = this;
+        phase = IDLE;
+        have_edge = next_pending = following = false;
+        period = 0;
+        timer1_isr_init();
+        timer1_attachInterrupt(&SolenoidController::TimerTrampoline);
+        timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+        attachInterruptArg(digitalPinToInterrupt(switch_pin), &SolenoidController::EdgeTrampoline, this, CHANGE);
+        Controller::Begin(update_interval);
+        if (digitalRead(switch_pin) == HIGH) {
+            noInterrupts();
+            OnEdge(ClockCycles());
+            have_edge = false;      // Part of a revolution: the next edge doesn't end a period
+            interrupts();
+        }
+        return true;
+    }
+
+    // ### `SolenoidController.Stop()`
+    // Detaches the interrupts, turns the coil off and stops the updates.
+    void Stop() {
+        detachInterrupt(digitalPinToInterrupt(switch_pin));
+        if (owner == this) {
+            timer1_disable();
+            timer1_detachInterrupt();
+            owner = nullptr;
+        }
+        WriteCoil(false);
+        phase = IDLE;
+        Controller::Stop();
+    }
+
+    // ### `SolenoidController.Period()`
+    // Returns the period of the last revolution, in `µs` (`0` if unknown).
+    uint32_t Period() const {
+        return period / CLOCK_CYCLES_PER_US;
+    }
+
+    // ### `SolenoidController.Update()`
+    // Takes the counts and latencies from the interrupt handlers, and publishes them to `Metrics`.
+    void Update() override {
+        noInterrupts();
+        uint32_t p = pulses_counted, l = late_counted;
+        uint32_t sum = latency_sum, count = latency_count, longest = latency_longest;
+        latency_sum = latency_count = latency_longest = 0;
+        interrupts();
+
+        Metrics::Increment(Counter::COIL_PULSES, p - pulses);
+        Metrics::Increment(Counter::COIL_PULSES_LATE, l - late);
+        pulses = p;
+        late = l;
+        latency = count > 0 ? (uint32_t)((uint64_t)sum * 1000 / count / CLOCK_CYCLES_PER_US) : 0;
+        latency_max = (uint32_t)((uint64_t)longest * 1000 / CLOCK_CYCLES_PER_US);
+        latency_peak = latency_max > latency_peak ? latency_max : latency_peak;
+        Metrics::Set(Gauge::COIL_LATENCY, latency);
+        Metrics::Set(Gauge::COIL_LATENCY_MAX, latency_max);
+    }
+};
+
+
+
+#endif // SOLENOID_CONTROLLER_HPP
\ No newline at end of file
@@ -0,0 +1,560 @@
+/****************************************************************
+*                                                               *
+*   TimingTuner.hpp                                             *
+*                                                               *
+*   Online hill-climbing of the coil timing for efficiency.     *
+*                                                               *
+*****************************************************************/
+#ifndef TIMING_TUNER_HPP
+#define TIMING_TUNER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Arduino.h>
+#include "Controller.hpp"
+#include "SolenoidController.hpp"
+#include "Clock/Clock.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Engine/StrokeMath.hpp"
+#include "Engine/StrokeAnalyzer.hpp"
+#include "Engine/ThermalModel.hpp"
+
+// ### `TIMING_TUNER_BINS`
+// Number of speed bins of the timing table.
+#ifndef TIMING_TUNER_BINS
+#define TIMING_TUNER_BINS 9
+#endif
+
+// ### `TIMING_TUNER_MIN_RPM`
+// Lowest speed of the timing table, in `RPM` (the first bin also takes every speed below it).
+#ifndef TIMING_TUNER_MIN_RPM
+#define TIMING_TUNER_MIN_RPM 500
+#endif
+
+// ### `TIMING_TUNER_BIN_WIDTH`
+// Width of each speed bin, in `RPM` (the last bin also takes every speed above the table). The defaults span the
+// bench engine's range, `500` to `1400 RPM`, in steps small enough for the best timing to differ between them.
+#ifndef TIMING_TUNER_BIN_WIDTH
+#define TIMING_TUNER_BIN_WIDTH 100
+#endif
+
+// ### `TIMING_TUNER_SETTLE` / `TIMING_TUNER_SETTLE_TIME`
+// Strokes, and time in `µs`, left out after each change of timing while the engine's speed settles to it (whichever
+// is longer).
+#ifndef TIMING_TUNER_SETTLE
+#define TIMING_TUNER_SETTLE 8
+#endif
+#ifndef TIMING_TUNER_SETTLE_TIME
+#define TIMING_TUNER_SETTLE_TIME 250000
+#endif
+
+// ### `TIMING_TUNER_WINDOW` / `TIMING_TUNER_WINDOW_TIME`
+// Strokes, and time in `µs`, each timing is measured over (whichever is longer). A stroke's efficiency rests on the
+// few INA219 readings taken during it (one every `2 ms`), so it takes many strokes to compare timings a few degrees
+// apart, whatever the speed; but every window at a step leaves the engine at a worse timing, and the coil warms up
+// all the while, so they are no longer than it takes `TIMING_TUNER_SIGNIFICANCE` to tell the timings apart.
+#ifndef TIMING_TUNER_WINDOW
+#define TIMING_TUNER_WINDOW 16
+#endif
+#ifndef TIMING_TUNER_WINDOW_TIME
+#define TIMING_TUNER_WINDOW_TIME 500000
+#endif
+
+// ### `TIMING_TUNER_STEP`
+// First step of the search, in degrees (of advance or dwell); halved each time no step improves, down to
+// `TIMING_TUNER_MIN_STEP`.
+#ifndef TIMING_TUNER_STEP
+#define TIMING_TUNER_STEP 10
+#endif
+
+// ### `TIMING_TUNER_MIN_STEP`
+// Smallest step, in degrees: the search keeps probing this far around the best timing, to follow the load (timings
+// closer than that differ by less than a window's noise).
+#ifndef TIMING_TUNER_MIN_STEP
+#define TIMING_TUNER_MIN_STEP 5
+#endif
+
+// ### `TIMING_TUNER_HOLD`
+// Windows measured at the best timing, once stored, before probing around it again: each probe runs the engine at a
+// worse timing, so once the search has settled it probes a fraction of the time.
+#ifndef TIMING_TUNER_HOLD
+#define TIMING_TUNER_HOLD 48
+#endif
+
+// ### `TIMING_TUNER_MARGIN`
+// Relative gain in efficiency a step must show to be taken, in `%` of the efficiency.
+#ifndef TIMING_TUNER_MARGIN
+#define TIMING_TUNER_MARGIN 0.5f
+#endif
+
+// ### `TIMING_TUNER_SIGNIFICANCE`
+// Standard errors (of the difference, from the spread of the strokes' efficiency in each window) a step's gain must
+// also exceed to be taken: at `18 V`, two windows at the same timing can differ by `2%`, four times the margin.
+#ifndef TIMING_TUNER_SIGNIFICANCE
+#define TIMING_TUNER_SIGNIFICANCE 1.f
+#endif
+
+// ### `TIMING_TUNER_HORIZON`
+// Time ahead, in `s`, at which timings are compared: each window's efficiency is taken down by the rise in the coil's
+// resistance after warming its `THERMAL_CAPACITANCE` at the window's power for that long (its time constant being
+// minutes long). A window is too short to show that a timing heats the coil faster, which at `18 V` costs more over a
+// minute than the `1%` of efficiency it may gain at once; a longer horizon settles on timings too weak to be efficient.
+#ifndef TIMING_TUNER_HORIZON
+#define TIMING_TUNER_HORIZON 60.f
+#endif
+
+// ### `TIMING_TUNER_MAX_SLOWDOWN`
+// Loss of speed against the best timing, in `%`, beyond which a step isn't taken however efficient it measures (the
+// strokes' efficiency only counts the power drawn while the switch is closed, so a timing that moves the coil's
+// current out of the stroke can look efficient while the engine slows down).
+#ifndef TIMING_TUNER_MAX_SLOWDOWN
+#define TIMING_TUNER_MAX_SLOWDOWN 10.f
+#endif
+
+// ### `TIMING_TUNER_MAX_DROP`
+// Loss of speed against the best timing, in `%`, at which a single stroke abandons the step being tried (some timings
+// can't keep the engine turning, and a few strokes of them can stop it for good).
+#ifndef TIMING_TUNER_MAX_DROP
+#define TIMING_TUNER_MAX_DROP 15.f
+#endif
+
+// ### `TIMING_TUNER_STALL_TIME`
+// Time without a stroke, in `µs`, after which the engine is taken as stalled and the search starts over.
+#ifndef TIMING_TUNER_STALL_TIME
+#define TIMING_TUNER_STALL_TIME 1000000
+#endif
+
+// Range the search keeps to, in degrees. The coil turns on no earlier than the switch closes, and off no later than
+// `TIMING_TUNER_MAX_DWELL` after that (when the switch opens), so all its current falls in the stroke whose readings
+// the efficiency is measured from: current drawn outside it would go unmeasured, making a timing look more efficient
+// than it is (over `100%` at `18 V`), and the advances that do so can stop the engine.
+#define TIMING_TUNER_MIN_ADVANCE -60
+#define TIMING_TUNER_MAX_ADVANCE 0
+#define TIMING_TUNER_MIN_DWELL 60
+#define TIMING_TUNER_MAX_DWELL 180
+
+// ### `TIMING_TUNER_START_ADVANCE` / `TIMING_TUNER_START_DWELL`
+// Timing the search starts from by default, in degrees: the centre of its range. The mechanical timing (`0°`, `180°`)
+// is a corner of it, with a single step in range, and the least efficient timing in it in the simulator.
+#ifndef TIMING_TUNER_START_ADVANCE
+#define TIMING_TUNER_START_ADVANCE -30
+#endif
+#ifndef TIMING_TUNER_START_DWELL
+#define TIMING_TUNER_START_DWELL 120
+#endif
+
+// ### `TIMING_TUNER_HOT_DWELL`
+// Dwell limit, in degrees, while the coil is predicted to overheat (see `SetDwellLimit()`). Far enough below the
+// mechanical timing's `180°` to keep the coil from overheating at `12 V` in the simulator, but not so far that the
+// hot coil (whose resistance has risen by a third) no longer keeps the engine turning.
+#ifndef TIMING_TUNER_HOT_DWELL
+#define TIMING_TUNER_HOT_DWELL 150
+#endif
+
+
+
+// ## TimingEntry
+// One speed bin of a `TimingTuner`'s table: the best timing found while the engine ran in it.
+// ### Defined properties:
+// - `advance` (`float`) - In degrees before the switch's rising edge.
+// - `dwell` (`float`) - In degrees.
+// - `efficiency` (`float`) - Measured at that timing, in `%`.
+// - `updates` (`uint32_t`) - Number of times the search settled in this bin (`0` if the entry is empty).
+struct TimingEntry {
+    float advance;
+    float dwell;
+    float efficiency;
+    uint32_t updates;
+};
+
+
+
+// ## TimingTuner
+// Closes the loop around a `SolenoidController`: searches for the advance and dwell (in degrees) giving the best
+// efficiency, while the engine runs, and keeps the result per speed in a table.
+// The feedback is the strokes' own `Data` (as `ComputeStrokeData()` computes it and the dashboard shows it), over a
+// window of `TIMING_TUNER_WINDOW` strokes and `TIMING_TUNER_WINDOW_TIME` rather than one stroke at a time (far too
+// noisy to compare timings a few degrees apart): the window's efficiency is the mean of the strokes' efficiency, its
+// standard error their spread over the root of their number, and its speed their mean. Timings are compared by the
+// efficiency taken down for the coil's warming over `TIMING_TUNER_HORIZON` at the power they draw.
+// The search is a hill climb from `TIMING_TUNER_START_ADVANCE` and `TIMING_TUNER_START_DWELL`: each timing is
+// applied, left to settle for `TIMING_TUNER_SETTLE` strokes and `TIMING_TUNER_SETTLE_TIME`, then measured. A step
+// from the best timing (the advance, or the dwell about its middle, up or down) is measured between two measurements
+// of the best timing, and compared with their mean, which cancels the drift as the coil warms up. It is taken if it
+// gains `TIMING_TUNER_MARGIN` and `TIMING_TUNER_SIGNIFICANCE` standard errors without slowing the engine by over
+// `TIMING_TUNER_MAX_SLOWDOWN`, and the same step is tried again; a stroke `TIMING_TUNER_MAX_DROP` slower than the best
+// timing abandons it at once. When none of the four steps improve, the step is halved, and once at
+// `TIMING_TUNER_MIN_STEP` the best timing is stored in the table at its speed and held for `TIMING_TUNER_HOLD`
+// windows before probing around it again, so it follows changes of load. When the speed moves to a bin of the table
+// that already has an entry, the search continues from that entry. `SetDwellLimit()` narrows the range of the dwell
+// (e.g. to back off the coil's duty while it runs hot), the search going on within it.
+// Per stroke it only adds to a few sums; each window is evaluated with a handful of float operations, so it can run
+// alongside everything else on the `Ticker` callbacks. After `TIMING_TUNER_STALL_TIME` without a stroke it returns to
+// the timing it started from.
+// ### Parameters
+// - `e` - The global `EventEmitter` object.
+// - `controller` - The `SolenoidController` whose timing is tuned.
+// - `advance` (optional) - The timing to start from: advance, in degrees (default `TIMING_TUNER_START_ADVANCE`).
+// - `dwell` (optional) - The timing to start from: dwell, in degrees (default `TIMING_TUNER_START_DWELL`).
+// ```c++
+// TimingTuner tuner(event_emitter, controller);
+// stroke_analyzer.SetOnStroke([](const StrokeAnalysis& stroke) { tuner.OnStroke(stroke); });
+// tuner.Begin(100);
+// ```
+class TimingTuner : public Controller {
+private:
+    enum Phase : uint8_t {
+        SETTLING,               // Strokes since the last change are being left out.
+        MEASURING,              // Strokes are being added up.
+    };
+
+    enum Target : uint8_t {
+        BEST,                   // The window measures a new best timing (or the starting one).
+        STEP,                   // A step from the best timing.
+        BEST_AGAIN,             // The best timing again, after a step.
+    };
+
+    SolenoidController& controller;
+    const float start_advance;
+    const float start_dwell;
+
+    // The search
+    float best_advance;
+    float best_dwell;
+    float best_efficiency = 0;                  // Last measured at the best timing, in `%`.
+    float best_score = 0;                       // Likewise, as compared (see `TIMING_TUNER_HORIZON`), in `%`.
+    float best_variance = 0;                    // Of the score (its squared standard error), in `%²`.
+    float best_rpm = 0;                         // Last measured at the best timing, in `RPM`.
+    float step_advance = 0;                     // Last step measured.
+    float step_dwell = 0;
+    float step_score = 0;                       // As measured at that step, in `%`.
+    float step_variance = 0;                    // Likewise, in `%²`.
+    float step_rpm = 0;                         // Likewise, in `RPM`.
+    Target target = BEST;
+    float advance;                              // Timing being measured.
+    float dwell;
+    float step = TIMING_TUNER_STEP;
+    float dwell_limit = TIMING_TUNER_MAX_DWELL;
+    uint8_t direction = 0;                      // Next step to try: advance up, advance down, dwell up, dwell down.
+    uint8_t failures = 0;                       // Steps tried in a row without improving.
+    uint8_t holding = 0;                        // Windows left at the best timing before probing around it again.
+
+    // The window
+    Phase phase = SETTLING;
+    uint32_t strokes = 0;                       // In the current phase.
+    uint32_t phase_began = 0;                   // Time the current phase began (`ClockMicros()`), in `µs`.
+    uint64_t duration = 0;                      // Of the strokes measured, in `µs`.
+    float efficiencies = 0;                     // Sum of the strokes' efficiency, in `%`.
+    float squares = 0;                          // Sum of its squares, in `%²`.
+    float powers = 0;                           // Sum of the strokes' power in, in `W`.
+    uint32_t last_stroke = 0;                   // Time of the last stroke (`ClockMicros()`), in `µs`.
+
+    TimingEntry table[TIMING_TUNER_BINS];
+
+    static size_t Bin(float rpm) {
+        size_t bin = rpm > TIMING_TUNER_MIN_RPM ? (size_t)((rpm - TIMING_TUNER_MIN_RPM) / TIMING_TUNER_BIN_WIDTH) : 0;
+        return bin < TIMING_TUNER_BINS ? bin : TIMING_TUNER_BINS - 1;
+    }
+
+    // ### `TimingTuner.Apply()`
+    // Private function setting the timing to measure next (and what it is), and starting to settle.
+    void Apply(float next_advance, float next_dwell, Target next_target) {
+        advance = next_advance;
+        dwell = next_dwell;
+        target = next_target;
+        controller.SetTiming(advance, dwell, CoilTiming::DEGREES);
+        phase = SETTLING;
+        strokes = 0;
+        phase_began = ClockMicros();
+    }
+
+    // ### `TimingTuner.Probe()`
+    // Private function applying the next step from the best timing that stays in range. Once all four have failed,
+    // the step is halved, or at `TIMING_TUNER_MIN_STEP`, the best timing is stored in the table and the probing
+    // goes on around it.
+    void Probe() {
+        for (uint8_t tries = 0; tries < 8; tries++) {
+            if (failures >= 4) {
+                failures = 0;
+                if (step > TIMING_TUNER_MIN_STEP) {
+                    step = step / 2 < TIMING_TUNER_MIN_STEP ? TIMING_TUNER_MIN_STEP : step / 2;
+                }
+                else {
+                    Store();
+                    holding = TIMING_TUNER_HOLD;
+                    Apply(best_advance, best_dwell, BEST);
+                    return;
+                }
+            }
+            float next_advance = best_advance + (direction == 0 ? step : direction == 1 ? -step
+                                               : direction == 2 ? step / 2 : -step / 2);
+            float next_dwell = best_dwell + (direction == 2 ? step : direction == 3 ? -step : 0);
+            if (next_advance >= TIMING_TUNER_MIN_ADVANCE && next_advance <= TIMING_TUNER_MAX_ADVANCE
+                && next_dwell >= TIMING_TUNER_MIN_DWELL && next_dwell <= dwell_limit
+                && next_dwell - next_advance <= TIMING_TUNER_MAX_DWELL) {
+                step_advance = next_advance;
+                step_dwell = next_dwell;
+                Apply(next_advance, next_dwell, STEP);
+                return;
+            }
+            failures++;
+            direction = (direction + 1) % 4;
+        }
+        Apply(best_advance, best_dwell, BEST);  // No step in range (not with the ranges above)
+    }
+
+    // ### `TimingTuner.Evaluate()`
+    // Private function taking the measured window's efficiency and moving the search on.
+    void Evaluate() {
+        if (!(efficiencies > 0) || duration == 0) {
+            Apply(advance, dwell, target);      // Nothing to go on; measure again
+            return;
+        }
+        rpm = 30e6f * strokes / duration;
+        efficiency = efficiencies / strokes;
+        float warming = 1 - INA219::temperature_coefficient * (powers / strokes)
+                          * (TIMING_TUNER_HORIZON / THERMAL_CAPACITANCE);
+        float score = efficiency * warming;
+        float variance = (squares / strokes - efficiency * efficiency) / strokes * (warming * warming);
+        windows++;
+
+        if (target == STEP) {
+            // Measure the best timing again, so the step is compared with it on either side (cancelling the drift
+            // as the coil warms up)
+            step_score = score;
+            step_variance = variance;
+            step_rpm = rpm;
+            Apply(best_advance, best_dwell, BEST_AGAIN);
+            return;
+        }
+        if (target == BEST_AGAIN) {
+            float reference = (best_score + score) / 2;
+            float reference_rpm = (best_rpm + rpm) / 2;
+            float noise = step_variance + (best_variance + variance) / 4;
+            float gain = step_score - reference;
+            best_efficiency = efficiency;
+            best_score = score;
+            best_variance = variance;
+            best_rpm = rpm;
+            if (gain > reference * (TIMING_TUNER_MARGIN / 100)
+                && gain * gain > noise * (TIMING_TUNER_SIGNIFICANCE * TIMING_TUNER_SIGNIFICANCE)
+                && step_rpm >= reference_rpm * (1 - TIMING_TUNER_MAX_SLOWDOWN / 100)) {
+                best_advance = step_advance;
+                best_dwell = step_dwell;
+                failures = 0;                   // Same direction again, once the new best timing is measured
+                improvements++;
+                Apply(best_advance, best_dwell, BEST);
+                return;
+            }
+            failures++;
+            direction = (direction + 1) % 4;
+            Probe();
+            return;
+        }
+
+        // A new best timing (or the starting one)
+        best_efficiency = efficiency;
+        best_score = score;
+        best_variance = variance;
+        best_rpm = rpm;
+        const TimingEntry& entry = table[Bin(rpm)];
+        float entry_dwell = entry.dwell < dwell_limit ? entry.dwell : dwell_limit;
+        if (entry.updates > 0 && (entry.advance != best_advance || entry_dwell != best_dwell)) {
+            // In a speed bin already tuned: continue from there
+            best_advance = entry.advance;
+            best_dwell = entry_dwell;
+            step = TIMING_TUNER_MIN_STEP;
+            Apply(best_advance, best_dwell, BEST);
+            return;
+        }
+        if (holding > 0) {
+            holding--;
+            Apply(best_advance, best_dwell, BEST);
+            return;
+        }
+        Probe();
+    }
+
+    // ### `TimingTuner.Store()`
+    // Private function recording the best timing in the table, at the speed it was last measured at.
+    void Store() {
+        TimingEntry& entry = table[Bin(best_rpm)];
+        entry.advance = best_advance;
+        entry.dwell = best_dwell;
+        entry.efficiency = best_efficiency;
+        entry.updates++;
+    }
+
+public:
+    // ### `TimingTuner.rpm`
+    // Mean speed over the last window measured, in `RPM`.
+    float rpm = 0;
+
+    // ### `TimingTuner.efficiency`
+    // Efficiency over the last window measured, in `%`.
+    float efficiency = 0;
+
+    // ### `TimingTuner.enabled`
+    // Whether strokes are measured (e.g. not while the engine is being started or is over-temperature); strokes
+    // still count as such for the stall check, and the window in progress when it is cleared starts over.
+    bool enabled = true;
+
+    // ### `TimingTuner.windows`
+    // Number of windows measured.
+    uint32_t windows = 0;
+
+    // ### `TimingTuner.improvements`
+    // Number of steps taken (that improved the efficiency).
+    uint32_t improvements = 0;
+
+    // ## TimingTuner
+    // Searches for the coil timing giving the best efficiency, and keeps it per speed.
+    // ### Parameters
+    // - `e` - The global `EventEmitter` object.
+    // - `controller` - The `SolenoidController` whose timing is tuned.
+    // - `advance` (optional) - The timing to start from: advance, in degrees (default `TIMING_TUNER_START_ADVANCE`).
+    // - `dwell` (optional) - The timing to start from: dwell, in degrees (default `TIMING_TUNER_START_DWELL`).
+    TimingTuner(EventEmitter& e, SolenoidController& controller, float advance = TIMING_TUNER_START_ADVANCE,
+                float dwell = TIMING_TUNER_START_DWELL)
+        : Controller(e),
+          controller(controller),
+          start_advance(advance),
+          start_dwell(dwell),
+          best_advance(advance),
+          best_dwell(dwell),
+          advance(advance),
+          dwell(dwell) {
+            for (size_t bin = 0; bin < TIMING_TUNER_BINS; bin++) {
+                table[bin] = {0, 0, 0, 0};
+            }
+    }
+
+    // ### `TimingTuner.Begin()`
+    // Applies the starting timing, and begins the search (and the periodic stall checks).
+    // ### Parameters
+    // - `update_interval` - How long to wait between each stall check, in milliseconds.
+    void Begin(float update_interval) {
+        Restart();
+        Controller::Begin(update_interval);
+    }
+
+    // ### `TimingTuner.Restart()`
+    // Starts the search over from the starting timing (keeping the table).
+    void Restart() {
+        best_advance = start_advance;
+        best_dwell = start_dwell < dwell_limit ? start_dwell : dwell_limit;
+        step = TIMING_TUNER_STEP;
+        direction = failures = holding = 0;
+        last_stroke = ClockMicros();
+        Apply(best_advance, best_dwell, BEST);
+    }
+
+    // ### `TimingTuner.SetDwellLimit()`
+    // Sets the longest dwell the search may use, in degrees (`TIMING_TUNER_MAX_DWELL` to lift the limit). A timing
+    // over it is brought down to it at once, and the search goes on from there. Returns `false` (changing nothing)
+    // if it is outside `TIMING_TUNER_MIN_DWELL` to `TIMING_TUNER_MAX_DWELL`.
+    bool SetDwellLimit(float limit) {
+        if (!(limit >= TIMING_TUNER_MIN_DWELL && limit <= TIMING_TUNER_MAX_DWELL)) {
+            return false;
+        }
+        dwell_limit = limit;
+        if (best_dwell > limit || dwell > limit) {
+            best_dwell = best_dwell < limit ? best_dwell : limit;
+            direction = failures = holding = 0;
+            Apply(best_advance, best_dwell, BEST);
+        }
+        return true;
+    }
+
+    // ### `TimingTuner.OnStroke()`
+    // Takes one stroke (pass it every `StrokeAnalysis` from the `StrokeAnalyzer`).
+    void OnStroke(const StrokeAnalysis& stroke) {
+        last_stroke = stroke.time;
+        if (!enabled) {
+            phase = SETTLING;
+            strokes = 0;
+            phase_began = stroke.time;
+            return;
+        }
+        strokes++;
+        if (target == STEP && stroke.data.speed < best_rpm * (1 - TIMING_TUNER_MAX_DROP / 100)) {
+            failures++;                         // Losing the engine: back to the best timing at once
+            direction = (direction + 1) % 4;
+            Apply(best_advance, best_dwell, BEST);
+            return;
+        }
+        int32_t since = (int32_t)(stroke.time - phase_began);
+        if (phase == SETTLING) {
+            if (strokes >= TIMING_TUNER_SETTLE && since >= TIMING_TUNER_SETTLE_TIME) {
+                phase = MEASURING;
+                phase_began = stroke.time;
+                strokes = 0;
+                duration = 0;
+                efficiencies = squares = powers = 0;
+            }
+            return;
+        }
+        duration += stroke.duration;
+        efficiencies += stroke.data.efficiency;
+        squares += stroke.data.efficiency * stroke.data.efficiency;
+        powers += stroke.data.powerin;
+        if (strokes >= TIMING_TUNER_WINDOW && since >= TIMING_TUNER_WINDOW_TIME) {
+            Evaluate();
+        }
+    }
+
+    // ### `TimingTuner.Update()`
+    // Checks for a stall: with no stroke for `TIMING_TUNER_STALL_TIME`, returns to the starting timing.
+    void Update() override {
+        if (ClockMicros() - last_stroke >= (uint32_t)TIMING_TUNER_STALL_TIME) {
+            Restart();
+        }
+    }
+
+    // ### `TimingTuner.Advance()` / `TimingTuner.Dwell()`
+    // Return the best timing found so far, in degrees.
+    float Advance() const {
+        return best_advance;
+    }
+    float Dwell() const {
+        return best_dwell;
+    }
+
+    // ### `TimingTuner::BinSpeed()`
+    // Returns the lowest speed of `bin`, in `RPM`.
+    static uint32_t BinSpeed(size_t bin) {
+        return TIMING_TUNER_MIN_RPM + bin * TIMING_TUNER_BIN_WIDTH;
+    }
+
+    // ### `TimingTuner.Entry()`
+    // Returns the table's entry for `bin` (speeds from `BinSpeed(bin)` up).
+    const TimingEntry& Entry(size_t bin) const {
+        return table[bin < TIMING_TUNER_BINS ? bin : TIMING_TUNER_BINS - 1];
+    }
+
+    // ### `TimingTuner.Render()`
+    // Writes the timing and the table as JSON: `{"advance":A,"dwell":D,"efficiency":E,"rpm":R,"bins":[...]}`, with
+    // one `{"rpm":lowest,"advance":A,"dwell":D,"efficiency":E,"updates":N}` per entry (empty ones left out).
+    // ### Parameters
+    // - `out` - Where to write the output (any Arduino `Print`, e.g. an `AsyncResponseStream`).
+    void Render(Print& out) const {
+        out.printf("{\"advance\":%g,\"dwell\":%g,\"efficiency\":%.4g,\"rpm\":%.0f,\"bins\":[",
+            best_advance, best_dwell, best_efficiency, rpm);
+        bool first = true;
+        for (size_t bin = 0; bin < TIMING_TUNER_BINS; bin++) {
+            const TimingEntry& entry = table[bin];
+            if (entry.updates == 0) {
+                continue;
+            }
+            out.printf("%s{\"rpm\":%lu,\"advance\":%g,\"dwell\":%g,\"efficiency\":%.4g,\"updates\":%lu}",
+                first ? "" : ",", (unsigned long)BinSpeed(bin), entry.advance, entry.dwell,
+                entry.efficiency, (unsigned long)entry.updates);
+            first = false;
+        }
+        out.print("]}");
+    }
+};
+
+
+
+#endif // TIMING_TUNER_HPP
\ No newline at end of file
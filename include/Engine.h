@@ -0,0 +1,28 @@
+/****************************************************************
+*                                                               *
+*   Engine.h                                                    *
+*                                                               *
+*   Include file for:                                           *
+*     - FixedPoint.hpp                                          *
+*     - StrokeMath.hpp                                          *
+*     - StrokeAnalyzer.hpp                                      *
+*     - CrankProfile.hpp                                        *
+*     - Watchdog.hpp                                            *
+*     - EngineState.hpp                                         *
+*     - ThermalModel.hpp                                        *
+*     - SpectralMonitor.hpp                                     *
+*                                                               *
+*****************************************************************/
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "Engine/FixedPoint.hpp"
+#include "Engine/StrokeMath.hpp"
+#include "Engine/StrokeAnalyzer.hpp"
+#include "Engine/CrankProfile.hpp"
+#include "Engine/Watchdog.hpp"
+#include "Engine/EngineState.hpp"
+#include "Engine/ThermalModel.hpp"
+#include "Engine/SpectralMonitor.hpp"
+
+#endif // ENGINE_H
\ No newline at end of file
@@ -0,0 +1,241 @@
+/****************************************************************
+*                                                               *
+*   CrankProfile.hpp                                            *
+*                                                               *
+*   Crank-angle-domain current profile of the strokes.          *
+*                                                               *
+*****************************************************************/
+#ifndef CRANK_PROFILE_HPP
+#define CRANK_PROFILE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Arduino.h>
+#include "FixedPoint.hpp"
+#include "Events/Event.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Sensors/Sample.hpp"
+#include "Sensors/Responder.hpp"
+#include "Sensors/SampleListener.hpp"
+
+// ### `CRANK_PROFILE_BINS`
+// Number of crank-angle bins a stroke is resampled onto (`36` is `5°` per bin).
+#ifndef CRANK_PROFILE_BINS
+#define CRANK_PROFILE_BINS 36
+#endif
+
+// ### `CRANK_PROFILE_MAX_READINGS`
+// Most INA219 readings a stroke can hold (`8` bytes each); a longer stroke is skipped.
+// `64` readings `2 ms` apart cover strokes down to about `230 RPM`.
+#ifndef CRANK_PROFILE_MAX_READINGS
+#define CRANK_PROFILE_MAX_READINGS 64
+#endif
+
+// ### `CRANK_PROFILE_SPAN`
+// Crank angle from a stroke's rising to its falling switch edge, in degrees (the switch is closed for half a turn).
+#define CRANK_PROFILE_SPAN 180
+
+
+
+// ## CrankProfile
+// Builds the coil current as a function of crank angle, averaged over every stroke, whatever the speed.
+// The INA219 is read every `2 ms`, so a fast stroke gets fewer readings than a slow one and the readings fall at
+// different angles each time. Instead, each stroke's readings are kept until its falling edge, placed on the crank by
+// taking the rising edge as `0°` and the falling edge as `CRANK_PROFILE_SPAN` (constant speed in between), and
+// linearly interpolated at the centre of each of `CRANK_PROFILE_BINS` bins (holding the first and last readings out to
+// the edges). Each bin keeps the running mean and the peak of its values, so the table stays the same size however
+// long the engine runs. Serve it with `Render()` (`/profile`).
+// Resampling costs one division per bin, once per stroke; adding a reading only stores it.
+// Add it to the INA219 with `AddSampleListener()` (the edges are handled internally, so don't replace them with
+// `SetOnEvent()`).
+// ### Parameters
+// - `e` - The global `EventEmitter` object.
+// ```c++
+// CrankProfile crank_profile(event_emitter);
+// ina219.AddSampleListener(&crank_profile);
+// server.ServeCrankProfile(crank_profile);
+// ```
+class CrankProfile : public Responder, public SampleListener {
+private:
+    // One reading of the stroke in progress
+    struct Reading {
+        uint32_t time;                                  // Since the rising edge, in `µs`.
+        int32_t current;                                // In `µA`.
+    };
+
+    bool open = false;                                  // Whether a stroke is in progress.
+    bool overflowed = false;                            // Whether it had more readings than `readings` holds.
+    uint32_t began = 0;                                 // Time of its rising edge, in `µs`.
+    Reading readings[CRANK_PROFILE_MAX_READINGS];
+    size_t count = 0;
+
+    int64_t sums[CRANK_PROFILE_BINS];                   // Sum of each bin's values, in `µA`.
+    int32_t peaks[CRANK_PROFILE_BINS];                  // In `µA`.
+
+    void OnEdge(const Event& event) {
+        if (event.type == EventType::SWITCH1_STATE_CHANGE_TO_HIGH) {
+            Open(event.time);
+        }
+        else if (event.type == EventType::SWITCH1_STATE_CHANGE_TO_LOW) {
+            Close(event.time);
+        }
+    }
+
+    // ### `CrankProfile.Resample()`
+    // Private function adding the stroke in progress (at least two readings, `duration` `µs` long) to the table.
+    void Resample(uint32_t duration) {
+        size_t next = 0;        // First reading after the bin's centre
+        for (size_t bin = 0; bin < CRANK_PROFILE_BINS; bin++) {
+            uint32_t time = (uint32_t)(((uint64_t)duration * (2 * bin + 1)) / (2 * CRANK_PROFILE_BINS));
+            while (next < count && readings[next].time <= time) {
+                next++;
+            }
+            int32_t value;
+            if (next == 0) {
+                value = readings[0].current;
+            }
+            else if (next == count) {
+                value = readings[count - 1].current;
+            }
+            else {
+                const Reading& a = readings[next - 1];
+                const Reading& b = readings[next];
+                value = a.current + AverageRounded((int64_t)(b.current - a.current) * (time - a.time), b.time - a.time);
+            }
+            sums[bin] += value;
+            peaks[bin] = strokes == 0 || value > peaks[bin] ? value : peaks[bin];
+        }
+        strokes++;
+    }
+
+public:
+    // ### `CrankProfile.strokes`
+    // Number of strokes in the table.
+    uint32_t strokes = 0;
+
+    // ### `CrankProfile.skipped`
+    // Number of strokes left out of the table: fewer than two readings, or more than `CRANK_PROFILE_MAX_READINGS`.
+    uint32_t skipped = 0;
+
+    // ### `CrankProfile.enabled`
+    // Whether strokes are added to the table (e.g. not while the engine is being started); a stroke in progress when
+    // it is cleared is still added.
+    bool enabled = true;
+
+    // ## CrankProfile
+    // Builds the coil current as a function of crank angle, averaged over every stroke.
+    // ### Parameters
+    // - `e` - The global `EventEmitter` object.
+    CrankProfile(EventEmitter& e)
+        : Responder(
+            e,
+            {EventType::SWITCH1_STATE_CHANGE_TO_LOW, EventType::SWITCH1_STATE_CHANGE_TO_HIGH},
+            [this](const Event& event) { OnEdge(event); }
+        ) {
+            Reset();
+    }
+
+    // ### `CrankProfile.Reset()`
+    // Empties the table (the stroke in progress, if any, is still added when it closes).
+    void Reset() {
+        for (size_t bin = 0; bin < CRANK_PROFILE_BINS; bin++) {
+            sums[bin] = 0;
+            peaks[bin] = 0;
+        }
+        strokes = skipped = 0;
+    }
+
+    // ### `CrankProfile.Open()`
+    // Opens a stroke (discarding one in progress), unless not `enabled`. Called on every rising edge; call it directly
+    // for a stroke that was already under way, e.g. when the switch is HIGH at boot.
+    // ### Parameters
+    // - `time` - Time the stroke began (`micros()`), in `µs`.
+    void Open(uint32_t time) {
+        open = enabled;
+        overflowed = false;
+        began = time;
+        count = 0;
+    }
+
+    // ### `CrankProfile.OnReading()`
+    // Stores one reading of the stroke in progress.
+    void OnReading(const FixedSample& fixed) override {
+        if (!open) {
+            return;
+        }
+        if (count == CRANK_PROFILE_MAX_READINGS) {
+            overflowed = true;
+            return;
+        }
+        int32_t since = (int32_t)(fixed.time - began);
+        readings[count++] = {since < 0 ? 0 : (uint32_t)since, fixed.current};
+    }
+
+    // ### `CrankProfile.OnSample()`
+    // Stores one reading given only in floats (converted back to scaled integers).
+    void OnSample(const Sample& sample) override {
+        OnReading(FixedSample::FromSample(sample));
+    }
+
+    // ### `CrankProfile.Close()`
+    // Closes the stroke in progress (if any), resampling it into the table. Called on every falling edge.
+    // Returns `false` if no stroke was open, or it was skipped.
+    // ### Parameters
+    // - `time` - Time the stroke ended (`micros()`), in `µs`.
+    bool Close(uint32_t time) {
+        if (!open) {
+            return false;
+        }
+        open = false;
+        if (overflowed || count < 2) {
+            skipped++;
+            return false;
+        }
+        Resample(time - began);
+        return true;
+    }
+
+    // ### `CrankProfile.Angle()`
+    // Returns the crank angle at the centre of `bin`, in degrees after the rising edge.
+    static float Angle(size_t bin) {
+        return (bin + 0.5f) * CRANK_PROFILE_SPAN / CRANK_PROFILE_BINS;
+    }
+
+    // ### `CrankProfile.Mean()`
+    // Returns the mean current at `bin` over the strokes in the table, in `A` (`0` if there are none).
+    float Mean(size_t bin) const {
+        return strokes > 0 ? AverageRounded(sums[bin], strokes) * 1e-6f : 0;
+    }
+
+    // ### `CrankProfile.Peak()`
+    // Returns the highest current seen at `bin`, in `A` (`0` if there are no strokes).
+    float Peak(size_t bin) const {
+        return peaks[bin] * 1e-6f;
+    }
+
+    // ### `CrankProfile.Render()`
+    // Writes the table as JSON: `{"span":180,"strokes":N,"skipped":M,"angle":[...],"mean":[...],"peak":[...]}`,
+    // with one entry per bin (angles in degrees, currents in `A`).
+    // ### Parameters
+    // - `out` - Where to write the output (any Arduino `Print`, e.g. an `AsyncResponseStream`).
+    void Render(Print& out) const {
+        out.printf("{\"span\":%d,\"strokes\":%lu,\"skipped\":%lu,\"angle\":[",
+            CRANK_PROFILE_SPAN, (unsigned long)strokes, (unsigned long)skipped);
+        for (size_t bin = 0; bin < CRANK_PROFILE_BINS; bin++) {
+            out.printf(bin == 0 ? "%g" : ",%g", Angle(bin));
+        }
+        out.print("],\"mean\":[");
+        for (size_t bin = 0; bin < CRANK_PROFILE_BINS; bin++) {
+            out.printf(bin == 0 ? "%.6g" : ",%.6g", Mean(bin));
+        }
+        out.print("],\"peak\":[");
+        for (size_t bin = 0; bin < CRANK_PROFILE_BINS; bin++) {
+            out.printf(bin == 0 ? "%.6g" : ",%.6g", Peak(bin));
+        }
+        out.print("]}");
+    }
+};
+
+
+
+#endif // CRANK_PROFILE_HPP
\ No newline at end of file
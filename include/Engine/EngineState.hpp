@@ -0,0 +1,355 @@
+/****************************************************************
+*                                                               *
+*   EngineState.hpp                                             *
+*                                                               *
+*   Table-driven engine state machine.                          *
+*                                                               *
+*****************************************************************/
+#ifndef ENGINE_STATE_HPP
+#define ENGINE_STATE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Arduino.h>
+#include "Events/Event.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Sensors/Responder.hpp"
+#include "StrokeAnalyzer.hpp"
+
+// ### `ENGINE_RUNNING_RPM`
+// Speed at or above which the engine is running (rather than cranking), in `RPM`.
+#ifndef ENGINE_RUNNING_RPM
+#define ENGINE_RUNNING_RPM 300
+#endif
+
+// ### `ENGINE_CRANKING_RPM`
+// Speed below which a running engine is cranking again, in `RPM` (below `ENGINE_RUNNING_RPM`, so the state doesn't
+// flap).
+#ifndef ENGINE_CRANKING_RPM
+#define ENGINE_CRANKING_RPM 200
+#endif
+
+// ### `ENGINE_HOT_TEMPERATURE`
+// A stroke's inferred coil temperature at or above which the engine is over-temperature, in `°F` (`150 °C`).
+#ifndef ENGINE_HOT_TEMPERATURE
+#define ENGINE_HOT_TEMPERATURE 302
+#endif
+
+// ### `ENGINE_COOL_TEMPERATURE`
+// A stroke's inferred coil temperature at or below which it has cooled down again, in `°F` (`130 °C`).
+#ifndef ENGINE_COOL_TEMPERATURE
+#define ENGINE_COOL_TEMPERATURE 266
+#endif
+
+// ### `ENGINE_TEMPERATURE_SAMPLES`
+// Fewest INA219 readings a stroke needs for its temperature to be used. Inferring the resistance from one reading
+// only works once the coil current has settled, so the strokes too short for a few readings give nothing usable.
+#ifndef ENGINE_TEMPERATURE_SAMPLES
+#define ENGINE_TEMPERATURE_SAMPLES 4
+#endif
+
+
+
+// ## EngineState
+// What the engine is doing, as tracked by `EngineStateMachine`.
+// - `STOPPED` - Not turning, with the coil off (at boot, or after stopping with the switch open).
+// - `CRANKING` - Turning below `ENGINE_RUNNING_RPM` (being started, or slowing down).
+// - `RUNNING` - Turning at speed.
+// - `STALLED` - Stopped with the switch closed (the coil left on).
+// - `OVER_TEMPERATURE` - The coil over `ENGINE_HOT_TEMPERATURE`, until it cools to `ENGINE_COOL_TEMPERATURE`.
+enum class EngineState : uint8_t {
+    STOPPED,
+    CRANKING,
+    RUNNING,
+    STALLED,
+    OVER_TEMPERATURE,
+    ENGINE_STATE_COUNT,     // Number of states (not a state; must remain last).
+};
+
+// ### `EngineStateName()`
+// Returns the name of an `EngineState` (e.g. `"RUNNING"`).
+inline const char* EngineStateName(EngineState state) {
+    switch (state) {
+        case EngineState::STOPPED:              return "STOPPED";
+        case EngineState::CRANKING:             return "CRANKING";
+        case EngineState::RUNNING:              return "RUNNING";
+        case EngineState::STALLED:              return "STALLED";
+        case EngineState::OVER_TEMPERATURE:     return "OVER_TEMPERATURE";
+        default:                                return "UNKNOWN";
+    }
+}
+
+
+
+// ## EngineInput
+// What the event stream tells the state machine (each event is turned into at most one input).
+// - `EDGE` - A switch edge.
+// - `FAST` / `SLOW` - A revolution (rising edge to rising edge) at or above `ENGINE_RUNNING_RPM` / below
+//   `ENGINE_CRANKING_RPM`. Timed from the edges rather than taken from the `Tachometer`, whose pin interrupt the
+//   `SolenoidController` takes over when it drives the coil.
+// - `STOP` / `STALL` - An `ENGINE_STALL` with the switch open / closed.
+// - `HOT` / `COOL` - A coil temperature at or above `ENGINE_HOT_TEMPERATURE` / at or below `ENGINE_COOL_TEMPERATURE`.
+enum class EngineInput : uint8_t {
+    EDGE,
+    FAST,
+    SLOW,
+    STOP,
+    STALL,
+    HOT,
+    COOL,
+    ENGINE_INPUT_COUNT,     // Number of inputs (not an input; must remain last).
+};
+
+
+
+// ## EngineStateProfile
+// How the firmware works in one `EngineState`.
+// ### Defined properties:
+// - `switch_interval` (`uint16_t`) - `switch1.Begin()` interval, in `ms`.
+// - `sample_interval` (`uint16_t`) - `ina219.Begin()` interval while the coil is on, in `ms` (`0` = not polled).
+// - `update_interval` (`uint16_t`) - `server.ScheduleUpdates()` interval, in `ms` (`0` = pushed only when the data
+//   changes).
+// - `tachometer_interval` (`uint16_t`) - `tachometer.Begin()` interval, in `ms` (kept polling when stopped, so that it
+//   reports the speed falling to `0`).
+// - `watchdog_interval` (`uint16_t`) - `watchdog.Begin()` tick, in `ms` (`0` = not ticking). Only the states entered
+//   at boot or on an `ENGINE_STALL`, with none of its timeouts armed, can stop it; the next edge leaves them.
+// - `thermal_interval` (`uint16_t`) - `thermal.Begin()` interval, in `ms`.
+// - `accumulate` (`bool`) - Whether strokes are added to the tables kept over the whole run (crank profile, timing
+//   tuner), which the irregular strokes of a start or a fault would only blur.
+struct EngineStateProfile {
+    uint16_t switch_interval;
+    uint16_t sample_interval;
+    uint16_t update_interval;
+    uint16_t tachometer_interval;
+    uint16_t watchdog_interval;
+    uint16_t thermal_interval;
+    bool accumulate;
+};
+
+
+
+// ## EngineStateMachine
+// Tracks the `EngineState` from the event stream: switch edges (and the revolutions they time), the `Watchdog`'s
+// `ENGINE_STALL` and the coil temperature (a `ThermalModel`'s, passed to `OnTemperature()`, or the strokes' own, to
+// `OnStroke()`). Each is turned into an `EngineInput`, and the next state looked up in `transitions`, a table fixed
+// (and checked) at compile time; a change emits `ENGINE_STATE_CHANGE` (`value` is the new `EngineState`). Its
+// handlers apply the new state's `Profile()`, so a stopped engine is barely polled and pushes nothing new, while a
+// running one gets full resolution.
+// Construct it before the objects whose handlers read `State()` or `Profile()`, so it sees each edge first.
+// ### Parameters
+// - `e` - The global `EventEmitter` object.
+// ```c++
+// EngineStateMachine engine(event_emitter);
+// stroke_analyzer.SetOnStroke([](const StrokeAnalysis& stroke) { engine.OnStroke(stroke); });
+// Responder engine_listener(event_emitter, {EventType::ENGINE_STATE_CHANGE}, [](const Event&) {
+//     switch1.Begin(engine.Profile().switch_interval);
+// });
+// ```
+class EngineStateMachine : public Responder {
+private:
+    using S = EngineState;      // Keeps `transitions` readable
+
+public:
+    static constexpr size_t state_count = (size_t)EngineState::ENGINE_STATE_COUNT;
+    static constexpr size_t input_count = (size_t)EngineInput::ENGINE_INPUT_COUNT;
+
+    // ### `EngineStateMachine::transitions`
+    // The next state for each state (row) and input (column), in `EngineState` and `EngineInput` order.
+    static constexpr EngineState transitions[state_count][input_count] = {
+        //                       EDGE                  FAST                  SLOW                  STOP
+        //                       STALL                 HOT                   COOL
+        /* STOPPED */           {S::CRANKING,          S::RUNNING,           S::CRANKING,          S::STOPPED,
+                                 S::STALLED,           S::OVER_TEMPERATURE,  S::STOPPED},
+        /* CRANKING */          {S::CRANKING,          S::RUNNING,           S::CRANKING,          S::STOPPED,
+                                 S::STALLED,           S::OVER_TEMPERATURE,  S::CRANKING},
+        /* RUNNING */           {S::RUNNING,           S::RUNNING,           S::CRANKING,          S::STOPPED,
+                                 S::STALLED,           S::OVER_TEMPERATURE,  S::RUNNING},
+        /* STALLED */           {S::CRANKING,          S::RUNNING,           S::CRANKING,          S::STOPPED,
+                                 S::STALLED,           S::OVER_TEMPERATURE,  S::STALLED},
+        /* OVER_TEMPERATURE */  {S::OVER_TEMPERATURE,  S::OVER_TEMPERATURE,  S::OVER_TEMPERATURE,  S::STOPPED,
+                                 S::STALLED,           S::OVER_TEMPERATURE,  S::CRANKING},
+    };
+
+    // ### `EngineStateMachine::default_profiles`
+    // The `Profile()` of each state until changed with `SetProfile()`, in `EngineState` order.
+    static constexpr EngineStateProfile default_profiles[state_count] = {
+        // switch  sample  update  tachometer  watchdog  thermal  accumulate
+        {50,       0,      0,      100,        0,        1000,    false},  // STOPPED: a start's first stroke is longer
+        {1,        2,      250,    5,          10,       100,     false},  // CRANKING
+        {1,        2,      250,    5,          10,       100,     true},   // RUNNING
+        {5,        0,      0,      100,        0,        100,     false},  // STALLED: the coil may be on, and heating
+        {1,        2,      250,    5,          10,       100,     false},  // OVER_TEMPERATURE: at full resolution
+    };
+
+    // ### `EngineStateMachine::Check()`
+    // Checks `transitions` at compile time: every entry a state, every fault reachable from every state, and a way
+    // back to `RUNNING` from every state but `OVER_TEMPERATURE` (which has to cool down first).
+    static constexpr bool Check() {
+        for (size_t state = 0; state < state_count; state++) {
+            for (size_t input = 0; input < input_count; input++) {
+                if ((size_t)transitions[state][input] >= state_count) {
+                    return false;
+                }
+            }
+            if (transitions[state][(size_t)EngineInput::STALL] != EngineState::STALLED ||
+                transitions[state][(size_t)EngineInput::STOP] != EngineState::STOPPED ||
+                transitions[state][(size_t)EngineInput::HOT] != EngineState::OVER_TEMPERATURE) {
+                return false;
+            }
+            if (state != (size_t)EngineState::OVER_TEMPERATURE &&
+                transitions[state][(size_t)EngineInput::FAST] != EngineState::RUNNING) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    EventEmitter& emitter;
+    EngineState state = EngineState::STOPPED;
+    EngineStateProfile profiles[state_count];
+    bool high = false;                  // Whether the switch is closed (as of its last edge).
+    bool turning = false;               // Whether `last_rise` began a revolution (no stall since).
+    uint32_t last_rise = 0;             // Time of the last rising edge, in `µs`.
+    uint32_t entered = 0;               // Time the current state was entered, in `µs`.
+
+    void OnEngineEvent(const Event& event) {
+        switch (event.type) {
+            case EventType::SWITCH1_STATE_CHANGE_TO_LOW:
+                high = false;
+                Input(EngineInput::EDGE, event.time);
+                break;
+            case EventType::SWITCH1_STATE_CHANGE_TO_HIGH:
+                high = true;
+                Input(EngineInput::EDGE, event.time);
+                if (turning) {
+                    // Compared as periods, so there is no division
+                    uint32_t period = event.time - last_rise;
+                    if (period <= 60000000UL / ENGINE_RUNNING_RPM) {
+                        Input(EngineInput::FAST, event.time);
+                    }
+                    else if (period > 60000000UL / ENGINE_CRANKING_RPM) {
+                        Input(EngineInput::SLOW, event.time);
+                    }
+                }
+                last_rise = event.time;
+                turning = true;
+                break;
+            case EventType::ENGINE_STALL:
+                turning = false;
+                Input(high ? EngineInput::STALL : EngineInput::STOP, event.time);
+                break;
+            default:
+                break;
+        }
+    }
+
+public:
+    // ### `EngineStateMachine.changes`
+    // Number of state changes.
+    uint32_t changes = 0;
+
+    // ## EngineStateMachine
+    // Tracks the `EngineState` from the event stream, starting `STOPPED`.
+    // ### Parameters
+    // - `e` - The global `EventEmitter` object.
+    EngineStateMachine(EventEmitter& e)
+        : Responder(
+            e,
+            {EventType::SWITCH1_STATE_CHANGE_TO_LOW, EventType::SWITCH1_STATE_CHANGE_TO_HIGH, EventType::ENGINE_STALL},
+            [this](const Event& event) { OnEngineEvent(event); }
+        ),
+        emitter(e) {
+            for (size_t i = 0; i < state_count; i++) {
+                profiles[i] = default_profiles[i];
+            }
+    }
+
+    // ### `EngineStateMachine::Next()`
+    // Returns the state `transitions` moves `state` to on `input`.
+    static constexpr EngineState Next(EngineState state, EngineInput input) {
+        return transitions[(size_t)state][(size_t)input];
+    }
+
+    // ### `EngineStateMachine.Input()`
+    // Moves to the next state for `input` (called for every event it is registered for; call it directly for inputs
+    // from elsewhere). Returns `true` if the state changed, after emitting `ENGINE_STATE_CHANGE`.
+    // ### Parameters
+    // - `input` - The `EngineInput`.
+    // - `time` - When it happened (`ClockMicros()`, or an event's `time`), in `µs`.
+    bool Input(EngineInput input, uint32_t time) {
+        EngineState next = Next(state, input);
+        if (next == state) {
+            return false;
+        }
+        state = next;
+        entered = time;
+        changes++;
+        emitter.EmitEvent({EventType::ENGINE_STATE_CHANGE, (float)next, EventTypeName(EventType::ENGINE_STATE_CHANGE), time});
+        return true;
+    }
+
+    // ### `EngineStateMachine.OnTemperature()`
+    // Checks the coil temperature (e.g. `ThermalModel.Temperature()`, after each stroke).
+    // ### Parameters
+    // - `temperature` - The coil temperature, in `°F`.
+    // - `time` - When it was estimated, in `µs`.
+    void OnTemperature(float temperature, uint32_t time) {
+        if (temperature >= ENGINE_HOT_TEMPERATURE) {
+            Input(EngineInput::HOT, time);
+        }
+        else if (temperature <= ENGINE_COOL_TEMPERATURE) {
+            Input(EngineInput::COOL, time);
+        }
+    }
+
+    // ### `EngineStateMachine.OnStroke()`
+    // Checks a stroke's inferred coil temperature (if it had at least `ENGINE_TEMPERATURE_SAMPLES` readings), for
+    // firmware without a `ThermalModel`. Call it with every stroke from `StrokeAnalyzer`.
+    void OnStroke(const StrokeAnalysis& stroke) {
+        if (stroke.samples >= ENGINE_TEMPERATURE_SAMPLES) {
+            OnTemperature(stroke.data.temperature, stroke.time);
+        }
+    }
+
+    // ### `EngineStateMachine.State()`
+    // Returns the current state.
+    EngineState State() const {
+        return state;
+    }
+
+    // ### `EngineStateMachine.Entered()`
+    // Returns when the current state was entered (`0` if it is still the initial one), in `µs`.
+    uint32_t Entered() const {
+        return entered;
+    }
+
+    // ### `EngineStateMachine.Profile()`
+    // Returns how the firmware works in `state` (the current state by default).
+    const EngineStateProfile& Profile(EngineState state) const {
+        return profiles[(size_t)state];
+    }
+    const EngineStateProfile& Profile() const {
+        return Profile(state);
+    }
+
+    // ### `EngineStateMachine.SetProfile()`
+    // Changes how the firmware works in `state` (from its next `ENGINE_STATE_CHANGE` on, if it is the current one).
+    // Returns `false` (changing nothing) if its switch, tachometer or thermal interval is `0`.
+    // ### Parameters
+    // - `state` - The `EngineState`.
+    // - `profile` - Its new `EngineStateProfile`.
+    bool SetProfile(EngineState state, const EngineStateProfile& profile) {
+        if (profile.switch_interval == 0 || profile.tachometer_interval == 0 || profile.thermal_interval == 0) {
+            return false;
+        }
+        profiles[(size_t)state] = profile;
+        return true;
+    }
+};
+
+static_assert(EngineStateMachine::Check(), "Invalid EngineStateMachine::transitions");
+
+
+
+#endif // ENGINE_STATE_HPP
\ No newline at end of file
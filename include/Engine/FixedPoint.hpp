@@ -0,0 +1,110 @@
+/****************************************************************
+*                                                               *
+*   FixedPoint.hpp                                              *
+*                                                               *
+*   Scaled-integer arithmetic helpers.                          *
+*   Platform-independent (shared with host-side tools).         *
+*                                                               *
+*****************************************************************/
+// The ESP8266 has no FPU: every `float` operation is a library call, and a division costs hundreds of cycles.
+// Quantities on the hot paths are therefore kept as integers in small fixed units (`µV`, `µA`, `µW`, ...), and
+// multiplications by physical constants are done with a `FixedScale`: the constant as a 32-bit multiplier and a
+// binary shift, computed from a `double` at compile time.
+#ifndef FIXED_POINT_HPP
+#define FIXED_POINT_HPP
+
+#include <stdint.h>
+
+
+
+// ## FixedScale
+// A positive factor `multiplier / 2^shift`, with `multiplier` normalized to 32 significant bits
+// (a relative precision of `2^-32`). Make one with `MakeScale()`, and apply it with `Scale()`.
+struct FixedScale {
+    uint32_t multiplier;
+    int shift;
+};
+
+// ### `MakeScale()`
+// Returns the `FixedScale` for `factor` (between `2^-63` and `2^32`).
+// Meant for `constexpr` constants, so the floating-point work happens in the compiler.
+constexpr FixedScale MakeScale(double factor) {
+    int shift = 0;
+    while (factor < 2147483648.0) {
+        factor *= 2;
+        shift++;
+    }
+    while (factor >= 4294967296.0) {
+        factor /= 2;
+        shift--;
+    }
+    uint64_t multiplier = (uint64_t)(factor + 0.5);
+    if (multiplier >= 4294967296ull) {
+        multiplier /= 2;
+        shift--;
+    }
+    return FixedScale{(uint32_t)multiplier, shift};
+}
+
+// ### `Scale()`
+// Returns `value × scale`, rounded to the nearest integer.
+// The product is formed in 96 bits, so it cannot overflow unless the result itself doesn't fit in 64 bits.
+inline uint64_t Scale(uint64_t value, FixedScale scale) {
+    uint64_t low = (value & 0xFFFFFFFFull) * scale.multiplier;
+    uint64_t high = (value >> 32) * scale.multiplier + (low >> 32);    // Product = high × 2^32 + (uint32_t)low
+    uint32_t low32 = (uint32_t)low;
+    int shift = scale.shift;
+    if (shift == 0) {
+        return (high << 32) | low32;
+    }
+    if (shift < 32) {
+        return ((high << (32 - shift)) | (low32 >> shift)) + ((low32 >> (shift - 1)) & 1);
+    }
+    if (shift == 32) {
+        return high + (low32 >> 31);
+    }
+    if (shift - 32 >= 64) {
+        return 0;
+    }
+    return (high >> (shift - 32)) + ((high >> (shift - 33)) & 1);
+}
+
+// ### `ScaleSigned()`
+// Returns `value × scale`, rounded to the nearest integer (halves away from zero).
+inline int64_t ScaleSigned(int64_t value, FixedScale scale) {
+    if (value < 0) {
+        return -(int64_t)Scale((uint64_t)-value, scale);
+    }
+    return (int64_t)Scale((uint64_t)value, scale);
+}
+
+// ### `DivideRounded()`
+// Returns `numerator / denominator`, rounded to the nearest integer (`denominator` must not be `0`).
+// Use 32-bit operands where they fit: a 64-bit division is a much slower library call on the ESP8266.
+inline uint32_t DivideRounded(uint32_t numerator, uint32_t denominator) {
+    uint32_t quotient = numerator / denominator;
+    uint32_t remainder = numerator - quotient * denominator;
+    return quotient + (remainder >= denominator - remainder ? 1 : 0);
+}
+
+inline uint64_t DivideRounded(uint64_t numerator, uint64_t denominator) {
+    uint64_t quotient = numerator / denominator;
+    uint64_t remainder = numerator - quotient * denominator;
+    return quotient + (remainder >= denominator - remainder ? 1 : 0);
+}
+
+// ### `AverageRounded()`
+// Returns `sum / count` for a sum of `count` `int32_t` values, rounded to the nearest integer (halves away from zero).
+// `count` must not be `0`. The division is done in 32 bits when the sum fits.
+inline int32_t AverageRounded(int64_t sum, uint32_t count) {
+    int32_t half = count / 2;
+    if (sum > INT32_MIN + half && sum < INT32_MAX - half) {
+        int32_t small = (int32_t)sum;
+        return (small < 0 ? small - half : small + half) / (int32_t)count;
+    }
+    return (int32_t)((sum < 0 ? sum - half : sum + half) / (int64_t)count);
+}
+
+
+
+#endif // FIXED_POINT_HPP
\ No newline at end of file
@@ -0,0 +1,485 @@
+/****************************************************************
+*                                                               *
+*   SpectralMonitor.hpp                                         *
+*                                                               *
+*   Goertzel filter bank over the coil current, in orders.      *
+*                                                               *
+*****************************************************************/
+#ifndef SPECTRAL_MONITOR_HPP
+#define SPECTRAL_MONITOR_HPP
+
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <Arduino.h>
+#include "Events/Event.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Sensors/Sample.hpp"
+#include "Sensors/INA219.hpp"
+#include "Sensors/Responder.hpp"
+#include "Sensors/SampleListener.hpp"
+#include "Clock/Clock.hpp"
+
+// ### `SPECTRAL_BANDS`
+// Number of bands (Goertzel filters) the current is watched in.
+#ifndef SPECTRAL_BANDS
+#define SPECTRAL_BANDS 6
+#endif
+
+// ### `SPECTRAL_ORDERS`
+// Default frequency of each band, in orders (multiples of the rotation frequency). The switch is closed for half a
+// turn, so a healthy engine draws mostly the odd orders; a stroke longer or shorter than the other half, or the
+// current dipping within it (e.g. a fouled switch contact), shows up in the even ones, and something happening every
+// other turn (e.g. a loose crank) in the half orders.
+#ifndef SPECTRAL_ORDERS
+#define SPECTRAL_ORDERS {0.5f, 1.f, 1.5f, 2.f, 3.f, 4.f}
+#endif
+
+// ### `SPECTRAL_SAMPLE_PERIOD`
+// Time between the samples the filters run on, in `µs` (the INA219's polling interval while the engine runs).
+#ifndef SPECTRAL_SAMPLE_PERIOD
+#define SPECTRAL_SAMPLE_PERIOD 2000
+#endif
+
+// ### `SPECTRAL_BLOCK`
+// Samples per block, over which each band's magnitude is measured (`256` at `2 ms` is about half a second, and
+// resolves `2 Hz`).
+#ifndef SPECTRAL_BLOCK
+#define SPECTRAL_BLOCK 256
+#endif
+
+// ### `SPECTRAL_MAX_GAP`
+// Longest time after a reading taken while the switch is open, in `µs`, it stands in for the samples missing after it
+// (with a controller driving the coil, the INA219 is polled whatever the switch, so these are only late readings).
+#ifndef SPECTRAL_MAX_GAP
+#define SPECTRAL_MAX_GAP 3000
+#endif
+
+// ### `SPECTRAL_MIN_SAMPLES`
+// Fewest samples per revolution a block runs at. The INA219 doesn't filter the current before it is sampled, so the
+// harmonics of the square-ish current above half the sample rate alias onto the bands; at `16` (up to `1875 RPM` at
+// `2 ms`) the ones that do are weak enough not to matter.
+#ifndef SPECTRAL_MIN_SAMPLES
+#define SPECTRAL_MIN_SAMPLES 16
+#endif
+
+// ### `SPECTRAL_MAX_REVOLUTION`
+// Longest time between two rising edges, in `µs`, taken as a revolution (for the rotation frequency).
+#ifndef SPECTRAL_MAX_REVOLUTION
+#define SPECTRAL_MAX_REVOLUTION 500000
+#endif
+
+// ### `SPECTRAL_LEARN_BLOCKS`
+// Blocks each band's baseline is averaged over before it is checked against.
+#ifndef SPECTRAL_LEARN_BLOCKS
+#define SPECTRAL_LEARN_BLOCKS 16
+#endif
+
+// ### `SPECTRAL_BASELINE_GAIN`
+// Fraction of the gap to a block's magnitude each band's baseline then closes (`1/32` follows slow changes over about
+// `16 s`), unless the band exceeded it.
+#ifndef SPECTRAL_BASELINE_GAIN
+#define SPECTRAL_BASELINE_GAIN (1 / 32.f)
+#endif
+
+// ### `SPECTRAL_RELEARN_SPEED`
+// Relative change of speed from the baselines' after which they are learned again (the current's spectrum, in
+// orders, changes with the speed).
+#ifndef SPECTRAL_RELEARN_SPEED
+#define SPECTRAL_RELEARN_SPEED 0.3f
+#endif
+
+// ### `SPECTRAL_THRESHOLD`
+// A band exceeds its baseline once its magnitude is more than this many times the baseline,
+#ifndef SPECTRAL_THRESHOLD
+#define SPECTRAL_THRESHOLD 2.f
+#endif
+
+// ### `SPECTRAL_FLOOR`
+// plus this much, in `A` (so that a band with almost nothing in it doesn't exceed its baseline on noise alone).
+#ifndef SPECTRAL_FLOOR
+#define SPECTRAL_FLOOR 0.05f
+#endif
+
+
+
+// ## SpectralBand
+// One band of a `SpectralMonitor`, as of its last block.
+// ### Defined properties:
+// - `order` (`float`) - The band's frequency, in orders (multiples of the rotation frequency).
+// - `frequency` (`float`) - Its frequency in the last block, in `Hz` (`0` if it couldn't be measured: the engine not
+//   turning, or the frequency too close to `0` or to half the sample rate for the block to resolve).
+// - `magnitude` (`float`) - Amplitude of the current at that frequency over the last block, in `A`.
+// - `baseline` (`float`) - What the magnitude usually is, in `A`.
+// - `blocks` (`uint16_t`) - Blocks the baseline has been learned from (it is only checked against from `SPECTRAL_LEARN_BLOCKS` on).
+// - `exceeded` (`bool`) - Whether the magnitude exceeds the baseline (`SPECTRAL_BAND_EXCEEDED` raised, and the
+//   magnitude not back under `SPECTRAL_THRESHOLD` times the baseline since).
+// - `time` (`uint32_t`) - When the last block ended, in `µs`.
+struct SpectralBand {
+    float order;
+    float frequency;
+    float magnitude;
+    float baseline;
+    uint16_t blocks;
+    bool exceeded;
+    uint32_t time;
+};
+
+
+
+// ## SpectralMonitor
+// Watches the coil current for mechanical problems, which show up as changes in its spectrum at frequencies tied to
+// the speed. A bank of `SPECTRAL_BANDS` Goertzel filters runs over the INA219's current as the readings come in, each
+// tuned to a multiple (`order`) of the rotation frequency timed from the switch's rising edges, so a band follows the
+// engine whatever its speed. A filter is one multiply-add per sample on integer state, so a sample costs `O(bands)`
+// and nothing is buffered: no FFT, no window of past readings.
+// The filters need evenly spaced samples. Readings are placed on a `SPECTRAL_SAMPLE_PERIOD` grid, a missing sample
+// taking the last reading while the switch is closed (or up to `SPECTRAL_MAX_GAP` after it) and `0` otherwise, when
+// the coil is off. Each block of `SPECTRAL_BLOCK` samples is Hann-windowed (a table of its weights, so a strong order
+// doesn't leak into its neighbours), has the previous block's mean taken off, and runs at the mean rotation frequency
+// over the previous block (none while the engine turns too fast for `SPECTRAL_MIN_SAMPLES`); at its end, each band's
+// magnitude is computed (one square root), compared to its baseline, and passed to the `SetOnBand()` function, e.g.
+// for the serial telemetry.
+// Each band's baseline is its mean over `SPECTRAL_LEARN_BLOCKS` blocks, then follows its magnitude slowly; once the
+// magnitude is more than `SPECTRAL_THRESHOLD` times the baseline (plus `SPECTRAL_FLOOR`), `SPECTRAL_BAND_EXCEEDED` is
+// raised, with the band's `order` as its value, and the baseline is held until it falls back. The baselines are
+// learned again after the speed changed by more than `SPECTRAL_RELEARN_SPEED`.
+// Add it to the INA219 with `AddSampleListener()` (the edges are handled internally, so don't replace them with
+// `SetOnEvent()`).
+// ### Parameters
+// - `e` - The global `EventEmitter` object.
+// ```c++
+// SpectralMonitor spectral(event_emitter);
+// ina219.AddSampleListener(&spectral);
+// spectral.SetOnBand([](const SpectralBand& band, size_t index) { telemetry.OnBand(band, index); });
+// server.ServeSpectralMonitor(spectral);
+// ```
+class SpectralMonitor : public Responder, public SampleListener {
+private:
+    // Coefficients are `2·cos(ω)` with this many fractional bits. The filters' state stays well within 32 bits: with a
+    // reading below `2^16` current LSBs and `ω` at least two blocks' resolution from `0`, a block adds up to at most
+    // about `2^27`.
+    static constexpr int coefficient_bits = 28;
+
+    EventEmitter& emitter;
+    SpectralBand bands[SPECTRAL_BANDS];
+    bool measured[SPECTRAL_BANDS];                  // Whether each band is measured in this block,
+    int32_t coefficients[SPECTRAL_BANDS];           // and its `2·cos(ω)`.
+    int32_t state1[SPECTRAL_BANDS];                 // Each filter's last two outputs.
+    int32_t state2[SPECTRAL_BANDS];
+    uint16_t window[SPECTRAL_BLOCK];                // Hann weights, in `1/65536`.
+    float scale = 0;                                // From a filter's output to an amplitude, in `A`.
+
+    bool active = false;                            // Whether a block is in progress.
+    size_t count = 0;                               // Its samples so far.
+    int64_t sum = 0;                                // And their sum, in current LSBs.
+    int32_t mean = 0;                               // Of the previous block, in current LSBs.
+    uint32_t next_sample = 0;                       // Time of its next sample, in `µs`.
+    float block_rpm = 0;                            // Speed it runs at.
+    float baseline_rpm = 0;                         // Speed the baselines were learned at,
+    uint32_t baseline_blocks = 0;                   // over this many blocks.
+
+    int32_t last_value = 0;                         // Last reading, in current LSBs.
+    uint32_t last_reading = 0;                      // Times, in `µs`.
+    uint32_t last_rise = 0;
+    uint32_t last_fall = 0;
+    uint32_t revolution = 0;                        // Length of the last revolution, in `µs` (`0` = none).
+    uint32_t revolutions = 0;                       // Revolutions since the block began,
+    uint32_t revolutions_time = 0;                  // and their total length, in `µs`.
+    bool turning = false;                           // Whether `last_rise` began a revolution (no stall since).
+    bool high = false;                              // Whether the switch is closed.
+
+    std::function<void(const SpectralBand&, size_t)> on_band;
+
+    void OnEdge(const Event& event) {
+        Fill(event.time);                       // The samples before the edge, in the state before it
+        if (event.type == EventType::SWITCH1_STATE_CHANGE_TO_HIGH) {
+            uint32_t period = event.time - last_rise;
+            revolution = turning && period <= SPECTRAL_MAX_REVOLUTION ? period : 0;
+            if (revolution != 0) {
+                revolutions++;
+                revolutions_time += revolution;
+            }
+            last_rise = event.time;
+            turning = high = true;
+        }
+        else if (event.type == EventType::SWITCH1_STATE_CHANGE_TO_LOW) {
+            last_fall = event.time;
+            high = false;
+        }
+        else {                                  // ENGINE_STALL
+            turning = false;
+            revolution = 0;
+            active = false;
+        }
+    }
+
+    // ### `SpectralMonitor.Missing()`
+    // Private function returning what stands in for a missing sample at `time`: the last reading while the switch is
+    // closed; once it opened, the last reading over the part of the sample's period before the edge (so where the edge
+    // falls between two samples doesn't show up in the spectrum), or, for a reading taken after the edge, up to
+    // `SPECTRAL_MAX_GAP` after it; else `0`, the coil being off.
+    int32_t Missing(uint32_t time) const {
+        if (high) {
+            return last_value;
+        }
+        if (Clock::Before(last_reading, last_fall)) {
+            int32_t before = (int32_t)(last_fall - (time - SPECTRAL_SAMPLE_PERIOD / 2));
+            return before <= 0 ? 0
+                : before >= SPECTRAL_SAMPLE_PERIOD ? last_value
+                : (int32_t)((int64_t)last_value * before / SPECTRAL_SAMPLE_PERIOD);
+        }
+        return Clock::Before(time, last_reading + SPECTRAL_MAX_GAP) ? last_value : 0;
+    }
+
+    // ### `SpectralMonitor.Fill()`
+    // Private function running the missing samples before `end` through the filters. Drops the block instead if the
+    // gap is longer than a revolution could be.
+    void Fill(uint32_t end) {
+        if (active && Clock::Before(next_sample + SPECTRAL_MAX_REVOLUTION, end)) {
+            active = false;                     // Not turning in between (e.g. polling stopped by the watchdog)
+        }
+        while (active && Clock::Before(next_sample, end)) {
+            uint32_t time = next_sample;
+            next_sample += SPECTRAL_SAMPLE_PERIOD;
+            Step(Missing(time), time);
+        }
+    }
+
+    // ### `SpectralMonitor.Start()`
+    // Private function starting a block at the mean rotation frequency of the revolutions since the last one began (the
+    // switch's edges are only polled, so one revolution's is off by a few `%`), if the engine is turning slowly enough
+    // for `SPECTRAL_MIN_SAMPLES`. A band whose frequency is within two blocks' resolution of `0` or of half the sample
+    // rate isn't measured.
+    void Start() {
+        const float rate = 1e6f / SPECTRAL_SAMPLE_PERIOD;
+        float rpm = revolutions > 0 ? 60e6f * revolutions / revolutions_time : revolution != 0 ? 60e6f / revolution : 0;
+        revolutions = revolutions_time = 0;
+        active = revolution != 0 && rpm / 60 * SPECTRAL_MIN_SAMPLES <= rate;
+        if (!active) {
+            return;
+        }
+        block_rpm = rpm;
+        const float resolution = 2 * rate / SPECTRAL_BLOCK;
+        for (size_t band = 0; band < SPECTRAL_BANDS; band++) {
+            float frequency = bands[band].order * block_rpm / 60;
+            measured[band] = frequency >= resolution && frequency <= rate / 2 - resolution;
+            coefficients[band] = measured[band] ? (int32_t)lroundf(2 * cosf(2 * (float)M_PI * frequency / rate) * (1L << coefficient_bits)) : 0;
+            state1[band] = state2[band] = 0;
+        }
+        count = 0;
+        sum = 0;
+    }
+
+    // ### `SpectralMonitor.Step()`
+    // Private function running one sample through every filter, finishing the block with its last (and starting the
+    // next one, back to back).
+    void Step(int32_t value, uint32_t time) {
+        int32_t input = (int32_t)(((int64_t)(value - mean) * window[count]) >> 16);
+        for (size_t band = 0; band < SPECTRAL_BANDS; band++) {
+            int32_t output = input + (int32_t)(((int64_t)coefficients[band] * state1[band]) >> coefficient_bits) - state2[band];
+            state2[band] = state1[band];
+            state1[band] = output;
+        }
+        sum += value;
+        if (++count == SPECTRAL_BLOCK) {
+            Finish(time);
+            Start();
+        }
+    }
+
+    // ### `SpectralMonitor.Finish()`
+    // Private function computing each band's magnitude at the end of a block and checking it against its baseline.
+    void Finish(uint32_t time) {
+        mean = (int32_t)(sum / SPECTRAL_BLOCK);
+        bool relearn = baseline_blocks == 0 || fabsf(block_rpm - baseline_rpm) > baseline_rpm * SPECTRAL_RELEARN_SPEED;
+        if (relearn) {
+            baseline_rpm = block_rpm;
+            baseline_blocks = 0;
+        }
+        else if (baseline_blocks >= SPECTRAL_LEARN_BLOCKS) {
+            baseline_rpm += (block_rpm - baseline_rpm) * SPECTRAL_BASELINE_GAIN;
+        }
+        baseline_blocks++;
+        blocks++;
+        for (size_t band = 0; band < SPECTRAL_BANDS; band++) {
+            SpectralBand& b = bands[band];
+            b.time = time;
+            if (relearn) {
+                b.baseline = 0;
+                b.blocks = 0;
+                b.exceeded = false;
+            }
+            if (!measured[band]) {
+                b.frequency = b.magnitude = 0;
+                continue;
+            }
+            b.frequency = b.order * block_rpm / 60;
+            double c = (double)coefficients[band] / (1L << coefficient_bits);
+            double s1 = state1[band], s2 = state2[band];
+            b.magnitude = (float)sqrt(fmax(s1 * s1 + s2 * s2 - c * s1 * s2, 0)) * scale;
+            if (b.blocks < SPECTRAL_LEARN_BLOCKS) {
+                b.blocks++;
+                b.baseline += (b.magnitude - b.baseline) / b.blocks;
+                continue;
+            }
+            if (!b.exceeded && b.magnitude > b.baseline * SPECTRAL_THRESHOLD + SPECTRAL_FLOOR) {
+                b.exceeded = true;
+                alerts++;
+                emitter.EmitEvent({EventType::SPECTRAL_BAND_EXCEEDED, b.order, EventTypeName(EventType::SPECTRAL_BAND_EXCEEDED), time});
+            }
+            else if (b.exceeded && b.magnitude <= b.baseline * SPECTRAL_THRESHOLD) {
+                b.exceeded = false;
+            }
+            if (!b.exceeded) {
+                b.baseline += (b.magnitude - b.baseline) * SPECTRAL_BASELINE_GAIN;
+            }
+        }
+        if (on_band) {
+            for (size_t band = 0; band < SPECTRAL_BANDS; band++) {
+                on_band(bands[band], band);
+            }
+        }
+    }
+
+public:
+    // ### `SpectralMonitor.blocks`
+    // Number of blocks completed.
+    uint32_t blocks = 0;
+
+    // ### `SpectralMonitor.alerts`
+    // Number of `SPECTRAL_BAND_EXCEEDED` events raised.
+    uint32_t alerts = 0;
+
+    // ### `SpectralMonitor.enabled`
+    // Whether readings are taken (e.g. not while the engine is being started, when its spectrum is nothing like the
+    // running engine's); clearing it drops the block in progress.
+    bool enabled = true;
+
+    // ## SpectralMonitor
+    // Watches the coil current's spectrum at multiples of the rotation frequency.
+    // ### Parameters
+    // - `e` - The global `EventEmitter` object.
+    SpectralMonitor(EventEmitter& e)
+        : Responder(
+            e,
+            {EventType::SWITCH1_STATE_CHANGE_TO_LOW, EventType::SWITCH1_STATE_CHANGE_TO_HIGH, EventType::ENGINE_STALL},
+            [this](const Event& event) { OnEdge(event); }
+        ),
+        emitter(e) {
+            const float orders[SPECTRAL_BANDS] = SPECTRAL_ORDERS;
+            for (size_t band = 0; band < SPECTRAL_BANDS; band++) {
+                bands[band] = {orders[band], 0, 0, 0, 0, false, 0};
+                measured[band] = false;
+                coefficients[band] = state1[band] = state2[band] = 0;
+            }
+            uint32_t total = 0;
+            for (size_t i = 0; i < SPECTRAL_BLOCK; i++) {
+                window[i] = (uint16_t)lroundf(32767.5f * (1 - cosf(2 * (float)M_PI * i / SPECTRAL_BLOCK)));
+                total += window[i];
+            }
+            // A sinusoid of amplitude `A` comes out of a windowed block with a magnitude of `A/2` times its weights' sum
+            scale = 2 * 65536.f / total * INA219_CURRENT_LSB * 1e-6f;
+    }
+
+    // ### `SpectralMonitor.SetOrder()`
+    // Sets the frequency of a band, in orders (`SPECTRAL_ORDERS` by default), from the next block on, and learns its
+    // baseline again. Returns `false` (changing nothing) if there is no such band or `order` isn't positive.
+    // ### Parameters
+    // - `band` - The band (`0` to `SPECTRAL_BANDS - 1`).
+    // - `order` - Its frequency, in multiples of the rotation frequency.
+    bool SetOrder(size_t band, float order) {
+        if (band >= SPECTRAL_BANDS || !(order > 0)) {
+            return false;
+        }
+        bands[band] = {order, 0, 0, 0, 0, false, 0};
+        return true;
+    }
+
+    // ### `SpectralMonitor.SetOnBand()`
+    // Sets a function receiving every band, and its index, at the end of each block (e.g. `SerialTelemetry.OnBand()`).
+    void SetOnBand(std::function<void(const SpectralBand&, size_t)> function) {
+        on_band = function;
+    }
+
+    // ### `SpectralMonitor.OnReading()`
+    // Places a reading on the sample grid, running the filters over the samples missing before it, then it (its time
+    // starting the grid again, so the readings' jitter doesn't add up).
+    void OnReading(const FixedSample& fixed) override {
+        if (!enabled) {
+            active = false;
+            return;
+        }
+        int32_t value = fixed.current / INA219_CURRENT_LSB;
+        if (active && Clock::Before(fixed.time + SPECTRAL_SAMPLE_PERIOD / 2, next_sample)) {
+            last_value = value;             // Read faster than the grid; the next sample takes the latest reading
+            last_reading = fixed.time;
+            return;
+        }
+        Fill(fixed.time - SPECTRAL_SAMPLE_PERIOD / 2);
+        if (!active) {
+            if (blocks == 0) {
+                mean = value;               // Nothing measured yet
+            }
+            Start();
+        }
+        if (active) {
+            Step(value, fixed.time);
+            next_sample = fixed.time + SPECTRAL_SAMPLE_PERIOD;
+        }
+        last_value = value;
+        last_reading = fixed.time;
+    }
+
+    // ### `SpectralMonitor.OnSample()`
+    // Takes one reading given only in floats (converted back to scaled integers).
+    void OnSample(const Sample& sample) override {
+        OnReading(FixedSample::FromSample(sample));
+    }
+
+    // ### `SpectralMonitor.Band()`
+    // Returns a band (`0` to `SPECTRAL_BANDS - 1`) as of the last block.
+    const SpectralBand& Band(size_t band) const {
+        return bands[band];
+    }
+
+    // ### `SpectralMonitor.Rpm()`
+    // Returns the speed the last block ran at, in `RPM` (`0` before the first).
+    float Rpm() const {
+        return block_rpm;
+    }
+
+    // ### `SpectralMonitor.Render()`
+    // Writes the bands as JSON: `{"rpm":R,"blocks":N,"alerts":M,"order":[...],"frequency":[...],"magnitude":[...],
+    // "baseline":[...],"exceeded":[...]}`, with one entry per band (frequencies in `Hz`, magnitudes in `A`).
+    // ### Parameters
+    // - `out` - Where to write the output (any Arduino `Print`, e.g. an `AsyncResponseStream`).
+    void Render(Print& out) const {
+        out.printf("{\"rpm\":%.6g,\"blocks\":%lu,\"alerts\":%lu,\"order\":[", block_rpm, (unsigned long)blocks, (unsigned long)alerts);
+        for (size_t band = 0; band < SPECTRAL_BANDS; band++) {
+            out.printf(band == 0 ? "%g" : ",%g", bands[band].order);
+        }
+        out.print("],\"frequency\":[");
+        for (size_t band = 0; band < SPECTRAL_BANDS; band++) {
+            out.printf(band == 0 ? "%.6g" : ",%.6g", bands[band].frequency);
+        }
+        out.print("],\"magnitude\":[");
+        for (size_t band = 0; band < SPECTRAL_BANDS; band++) {
+            out.printf(band == 0 ? "%.6g" : ",%.6g", bands[band].magnitude);
+        }
+        out.print("],\"baseline\":[");
+        for (size_t band = 0; band < SPECTRAL_BANDS; band++) {
+            out.printf(band == 0 ? "%.6g" : ",%.6g", bands[band].baseline);
+        }
+        out.print("],\"exceeded\":[");
+        for (size_t band = 0; band < SPECTRAL_BANDS; band++) {
+            out.printf(band == 0 ? "%s" : ",%s", bands[band].exceeded ? "true" : "false");
+        }
+        out.print("]}");
+    }
+};
+
+
+
+#endif // SPECTRAL_MONITOR_HPP
\ No newline at end of file
@@ -0,0 +1,205 @@
+/****************************************************************
+*                                                               *
+*   StrokeAnalyzer.hpp                                          *
+*                                                               *
+*   Per-stroke accumulation of INA219 readings.                 *
+*                                                               *
+*****************************************************************/
+#ifndef STROKE_ANALYZER_HPP
+#define STROKE_ANALYZER_HPP
+
+#include <stdint.h>
+#include <functional>
+#include "FixedPoint.hpp"
+#include "StrokeMath.hpp"
+#include "Clock/Clock.hpp"
+#include "Events/Event.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Sensors/Sample.hpp"
+#include "Sensors/INA219.hpp"
+#include "Sensors/Responder.hpp"
+#include "Sensors/SampleListener.hpp"
+#include "WebServer/Data.hpp"
+
+
+
+// ## StrokeAnalysis
+// One complete stroke, from the readings taken between its rising and falling switch edges.
+// ### Defined properties:
+// - `time` (`uint32_t`) - Timestamp of the falling edge that closed the stroke (`micros()`), in `µs`.
+// - `duration` (`uint32_t`) - Time from the rising to the falling edge, in `µs`.
+// - `samples` (`uint32_t`) - Number of INA219 readings taken during the stroke.
+// - `data` (`Data`) - Speed, torque, mean voltage and current, power, efficiency and temperature, as served.
+// - `energy` (`float`) - Electrical energy drawn during the stroke, in `J` (each reading's power held until the next).
+// - `peak_current` (`float`) - Highest current read during the stroke, in `A`.
+// - `resistance` (`float`) - Mean coil resistance over the stroke's powered readings, in `Ω` (`0` if there were none).
+struct StrokeAnalysis {
+    uint32_t time;
+    uint32_t duration;
+    uint32_t samples;
+    Data data;
+    float energy;
+    float peak_current;
+    float resistance;
+};
+
+
+
+// ## StrokeAnalyzer
+// Turns the INA219's readings into one `StrokeAnalysis` per stroke.
+// A rising edge of switch 1 opens a stroke and a falling edge closes it; each reading taken in between is added to
+// running sums as it arrives (in the scaled integers `INA219` derives it in), so closing a stroke only divides them
+// out. Only the stroke's own readings count, unlike the INA219's `measurements`, which span stroke boundaries.
+// Readings arriving while no stroke is open are ignored, as is a falling edge without a rising one.
+// Add it to the INA219 with `AddSampleListener()`, and receive each stroke with `SetOnStroke()`
+// (the edges are handled internally, so don't replace them with `SetOnEvent()`).
+// ### Parameters
+// - `e` - The global `EventEmitter` object.
+// - `origin` (optional) - Time from which `Data.elapsed` is counted (`micros()`), in `µs` (default: now).
+// ```c++
+// StrokeAnalyzer stroke_analyzer(event_emitter);
+// ina219.AddSampleListener(&stroke_analyzer);
+// stroke_analyzer.SetOnStroke([](const StrokeAnalysis& stroke) { /* serve/record stroke.data */ });
+// ```
+class StrokeAnalyzer : public Responder, public SampleListener {
+private:
+    bool open = false;                  // Whether a stroke is in progress.
+    uint32_t began = 0;                 // Time of the stroke's rising edge, in `µs`.
+    uint32_t last_time = 0;             // Time of the last reading (or the rising edge), in `µs`.
+    int32_t last_power = 0;             // Power of the last reading, in `µW`.
+    uint32_t samples = 0;
+    uint32_t powered_samples = 0;       // Readings with a resistance (some power drawn).
+    int64_t voltage = 0;                // Sum, in `µV`.
+    int64_t current = 0;                // Sum, in `µA`.
+    int64_t resistance = 0;             // Sum over the powered readings, in `µΩ`.
+    int64_t energy = 0;                 // In `pJ` (`µW × µs`).
+    int32_t peak_current = 0;           // In `µA`.
+
+    uint32_t last_edge;                 // Time of the last edge (or `origin`), in `µs`.
+    uint64_t elapsed = 0;               // Time from `origin` to `last_edge`, in `µs`.
+
+    std::function<void(const StrokeAnalysis&)> on_stroke;
+
+    void AdvanceTo(uint32_t time) {
+        elapsed += (uint32_t)(time - last_edge);
+        last_edge = time;
+    }
+
+    void OnEdge(const Event& event) {
+        if (event.type == EventType::SWITCH1_STATE_CHANGE_TO_HIGH) {
+            Open(event.time);
+        }
+        else if (event.type == EventType::SWITCH1_STATE_CHANGE_TO_LOW) {
+            Close(event.time);
+        }
+    }
+
+public:
+    // ### `StrokeAnalyzer.last`
+    // The most recently closed stroke (only valid once a stroke has closed).
+    StrokeAnalysis last = {};
+
+    // ## StrokeAnalyzer
+    // Turns the INA219's readings into one `StrokeAnalysis` per stroke.
+    // ### Parameters
+    // - `e` - The global `EventEmitter` object.
+    // - `origin` (optional) - Time from which `Data.elapsed` is counted (`micros()`), in `µs` (default: now).
+    StrokeAnalyzer(EventEmitter& e, uint32_t origin = ClockMicros())
+        : Responder(
+            e,
+            {EventType::SWITCH1_STATE_CHANGE_TO_LOW, EventType::SWITCH1_STATE_CHANGE_TO_HIGH},
+            [this](const Event& event) { OnEdge(event); }
+        ),
+        last_edge(origin) { }
+
+    // ### `StrokeAnalyzer.SetOnStroke()`
+    // Sets the function called with every stroke when it closes (from the switch's `Ticker` callback, so keep it short).
+    void SetOnStroke(std::function<void(const StrokeAnalysis&)> function) {
+        on_stroke = function;
+    }
+
+    // ### `StrokeAnalyzer.IsOpen()`
+    // Checks if a stroke is in progress.
+    bool IsOpen() const {
+        return open;
+    }
+
+    // ### `StrokeAnalyzer.Open()`
+    // Opens a stroke (discarding one in progress). Called on every rising edge; call it directly for a stroke that
+    // was already under way, e.g. when the switch is HIGH at boot.
+    // ### Parameters
+    // - `time` - Time the stroke began (`micros()`), in `µs`.
+    void Open(uint32_t time) {
+        AdvanceTo(time);
+        open = true;
+        began = last_time = time;
+        last_power = 0;
+        samples = powered_samples = 0;
+        voltage = current = resistance = energy = 0;
+        peak_current = 0;
+    }
+
+    // ### `StrokeAnalyzer.OnReading()`
+    // Adds one reading to the stroke in progress, in constant time.
+    void OnReading(const FixedSample& fixed) override {
+        if (!open) {
+            return;
+        }
+        // Each reading's power is held until the next one; the first also covers the time since the rising edge
+        int32_t power = samples == 0 ? fixed.power : last_power;
+        energy += (int64_t)power * (uint32_t)(fixed.time - last_time);
+        last_time = fixed.time;
+        last_power = fixed.power;
+        samples++;
+        voltage += fixed.voltage;
+        current += fixed.current;
+        peak_current = fixed.current > peak_current ? fixed.current : peak_current;
+        if (fixed.resistance != INT32_MAX) {
+            resistance += fixed.resistance;
+            powered_samples++;
+        }
+    }
+
+    // ### `StrokeAnalyzer.OnSample()`
+    // Adds one reading given only in floats (converted back to scaled integers).
+    void OnSample(const Sample& sample) override {
+        OnReading(FixedSample::FromSample(sample));
+    }
+
+    // ### `StrokeAnalyzer.Close()`
+    // Closes the stroke in progress (if any): finalizes it into `last` and passes it to the `SetOnStroke()` function.
+    // Called on every falling edge. Returns `false` if no stroke was open.
+    // ### Parameters
+    // - `time` - Time the stroke ended (`micros()`), in `µs`.
+    bool Close(uint32_t time) {
+        AdvanceTo(time);
+        if (!open) {
+            return false;
+        }
+        open = false;
+        int32_t mean_resistance = powered_samples > 0 ? AverageRounded(resistance, powered_samples) : 0;
+        int64_t total_energy = energy + (samples > 0 ? (int64_t)last_power * (uint32_t)(time - last_time) : 0);
+
+        last.time = time;
+        last.duration = time - began;
+        last.samples = samples;
+        last.data = ComputeStrokeDataFixed(
+            last.duration,
+            samples > 0 ? AverageRounded(voltage, samples) : 0,
+            samples > 0 ? AverageRounded(current, samples) : 0,
+            powered_samples > 0 ? INA219::InferTemperatureFixed(mean_resistance) : 0,
+            elapsed / 1000000.0
+        );
+        last.energy = total_energy * 1e-12f;
+        last.peak_current = peak_current * 1e-6f;
+        last.resistance = mean_resistance * 1e-6f;
+        if (on_stroke) {
+            on_stroke(last);
+        }
+        return true;
+    }
+};
+
+
+
+#endif // STROKE_ANALYZER_HPP
\ No newline at end of file
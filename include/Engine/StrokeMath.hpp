@@ -0,0 +1,116 @@
+/****************************************************************
+*                                                               *
+*   StrokeMath.hpp                                              *
+*                                                               *
+*   Per-stroke speed/torque/power/efficiency calculations.      *
+*   Platform-independent (shared with host-side tools).         *
+*                                                               *
+*****************************************************************/
+#ifndef STROKE_MATH_HPP
+#define STROKE_MATH_HPP
+
+#include <stdint.h>
+#include <math.h>
+#include "FixedPoint.hpp"
+#include "WebServer/Data.hpp"
+
+
+
+// ### `STROKE_AVERAGE_DISPLACEMENT`
+// Average distance, in `m`, over which the coil's force acts on the piston during a stroke.
+#ifndef STROKE_AVERAGE_DISPLACEMENT
+#define STROKE_AVERAGE_DISPLACEMENT 0.01346962
+#endif
+
+// ### `STROKE_MIN_DURATION`
+// Shortest stroke duration, in `µs`, `ComputeStrokeDataFixed()` computes with (shorter ones are taken as this long).
+// `100 µs` is `300000 RPM`, far beyond what the engine or the `1 ms` switch polling can produce.
+#ifndef STROKE_MIN_DURATION
+#define STROKE_MIN_DURATION 100
+#endif
+
+
+
+// ### `ComputeStrokeData()`
+// Computes the values served for one stroke from how long the switch stayed HIGH and the INA219's running averages.
+// Everything is derived from its arguments (never from the clock), so a replayed run gives bit-identical results.
+// The floating-point reference for `ComputeStrokeDataFixed()`, which the firmware uses (and for host tools working
+// from recorded floats).
+// ### Parameters
+// - `duration` - Time between the stroke's rising and falling switch edges, in `µs`.
+// - `voltage` - Average voltage over the stroke, in `V`.
+// - `current` - Average current over the stroke, in `A`.
+// - `temperature` - Average inferred coil temperature over the stroke, in `°F`.
+// - `elapsed` - Value of `Data.elapsed` for the stroke, in `s`.
+inline Data ComputeStrokeData(uint32_t duration, float voltage, float current, float temperature, float elapsed) {
+    const double x_avg = STROKE_AVERAGE_DISPLACEMENT;     // m
+    float dt = duration / 1000000.0;
+    float rpm = 30.0 / dt;
+    float force = 1 / (212.86 * dt * dt);
+    float torque = force * x_avg;
+    float powerin = voltage * current;
+    float powerout = (rpm * rpm * rpm) * (x_avg / 1829397.0);
+    float efficiency = powerout / powerin;
+    return Data(
+        rpm,
+        torque * 1000.0,            // N·m -> N·mm
+        voltage,
+        current,
+        powerin,
+        powerout,
+        efficiency * 100.0,         // .% -> %
+        temperature,
+        elapsed
+    );
+}
+
+
+
+// ### `ComputeStrokeDataFixed()`
+// `ComputeStrokeData()` in scaled integers, from the INA219's fixed-point running averages (see `FixedSample`).
+// Speed is kept in `1/128 RPM`, and torque and power-out are computed from it (`∝ RPM²` and `∝ RPM³`) with constants
+// folded at compile time, so the only divisions are a 32-bit one for the speed and a float one for the efficiency.
+// Values are converted to floats only to fill in the returned `Data`.
+// ### Parameters
+// - `duration` - Time between the stroke's rising and falling switch edges, in `µs`.
+// - `voltage` - Average voltage over the stroke, in `µV`.
+// - `current` - Average current over the stroke, in `µA`.
+// - `temperature` - Average inferred coil temperature over the stroke, in hundredths of a `°F`.
+// - `elapsed` - Value of `Data.elapsed` for the stroke, in `s`.
+inline Data ComputeStrokeDataFixed(uint32_t duration, int32_t voltage, int32_t current, int32_t temperature, float elapsed) {
+    constexpr double x_avg = STROKE_AVERAGE_DISPLACEMENT;     // m
+    // torque [N·mm] = 1000 × x_avg / (212.86 × dt²), with dt = 30 / rpm  ->  in mN·mm from rpm × 128
+    constexpr FixedScale torque_per_rpm2 = MakeScale(1e6 * x_avg / (212.86 * 900 * 128 * 128));
+    // powerout [W] = rpm³ × x_avg / 1829397  ->  in 1/256 µW from rpm × 128, as (rpm² × 2^24 × k) × rpm / 2^16
+    constexpr FixedScale powerout_per_rpm2 = MakeScale(1e6 * x_avg / 1829397.0 / (128.0 * 128 * 128) * (1 << 24));
+    constexpr FixedScale uW_per_uV_uA = MakeScale(1e-6);
+
+    if (duration < STROKE_MIN_DURATION) {
+        duration = STROKE_MIN_DURATION;
+    }
+    uint32_t rpm = DivideRounded(30u * 1000000u * 128u, duration);                 // 1/128 RPM
+    uint64_t rpm2 = (uint64_t)rpm * rpm;
+    uint64_t torque = Scale(rpm2, torque_per_rpm2);                                 // mN·mm
+    uint64_t powerout = Scale(Scale(rpm2, powerout_per_rpm2), FixedScale{rpm, 16});  // 1/256 µW
+    int64_t powerin = ScaleSigned((int64_t)voltage * current, uW_per_uV_uA);       // µW
+
+    // Percent. Divided as floats (the result is a float anyway): keeping the scaled numerator would take a 64-bit
+    // integer division, a slower library call on the ESP8266. No power in gives `INFINITY`, or `NAN` with none out,
+    // as the float computation does.
+    float efficiency = (float)powerout / (float)powerin * (100.f / 256);
+    return Data(
+        rpm * (1.f / 128),
+        torque * 0.001f,            // mN·mm -> N·mm
+        voltage * 1e-6f,
+        current * 1e-6f,
+        powerin * 1e-6f,
+        powerout * (1e-6f / 256),
+        efficiency,
+        temperature * 0.01f,
+        elapsed
+    );
+}
+
+
+
+#endif // STROKE_MATH_HPP
\ No newline at end of file
@@ -0,0 +1,345 @@
+/****************************************************************
+*                                                               *
+*   ThermalModel.hpp                                            *
+*                                                               *
+*   Lumped thermal model of the coil, with prediction.          *
+*                                                               *
+*****************************************************************/
+#ifndef THERMAL_MODEL_HPP
+#define THERMAL_MODEL_HPP
+
+#include <math.h>
+#include <stdint.h>
+#include <Arduino.h>
+#include "Events/Event.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Sensors/Sample.hpp"
+#include "Sensors/Sensor.hpp"
+#include "Sensors/INA219.hpp"
+#include "Sensors/SampleListener.hpp"
+#include "Clock/Clock.hpp"
+#include "EngineState.hpp"
+
+// ### `THERMAL_RESISTANCE`
+// Default thermal resistance from the coil to the ambient air, in `°C/W`.
+#ifndef THERMAL_RESISTANCE
+#define THERMAL_RESISTANCE 15.f
+#endif
+
+// ### `THERMAL_CAPACITANCE`
+// Default heat capacity of the coil, in `J/°C` (with `THERMAL_RESISTANCE`, a time constant of `300 s`).
+#ifndef THERMAL_CAPACITANCE
+#define THERMAL_CAPACITANCE 20.f
+#endif
+
+// ### `THERMAL_TICK`
+// Default time between the model's steps, in `ms`.
+#ifndef THERMAL_TICK
+#define THERMAL_TICK 100
+#endif
+
+// ### `THERMAL_GAIN`
+// Fraction of the gap between the model and the readings' inferred temperature closed at each step (`0.05` at
+// `100 ms` follows the measurements with a time constant of about `2 s`, averaging out their noise).
+#ifndef THERMAL_GAIN
+#define THERMAL_GAIN 0.05f
+#endif
+
+// ### `THERMAL_SETTLED`
+// A reading's resistance is only taken once the current has settled: within `1/THERMAL_SETTLED` of the previous
+// reading's, since the same switch edge. While it still rises, the coil's inductance adds to the resistance the coil seems to have
+// (`L·(di/dt)/I`), and the temperature inferred from it reads far too high.
+#ifndef THERMAL_SETTLED
+#define THERMAL_SETTLED 64
+#endif
+
+// ### `THERMAL_MIN_CURRENT`
+// Least current, in `µA`, a reading needs for its resistance to be taken (the resistance of a coil carrying almost
+// nothing is mostly noise).
+#ifndef THERMAL_MIN_CURRENT
+#define THERMAL_MIN_CURRENT 100000
+#endif
+
+// ### `THERMAL_MAX_CURRENT`
+// Most current, in `µA`, a reading may have for its resistance to be taken: the INA219's full scale (`320 mV` across
+// the shunt), above which its current register clips and `P/I²` reads high.
+#ifndef THERMAL_MAX_CURRENT
+#define THERMAL_MAX_CURRENT (32000 * INA219_CURRENT_LSB)
+#endif
+
+// ### `THERMAL_POWER_TIME`
+// Time constant of the mean power the prediction extrapolates, in `s` (long enough to average over many strokes).
+#ifndef THERMAL_POWER_TIME
+#define THERMAL_POWER_TIME 5.f
+#endif
+
+// ### `THERMAL_HORIZON`
+// Default time ahead the temperature is predicted, in `s`.
+#ifndef THERMAL_HORIZON
+#define THERMAL_HORIZON 30.f
+#endif
+
+// ### `THERMAL_LIMIT`
+// Default coil temperature the prediction is checked against, in `°F` (the state machine's over-temperature).
+#ifndef THERMAL_LIMIT
+#define THERMAL_LIMIT ENGINE_HOT_TEMPERATURE
+#endif
+
+// ### `THERMAL_CLEAR_MARGIN`
+// How far below the limit the prediction has to fall before the warning clears, in `°F`.
+#ifndef THERMAL_CLEAR_MARGIN
+#define THERMAL_CLEAR_MARGIN 9.f
+#endif
+
+// ### `THERMAL_MAX_GAP`
+// Longest time after a reading, in `µs`, its power is held for while the switch is open (the coil may be off, with
+// the INA219 no longer polled). While the switch is closed, the power is held until the next reading or edge.
+#ifndef THERMAL_MAX_GAP
+#define THERMAL_MAX_GAP 5000
+#endif
+
+
+
+// ## ThermalModel
+// First-order (lumped) thermal model of the coil: `C·dT/dt = P − (T − T_ambient)/R`, stepped every tick with the power
+// the INA219 measured over it. Each reading's power (`µW`, the bus side of the INA219 being the coil) is held until
+// the next one and added up in integers, so a reading costs a few integer operations; each step then solves the
+// equation exactly for that mean power (one `expf()`).
+// The temperature inferred from the coil's resistance is noisy, biased high while the current rises, and on its own
+// only says what already happened. Here the readings taken once the current has settled correct the model instead
+// (a fixed-gain observer: each step closes `THERMAL_GAIN` of the gap to the temperature they infer), so the model's
+// temperature is a filtered one, which follows the power drawn at once. Their resistance is taken as `P/I²`, summed
+// over the step: the INA219's power is its bus voltage times the current, i.e. the coil's alone, whereas the load
+// voltage `FixedSample.resistance` is derived from also counts the shunt's drop (and reads a few `%` high).
+// From the mean power (over `THERMAL_POWER_TIME`) it predicts the temperature `THERMAL_HORIZON` ahead, and raises
+// `OVERHEAT_PREDICTED` once the prediction reaches the limit, and `OVERHEAT_CLEARED` once it falls
+// `THERMAL_CLEAR_MARGIN` below it again, so the coil's duty can be backed off before it overheats rather than after.
+// Its parameters (`R`, `C` and the ambient temperature) are in `°C`, like `INA219`'s constants; the temperatures it
+// reports are in `°F`, like `Data.temperature`.
+// ### Parameters
+// - `e` - The global `EventEmitter` object.
+// ```c++
+// ThermalModel thermal(event_emitter);
+// ina219.AddSampleListener(&thermal);
+// thermal.Begin(THERMAL_TICK);
+// ```
+class ThermalModel : public Sensor, public SampleListener {
+private:
+    float thermal_resistance = THERMAL_RESISTANCE;                  // In `°C/W`.
+    float time_constant = THERMAL_RESISTANCE * THERMAL_CAPACITANCE; // `R·C`, in `s`.
+    float ambient = INA219::reference_temperature;                 // In `°C`.
+    float horizon = THERMAL_HORIZON;                                // In `s`.
+    float limit = THERMAL_LIMIT;                                    // In `°F`.
+
+    float temperature = INA219::reference_temperature;             // Of the coil, in `°C`.
+    float mean_power = 0;                                           // Over `THERMAL_POWER_TIME`, in `W`.
+    float prediction = INA219::reference_temperature;              // At the last step, in `°C`.
+    bool seeded = false;                                            // Whether a measurement was taken yet.
+
+    // Since the last step
+    int64_t energy = 0;                 // In `pJ` (`µW × µs`).
+    int64_t measured_power = 0;         // Sums over the settled readings: of the power, in `µW`,
+    int64_t measured_current = 0;       // and of the current squared, in `µA²`.
+
+    uint32_t last_step = 0;             // Times, in `µs`.
+    uint32_t last_time = 0;             // Up to which `energy` is added.
+    uint32_t last_reading = 0;
+    int32_t last_power = 0;             // Of the last reading, in `µW`.
+    int32_t last_current = 0;           // In `µA`.
+    bool high = false;                  // Whether the switch is closed.
+
+    static float ToFahrenheit(float celsius) {
+        return celsius * 9 / 5 + 32;
+    }
+
+    static float ToCelsius(float fahrenheit) {
+        return (fahrenheit - 32) * 5 / 9;
+    }
+
+    // ### `ThermalModel.Accumulate()`
+    // Private function adding the last reading's power up to `time` (while it is held) to the energy.
+    void Accumulate(uint32_t time) {
+        uint32_t end = time;
+        bool expired = !high && Clock::Before(last_reading + THERMAL_MAX_GAP, time);
+        if (expired) {
+            end = last_reading + THERMAL_MAX_GAP;
+        }
+        if (Clock::Before(last_time, end)) {
+            energy += (int64_t)last_power * (end - last_time);
+        }
+        if (expired) {
+            last_power = 0;             // Not held any longer, however long the coil stays off
+        }
+        if (Clock::Before(last_time, time)) {
+            last_time = time;
+        }
+    }
+
+    void OnEdge(const Event& event) {
+        Accumulate(event.time);
+        high = event.type == EventType::SWITCH1_STATE_CHANGE_TO_HIGH;
+        last_current = 0;               // The next reading is the first of its pulse, so not settled
+    }
+
+public:
+    // ### `ThermalModel.overheating`
+    // Whether the prediction is over the limit (`OVERHEAT_PREDICTED` raised, and not cleared since).
+    bool overheating = false;
+
+    // ### `ThermalModel.warnings`
+    // Number of `OVERHEAT_PREDICTED` events raised.
+    uint32_t warnings = 0;
+
+    // ## ThermalModel
+    // First-order thermal model of the coil, predicting its temperature.
+    // ### Parameters
+    // - `e` - The global `EventEmitter` object.
+    ThermalModel(EventEmitter& e)
+        : Sensor(
+            e,
+            {EventType::SWITCH1_STATE_CHANGE_TO_LOW, EventType::SWITCH1_STATE_CHANGE_TO_HIGH},
+            [this](const Event& event) { OnEdge(event); }
+        ) { }
+
+    // ### `ThermalModel.SetParameters()`
+    // Sets the coil's thermal constants. Returns `false` (changing nothing) if either isn't positive.
+    // ### Parameters
+    // - `resistance` - Thermal resistance from the coil to the ambient air, in `°C/W` (`THERMAL_RESISTANCE` by default).
+    // - `capacitance` - Heat capacity of the coil, in `J/°C` (`THERMAL_CAPACITANCE` by default).
+    bool SetParameters(float resistance, float capacitance) {
+        if (!(resistance > 0) || !(capacitance > 0)) {
+            return false;
+        }
+        thermal_resistance = resistance;
+        time_constant = resistance * capacitance;
+        return true;
+    }
+
+    // ### `ThermalModel.SetAmbient()`
+    // Sets the ambient temperature, in `°C` (`INA219::reference_temperature` by default); also the coil's
+    // temperature until the first measurement.
+    void SetAmbient(float celsius) {
+        ambient = celsius;
+        if (!seeded) {
+            temperature = prediction = celsius;
+        }
+    }
+
+    // ### `ThermalModel.SetLimit()`
+    // Sets what the prediction is checked against. Returns `false` (changing nothing) if `horizon` is negative.
+    // ### Parameters
+    // - `temperature` - The coil temperature not to reach, in `°F` (`THERMAL_LIMIT` by default).
+    // - `horizon` - How far ahead to predict, in `s` (`THERMAL_HORIZON` by default).
+    bool SetLimit(float temperature, float horizon) {
+        if (!(horizon >= 0)) {
+            return false;
+        }
+        limit = temperature;
+        this->horizon = horizon;
+        return true;
+    }
+
+    // ### `ThermalModel.Begin()`
+    // Starts stepping the model (if it is already, only changes the interval, keeping the step under way).
+    // ### Parameters
+    // - `tick_interval` - Time between steps, in `ms`.
+    void Begin(float tick_interval = THERMAL_TICK) {
+        if (!IsPolling()) {
+            last_step = last_time = ClockMicros();
+            energy = 0;
+        }
+        Sensor::Begin(tick_interval);
+    }
+
+    // ### `ThermalModel.Read()`
+    // One step: solves the model over the time since the last step for the mean power measured over it, corrects it
+    // with the temperature measured over it, and checks the prediction against the limit. The first measurement
+    // sets the temperature outright, as the coil may not be at ambient at boot.
+    void Read() override {
+        uint32_t now = ClockMicros();
+        Accumulate(now);
+        uint32_t span = now - last_step;
+        if (span == 0) {
+            return;
+        }
+        float dt = span * 1e-6f;
+        float power = (float)energy / span * 1e-6f;
+        energy = 0;
+        last_step = now;
+
+        float steady = ambient + power * thermal_resistance;
+        temperature = steady + (temperature - steady) * expf(-dt / time_constant);
+        if (measured_current > 0) {
+            float resistance = (float)measured_power / measured_current * 1e6f;
+            float measurement = ToCelsius(INA219::InferTemperature(resistance));
+            temperature = seeded ? temperature + THERMAL_GAIN * (measurement - temperature) : measurement;
+            seeded = true;
+            measured_power = 0;
+            measured_current = 0;
+        }
+        mean_power += (power - mean_power) * (1 - expf(-dt / THERMAL_POWER_TIME));
+
+        float predicted = Predict(horizon);
+        prediction = ToCelsius(predicted);
+        if (!overheating && predicted >= limit) {
+            overheating = true;
+            warnings++;
+            emitter.EmitEvent({EventType::OVERHEAT_PREDICTED, predicted, EventTypeName(EventType::OVERHEAT_PREDICTED), now});
+        }
+        else if (overheating && predicted <= limit - THERMAL_CLEAR_MARGIN) {
+            overheating = false;
+            emitter.EmitEvent({EventType::OVERHEAT_CLEARED, predicted, EventTypeName(EventType::OVERHEAT_CLEARED), now});
+        }
+    }
+
+    // ### `ThermalModel.OnReading()`
+    // Adds the power held since the last reading to the energy, and holds this one's; takes its power and current
+    // for the coil's resistance if the current has settled.
+    void OnReading(const FixedSample& fixed) override {
+        Accumulate(fixed.time);
+        int32_t change = fixed.current - last_current;
+        if (fixed.current >= THERMAL_MIN_CURRENT && fixed.current < THERMAL_MAX_CURRENT && fixed.time - last_reading <= THERMAL_MAX_GAP
+            && (change < 0 ? -change : change) <= fixed.current / THERMAL_SETTLED) {
+            measured_power += fixed.power;
+            measured_current += (int64_t)fixed.current * fixed.current;
+        }
+        last_reading = fixed.time;
+        last_power = fixed.power > 0 ? fixed.power : 0;
+        last_current = fixed.current;
+    }
+
+    // ### `ThermalModel.OnSample()`
+    // Takes one reading given only in floats (converted back to scaled integers).
+    void OnSample(const Sample& sample) override {
+        OnReading(FixedSample::FromSample(sample));
+    }
+
+    // ### `ThermalModel.Temperature()`
+    // Returns the model's (filtered) coil temperature, in `°F`.
+    float Temperature() const {
+        return ToFahrenheit(temperature);
+    }
+
+    // ### `ThermalModel.Predict()`
+    // Returns the coil temperature `seconds` from now, in `°F`, if the mean power stays as it is.
+    float Predict(float seconds) const {
+        float steady = ambient + mean_power * thermal_resistance;
+        return ToFahrenheit(steady + (temperature - steady) * expf(-seconds / time_constant));
+    }
+
+    // ### `ThermalModel.Prediction()`
+    // Returns the temperature predicted at the last step (`THERMAL_HORIZON` ahead), in `°F`.
+    float Prediction() const {
+        return ToFahrenheit(prediction);
+    }
+
+    // ### `ThermalModel.MeanPower()`
+    // Returns the mean power drawn by the coil (over `THERMAL_POWER_TIME`), in `W`.
+    float MeanPower() const {
+        return mean_power;
+    }
+};
+
+
+
+#endif // THERMAL_MODEL_HPP
\ No newline at end of file
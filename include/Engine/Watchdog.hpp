@@ -0,0 +1,263 @@
+/****************************************************************
+*                                                               *
+*   Watchdog.hpp                                                *
+*                                                               *
+*   Stall and fault detection by timeouts.                      *
+*                                                               *
+*****************************************************************/
+#ifndef WATCHDOG_HPP
+#define WATCHDOG_HPP
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "Events/Event.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Sensors/Sample.hpp"
+#include "Sensors/Sensor.hpp"
+#include "Sensors/INA219.hpp"
+#include "Sensors/SampleListener.hpp"
+#include "Clock/Clock.hpp"
+#include "Clock/TimerWheel.hpp"
+
+// ### `WATCHDOG_TICK`
+// Default time between the watchdog's ticks, in `ms`: a fault is reported at most this long after its timeout.
+#ifndef WATCHDOG_TICK
+#define WATCHDOG_TICK 10
+#endif
+
+// ### `WATCHDOG_SLOTS`
+// Slots of the watchdog's timer wheel (a power of two; `64` at `10 ms` covers the default timeouts in one turn).
+#ifndef WATCHDOG_SLOTS
+#define WATCHDOG_SLOTS 64
+#endif
+
+// ### `WATCHDOG_STALL_TIME`
+// Default time without a switch edge before the engine is taken as stalled, in `µs`.
+#ifndef WATCHDOG_STALL_TIME
+#define WATCHDOG_STALL_TIME 500000
+#endif
+
+// ### `WATCHDOG_OVERRUN_TIME`
+// Default shortest time the switch may stay HIGH before the stroke is taken as over-running, in `µs`.
+#ifndef WATCHDOG_OVERRUN_TIME
+#define WATCHDOG_OVERRUN_TIME 100000
+#endif
+
+// ### `WATCHDOG_OVERRUN_FACTOR`
+// A stroke also over-runs only once it is this many times as long as the previous one.
+#ifndef WATCHDOG_OVERRUN_FACTOR
+#define WATCHDOG_OVERRUN_FACTOR 4
+#endif
+
+// ### `WATCHDOG_SILENT_TIME`
+// Default time the INA219 may be polled without a reading before it is taken as silent, in `µs`.
+#ifndef WATCHDOG_SILENT_TIME
+#define WATCHDOG_SILENT_TIME 20000
+#endif
+
+// ### `WATCHDOG_I2C_FAILURES`
+// Consecutive failed I2C transactions (four per reading) before the INA219 is taken as failed.
+#ifndef WATCHDOG_I2C_FAILURES
+#define WATCHDOG_I2C_FAILURES 12
+#endif
+
+
+
+// ## Watchdog
+// Detects the engine and the INA219 stopping, by timeouts on a `TimerWheel` that the switch edges and the readings
+// push back (each one an `O(1)` relink, cheap enough for every reading), and raises an event for each fault:
+// - `ENGINE_STALL` - No switch edge for the stall time. Polling the INA219 is then pointless (and with the switch
+//   stuck HIGH nothing else would stop it), so the watchdog stops it, and with it the readings streamed to the serial
+//   telemetry, run log and analyzers. The next rising edge starts polling again as usual.
+// - `STROKE_OVERRUN` - The switch HIGH (the coil on) for longer than the over-run time and
+//   `WATCHDOG_OVERRUN_FACTOR` times the previous stroke.
+// - `SENSOR_SILENT` - The INA219 polled but no reading for the silent time (e.g. its `Ticker` starved).
+// - `I2C_FAILURE` - `WATCHDOG_I2C_FAILURES` consecutive failed transactions with the INA219.
+// Each is raised once, then again only after it cleared (an edge, a reading, a successful transaction).
+// It is checked every tick (`Begin()`), so each is raised within its timeout plus one tick.
+// ### Parameters
+// - `e` - The global `EventEmitter` object.
+// - `ina219` - The INA219 to watch (and stop polling on a stall).
+// ```c++
+// Watchdog watchdog(event_emitter, ina219);
+// ina219.AddSampleListener(&watchdog);
+// watchdog.Begin(WATCHDOG_TICK);
+// ```
+class Watchdog : public Sensor, public SampleListener {
+private:
+    INA219& ina219;
+
+    TimerWheel<WATCHDOG_SLOTS> wheel;
+    WheelTimer stall;                       // Armed at every edge.
+    WheelTimer overrun;                     // Armed at a rising edge, cancelled at the falling one.
+    WheelTimer silent;                      // Armed at every reading and rising edge.
+    uint32_t tick = WATCHDOG_TICK * 1000;   // Time between ticks, in `µs`.
+    uint32_t next_tick = 0;                 // Time of tick `wheel.Now() + 1`, in `µs`.
+
+    uint32_t stall_time = WATCHDOG_STALL_TIME;
+    uint32_t overrun_time = WATCHDOG_OVERRUN_TIME;
+    uint32_t silent_time = WATCHDOG_SILENT_TIME;
+
+    uint32_t last_edge = 0;                 // Times, in `µs`.
+    uint32_t last_rise = 0;
+    uint32_t last_reading = 0;
+    uint32_t stroke = 0;                    // Length of the last stroke (HIGH), in `µs` (`0` = none yet).
+    bool high = false;                      // Whether the last edge was rising.
+
+    // ### `Watchdog.TickAt()`
+    // Private function returning the first tick at or after `time` (the next one if that has passed).
+    uint32_t TickAt(uint32_t time) const {
+        int32_t ahead = (int32_t)(time - next_tick);
+        return wheel.Now() + 1 + (ahead > 0 ? ((uint32_t)ahead + tick - 1) / tick : 0);
+    }
+
+    void Raise(EventType type, float value, uint32_t time) {
+        emitter.EmitEvent({type, value, EventTypeName(type), time});
+    }
+
+    void OnEdge(const Event& event) {
+        last_edge = event.time;
+        stalled = false;
+        wheel.ArmAt(stall, TickAt(event.time + stall_time));
+        if (event.type == EventType::SWITCH1_STATE_CHANGE_TO_HIGH) {
+            uint32_t limit = stroke * WATCHDOG_OVERRUN_FACTOR;
+            wheel.ArmAt(overrun, TickAt(event.time + (limit > overrun_time ? limit : overrun_time)));
+            if (!silenced) {            // The INA219 may only begin polling now
+                wheel.ArmAt(silent, TickAt(event.time + silent_time));
+            }
+            last_rise = event.time;
+            high = true;
+        }
+        else {
+            wheel.Cancel(overrun);
+            if (high) {
+                stroke = event.time - last_rise;
+            }
+            high = false;
+        }
+    }
+
+    // ### `Watchdog.Expired()`
+    // Private function raising the fault of a timer that expired at `time`.
+    void Expired(WheelTimer& timer, uint32_t time) {
+        if (&timer == &stall) {
+            stalled = true;
+            stalls++;
+            wheel.Cancel(overrun);
+            wheel.Cancel(silent);
+            ina219.StopPolling();
+            Raise(EventType::ENGINE_STALL, Clock::Elapsed(last_edge, time) * 1e-6f, time);
+        }
+        else if (&timer == &overrun) {
+            overruns++;
+            Raise(EventType::STROKE_OVERRUN, Clock::Elapsed(last_rise, time) * 1e-6f, time);
+        }
+        else if (&timer == &silent && ina219.IsPolling()) {
+            silenced = true;
+            silences++;
+            Raise(EventType::SENSOR_SILENT, Clock::Elapsed(last_reading, time) * 1e-6f, time);
+        }
+    }
+
+public:
+    // ### `Watchdog.stalled`
+    // Whether the engine is stalled (no edge since the last `ENGINE_STALL`).
+    bool stalled = false;
+
+    // ### `Watchdog.silenced`
+    // Whether the INA219 is silent (no reading since the last `SENSOR_SILENT`).
+    bool silenced = false;
+
+    // ### `Watchdog.i2c_failed`
+    // Whether the INA219's transactions are failing (no success since the last `I2C_FAILURE`).
+    bool i2c_failed = false;
+
+    // ### `Watchdog.stalls`
+    // Number of `ENGINE_STALL` events raised (and likewise for the other faults below).
+    uint32_t stalls = 0;
+    uint32_t overruns = 0;
+    uint32_t silences = 0;
+    uint32_t i2c_faults = 0;
+
+    // ## Watchdog
+    // Detects the engine and the INA219 stopping, and raises an event for each fault.
+    // ### Parameters
+    // - `e` - The global `EventEmitter` object.
+    // - `ina219` - The INA219 to watch (and stop polling on a stall).
+    Watchdog(EventEmitter& e, INA219& ina219)
+        : Sensor(
+            e,
+            {EventType::SWITCH1_STATE_CHANGE_TO_LOW, EventType::SWITCH1_STATE_CHANGE_TO_HIGH},
+            [this](const Event& event) { OnEdge(event); }
+        ),
+        ina219(ina219) { }
+
+    // ### `Watchdog.SetTimeouts()`
+    // Sets the timeouts, in `µs` (`WATCHDOG_STALL_TIME`, `WATCHDOG_OVERRUN_TIME` and `WATCHDOG_SILENT_TIME` by default),
+    // from the next edge or reading on. Returns `false` (changing nothing) if any is `0`.
+    // ### Parameters
+    // - `stall` - Time without a switch edge before `ENGINE_STALL`.
+    // - `overrun` - Shortest time with the switch HIGH before `STROKE_OVERRUN`.
+    // - `silent` - Time polling the INA219 without a reading before `SENSOR_SILENT`.
+    bool SetTimeouts(uint32_t stall, uint32_t overrun, uint32_t silent) {
+        if (stall == 0 || overrun == 0 || silent == 0) {
+            return false;
+        }
+        stall_time = stall;
+        overrun_time = overrun;
+        silent_time = silent;
+        return true;
+    }
+
+    // ### `Watchdog.Begin()`
+    // Starts the watchdog, the stall timeout running from now.
+    // ### Parameters
+    // - `tick_interval` - Time between checks, in `ms` (how late a fault may be reported after its timeout).
+    void Begin(float tick_interval = WATCHDOG_TICK) {
+        uint32_t now = ClockMicros();
+        tick = tick_interval >= 1 ? (uint32_t)(tick_interval * 1000) : 1000;
+        next_tick = now + tick;
+        last_edge = now;
+        wheel.ArmAt(stall, TickAt(now + stall_time));
+        Sensor::Begin(tick_interval);
+    }
+
+    // ### `Watchdog.Read()`
+    // One tick: moves the wheel up to now, raising the faults whose timeouts expired, and checks the INA219's I2C.
+    void Read() override {
+        uint32_t now = ClockMicros();
+        while (Clock::Reached(now, next_tick)) {
+            uint32_t time = next_tick;
+            next_tick += tick;
+            wheel.Advance([this, time](WheelTimer& timer) { Expired(timer, time); });
+        }
+        if (ina219.consecutive_errors == 0) {
+            i2c_failed = false;
+        }
+        else if (ina219.consecutive_errors >= WATCHDOG_I2C_FAILURES && !i2c_failed) {
+            i2c_failed = true;
+            i2c_faults++;
+            Raise(EventType::I2C_FAILURE, ina219.consecutive_errors, now);
+        }
+    }
+
+    // ### `Watchdog.OnReading()`
+    // Pushes the silent timeout back (a relink in the wheel).
+    void OnReading(const FixedSample& fixed) override {
+        last_reading = fixed.time;
+        silenced = false;
+        if (!stalled) {
+            wheel.ArmAt(silent, TickAt(fixed.time + silent_time));
+        }
+    }
+
+    // ### `Watchdog.OnSample()`
+    // Pushes the silent timeout back, for a reading given only in floats.
+    void OnSample(const Sample& sample) override {
+        OnReading(FixedSample::FromSample(sample));
+    }
+};
+
+
+
+#endif // WATCHDOG_HPP
\ No newline at end of file
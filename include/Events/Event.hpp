@@ -20,25 +20,72 @@
 // - `SWITCH2_STATE_CHANGE`
 // - `SWITCH1_STATE_CHANGE_TO_LOW`
 // - `SWITCH1_STATE_CHANGE_TO_HIGH`
+// - `TACHOMETER_RPM` - A new speed estimate (`value` in `RPM`).
+// - `TACHOMETER_ACCELERATION` - A new angular acceleration estimate (`value` in `rad/s²`).
+// - `ENGINE_STALL` - No switch edge for the watchdog's stall time (`value` is the time since the last one, in `s`).
+// - `STROKE_OVERRUN` - The switch HIGH for longer than the watchdog allows (`value` is the time since it rose, in `s`).
+// - `SENSOR_SILENT` - The INA219 polled without a reading for the watchdog's silent time (`value` is the time since the last one, in `s`).
+// - `I2C_FAILURE` - Consecutive failed I2C transactions with the INA219 (`value` is their number).
+// - `ENGINE_STATE_CHANGE` - The engine state machine changed state (`value` is the new `EngineState`).
+// - `OVERHEAT_PREDICTED` - The thermal model predicts the coil reaching its limit (`value` is the predicted temperature, in `°F`).
+// - `OVERHEAT_CLEARED` - The thermal model's prediction fell back below the limit (`value` is the predicted temperature, in `°F`).
+// - `SPECTRAL_BAND_EXCEEDED` - A band of the coil current's spectrum exceeded its baseline (`value` is the band's order).
 enum class EventType {
     // SWITCH1_STATE_CHANGE,
     // SWITCH2_STATE_CHANGE,
     SWITCH1_STATE_CHANGE_TO_LOW,
     SWITCH1_STATE_CHANGE_TO_HIGH,
+    TACHOMETER_RPM,
+    TACHOMETER_ACCELERATION,
+    ENGINE_STALL,
+    STROKE_OVERRUN,
+    SENSOR_SILENT,
+    I2C_FAILURE,
+    ENGINE_STATE_CHANGE,
+    OVERHEAT_PREDICTED,
+    OVERHEAT_CLEARED,
+    SPECTRAL_BAND_EXCEEDED,
+    EVENT_TYPE_COUNT,       // Number of event types (not an event; must remain last).
 };
 
 
 
+// ### `EventTypeName()`
+// Returns the name of an `EventType` as a string literal (e.g. `"SWITCH1_STATE_CHANGE_TO_LOW"`).
+// ### Parameters
+// - `type` - An `EventType` enum (i.e. `EventType::SWITCH1_STATE_CHANGE_TO_LOW`).
+inline const char* EventTypeName(EventType type) {
+    switch (type) {
+        case EventType::SWITCH1_STATE_CHANGE_TO_LOW:    return "SWITCH1_STATE_CHANGE_TO_LOW";
+        case EventType::SWITCH1_STATE_CHANGE_TO_HIGH:   return "SWITCH1_STATE_CHANGE_TO_HIGH";
+        case EventType::TACHOMETER_RPM:                 return "TACHOMETER_RPM";
+        case EventType::TACHOMETER_ACCELERATION:        return "TACHOMETER_ACCELERATION";
+        case EventType::ENGINE_STALL:                   return "ENGINE_STALL";
+        case EventType::STROKE_OVERRUN:                 return "STROKE_OVERRUN";
+        case EventType::SENSOR_SILENT:                  return "SENSOR_SILENT";
+        case EventType::I2C_FAILURE:                    return "I2C_FAILURE";
+        case EventType::ENGINE_STATE_CHANGE:            return "ENGINE_STATE_CHANGE";
+        case EventType::OVERHEAT_PREDICTED:             return "OVERHEAT_PREDICTED";
+        case EventType::OVERHEAT_CLEARED:               return "OVERHEAT_CLEARED";
+        case EventType::SPECTRAL_BAND_EXCEEDED:         return "SPECTRAL_BAND_EXCEEDED";
+        default:                                        return "UNKNOWN";
+    }
+}
+
+
+
 // ## Event
 // Struct defining the properties of an event.
 // ### Defined properties:
 // - `type` (`EventType`) - The type of event, as defined by the `EventType` class.
 // - `value` (`float`) - The value associated with the event.
-// - `type_string` (`String`) - A string representation of the event type (e.g. `"SWITCH1_STATE_CHANGE"` for `EventType::SWITCH2_STATE_CHANGE`).
+// - `type_string` (`const char*`) - The name of the event type, from `EventTypeName()` (e.g. `"SWITCH1_STATE_CHANGE_TO_LOW"`). A string literal, so building an event never allocates.
+// - `time` (`uint32_t`) - When the event was detected (`ClockMicros()`), in `µs`. Handlers should use this rather than reading the clock themselves, so replayed events give the same results.
 struct Event {
     EventType type;
     float value;
-    String type_string;
+    const char* type_string;
+    uint32_t time;
 };
 
 
@@ -11,6 +11,7 @@
 #include <vector>
 #include "Event.hpp"
 #include "EventListener.hpp"
+#include "Telemetry/Metrics.hpp"
 
 
 
@@ -43,8 +44,9 @@ public:
     // - `event` - An `Event` struct with the following properties:
     //      --> `value` (`float`) - The value associated with the event.
     //      --> `type` (`EventType`) - The type of event, as defined by the `EventType` class.
-    //      --> `type_string` (`String`) - A string representation of the event type (e.g. `"TEMPERATURE_CHANGE"` for `EventType::TEMPERATURE_CHANGE`).
+    //      --> `type_string` (`const char*`) - The name of the event type (e.g. `"SWITCH1_STATE_CHANGE_TO_LOW"` for `EventType::SWITCH1_STATE_CHANGE_TO_LOW`).
     void EmitEvent(const Event& event) {
+        Metrics::Increment(event.type);
         for (auto listener : listeners) {
             if (listener->IsRegisteredFor(event.type)) {
                 listener->OnEvent(event);
@@ -8,7 +8,9 @@
 #ifndef EVENT_LISTENER_HPP
 #define EVENT_LISTENER_HPP
 
-#include <set>
+#include <stdint.h>
+#include <vector>
+#include <functional>
 #include "Event.hpp"
 
 
@@ -23,7 +25,7 @@
 class EventListener {
 protected:
     // ### `EventListener.registered_events`
-    // Protected set of `EventType` objects.
+    // Protected set of `EventType` objects, one bit per type (bit `n` is set when registered for the type numbered `n`).
     // The event types contained in this set are the events that the inheriting object is registered for and will be notified of.
     // It is populated in one of two ways:
     // - During instantiation via the `events` parameter
@@ -37,7 +39,7 @@ protected:
     // sensor.RegisterForEvent(EventType::TEMPERATURE_CHANGE);
     // sensor.RegisterForEvent({EventType::TEMPERATURE_CHANGE, EventType::HALL_EFFECT_CHANGE});
     // ```
-    std::set<EventType> registered_events;
+    uint32_t registered_events = 0;
 
     // ### `EventListener.event_handler`
     // Protected function used as the `onEvent` callback for the inheriting object when receiving an event.
@@ -60,6 +62,13 @@ protected:
     // ```
     std::function<void(const Event&)> event_handler;
 
+    // The bit of `registered_events` standing for `type`.
+    static uint32_t EventBit(EventType type) {
+        return (uint32_t)1 << (int)type;
+    }
+
+    static_assert((int)EventType::EVENT_TYPE_COUNT <= 32, "registered_events holds one bit per EventType");
+
 public:
     // ## EventListener
     // Event listener interface class.
@@ -71,10 +80,13 @@ public:
     EventListener(
         const std::vector<EventType>& events = {},
         std::function<void(const Event&)> handler = nullptr
-    ) : registered_events(events.begin(), events.end()), event_handler(handler) {
+    ) : event_handler(handler) {
+        RegisterForEvents(events);
         if (!event_handler) {
             event_handler = [](const Event& event) {
+#ifndef SERIAL_TELEMETRY    // Not with telemetry: it would corrupt the binary stream
                 Serial.println("[Default Handler] Event received but no custom handler set.");
+#endif
             };
         }
     }
@@ -88,7 +100,7 @@ public:
     // - `event` - An `Event` struct with the following properties:
     //      --> `value` (`float`) - The value associated with the event.
     //      --> `type` (`EventType`) - The type of event, as defined by the `EventType` class.
-    //      --> `type_string` (`String`) - A string representation of the event type (e.g. `"TEMPERATURE_CHANGE"` for `EventType::TEMPERATURE_CHANGE`).
+    //      --> `type_string` (`const char*`) - The name of the event type (e.g. `"SWITCH1_STATE_CHANGE_TO_LOW"` for `EventType::SWITCH1_STATE_CHANGE_TO_LOW`).
     void OnEvent(const Event& event) {
         if (IsRegisteredFor(event.type)) {
             event_handler(event);
@@ -102,7 +114,7 @@ public:
     // ### Parameters
     // - `type` - An `EventType` enum (i.e. `EventType::TEMPERATURE_CHANGE`).
     bool IsRegisteredFor(EventType type) const {
-        return registered_events.find(type) != registered_events.end();
+        return (registered_events & EventBit(type)) != 0;
     }
 
     // ### `EventListener.SetOnEvent()`
@@ -139,7 +151,7 @@ public:
     // sensor.RegisterForEvent(EventType::TEMPERATURE_CHANGE);
     // ```
     void RegisterForEvent(EventType event) {
-        registered_events.insert(event);
+        registered_events |= EventBit(event);
     }
 
     // ### `EventListener.RegisterForEvents()`
@@ -153,7 +165,9 @@ public:
     // sensor.RegisterForEvents({EventType::TEMPERATURE_CHANGE, EventType::HALL_EFFECT_CHANGE});
     // ```
     void RegisterForEvents(const std::vector<EventType>& events) {
-        registered_events.insert(events.begin(), events.end());
+        for (EventType event : events) {
+            registered_events |= EventBit(event);
+        }
     }
 };
 
@@ -9,6 +9,7 @@
 #define BUILTIN_LED_HPP
 
 #include <Arduino.h>
+#include "Clock/Clock.hpp"
 
 
 
@@ -26,7 +27,7 @@ private:
 
     // ### `BuiltinLED.state_str`
     // The current state of the built-in LED (`"OFF"` / `"ON"`).
-    String state_str;
+    const char* state_str = "OFF";
 
 public:
     // ## `BuiltinLED`
@@ -34,7 +35,7 @@ public:
     BuiltinLED() { }
 
     // ### `BuiltinLED.last_state_change`
-    // Stores the timestamp (`millis()`) of the last change of LED state.
+    // Stores the timestamp (`ClockMillis()`) of the last change of LED state.
     unsigned long last_state_change;
 
     // ### `BuiltinLED.Initialize()`
@@ -43,8 +44,8 @@ public:
         pinMode(pin, OUTPUT);
         digitalWrite(pin, LOW);
         state = 0;
-        state_str = String("OFF");
-        last_state_change = millis();
+        state_str = "OFF";
+        last_state_change = ClockMillis();
     }
 
     // ### `BuiltinLED.On()`
@@ -52,8 +53,8 @@ public:
     void On() {
         digitalWrite(pin, HIGH);
         state = 1;
-        state_str = String("ON");
-        last_state_change = millis();
+        state_str = "ON";
+        last_state_change = ClockMillis();
     }
 
     // ### `BuiltinLED.Off()`
@@ -61,8 +62,8 @@ public:
     void Off() {
         digitalWrite(pin, LOW);
         state = 0;
-        state_str = String("OFF");
-        last_state_change = millis();
+        state_str = "OFF";
+        last_state_change = ClockMillis();
     }
 
     // ### `BuiltinLED.Toggle()`
@@ -85,7 +86,7 @@ public:
 
     // ### `BuiltinLED.GetStateStr()`
     // Returns the current state (`"OFF"` / `"ON"`) of the built-in LED.
-    String GetStateStr() {
+    const char* GetStateStr() const {
         return state_str;
     }
 };
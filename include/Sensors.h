@@ -5,9 +5,15 @@
 *   Include file for:                                           *
 *     - Sensor.hpp                                              *
 *     - Switch.hpp                                              *
+*     - Tachometer.hpp                                          *
 *     - INA219.hpp                                              *
+*     - BurstCapture.hpp                                        *
 *     - Responder.hpp                                           *
 *     - SensorBuffer.hpp                                        *
+*     - RingBuffer.hpp                                          *
+*     - Sample.hpp                                              *
+*     - AggregatedHistory.hpp                                   *
+*     - SampleListener.hpp                                      *
 *                                                               *
 *****************************************************************/
 #ifndef SENSORS_H
@@ -15,8 +21,14 @@
 
 #include "Sensors/Sensor.hpp"
 #include "Sensors/Switch.hpp"
+#include "Sensors/Tachometer.hpp"
 #include "Sensors/INA219.hpp"
+#include "Sensors/BurstCapture.hpp"
 #include "Sensors/Responder.hpp"
 #include "Sensors/SensorBuffer.hpp"
+#include "Sensors/RingBuffer.hpp"
+#include "Sensors/Sample.hpp"
+#include "Sensors/AggregatedHistory.hpp"
+#include "Sensors/SampleListener.hpp"
 
 #endif // SENSORS_H
\ No newline at end of file
@@ -0,0 +1,338 @@
+/****************************************************************
+*                                                               *
+*   AggregatedHistory.hpp                                       *
+*                                                               *
+*   Record history with precomputed min/max/mean buckets.       *
+*                                                               *
+*****************************************************************/
+#ifndef AGGREGATED_HISTORY_HPP
+#define AGGREGATED_HISTORY_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Sample.hpp"
+#include "RingBuffer.hpp"
+
+
+
+// ## RecordChannels
+// Traits class describing the numeric channels of a record type stored in an `AggregatedHistory`.
+// Each record type that is aggregated specializes it with:
+// - `count` - The number of channels.
+// - `Value` / `Sum` - The type the channels are extracted and compared in, and the one they are summed in.
+// - `Names()` - The channel names, in order (used as JSON/CSV column names).
+// - `Scale()` - The factor converting one channel's values to its unit (as exported).
+// - `Time()` - The record's timestamp, in `µs`.
+// - `Extract()` - Writes the record's `count` channel values into `values`.
+template <typename T>
+struct RecordChannels;
+
+// ## RecordChannels<FixedSample>
+// Channels of an INA219 reading, kept in its scaled integers (summed in 64 bits, so a bucket never overflows), and
+// converted to `V`, `A`, `W`, `Ω` and `°F` only when exported.
+template <>
+struct RecordChannels<FixedSample> {
+    static constexpr size_t count = 5;
+    typedef int32_t Value;
+    typedef int64_t Sum;
+    static const char* const* Names() {
+        static const char* const names[count] = {"voltage", "current", "power", "resistance", "temperature"};
+        return names;
+    }
+    static float Scale(size_t channel) {
+        return channel == 4 ? 0.01f : 1e-6f;
+    }
+    static uint32_t Time(const FixedSample& sample) {
+        return sample.time;
+    }
+    static void Extract(const FixedSample& sample, int32_t* values) {
+        values[0] = sample.voltage;
+        values[1] = sample.current;
+        values[2] = sample.power;
+        values[3] = sample.resistance;
+        values[4] = sample.temperature;
+    }
+};
+
+
+
+// ## Bucket
+// Min/max/sum of each channel over a span of consecutive records.
+// ### Parameters
+// - `C` - The number of channels.
+// - `V` / `S` - The type of the channels' values, and of their sums (see `RecordChannels`).
+template <size_t C, typename V, typename S>
+struct Bucket {
+    // ### `Bucket.first`
+    // Time of the first record in the bucket, in `ms` since boot.
+    uint32_t first;
+    // ### `Bucket.last`
+    // Time of the last record in the bucket, in `ms` since boot.
+    uint32_t last;
+    // ### `Bucket.count`
+    // Number of records in the bucket (`0` = empty).
+    uint32_t count;
+    S sum[C];
+    V min[C];
+    V max[C];
+
+    // ### `Bucket.Clear()`
+    // Empties the bucket.
+    void Clear() {
+        count = 0;
+    }
+
+    // ### `Bucket.Add()`
+    // Adds a single record's channel values, taken at `time` (`ms`), to the bucket.
+    void Add(uint32_t time, const V* values) {
+        if (count == 0) {
+            first = time;
+            for (size_t i = 0; i < C; i++) {
+                min[i] = max[i] = values[i];
+                sum[i] = values[i];
+            }
+        }
+        else {
+            for (size_t i = 0; i < C; i++) {
+                if (values[i] < min[i]) min[i] = values[i];
+                if (values[i] > max[i]) max[i] = values[i];
+                sum[i] += values[i];
+            }
+        }
+        last = time;
+        count++;
+    }
+
+    // ### `Bucket.Merge()`
+    // Adds all records of another (later) bucket to this one.
+    void Merge(const Bucket& other) {
+        if (other.count == 0) {
+            return;
+        }
+        if (count == 0) {
+            *this = other;
+            return;
+        }
+        for (size_t i = 0; i < C; i++) {
+            if (other.min[i] < min[i]) min[i] = other.min[i];
+            if (other.max[i] > max[i]) max[i] = other.max[i];
+            sum[i] += other.sum[i];
+        }
+        last = other.last;
+        count += other.count;
+    }
+};
+
+
+
+// ## BucketLevel
+// One level of an `AggregatedHistory`: a ring of buckets, each covering `FACTOR` consecutive inputs from the level below.
+// ### Parameters
+// - `B` - The `Bucket` type.
+// - `FACTOR` - The number of inputs (records or lower-level buckets) merged into each bucket.
+// - `N` - The number of completed buckets to keep.
+template <typename B, size_t FACTOR, size_t N>
+class BucketLevel {
+private:
+    RingBuffer<B, N> buckets;           // Completed buckets.
+    B partial;                          // Bucket currently being filled.
+    size_t inputs = 0;                  // Number of inputs merged into `partial`.
+
+public:
+    BucketLevel() { partial.Clear(); }
+
+    // ### `BucketLevel.Add()`
+    // Merges one input into the bucket being filled.
+    // Returns `true` if that completed the bucket (which is then available as `Buckets().At(Buckets().Newest() - 1)`).
+    bool Add(const B& input) {
+        partial.Merge(input);
+        if (++inputs < FACTOR) {
+            return false;
+        }
+        buckets.Push(partial);
+        partial.Clear();
+        inputs = 0;
+        return true;
+    }
+
+    // ### `BucketLevel.Buckets()`
+    // Returns the ring of completed buckets.
+    const RingBuffer<B, N>& Buckets() const {
+        return buckets;
+    }
+
+    // ### `BucketLevel.Partial()`
+    // Returns the bucket currently being filled (may be empty).
+    const B& Partial() const {
+        return partial;
+    }
+
+    // ### `BucketLevel.Clear()`
+    // Discards all buckets.
+    void Clear() {
+        buckets.Clear();
+        partial.Clear();
+        inputs = 0;
+    }
+};
+
+
+
+// ## AggregatedHistory
+// A history of records kept at three resolutions, so that any time range can be summarized at constant cost:
+// - Level `0` - The most recent `N` raw records.
+// - Level `1` - The most recent `LEVEL1_SIZE` buckets of `FACTOR1` records each.
+// - Level `2` - The most recent `LEVEL2_SIZE` buckets of `FACTOR1 * FACTOR2` records each, if `LEVEL2_SIZE` isn't `0`
+//   (with `0`, there are only levels `0` and `1`).
+// 
+// The buckets are updated incrementally as each record is pushed, so summarizing a long run never revisits raw records.
+// ### Parameters
+// - `T` - The record type (must have a `RecordChannels<T>` specialization).
+// - `N` - The number of raw records to keep.
+// - `FACTOR1` / `LEVEL1_SIZE` - The number of records per level-1 bucket / the number of level-1 buckets kept.
+// - `FACTOR2` / `LEVEL2_SIZE` - The number of level-1 buckets per level-2 bucket / the number of level-2 buckets kept.
+template <typename T, size_t N, size_t FACTOR1, size_t LEVEL1_SIZE, size_t FACTOR2, size_t LEVEL2_SIZE>
+class AggregatedHistory {
+public:
+    // ### `AggregatedHistory.channels`
+    // The number of channels of each record.
+    static constexpr size_t channels = RecordChannels<T>::count;
+
+    // ### `AggregatedHistory::Aggregate`
+    // The bucket type of every level (raw records are returned as single-record ones).
+    typedef Bucket<channels, typename RecordChannels<T>::Value, typename RecordChannels<T>::Sum> Aggregate;
+
+    // ### `AggregatedHistory.levels`
+    // The number of resolution levels (raw records included): `3`, or `2` if `LEVEL2_SIZE` is `0`.
+    static constexpr size_t levels = LEVEL2_SIZE > 0 ? 3 : 2;
+
+private:
+    RingBuffer<T, N> records;                                   // Level 0: raw records.
+    BucketLevel<Aggregate, FACTOR1, LEVEL1_SIZE> level1;        // Level 1: `FACTOR1` records per bucket.
+    // Level 2: `FACTOR2` level-1 buckets per bucket (a one-bucket ring that stays empty if `LEVEL2_SIZE` is `0`)
+    BucketLevel<Aggregate, FACTOR2, (LEVEL2_SIZE > 0 ? LEVEL2_SIZE : 1)> level2;
+    uint32_t newest_us = 0;                                     // Timestamp of the newest record, in `µs`.
+    uint32_t newest_ms = 0;                                     // Timestamp of the newest record, in `ms` (does not wrap with `µs`).
+    uint32_t residual_us = 0;                                   // Sub-millisecond remainder carried between records.
+
+public:
+    // ### `AggregatedHistory.Push()`
+    // Appends a record to the raw history and merges it into the bucket levels.
+    void Push(const T& record) {
+        uint32_t time_us = RecordChannels<T>::Time(record);
+        if (records.Newest() == 0) {
+            newest_ms = time_us / 1000;
+            residual_us = time_us % 1000;
+        }
+        else {
+            // Wraparound-safe: only the difference between consecutive timestamps is used
+            uint32_t elapsed = residual_us + (time_us - newest_us);
+            newest_ms += elapsed / 1000;
+            residual_us = elapsed % 1000;
+        }
+        newest_us = time_us;
+        records.Push(record);
+
+        Aggregate single;
+        single.Clear();
+        typename RecordChannels<T>::Value values[channels];
+        RecordChannels<T>::Extract(record, values);
+        single.Add(newest_ms, values);
+        if (level1.Add(single) && levels > 2) {
+            const RingBuffer<Aggregate, LEVEL1_SIZE>& completed = level1.Buckets();
+            level2.Add(completed.At(completed.Newest() - 1));
+        }
+    }
+
+    // ### `AggregatedHistory.Clear()`
+    // Discards all records and buckets.
+    void Clear() {
+        records.Clear();
+        level1.Clear();
+        level2.Clear();
+    }
+
+    // ### `AggregatedHistory.Records()`
+    // Returns the ring of raw records (level `0`).
+    const RingBuffer<T, N>& Records() const {
+        return records;
+    }
+
+    // ### `AggregatedHistory.NewestTime()`
+    // Returns the time of the newest record, in `ms` since boot.
+    uint32_t NewestTime() const {
+        return newest_ms;
+    }
+
+    // ### `AggregatedHistory.Oldest()` / `AggregatedHistory.Newest()`
+    // Return the range of sequence numbers held at `level` (see `RingBuffer.Oldest()` / `RingBuffer.Newest()`).
+    // At levels `1` and `2`, the sequence number `Newest()` refers to the bucket still being filled.
+    uint32_t Oldest(size_t level) const {
+        switch (level) {
+            case 0:  return records.Oldest();
+            case 1:  return level1.Buckets().Oldest();
+            default: return level2.Buckets().Oldest();
+        }
+    }
+    uint32_t Newest(size_t level) const {
+        switch (level) {
+            case 0:  return records.Newest();
+            case 1:  return level1.Buckets().Newest();
+            default: return level2.Buckets().Newest();
+        }
+    }
+
+    // ### `AggregatedHistory.Partial()`
+    // Returns the bucket still being filled at `level` (`1` or `2`).
+    // It holds the records pushed since the last completed bucket at that level that are not already covered by the partial bucket of the level below.
+    const Aggregate& Partial(size_t level) const {
+        return (level == 1) ? level1.Partial() : level2.Partial();
+    }
+
+    // ### `AggregatedHistory.Entry()`
+    // Returns the entry with sequence number `sequence` at `level`, as a bucket.
+    // Raw records are returned as single-record buckets; at levels `1` and `2`, `Newest(level)` returns the partial bucket.
+    Aggregate Entry(size_t level, uint32_t sequence) const {
+        if (level == 0) {
+            const T& record = records.At(sequence);
+            typename RecordChannels<T>::Value values[channels];
+            RecordChannels<T>::Extract(record, values);
+            Aggregate single;
+            single.Clear();
+            single.Add(newest_ms - (newest_us - RecordChannels<T>::Time(record)) / 1000, values);
+            return single;
+        }
+        if (level == 1) {
+            return sequence == level1.Buckets().Newest() ? level1.Partial() : level1.Buckets().At(sequence);
+        }
+        return sequence == level2.Buckets().Newest() ? level2.Partial() : level2.Buckets().At(sequence);
+    }
+
+    // ### `AggregatedHistory.SelectLevel()`
+    // Picks the level to summarize the range starting at `from` (`ms`) into buckets of `width` milliseconds:
+    // the coarsest level that still reaches back to `from` and whose buckets are no wider than `width`,
+    // else the finest level that reaches back to `from`, else the coarsest level holding any completed entries.
+    size_t SelectLevel(uint32_t from, uint32_t width) const {
+        size_t selected = levels;
+        size_t coarsest = 0;
+        for (size_t level = 0; level < levels; level++) {
+            if (Oldest(level) == Newest(level)) {
+                continue;   // Nothing completed at this level yet
+            }
+            coarsest = level;
+            Aggregate oldest = Entry(level, Oldest(level));
+            if ((int32_t)(oldest.first - from) > 0) {
+                continue;   // Does not reach back far enough
+            }
+            uint32_t span = (newest_ms - oldest.first) / (Newest(level) - Oldest(level));
+            if (selected == levels || span <= width) {
+                selected = level;
+            }
+        }
+        return selected == levels ? coarsest : selected;
+    }
+};
+
+
+
+#endif // AGGREGATED_HISTORY_HPP
\ No newline at end of file
@@ -0,0 +1,385 @@
+/****************************************************************
+*                                                               *
+*   BurstCapture.hpp                                            *
+*                                                               *
+*   Triggered dense capture of INA219 readings.                 *
+*                                                               *
+*****************************************************************/
+#ifndef BURST_CAPTURE_HPP
+#define BURST_CAPTURE_HPP
+
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <Arduino.h>
+#include "Sensor.hpp"
+#include "INA219.hpp"
+#include "Sample.hpp"
+#include "Events/Event.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Clock/Clock.hpp"
+
+// ### `BURST_CAPTURE_SIZE`
+// Readings a capture holds, before and after the trigger together (`12` bytes each).
+#ifndef BURST_CAPTURE_SIZE
+#define BURST_CAPTURE_SIZE 512
+#endif
+
+// ### `BURST_CAPTURE_PRE_TRIGGER`
+// Default number of readings kept from before the trigger.
+#ifndef BURST_CAPTURE_PRE_TRIGGER
+#define BURST_CAPTURE_PRE_TRIGGER 128
+#endif
+
+// ### `BURST_CAPTURE_INTERVAL`
+// Default time between readings while armed, in `ms`. With the driver's default 12-bit conversions (`532 µs` each
+// for the bus and shunt voltages), the INA219 has a new reading about every millisecond, so faster is no denser.
+// A capture reading is three register reads (the power is computed, see `INA219.ReadRaw()`): ~0.4 ms of I2C at the
+// `400 kHz` `INA219.Initialize()` sets, so 1 ms is kept up with (with the INA219's own polling, if it's running, on
+// the same bus). At the Wire library's default `100 kHz`, they take ~1.5 ms, and the real rate is one per ~2 ms.
+#ifndef BURST_CAPTURE_INTERVAL
+#define BURST_CAPTURE_INTERVAL 1
+#endif
+
+// ### `BURST_FORMAT_VERSION`
+// Version of the burst capture export, written in `BurstHeader.version`.
+#define BURST_FORMAT_VERSION 1
+
+
+
+// ## BurstTrigger
+// What ends the pre-trigger part of a capture.
+// - `RISING_EDGE` / `FALLING_EDGE` / `ANY_EDGE` - A switch 1 edge (the stroke's start, end, or either).
+// - `OVER_CURRENT` - The current rising above the level (`µA`) from one reading to the next.
+// - `OVER_TEMPERATURE` - The inferred coil temperature rising above the level (hundredths of a `°F`) likewise.
+enum class BurstTrigger : uint8_t {
+    RISING_EDGE = 1,
+    FALLING_EDGE,
+    ANY_EDGE,
+    OVER_CURRENT,
+    OVER_TEMPERATURE
+};
+
+// ### `BurstTriggerName()`
+// Returns the name of a `BurstTrigger` (as taken by `/capture?trigger=`).
+inline const char* BurstTriggerName(BurstTrigger trigger) {
+    switch (trigger) {
+        case BurstTrigger::RISING_EDGE:         return "rising";
+        case BurstTrigger::FALLING_EDGE:        return "falling";
+        case BurstTrigger::ANY_EDGE:            return "edge";
+        case BurstTrigger::OVER_CURRENT:        return "current";
+        case BurstTrigger::OVER_TEMPERATURE:    return "temperature";
+    }
+    return "unknown";
+}
+
+// ### `ParseBurstTrigger()`
+// Finds the `BurstTrigger` named `name`. Returns `false` if there is none.
+inline bool ParseBurstTrigger(const char* name, BurstTrigger& trigger) {
+    for (uint8_t i = (uint8_t)BurstTrigger::RISING_EDGE; i <= (uint8_t)BurstTrigger::OVER_TEMPERATURE; i++) {
+        if (strcmp(name, BurstTriggerName((BurstTrigger)i)) == 0) {
+            trigger = (BurstTrigger)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ## CaptureState
+// - `IDLE` - Not reading (never armed, or disarmed).
+// - `ARMED` - Reading into the pre-trigger ring, waiting for the trigger.
+// - `TRIGGERED` - Reading the post-trigger part.
+// - `COMPLETE` - Frozen, ready to be exported; not reading.
+enum class CaptureState : uint8_t {
+    IDLE,
+    ARMED,
+    TRIGGERED,
+    COMPLETE
+};
+
+// ### `CaptureStateName()`
+// Returns the name of a `CaptureState`.
+inline const char* CaptureStateName(CaptureState state) {
+    switch (state) {
+        case CaptureState::IDLE:        return "idle";
+        case CaptureState::ARMED:       return "armed";
+        case CaptureState::TRIGGERED:   return "triggered";
+        case CaptureState::COMPLETE:    return "complete";
+    }
+    return "unknown";
+}
+
+
+
+// ## BurstHeader
+// Header of an exported capture, followed by `count` `RawSample` records (`record_size` bytes each, little-endian,
+// no padding), oldest first.
+// ### Defined properties:
+// - `magic` (`char[4]`) - Always `"SEBC"`.
+// - `version` (`uint8_t`) - The export format version (`BURST_FORMAT_VERSION`).
+// - `trigger` (`uint8_t`) - The `BurstTrigger` that fired (`0` if forced).
+// - `record_size` (`uint16_t`) - Size of each record, in bytes.
+// - `trigger_time` (`uint32_t`) - When the trigger fired (`micros()`), in `µs`.
+// - `level` (`int32_t`) - The trigger level (`µA` or hundredths of a `°F`; `0` for edges).
+// - `count` (`uint16_t`) - Number of records.
+// - `pre_trigger` (`uint16_t`) - Number of records taken before the trigger.
+// - `current_lsb` (`uint16_t`) - Value of one unit of `RawSample.current`, in `µA`.
+// - `power_lsb` (`uint16_t`) - Value of one unit of `RawSample.power`, in `µW`.
+struct BurstHeader {
+    char magic[4];
+    uint8_t version;
+    uint8_t trigger;
+    uint16_t record_size;
+    uint32_t trigger_time;
+    int32_t level;
+    uint16_t count;
+    uint16_t pre_trigger;
+    uint16_t current_lsb;
+    uint16_t power_lsb;
+};
+
+
+
+// ## BurstCapture
+// Oscilloscope-style capture of the INA219's raw registers around a trigger, at the sensor's full rate.
+// Once armed, it reads the INA219 on its own `Ticker` (independently of the INA219's own polling, and without
+// recording anything to its `history`, listeners or telemetry) into a preallocated ring of `BURST_CAPTURE_SIZE`
+// readings. Once the `pre_trigger` readings have been taken, the trigger can fire; it then takes enough further
+// readings to fill the ring but for the `pre_trigger` ones before the trigger, then stops reading and freezes, until
+// exported (`Header()` and `Copy()`, or `/capture`) and armed again. The trigger can be a switch edge, a current or
+// temperature level crossing (checked on every reading), or forced with `Trigger()`.
+// ### Parameters
+// - `e` - The global `EventEmitter` object.
+// - `ina219` - The INA219 to read.
+// ```c++
+// BurstCapture burst_capture(event_emitter, ina219);
+// burst_capture.Arm(BurstTrigger::OVER_CURRENT, 2500000);     // 2.5 A
+// ```
+class BurstCapture : public Sensor {
+private:
+    INA219& ina219;
+    RawSample ring[BURST_CAPTURE_SIZE];
+    uint32_t written = 0;               // Readings taken since armed (the newest is at `(written - 1) % size`).
+    uint32_t trigger_written = 0;       // `written` when the trigger fired.
+    CaptureState state = CaptureState::IDLE;
+    BurstTrigger trigger = BurstTrigger::RISING_EDGE;
+    uint8_t fired = 0;                  // `BurstHeader.trigger`.
+    int32_t level = 0;
+    bool above = true;                  // Whether the last reading was above `level` (no crossing on the first).
+    size_t pre_trigger = BURST_CAPTURE_PRE_TRIGGER;
+    uint32_t trigger_time = 0;
+
+    // Whether a trigger can fire: armed, with the pre-trigger readings taken.
+    bool Ready() const {
+        return state == CaptureState::ARMED && written >= pre_trigger;
+    }
+
+    void OnEdge(const Event& event) {
+        if (!Ready()) {
+            return;
+        }
+        bool rising = event.type == EventType::SWITCH1_STATE_CHANGE_TO_HIGH;
+        if (trigger == BurstTrigger::ANY_EDGE
+            || (trigger == BurstTrigger::RISING_EDGE && rising)
+            || (trigger == BurstTrigger::FALLING_EDGE && !rising)) {
+            Fire(event.time, written, (uint8_t)trigger);
+        }
+    }
+
+    // Checks a level trigger on the newest reading: whether it went above the level since the last one.
+    bool Crossed(const RawSample& raw) {
+        bool was_above = above;
+        if (trigger == BurstTrigger::OVER_CURRENT) {
+            above = (int32_t)raw.current * INA219_CURRENT_LSB > level;
+        }
+        else if (trigger == BurstTrigger::OVER_TEMPERATURE) {
+            FixedSample sample = INA219::Derive(raw);
+            above = sample.resistance != INT32_MAX && sample.temperature > level;
+        }
+        else {
+            return false;
+        }
+        return above && !was_above;
+    }
+
+    void Fire(uint32_t time, uint32_t at, uint8_t source) {
+        state = CaptureState::TRIGGERED;
+        trigger_time = time;
+        trigger_written = at;
+        fired = source;
+        Finish();
+    }
+
+    // Freezes the capture once the post-trigger part is full.
+    void Finish() {
+        if (written - trigger_written >= BURST_CAPTURE_SIZE - pre_trigger) {
+            state = CaptureState::COMPLETE;
+            Sensor::StopPolling();
+        }
+    }
+
+    // Sequence number (in `written` terms) of the first record of the capture.
+    uint32_t First() const {
+        return trigger_written - PreTrigger();
+    }
+
+public:
+    // ## BurstCapture
+    // Oscilloscope-style capture of the INA219's raw registers around a trigger.
+    // ### Parameters
+    // - `e` - The global `EventEmitter` object.
+    // - `ina219` - The INA219 to read.
+    BurstCapture(EventEmitter& e, INA219& ina219)
+        : Sensor(
+            e,
+            {EventType::SWITCH1_STATE_CHANGE_TO_LOW, EventType::SWITCH1_STATE_CHANGE_TO_HIGH},
+            [this](const Event& event) { OnEdge(event); }
+        ),
+        ina219(ina219) { }
+
+    // ### `BurstCapture.Arm()`
+    // Discards any capture, and starts reading, waiting for `trigger`.
+    // Returns `false` (and stays as it was) if `pre_trigger` leaves no room after the trigger.
+    // ### Parameters
+    // - `trigger` - What fires the capture.
+    // - `level` (optional) - The level of `OVER_CURRENT` (`µA`) and `OVER_TEMPERATURE` (hundredths of a `°F`) triggers.
+    // - `pre_trigger` (optional) - Readings to keep from before the trigger (default `BURST_CAPTURE_PRE_TRIGGER`).
+    // - `update_interval` (optional) - Time between readings, in `ms` (default `BURST_CAPTURE_INTERVAL`).
+    bool Arm(
+        BurstTrigger trigger,
+        int32_t level = 0,
+        size_t pre_trigger = BURST_CAPTURE_PRE_TRIGGER,
+        float update_interval = BURST_CAPTURE_INTERVAL
+    ) {
+        if (pre_trigger >= BURST_CAPTURE_SIZE) {
+            return false;
+        }
+        Sensor::StopPolling();
+        this->trigger = trigger;
+        this->level = level;
+        this->pre_trigger = pre_trigger;
+        written = trigger_written = 0;
+        fired = 0;
+        above = true;
+        state = CaptureState::ARMED;
+        Sensor::Begin(update_interval);
+        return true;
+    }
+
+    // ### `BurstCapture.Disarm()`
+    // Stops reading and discards any capture.
+    void Disarm() {
+        Sensor::StopPolling();
+        state = CaptureState::IDLE;
+    }
+
+    // ### `BurstCapture.Trigger()`
+    // Fires the trigger now, whatever it is set to (even before the pre-trigger readings are all taken).
+    // Returns `false` if not armed.
+    bool Trigger() {
+        if (state != CaptureState::ARMED) {
+            return false;
+        }
+        Fire(ClockMicros(), written, 0);
+        return true;
+    }
+
+    // ### `BurstCapture.State()`
+    // Returns where the capture is at.
+    CaptureState State() const {
+        return state;
+    }
+
+    // ### `BurstCapture.Read()`
+    // Takes one reading while armed or triggered (the function bound to the `Ticker` by `Arm()`).
+    void Read() override {
+        if (state != CaptureState::ARMED && state != CaptureState::TRIGGERED) {
+            return;
+        }
+        bool ready = Ready();
+        RawSample raw = ina219.ReadRaw(false);
+        ring[written % BURST_CAPTURE_SIZE] = raw;
+        written++;
+        if (state == CaptureState::ARMED) {
+            if (Crossed(raw) && ready) {
+                Fire(raw.time, written - 1, (uint8_t)trigger);     // The crossing reading is the first after the trigger
+            }
+        }
+        else {
+            Finish();
+        }
+    }
+
+    // ### `BurstCapture.PreTrigger()`
+    // Returns the number of readings of the capture taken before the trigger (fewer than asked for if forced early).
+    size_t PreTrigger() const {
+        return trigger_written < pre_trigger ? trigger_written : pre_trigger;
+    }
+
+    // ### `BurstCapture.Count()`
+    // Returns the number of readings in the complete capture (`0` until complete).
+    size_t Count() const {
+        return state == CaptureState::COMPLETE ? written - First() : 0;
+    }
+
+    // ### `BurstCapture.At()`
+    // Returns reading `index` (`0` to `Count() - 1`, oldest first) of the complete capture.
+    const RawSample& At(size_t index) const {
+        return ring[(First() + index) % BURST_CAPTURE_SIZE];
+    }
+
+    // ### `BurstCapture.Header()`
+    // Returns the `BurstHeader` of the complete capture.
+    BurstHeader Header() const {
+        return {
+            {'S', 'E', 'B', 'C'},
+            BURST_FORMAT_VERSION,
+            fired,
+            (uint16_t)sizeof(RawSample),
+            trigger_time,
+            level,
+            (uint16_t)Count(),
+            (uint16_t)PreTrigger(),
+            INA219_CURRENT_LSB,
+            INA219_POWER_LSB
+        };
+    }
+
+    // ### `BurstCapture.Size()`
+    // Returns the size of the exported capture (`BurstHeader` and records), in bytes (`0` until complete).
+    size_t Size() const {
+        return state == CaptureState::COMPLETE ? sizeof(BurstHeader) + Count() * sizeof(RawSample) : 0;
+    }
+
+    // ### `BurstCapture.Copy()`
+    // Copies up to `length` bytes of the exported capture, from byte `offset` on, into `buffer` (for use as the filler
+    // of a chunked HTTP response). Returns the number of bytes copied; `0` once past the end, or if the capture is no
+    // longer complete (re-armed meanwhile).
+    size_t Copy(size_t offset, uint8_t* buffer, size_t length) const {
+        size_t size = Size();
+        size_t copied = 0;
+        while (offset < size && copied < length) {
+            size_t count;
+            if (offset < sizeof(BurstHeader)) {
+                BurstHeader header = Header();
+                count = sizeof(BurstHeader) - offset;
+                count = count < length - copied ? count : length - copied;
+                memcpy(buffer + copied, (const uint8_t*)&header + offset, count);
+            }
+            else {
+                size_t record = (offset - sizeof(BurstHeader)) / sizeof(RawSample);
+                size_t within = (offset - sizeof(BurstHeader)) % sizeof(RawSample);
+                count = sizeof(RawSample) - within;
+                count = count < length - copied ? count : length - copied;
+                memcpy(buffer + copied, (const uint8_t*)&At(record) + within, count);
+            }
+            offset += count;
+            copied += count;
+        }
+        return copied;
+    }
+};
+
+
+
+#endif // BURST_CAPTURE_HPP
\ No newline at end of file
@@ -12,11 +12,89 @@
 #include <functional>
 #include <Wire.h>
 #include <Arduino.h>
+#include "Sample.hpp"
 #include "Sensor.hpp"
+#include "RingBuffer.hpp"
 #include "SensorBuffer.hpp"
+#include "SampleListener.hpp"
+#include "AggregatedHistory.hpp"
 #include "Events/Event.hpp"
 #include "Adafruit_INA219.h"
 #include "Events/EventEmitter.hpp"
+#include "Telemetry/Metrics.hpp"
+#include "Clock/Clock.hpp"
+#include "Engine/FixedPoint.hpp"
+
+// ### `INA219_MAX_SAMPLE_LISTENERS`
+// Maximum number of `SampleListener`s that can be added to an INA219 (the firmware adds at most 7, checked against it
+// in main.cpp).
+#ifndef INA219_MAX_SAMPLE_LISTENERS
+#define INA219_MAX_SAMPLE_LISTENERS 10
+#endif
+
+// ### `INA219_ADDRESS`
+// I2C address of the INA219 (`0x40` with A0 and A1 grounded).
+#ifndef INA219_ADDRESS
+#define INA219_ADDRESS 0x40
+#endif
+
+// ### `INA219_I2C_CLOCK`
+// I2C clock set by `INA219.Initialize()`, in `Hz`. The INA219 supports fast mode; at the Wire library's default
+// `100 kHz`, each register read takes ~0.5 ms, so a four-register reading alone takes ~2 ms (~0.5 ms at `400 kHz`).
+#ifndef INA219_I2C_CLOCK
+#define INA219_I2C_CLOCK 400000
+#endif
+
+// ### `INA219_CURRENT_LSB`
+// Value of one unit of the current register, in `µA` (`100` with the Adafruit driver's default `setCalibration_32V_2A()`).
+#ifndef INA219_CURRENT_LSB
+#define INA219_CURRENT_LSB 100
+#endif
+
+// ### `INA219_POWER_LSB`
+// Value of one unit of the power register, in `µW` (`20 ×` the current LSB, as the INA219 defines it).
+#ifndef INA219_POWER_LSB
+#define INA219_POWER_LSB (20 * INA219_CURRENT_LSB)
+#endif
+
+// ### `SAMPLE_HISTORY_SIZE`
+// Number of raw readings kept in `INA219.history` (`24` bytes each).
+#ifndef SAMPLE_HISTORY_SIZE
+#define SAMPLE_HISTORY_SIZE 128
+#endif
+
+// ### `SAMPLE_HISTORY_LEVEL1`
+// Aggregate level 1 of `INA219.history`: readings per bucket, and buckets kept (`96` bytes each).
+#ifndef SAMPLE_HISTORY_FACTOR1
+#define SAMPLE_HISTORY_FACTOR1 32
+#endif
+#ifndef SAMPLE_HISTORY_LEVEL1_SIZE
+#define SAMPLE_HISTORY_LEVEL1_SIZE 32
+#endif
+
+// ### `SAMPLE_HISTORY_LEVEL2`
+// Aggregate level 2 of `INA219.history`: level-1 buckets per bucket, and buckets kept (`96` bytes each). Off (`0`
+// buckets) unless built with e.g. `-D SAMPLE_HISTORY_LEVEL2_SIZE=64`, which (with 2 ms polling) spans the last ~17
+// minutes of polling (~35 minutes of running) for `6 KB` of RAM; without it, `/history` reaches back ~2 seconds of
+// polling.
+#ifndef SAMPLE_HISTORY_FACTOR2
+#define SAMPLE_HISTORY_FACTOR2 256
+#endif
+#ifndef SAMPLE_HISTORY_LEVEL2_SIZE
+#define SAMPLE_HISTORY_LEVEL2_SIZE 0
+#endif
+
+
+
+// ## SampleHistory
+// The most recent complete INA219 readings, plus precomputed min/max/mean buckets over longer spans, all kept in the
+// scaled integers the readings are derived in (and exported as `Sample`s).
+typedef AggregatedHistory<
+    FixedSample,
+    SAMPLE_HISTORY_SIZE,
+    SAMPLE_HISTORY_FACTOR1, SAMPLE_HISTORY_LEVEL1_SIZE,
+    SAMPLE_HISTORY_FACTOR2, SAMPLE_HISTORY_LEVEL2_SIZE
+> SampleHistory;
 
 
 
@@ -47,53 +125,167 @@ private:
     const int scl_pin;
 
     // ### `INA219.ada_obj`
-    // Private `Adafruit_INA219` object that this class wraps.
-    Adafruit_INA219 ada_obj;
+    // Private `Adafruit_INA219` object that this class wraps (to initialize and calibrate the sensor; the readings'
+    // registers are read directly, see `ReadRegister()`).
+    Adafruit_INA219 ada_obj{INA219_ADDRESS};
+
+    // ### `INA219.sample_listeners`
+    // Private array of the `SampleListener`s notified of every complete reading (a fixed array, so adding one never allocates).
+    SampleListener* sample_listeners[INA219_MAX_SAMPLE_LISTENERS] = {};
+
+    // ### `INA219.sample_listener_count`
+    // Private number of entries used in `INA219.sample_listeners`.
+    size_t sample_listener_count = 0;
+
+    // ### `INA219.CheckTransaction()`
+    // Private function that counts an I2C transaction in `Metrics` and `consecutive_errors` if it failed
+    // (resetting `consecutive_errors` if it succeeded).
+    void CheckTransaction(bool success) {
+        if (!success) {
+            Metrics::Increment(Counter::I2C_ERRORS);
+            consecutive_errors++;
+        }
+        else {
+            consecutive_errors = 0;
+        }
+    }
+
+    // ### `INA219.ReadRegister()`
+    // Private function that reads one of the INA219's 16-bit registers over I2C (`0x01` shunt voltage, `0x02` bus
+    // voltage, `0x03` power, `0x04` current) and counts the transaction. Reads `0` if it failed.
+    // The Adafruit driver keeps its raw getters private, and rewrites the calibration before every current or power
+    // reading; reading the registers here takes one transaction each instead.
+    uint16_t ReadRegister(uint8_t reg) {
+        Wire.beginTransmission((uint8_t)INA219_ADDRESS);
+        Wire.write(reg);
+        bool success = Wire.endTransmission() == 0 && Wire.requestFrom((uint8_t)INA219_ADDRESS, (uint8_t)2) == 2;
+        uint16_t value = 0;
+        if (success) {
+            value = (uint16_t)(Wire.read() << 8);
+            value |= (uint16_t)Wire.read();
+        }
+        CheckTransaction(success);
+        return value;
+    }
+
+    // ### `INA219.ReadBusRegister()`
+    // Private function that reads the bus voltage register, in `mV` (its 13-bit value is in `4 mV` units, above the
+    // conversion-ready and overflow flags).
+    int16_t ReadBusRegister() {
+        return (int16_t)((ReadRegister(0x02) >> 3) * 4);
+    }
+
+    // ### `INA219.ReadPower()`
+    // Private function that reads the power register, in `µW`, without recording it.
+    int32_t ReadPower() {
+        return (int32_t)ReadRegister(0x03) * INA219_POWER_LSB;
+    }
+
+    // ### `INA219.ReadCurrent()`
+    // Private function that reads the current register, in `µA`, without recording it.
+    int32_t ReadCurrent() {
+        return (int32_t)(int16_t)ReadRegister(0x04) * INA219_CURRENT_LSB;
+    }
+
+    // ### `INA219.ReadVoltage()`
+    // Private function that reads the bus (`4 mV` units, returned in `mV`) and shunt (`10 µV` units) voltage registers,
+    // and returns the voltage across the load, in `µV`, without recording it.
+    int32_t ReadVoltage() {
+        int32_t bus = ReadBusRegister();
+        return bus * 1000 + (int32_t)(int16_t)ReadRegister(0x01) * 10;
+    }
 
+public:
     // ### `INA219.reference_temperature`
-    // Private float defining the reference room temperature (in `°C`) of the coil the INA219 is in series with.
-    // Used in inferring the temperature of the coil.
-    const float reference_temperature = 20.f;
+    // Float defining the reference room temperature (in `°C`) of the coil the INA219 is in series with.
+    // Used in inferring the temperature of the coil (and by the host-side engine simulator).
+    static constexpr float reference_temperature = 20.f;
 
     // ### `INA219.reference_resistance`
-    // Private float defining the room-temperature resistance (in `Ω`) of the coil the INA219 is in series with.
-    // Used in inferring the temperature of the coil.
-    const float reference_resistance = 4.f;
+    // Float defining the room-temperature resistance (in `Ω`) of the coil the INA219 is in series with.
+    // Used in inferring the temperature of the coil (and by the host-side engine simulator).
+    static constexpr float reference_resistance = 4.f;
 
     // ### `INA219.temperature_coefficient`
-    // Private float defining the Temperature Coefficient of copper (in `1/°C`) of the coil the INA219 is in series with.
-    // Used in inferring the temperature of the coil.
-    const float temperature_coefficient = 0.00393f;
+    // Float defining the Temperature Coefficient of copper (in `1/°C`) of the coil the INA219 is in series with.
+    // Used in inferring the temperature of the coil (and by the host-side engine simulator).
+    static constexpr float temperature_coefficient = 0.00393f;
+
+    // ### `INA219::InferResistance()`
+    // Calculates the load's resistance, in `Ω`, from its voltage and power.
+    // The floating-point reference for `InferResistanceFixed()` (used by the benchmarks and `tools/fixed_check`).
+    static float InferResistance(float voltage, float power) {
+        return voltage * voltage / power;
+    }
+
+    // ### `INA219::InferTemperature()`
+    // Infers the coil temperature, in `°F`, from its resistance.
+    // The floating-point reference for `InferTemperatureFixed()` (used by the benchmarks and `tools/fixed_check`).
+    static float InferTemperature(float resistance) {
+        float temperature_C = reference_temperature + ((1/temperature_coefficient) * (resistance/reference_resistance - 1));
+        return (temperature_C * 9/5) + 32;
+    }
+
+    // ### `INA219::InferResistanceFixed()`
+    // Calculates the load's resistance, in `µΩ`, from its voltage in `µV` and power in `µW` (as `Read()` does).
+    // A reading with no power (or over `2147 Ω`) saturates to `INT32_MAX`.
+    // The one division is done in floats: the square of the voltage needs 50 bits, and a 64-bit integer division is a
+    // slower library call on the ESP8266, while a float keeps the result well within `tools/fixed_check`'s bound.
+    static int32_t InferResistanceFixed(int32_t voltage, int32_t power) {
+        if (power <= 0) {
+            return INT32_MAX;
+        }
+        float resistance = (float)voltage * (float)voltage / (float)power;
+        return resistance >= 2147483648.f ? INT32_MAX : (int32_t)(resistance + 0.5f);
+    }
+
+    // ### `INA219::InferTemperatureFixed()`
+    // Infers the coil temperature, in hundredths of a `°F`, from its resistance in `µΩ` (as `Read()` does).
+    // The temperature is linear in the resistance, with both constants folded at compile time.
+    static int32_t InferTemperatureFixed(int32_t resistance) {
+        constexpr int32_t reference_resistance_uOhm = (int32_t)(reference_resistance * 1e6 + 0.5);
+        constexpr int32_t reference_temperature_cF = (int32_t)(((double)reference_temperature * 9 / 5 + 32) * 100 + 0.5);
+        constexpr FixedScale cF_per_uOhm = MakeScale(100.0 * 9 / 5 / ((double)temperature_coefficient * reference_resistance * 1e6));
+        return reference_temperature_cF + (int32_t)ScaleSigned((int64_t)resistance - reference_resistance_uOhm, cF_per_uOhm);
+    }
 
-public:
     Adafruit_INA219 GetAdaObj() {
         return ada_obj;
     }
 
     struct Measurements {
         // ### `Measurements.power`
-        // List of past power readings by the INA219.
-        SensorBuffer power;
+        // List of past power readings by the INA219, in `µW`.
+        FixedSensorBuffer power;
         // ### `Measurements.voltage`
-        // List of past voltage readings by the INA219.
-        SensorBuffer voltage;
+        // List of past voltage readings by the INA219, in `µV`.
+        FixedSensorBuffer voltage;
         // ### `Measurements.current`
-        // List of past current readings by the INA219.
-        SensorBuffer current;
+        // List of past current readings by the INA219, in `µA`.
+        FixedSensorBuffer current;
         // ### `Measurements.resistance`
-        // List of past resistance calculations.
-        SensorBuffer resistance;
+        // List of past resistance calculations, in `µΩ`.
+        FixedSensorBuffer resistance;
         // ### `Measurements.temperature`
-        // List of past inferred temperatures, in `°F`.
-        SensorBuffer temperature;
+        // List of past inferred temperatures, in hundredths of a `°F`.
+        FixedSensorBuffer temperature;
     };
     // ### `INA219.measurements`
     // Stores previous measurements read by the INA219.
     Measurements measurements;
 
+    // ### `INA219.history`
+    // Stores the most recent complete readings (one `FixedSample` per `Read()`), oldest first.
+    // Unlike `measurements`, which only keeps short running averages, this is what the `/history` endpoint exports.
+    SampleHistory history;
+
+    // ### `INA219.consecutive_errors`
+    // Number of I2C transactions with the sensor that failed since the last one that succeeded.
+    uint32_t consecutive_errors = 0;
+
     // ### `INA219.reading_began`
-    // Timestamp of when the sensor began reading data.
-    unsigned long reading_began;
+    // Timestamp of when the sensor began reading data (`ClockMicros()`, or the `time` of the event that started it), in `µs`.
+    uint32_t reading_began = 0;
 
     // ## INA219
     // Class representing an INA219 sensor.
@@ -122,8 +314,22 @@ public:
             /* Could also define the OnEvent method below and assign it here with SetOnEvent(OnEvent) */
     }
 
+    // ### `INA219.AddSampleListener()`
+    // Adds a listener to be notified (from `AddSample()`) of every complete reading.
+    // Returns `false` if `INA219_MAX_SAMPLE_LISTENERS` listeners have already been added.
+    // ### Parameters
+    // - `listener` - A pointer to the `SampleListener` to add.
+    bool AddSampleListener(SampleListener* listener) {
+        if (sample_listener_count == INA219_MAX_SAMPLE_LISTENERS) {
+            return false;
+        }
+        sample_listeners[sample_listener_count++] = listener;
+        return true;
+    }
+
     // ### `INA219.Initialize()`
-    // Initializes the INA219 to prepare for reading values.
+    // Initializes the INA219 to prepare for reading values (its calibration set for `INA219_CURRENT_LSB`), and sets the
+    // I2C clock to `INA219_I2C_CLOCK`.
     // ```
     // if (!ina219.Initialize()) {
     //     Serial.println("Failed to find/initialize INA219.");
@@ -131,92 +337,173 @@ public:
     // }
     // ```
     bool Initialize() {
-        return ada_obj.begin();
+        if (!ada_obj.begin()) {
+            return false;
+        }
+        Wire.setClock(INA219_I2C_CLOCK);    // After `begin()`, which starts the bus at the default clock
+        return true;
     }
 
     // ### `INA219.GetPower()`
     // Reads the power consumption, in `Watts`, of the load the INA219 is in series with.
     float GetPower() {
-        float power = ada_obj.getPower_mW() / 1000.f;
+        int32_t power = ReadPower();
         measurements.power.Add(power);
-        return power;
+        return power * 1e-6f;
     }
 
     // ### `INA219.GetCurrent()`
     // Reads the current, in `Amperes`, traveling through the INA219 and the load it is in series with.
     float GetCurrent() {
-        float current = ada_obj.getCurrent_mA() / 1000.f;
+        int32_t current = ReadCurrent();
         measurements.current.Add(current);
-        return current;
+        return current * 1e-6f;
     }
 
     // ### `INA219.GetVoltage()`
     // Reads the voltage, in `Volts`, across the load the INA219 is in series with.
     float GetVoltage() {
-        float voltage = ada_obj.getBusVoltage_V() + (ada_obj.getShuntVoltage_mV() / 1000.f);
+        int32_t voltage = ReadVoltage();
         measurements.voltage.Add(voltage);
-        return voltage;
+        return voltage * 1e-6f;
     }
 
     // ### `INA219.GetResistance()`
     // Calculates the resistance, in `Ohms`, of the load the INA219 is in series with.
     float GetResistance() {
-        float power = GetPower();
-        float voltage = GetVoltage();
-        float resistance = voltage * voltage / power;
-        measurements.resistance.Add(resistance);
-        return resistance;
+        return ReadResistance() * 1e-6f;
     }
 
     // ### `INA219.GetAveragePower()`
     // Returns the average of all power measurements, in `W`, made since the buffer was last cleared.
     float GetAveragePower() {
-        return measurements.power.GetAverage();
+        return measurements.power.GetAverage() * 1e-6f;
     }
 
     // ### `INA219.GetAverageCurrent()`
     // Returns the average of all current measurements, in `A`, made since the buffer was last cleared.
     float GetAverageCurrent() {
-        return measurements.current.GetAverage();
+        return measurements.current.GetAverage() * 1e-6f;
     }
 
     // ### `INA219.GetAverageVoltage()`
     // Returns the average of all voltage measurements, in `V`, made since the buffer was last cleared.
     float GetAverageVoltage() {
-        return measurements.voltage.GetAverage();
+        return measurements.voltage.GetAverage() * 1e-6f;
     }
 
     // ### `INA219.GetAverageResistance()`
     // Returns the average of all resistance measurements, in `Ω`, made since the buffer was last cleared.
     float GetAverageResistance() {
-        return measurements.resistance.GetAverage();
+        return measurements.resistance.GetAverage() * 1e-6f;
     }
 
     // ### `INA219.GetInferredTemperature()`
     // Returns the inferred coil temperature based on calculations of resistance.
     float GetInferredTemperature() {
-        float resistance = GetResistance();
-        float temperature_C = reference_temperature + ((1/temperature_coefficient) * (resistance/reference_resistance - 1));
-        float temperature_F = (temperature_C * 9/5) + 32;
-        measurements.temperature.Add(temperature_F);
-        return temperature_F;
+        int32_t temperature = InferTemperatureFixed(ReadResistance());
+        measurements.temperature.Add(temperature);
+        return temperature * 0.01f;
     }
 
     // ### `INA219.GetAverageInferredTemperature()`
     // Returns the average of all inferred temperatures, in `°F`, done since the buffer was last cleared.
     float GetAverageInferredTemperature() {
-        return measurements.temperature.GetAverage();
+        return measurements.temperature.GetAverage() * 0.01f;
     }
 
     // ### `INA219.Read()`
     // Defines how and what it means to read this sensor, and under what condition it should emit an event.
     // This is the function bound to a `Ticker` object and is called continously at the interval specified in `Begin()`.
+    // Each register is read once per call, and the whole reading is derived in scaled integers (floating point only
+    // for the resistance's division) and recorded with `AddSample()`.
     void Read() override {
-        GetPower();
-        GetCurrent();
-        GetVoltage();
-        GetResistance();
-        GetInferredTemperature();
+        AddSample(Derive(ReadRaw()));
+    }
+
+    // ### `INA219.ReadRaw()`
+    // Reads each register once, without deriving or recording anything (e.g. for a `BurstCapture`).
+    // A sharp load can reset the INA219, clearing its calibration, after which it reads no current whatever the shunt
+    // voltage; it is calibrated again then (the Adafruit driver instead rewrites the calibration before every reading).
+    // ### Parameters
+    // - `read_power` (optional) - Whether to read the power register; if not, `power` is computed from `current` and
+    //   `bus` as the INA219 computes it (to within a few units, from the bus voltage's rounding), saving a quarter of
+    //   the I2C traffic.
+    RawSample ReadRaw(bool read_power = true) {
+        RawSample raw;
+        raw.time = ClockMicros();
+        raw.power = read_power ? ReadRegister(0x03) : 0;
+        raw.current = (int16_t)ReadRegister(0x04);
+        raw.bus = ReadBusRegister();
+        raw.shunt = (int16_t)ReadRegister(0x01);
+        if (!read_power) {
+            // Power register = current register * bus register (`4 mV` units) / 5000
+            int32_t current = raw.current < 0 ? -raw.current : raw.current;
+            raw.power = (uint16_t)(current * raw.bus / 20000);
+        }
+        if (raw.current == 0 && (raw.shunt > 1 || raw.shunt < -1)) {
+            ada_obj.setCalibration_32V_2A();
+        }
+        return raw;
+    }
+
+    // ### `INA219::Derive()`
+    // Derives a complete reading, in scaled integers, from the raw registers (as `Read()` does).
+    static FixedSample Derive(const RawSample& raw) {
+        FixedSample sample;
+        sample.time = raw.time;
+        sample.power = (int32_t)raw.power * INA219_POWER_LSB;
+        sample.current = (int32_t)raw.current * INA219_CURRENT_LSB;
+        sample.voltage = (int32_t)raw.bus * 1000 + (int32_t)raw.shunt * 10;
+        sample.resistance = InferResistanceFixed(sample.voltage, sample.power);
+        sample.temperature = InferTemperatureFixed(sample.resistance);
+        return sample;
+    }
+
+    // ### `INA219.AddSample()`
+    // Records one complete reading: adds it to `measurements` and `history`, and notifies the `SampleListener`s.
+    // `Read()` calls this with every reading from the sensor. The reading stays in scaled integers: it is only converted
+    // to floats where it is exported (`/history`) or by the listeners that take floats (see `SampleListener`).
+    // ### Parameters
+    // - `sample` - The reading to record.
+    void AddSample(const FixedSample& sample) {
+        Record(sample);
+    }
+
+    // ### `INA219.AddSample()`
+    // Records one complete reading given in floats, e.g. a recorded one (see `RunLogReplay`), converted back to the
+    // scaled integers it was recorded from (see `FixedSample::FromSample()`).
+    // ### Parameters
+    // - `sample` - The reading to record.
+    void AddSample(const Sample& sample) {
+        Record(FixedSample::FromSample(sample));
+    }
+
+private:
+    // ### `INA219.ReadResistance()`
+    // Private function that reads the power and voltage, records them and the resistance, and returns the resistance in `µΩ`.
+    int32_t ReadResistance() {
+        int32_t power = ReadPower();
+        int32_t voltage = ReadVoltage();
+        measurements.power.Add(power);
+        measurements.voltage.Add(voltage);
+        int32_t resistance = InferResistanceFixed(voltage, power);
+        measurements.resistance.Add(resistance);
+        return resistance;
+    }
+
+    // ### `INA219.Record()`
+    // Private function recording a reading.
+    void Record(const FixedSample& fixed) {
+        measurements.power.Add(fixed.power);
+        measurements.current.Add(fixed.current);
+        measurements.voltage.Add(fixed.voltage);
+        measurements.resistance.Add(fixed.resistance);
+        measurements.temperature.Add(fixed.temperature);
+        history.Push(fixed);
+        for (size_t i = 0; i < sample_listener_count; i++) {
+            sample_listeners[i]->OnReading(fixed);
+        }
     }
 };
 
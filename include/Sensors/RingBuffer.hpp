@@ -0,0 +1,83 @@
+/****************************************************************
+*                                                               *
+*   RingBuffer.hpp                                              *
+*                                                               *
+*   Fixed-capacity, sequence-numbered circular record buffer.   *
+*                                                               *
+*****************************************************************/
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+// ## `RingBuffer`
+// A fixed-capacity circular buffer of records, allocated up front and never resized.
+// Every record pushed is given a sequence number (`0`, `1`, `2`, ...), so a reader that walks the buffer across several
+// callbacks (e.g. a chunked HTTP response) can tell which records it has already seen and which were overwritten in the meantime.
+// ### Parameters
+// - `T` - The record type stored in the buffer.
+// - `N` - The maximum number of records to hold before the oldest ones are overwritten.
+template <typename T, size_t N>
+class RingBuffer {
+private:
+    T items[N];                 // Record storage, indexed by `sequence % N`.
+    uint32_t written = 0;       // Total number of records ever pushed (sequence number of the next record).
+
+public:
+    // ### `RingBuffer.Push()`
+    // Appends a record, overwriting the oldest one if the buffer is full.
+    void Push(const T& item) {
+        items[written % N] = item;
+        written++;
+    }
+
+    // ### `RingBuffer.Clear()`
+    // Discards all records (sequence numbers restart at `0`).
+    void Clear() {
+        written = 0;
+    }
+
+    // ### `RingBuffer.Newest()`
+    // Returns the sequence number one past the most recently pushed record (i.e. the sequence number the next record will get).
+    uint32_t Newest() const {
+        return written;
+    }
+
+    // ### `RingBuffer.Oldest()`
+    // Returns the sequence number of the oldest record still held in the buffer.
+    uint32_t Oldest() const {
+        return written > N ? written - N : 0;
+    }
+
+    // ### `RingBuffer.Contains()`
+    // Checks whether the record with sequence number `sequence` is still held in the buffer.
+    bool Contains(uint32_t sequence) const {
+        return sequence >= Oldest() && sequence < written;
+    }
+
+    // ### `RingBuffer.At()`
+    // Returns the record with sequence number `sequence`.
+    // The caller should check `Contains()` first; an overwritten sequence number returns whichever record now occupies its slot.
+    const T& At(uint32_t sequence) const {
+        return items[sequence % N];
+    }
+
+    // ### `RingBuffer.Size()`
+    // Returns the number of records currently held in the buffer.
+    size_t Size() const {
+        return written - Oldest();
+    }
+
+    // ### `RingBuffer.Capacity()`
+    // Returns the maximum number of records the buffer can hold (`N`).
+    static constexpr size_t Capacity() {
+        return N;
+    }
+};
+
+
+
+#endif // RING_BUFFER_HPP
\ No newline at end of file
@@ -0,0 +1,114 @@
+/****************************************************************
+*                                                               *
+*   Sample.hpp                                                  *
+*                                                               *
+*   `Sample` struct definition (one INA219 reading).            *
+*                                                               *
+*****************************************************************/
+#ifndef SAMPLE_HPP
+#define SAMPLE_HPP
+
+#include <stdint.h>
+#include <math.h>
+
+
+
+// ## Sample
+// Struct holding one complete INA219 reading in floats, as exported from `INA219.history` and sent by telemetry.
+// Its layout has no padding, so it is also the on-the-wire record of the packed binary history export.
+// ### Defined properties:
+// - `time` (`uint32_t`) - Timestamp of the reading (`micros()`), in `µs`.
+// - `voltage` (`float`) - The voltage across the load, in `V`.
+// - `current` (`float`) - The current through the load, in `A`.
+// - `power` (`float`) - The power consumed by the load, in `W`.
+// - `resistance` (`float`) - The resistance of the load, in `Ω`.
+// - `temperature` (`float`) - The inferred coil temperature, in `°F`.
+struct Sample {
+    uint32_t time;
+    float voltage;
+    float current;
+    float power;
+    float resistance;
+    float temperature;
+};
+
+
+
+// ## FixedSample
+// Struct holding one complete INA219 reading in the scaled integers `INA219` derives it in (see `Engine/FixedPoint.hpp`).
+// Only converted to a `Sample` (floats) where it is exported, sent or logged.
+// ### Defined properties:
+// - `time` (`uint32_t`) - Timestamp of the reading (`micros()`), in `µs`.
+// - `voltage` (`int32_t`) - The voltage across the load, in `µV`.
+// - `current` (`int32_t`) - The current through the load, in `µA`.
+// - `power` (`int32_t`) - The power consumed by the load, in `µW`.
+// - `resistance` (`int32_t`) - The resistance of the load, in `µΩ`.
+// - `temperature` (`int32_t`) - The inferred coil temperature, in hundredths of a `°F`.
+struct FixedSample {
+    uint32_t time;
+    int32_t voltage;
+    int32_t current;
+    int32_t power;
+    int32_t resistance;
+    int32_t temperature;
+
+    // ### `FixedSample.ToSample()`
+    // Converts the reading to floats (one multiplication per value).
+    Sample ToSample() const {
+        return {time, voltage * 1e-6f, current * 1e-6f, power * 1e-6f, resistance * 1e-6f, temperature * 0.01f};
+    }
+
+    // ### `FixedSample::FromSample()`
+    // Converts a float reading (e.g. a recorded one) back to scaled integers, rounding to the nearest unit.
+    // `FromSample(fixed.ToSample())` gives `fixed` back for values up to `2^22` units (e.g. `4.19 V`, `4.19 W`, `41943 °F`),
+    // and to within `2e-7` (relative) above.
+    // Values out of range (or not finite, e.g. the resistance of a reading with no power) saturate.
+    static FixedSample FromSample(const Sample& sample) {
+        return {
+            sample.time,
+            ToFixed(sample.voltage, 1e6),
+            ToFixed(sample.current, 1e6),
+            ToFixed(sample.power, 1e6),
+            ToFixed(sample.resistance, 1e6),
+            ToFixed(sample.temperature, 1e2)
+        };
+    }
+
+    // ### `FixedSample::ToFixed()`
+    // Returns `value × units`, rounded and saturated to `int32_t` (`NaN` gives `0`).
+    static int32_t ToFixed(float value, double units) {
+        double scaled = value * units;
+        if (!(scaled > -2147483647.0)) {
+            return scaled != scaled ? 0 : -2147483647;
+        }
+        if (!(scaled < 2147483647.0)) {
+            return 2147483647;
+        }
+        return (int32_t)lround(scaled);
+    }
+};
+
+
+
+
+// ## RawSample
+// Struct holding one INA219 reading as its raw registers (as read by `INA219::ReadRaw()`), for dense captures.
+// Half the size of a `FixedSample`; `INA219::Derive()` turns it into one. Its layout has no padding, so it is also
+// the on-the-wire record of a burst capture (see `BurstCapture`).
+// ### Defined properties:
+// - `time` (`uint32_t`) - Timestamp of the reading (`micros()`), in `µs`.
+// - `bus` (`int16_t`) - The bus voltage register, in `mV` (`4 mV` steps).
+// - `shunt` (`int16_t`) - The shunt voltage register, in `10 µV` units.
+// - `current` (`int16_t`) - The current register, in `INA219_CURRENT_LSB` units.
+// - `power` (`uint16_t`) - The power register, in `INA219_POWER_LSB` units.
+struct RawSample {
+    uint32_t time;
+    int16_t bus;
+    int16_t shunt;
+    int16_t current;
+    uint16_t power;
+};
+
+
+
+#endif // SAMPLE_HPP
\ No newline at end of file
@@ -0,0 +1,40 @@
+/****************************************************************
+*                                                               *
+*   SampleListener.hpp                                          *
+*                                                               *
+*   SampleListener interface class definition.                  *
+*                                                               *
+*****************************************************************/
+#ifndef SAMPLE_LISTENER_HPP
+#define SAMPLE_LISTENER_HPP
+
+#include "Sample.hpp"
+
+
+
+// ## SampleListener
+// Interface for objects that consume every complete INA219 reading (e.g. telemetry sinks and loggers).
+// Listeners are added with `INA219.AddSampleListener()` and called from `INA219.Read()`, i.e. from the sensor's `Ticker` callback,
+// so `OnSample` (and `OnReading`) must be short and must not block (copy the sample somewhere and process it later from `loop()`).
+class SampleListener {
+public:
+    // ### `SampleListener.OnSample()`
+    // Called once for each complete reading taken by the INA219 the listener was added to.
+    // ### Parameters
+    // - `sample` - The reading.
+    virtual void OnSample(const Sample& sample) = 0;
+
+    // ### `SampleListener.OnReading()`
+    // Called by the INA219 for each reading, in the scaled integers it was derived in.
+    // Converts it to floats for `OnSample()` unless overridden: listeners working in fixed point override this instead,
+    // so a reading is only converted for the listeners that need floats (e.g. to send or store it).
+    // ### Parameters
+    // - `fixed` - The reading in scaled integers.
+    virtual void OnReading(const FixedSample& fixed) {
+        OnSample(fixed.ToSample());
+    }
+};
+
+
+
+#endif // SAMPLE_LISTENER_HPP
\ No newline at end of file
@@ -17,6 +17,7 @@
 #include "Events/Event.hpp"
 #include "Events/EventEmitter.hpp"
 #include "Events/EventListener.hpp"
+#include "Telemetry/Metrics.hpp"
 
 
 
@@ -59,7 +60,21 @@ public:
     void Begin(float update_interval) {
         // timer.attach(update_interval/1000.f, std::bind(&Sensor::Read, this));
         // timer.attach_ms_scheduled_accurate(update_interval, std::bind(&Sensor::Read, this));
-        timer.attach_ms(update_interval, std::bind(&Sensor::Read, this));
+        timer.attach_ms(update_interval, &Sensor::PollTrampoline, this);
+    }
+
+    // ### `Sensor.PollTrampoline()`
+    // Calls `sensor->Poll()`. Attaching it with the sensor as the `Ticker`'s argument (rather than a `std::bind` of
+    // `Poll`) keeps `Begin()` from allocating, which matters since `INA219` begins polling again on every stroke.
+    static void PollTrampoline(Sensor* sensor) {
+        sensor->Poll();
+    }
+
+    // ### `Sensor.Poll()`
+    // The function actually bound to the `Ticker`: counts the callback in `Metrics`, then calls `Read()`.
+    void Poll() {
+        Metrics::Increment(Counter::TICKER_CALLBACKS);
+        Read();
     }
 
     // ### `Sensor.IsPolling()`
@@ -8,69 +8,131 @@
 #ifndef SENSOR_BUFFER_HPP
 #define SENSOR_BUFFER_HPP
 
-#include <deque>
-#include <numeric>
+#include <stddef.h>
+#include <stdint.h>
+#include "Engine/FixedPoint.hpp"
 
 
 
-// ## `SensorBuffer`
-// A vector-like buffer for storing sensor readings/values.
+// ### `SENSOR_BUFFER_CAPACITY`
+// Storage reserved by every `SensorBuffer`, and so the largest `MAX_SIZE` it can be given.
+// The values live inside the object, so adding one never touches the heap.
+#ifndef SENSOR_BUFFER_CAPACITY
+#define SENSOR_BUFFER_CAPACITY 64
+#endif
+
+
+
+// ## `BasicSensorBuffer`
+// A vector-like buffer for storing sensor readings/values of type `T`, averaged in type `Sum`.
+// Use `SensorBuffer` for `float` values and `FixedSensorBuffer` for scaled integers (see `Engine/FixedPoint.hpp`).
 // ### Parameters
-// - `MAX_SIZE` - The maximum number of values to hold before overwriting begins (optional, default = `20`).
-class SensorBuffer {
+// - `MAX_SIZE` - The maximum number of values to hold before overwriting begins (optional, default = `20`, at most `SENSOR_BUFFER_CAPACITY`).
+template <typename T, typename Sum>
+class BasicSensorBuffer {
 private:
-    std::deque<float> buffer;       // Acts like a limited-size queue.
-    const size_t MAX_SIZE;          // Maximum number of values to hold.
+    T buffer[SENSOR_BUFFER_CAPACITY];   // Ring of the last `count` values, the oldest at `first`.
+    size_t first = 0;                       // Index of the oldest value.
+    size_t MAX_SIZE;                        // Maximum number of values to hold.
+
+    static size_t Clamp(size_t max_size) {
+        if (max_size < 1) {
+            return 1;
+        }
+        return max_size > SENSOR_BUFFER_CAPACITY ? SENSOR_BUFFER_CAPACITY : max_size;
+    }
+
+    static float Divide(double sum, unsigned int count) {
+        return (float)(sum / count);
+    }
+
+    // Rounded to the nearest integer (halves away from zero)
+    static int32_t Divide(int64_t sum, unsigned int count) {
+        return AverageRounded(sum, count);
+    }
 
 public:
-    // ## `SensorBuffer`
+    // ## `BasicSensorBuffer`
     // A vector-like buffer for storing sensor readings/values.
     // ### Parameters
-    // - `MAX_SIZE` - The maximum number of values to hold before overwriting begins (optional, default = `20`).
-    SensorBuffer(size_t MAX_SIZE = 20) : MAX_SIZE(MAX_SIZE) { }
+    // - `MAX_SIZE` - The maximum number of values to hold before overwriting begins (optional, default = `20`, at most `SENSOR_BUFFER_CAPACITY`).
+    BasicSensorBuffer(size_t MAX_SIZE = 20) : MAX_SIZE(Clamp(MAX_SIZE)) { }
 
     // ### `SensorBuffer.count`
     // The number of values currently stored in the buffer.
-    unsigned int count;
+    unsigned int count = 0;
 
     // ### `SensorBuffer.Add()`
     // Adds a new sensor reading to the buffer.
-    void Add(float measurement) {
-        if (buffer.size() == MAX_SIZE) {
-            buffer.pop_front();     // Remove oldest element
+    void Add(T measurement) {
+        if (count == MAX_SIZE) {
+            buffer[first] = measurement;    // Overwrite the oldest element
+            first = (first + 1) % MAX_SIZE;
+            return;
+        }
+        buffer[(first + count) % MAX_SIZE] = measurement;
+        count++;
+    }
+
+    // ### `SensorBuffer.Resize()`
+    // Changes the maximum number of values to hold (clamped to `1`..`SENSOR_BUFFER_CAPACITY`), dropping the oldest values if there are more than that.
+    void Resize(size_t max_size) {
+        max_size = Clamp(max_size);
+        size_t kept = count < max_size ? count : max_size;
+        T values[SENSOR_BUFFER_CAPACITY];
+        for (size_t i = 0; i < kept; i++) {
+            values[i] = buffer[(first + count - kept + i) % MAX_SIZE];
+        }
+        for (size_t i = 0; i < kept; i++) {
+            buffer[i] = values[i];
         }
-        buffer.push_back(measurement);
-        count = buffer.size();
+        MAX_SIZE = max_size;
+        first = 0;
+        count = kept;
     }
 
     // ### `SensorBuffer.Clear()`
     // Clears all values from the buffer (its size will be equal to zero afterwards).
     void Clear() {
-        buffer.clear();
+        first = 0;
         count = 0;
     }
 
     // ### `SensorBuffer.GetLast()`
     // Gets the most recently added value from the buffer.
-    float GetLast() const {
-        if (buffer.empty()) {
-            return 0.f;
+    T GetLast() const {
+        if (count == 0) {
+            return 0;
         }
-        return buffer.back();
+        return buffer[(first + count - 1) % MAX_SIZE];
     }
 
     // ### `SensorBuffer.GetAverage()`
-    // Computes the average of all values in the buffer.
-    float GetAverage() const {
-        if (buffer.empty()) {
-            return 0.f;
+    // Computes the average of all values in the buffer (summed oldest first).
+    T GetAverage() const {
+        if (count == 0) {
+            return 0;
         }
-        double sum = std::accumulate(buffer.begin(), buffer.end(), 0.0);
-        double avg = sum / buffer.size();
-        return (float)avg;
+        size_t wrapped = first + count > MAX_SIZE ? first + count - MAX_SIZE : 0;
+        Sum sum = 0;
+        for (size_t i = first; i < first + count - wrapped; i++) {
+            sum += buffer[i];
+        }
+        for (size_t i = 0; i < wrapped; i++) {
+            sum += buffer[i];
+        }
+        return Divide(sum, count);
     }
 };
 
+// ## `SensorBuffer`
+// A `BasicSensorBuffer` of `float` values, averaged in `double`.
+typedef BasicSensorBuffer<float, double> SensorBuffer;
+
+// ## `FixedSensorBuffer`
+// A `BasicSensorBuffer` of scaled-integer values (e.g. `µV`), averaged in `int64_t` and rounded.
+typedef BasicSensorBuffer<int32_t, int64_t> FixedSensorBuffer;
+
 
 
 #endif // SENSOR_BUFFER_HPP
\ No newline at end of file
@@ -12,6 +12,7 @@
 #include <Wire.h>
 #include <Arduino.h>
 #include "Sensor.hpp"
+#include "Clock/Clock.hpp"
 
 
 // ## Switch
@@ -67,7 +68,7 @@ public:
             /* Could also define the OnEvent method below and assign it here with SetOnEvent(OnEvent) */
             pinMode(pin, INPUT);            // Designate pin as an input
             last_state = digitalRead(pin);      // Initialize the last_state variable
-            last_statechange_millis = millis(); // Initialize the last_statechange_millis variable
+            last_statechange_millis = ClockMillis(); // Initialize the last_statechange_millis variable
     }
 
     // ### `Switch.Read()`
@@ -76,18 +77,19 @@ public:
     void Read() override {
         int current_state = digitalRead(pin);
         if (current_state != last_state) {
+            uint32_t now = ClockMicros();
             if (current_state == 1) {
                 // Switch went from LOW to HIGH
-                Event event = {EventType::SWITCH1_STATE_CHANGE_TO_HIGH, static_cast<float>(current_state), String("SWITCH1_STATE_CHANGE_TO_HIGH")};
+                Event event = {EventType::SWITCH1_STATE_CHANGE_TO_HIGH, static_cast<float>(current_state), EventTypeName(EventType::SWITCH1_STATE_CHANGE_TO_HIGH), now};
                 emitter.EmitEvent(event);
             }
             else if (current_state == 0) {
                 // Switch went from HIGH to LOW
-                Event event = {EventType::SWITCH1_STATE_CHANGE_TO_LOW, static_cast<float>(current_state), String("SWITCH1_STATE_CHANGE_TO_LOW")};
+                Event event = {EventType::SWITCH1_STATE_CHANGE_TO_LOW, static_cast<float>(current_state), EventTypeName(EventType::SWITCH1_STATE_CHANGE_TO_LOW), now};
                 emitter.EmitEvent(event);
             }
             last_state = current_state;
-            last_statechange_millis = millis();
+            last_statechange_millis = ClockMillis();
         }
         // if (current_state != last_state) {
         //     Event event = {EventType::SWITCH1_STATE_CHANGE, static_cast<float>(current_state), String("SWITCH1_STATE_CHANGE")};
@@ -0,0 +1,283 @@
+/****************************************************************
+*                                                               *
+*   Tachometer.hpp                                              *
+*                                                               *
+*   Interrupt-timed engine speed and acceleration sensor.       *
+*                                                               *
+*****************************************************************/
+#ifndef TACHOMETER_HPP
+#define TACHOMETER_HPP
+
+#include <vector>
+#include <functional>
+#include <Arduino.h>
+#include "Sensor.hpp"
+#include "Events/Event.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Telemetry/Metrics.hpp"
+#include "Telemetry/LockFreeRing.hpp"
+#include "Clock/Clock.hpp"
+#include "Engine/FixedPoint.hpp"
+
+// ### `TACHOMETER_WINDOW`
+// Default number of revolutions the speed is averaged over.
+#ifndef TACHOMETER_WINDOW
+#define TACHOMETER_WINDOW 8
+#endif
+
+// ### `TACHOMETER_MAX_WINDOW`
+// Largest window a `Tachometer` can be given (`4` bytes of edge times per revolution).
+#ifndef TACHOMETER_MAX_WINDOW
+#define TACHOMETER_MAX_WINDOW 16
+#endif
+
+// ### `TACHOMETER_QUEUE_SIZE`
+// Edges the interrupt handler can queue until `Read()` takes them (a power of two).
+#ifndef TACHOMETER_QUEUE_SIZE
+#define TACHOMETER_QUEUE_SIZE 16
+#endif
+
+// ### `TACHOMETER_MIN_PERIOD`
+// Shortest time between edges, in `µs`; an edge coming sooner after the last one is taken as contact bounce.
+// `2 ms` is `30000 RPM` with one edge per revolution.
+#ifndef TACHOMETER_MIN_PERIOD
+#define TACHOMETER_MIN_PERIOD 2000
+#endif
+
+// ### `TACHOMETER_STALL_TIME`
+// Time without an edge, in `µs`, after which the engine is taken as stopped (`1 s` is `60 RPM` with one edge per
+// revolution). Also keeps every window well within the cycle counter's wraparound.
+#ifndef TACHOMETER_STALL_TIME
+#define TACHOMETER_STALL_TIME 1000000
+#endif
+
+
+
+// ## Tachometer
+// Class measuring the engine's speed from the rising edges of a switch, timestamped in CPU cycles by a pin interrupt
+// (rather than the `1 ms` polling of `Switch`, which quantizes a `30 ms` stroke to `±3%`).
+// The interrupt handler only reads the cycle counter and queues the time; `Read()` (polled like any sensor) takes the
+// queued edges and, for each, estimates over the last `window` revolutions:
+// - the speed, from the mean period (`TACHOMETER_RPM` events, in `RPM`)
+// - the angular acceleration, from the change in speed between the window's first and second halves
+//   (`TACHOMETER_ACCELERATION` events, in `rad/s²`, once the window holds two revolutions)
+// Both cost the same for any window: three divisions and a few multiplications per edge.
+// After `TACHOMETER_STALL_TIME` without an edge the window restarts, and `0 RPM` is published.
+// ### Parameters
+// - `e` - The global `EventEmitter` object.
+// - `pin` - The GPIO pin of the switch (interrupt-capable, i.e. not GPIO16).
+// - `window` (optional) - The number of revolutions estimates are made over (default `TACHOMETER_WINDOW`).
+// - `pulses_per_revolution` (optional) - Rising edges per revolution (default `1`).
+// ### Example Instantiation
+// ```
+// #define SWITCH_PIN 14
+// EventEmitter event_emitter;
+// Tachometer tachometer(event_emitter, SWITCH_PIN);
+// tachometer.Begin(5);
+// ```
+class Tachometer : public Sensor {
+private:
+    // ### `Tachometer.pin`
+    // Private integer defining which GPIO pin the switch's output is connected to.
+    const int pin;
+
+    // ### `Tachometer.pulses_per_revolution`
+    // Private number of rising edges per revolution.
+    const uint32_t pulses_per_revolution;
+
+    // ### `Tachometer.window`
+    // Private number of revolutions the estimates are made over.
+    size_t window;
+
+    // ### `Tachometer.attached`
+    // Private flag telling whether `Begin()` attached the pin interrupt (rather than leaving it to another handler).
+    bool attached = false;
+
+    // Written by the interrupt handler only
+    LockFreeRing<uint32_t, TACHOMETER_QUEUE_SIZE> queue;    // Edge times, in cycles.
+    volatile uint32_t last_accepted = 0;                    // Time of the last queued edge, in cycles.
+    volatile bool accepted_any = false;
+    volatile uint32_t dropped = 0;                          // Edges the queue had no room for.
+    volatile uint32_t rejected = 0;                         // Edges taken as bounce.
+
+    // Owned by `Read()`
+    uint32_t edges[TACHOMETER_MAX_WINDOW + 1];              // Ring of the last `count` edge times, in cycles.
+    size_t newest = 0;                                      // Index of the last edge in `edges`.
+    size_t count = 0;
+    uint32_t dropped_counted = 0;                           // `dropped`/`rejected` already added to `Metrics`.
+    uint32_t rejected_counted = 0;
+
+    static size_t Clamp(size_t window) {
+        if (window < 1) {
+            return 1;
+        }
+        return window > TACHOMETER_MAX_WINDOW ? TACHOMETER_MAX_WINDOW : window;
+    }
+
+    // ### `Tachometer::EdgeTrampoline()`
+    // The pin's interrupt handler: timestamps the edge and calls `tachometer->OnEdge()`.
+    static void IRAM_ATTR EdgeTrampoline(void* tachometer) {
+        ((Tachometer*)tachometer)->OnEdge(ClockCycles());
+    }
+
+    // Returns the edge time `back` edges before the newest.
+    uint32_t Edge(size_t back) const {
+        return edges[(newest + TACHOMETER_MAX_WINDOW + 1 - back) % (TACHOMETER_MAX_WINDOW + 1)];
+    }
+
+    // Returns the mean speed over `n` edge-to-edge periods taking `span` cycles, in `1/128 RPM`.
+    uint32_t Speed(uint32_t n, uint32_t span) const {
+        constexpr uint64_t cycles_per_minute_128 = 60ull * 1000000 * CLOCK_CYCLES_PER_US * 128;
+        return (uint32_t)DivideRounded(cycles_per_minute_128 * n, (uint64_t)span * pulses_per_revolution);
+    }
+
+    // ### `Tachometer.Estimate()`
+    // Private function updating `rpm` and `acceleration` from the edges in the window, and emitting them.
+    void Estimate(uint32_t time) {
+        periods = count - 1 < window * pulses_per_revolution ? count - 1 : window * pulses_per_revolution;
+        uint32_t span = Edge(0) - Edge(periods);
+        rpm = Speed(periods, span) * (1.f / 128);
+        emitter.EmitEvent({EventType::TACHOMETER_RPM, rpm, EventTypeName(EventType::TACHOMETER_RPM), time});
+        if (periods < 2) {
+            return;
+        }
+        // Mean speeds over the first and last halves, and the time between their midpoints (× 2)
+        size_t half = periods / 2;
+        uint32_t first = Speed(half, Edge(periods - half) - Edge(periods));
+        uint32_t last = Speed(half, Edge(0) - Edge(half));
+        uint32_t midpoints = span + (Edge(half) - Edge(periods - half));
+        constexpr float rad_s2 = 2 * 3.14159265358979f / 60 / 128 * 2 * 1000000.f * CLOCK_CYCLES_PER_US;
+        acceleration = (float)((int32_t)last - (int32_t)first) * rad_s2 / midpoints;
+        emitter.EmitEvent({EventType::TACHOMETER_ACCELERATION, acceleration, EventTypeName(EventType::TACHOMETER_ACCELERATION), time});
+    }
+
+public:
+    // ### `Tachometer.rpm`
+    // The latest speed estimate, in `RPM` (`0` until two edges have been seen, and after a stall).
+    float rpm = 0;
+
+    // ### `Tachometer.acceleration`
+    // The latest angular acceleration estimate, in `rad/s²`.
+    float acceleration = 0;
+
+    // ### `Tachometer.periods`
+    // Number of edge-to-edge periods the latest estimates were made over (up to `window` × `pulses_per_revolution`,
+    // and at most `TACHOMETER_MAX_WINDOW`).
+    size_t periods = 0;
+
+    // ## Tachometer
+    // Class measuring the engine's speed from the rising edges of a switch, timestamped by a pin interrupt.
+    // ### Parameters
+    // - `e` - The global `EventEmitter` object.
+    // - `pin` - The GPIO pin of the switch (interrupt-capable, i.e. not GPIO16).
+    // - `window` (optional) - The number of revolutions estimates are made over (default `TACHOMETER_WINDOW`).
+    // - `pulses_per_revolution` (optional) - Rising edges per revolution (default `1`).
+    Tachometer(
+        EventEmitter& e,
+        int pin,
+        size_t window = TACHOMETER_WINDOW,
+        uint32_t pulses_per_revolution = 1,
+        const std::vector<EventType>& events = {},
+        std::function<void(const Event&)> handler = nullptr
+    ) : Sensor(e, events, handler),
+        pin(pin),
+        pulses_per_revolution(pulses_per_revolution < 1 ? 1 : pulses_per_revolution),
+        window(Clamp(window)) {
+            pinMode(pin, INPUT);
+    }
+
+    ~Tachometer() {
+        if (attached) {
+            detachInterrupt(digitalPinToInterrupt(pin));
+        }
+    }
+
+    // ### `Tachometer.Begin()`
+    // Attaches the pin interrupt, and begins polling for the edges it timestamps.
+    // The ESP8266 keeps one interrupt handler per pin, so if another one needs the pin's edges (e.g. a
+    // `SolenoidController`'s), pass `attach` as `false` and have that handler pass the rising edges on to `OnEdge()`.
+    // ### Parameters
+    // - `update_interval` - How long to wait between each polling, in milliseconds (events lag edges by up to this).
+    // - `attach` (optional) - Whether to attach the pin interrupt (default `true`).
+    void Begin(float update_interval, bool attach = true) {
+        attached = attach;
+        if (attached) {
+            attachInterruptArg(digitalPinToInterrupt(pin), &Tachometer::EdgeTrampoline, this, RISING);
+        }
+        Sensor::Begin(update_interval);
+    }
+
+    // ### `Tachometer.StopPolling()`
+    // Detaches the pin interrupt (if `Begin()` attached it) and stops polling.
+    void StopPolling() {
+        if (attached) {
+            detachInterrupt(digitalPinToInterrupt(pin));
+            attached = false;
+        }
+        Sensor::StopPolling();
+    }
+
+    // ### `Tachometer.OnEdge()`
+    // Timestamps one rising edge at `now`, in cycles (in interrupt context: no events, no `Metrics`, nothing in flash;
+    // the queue's `Push()` is inlined into it). Called by the tachometer's own pin interrupt, or by another handler on
+    // the pin (see `Begin()`).
+    void IRAM_ATTR OnEdge(uint32_t now) {
+        if (accepted_any && now - last_accepted < (uint32_t)TACHOMETER_MIN_PERIOD * CLOCK_CYCLES_PER_US) {
+            rejected = rejected + 1;
+            return;
+        }
+        last_accepted = now;
+        accepted_any = true;
+        if (!queue.Push(now)) {
+            dropped = dropped + 1;
+        }
+    }
+
+    // ### `Tachometer.SetWindow()`
+    // Changes the number of revolutions estimates are made over (clamped to `1`..`TACHOMETER_MAX_WINDOW`).
+    void SetWindow(size_t revolutions) {
+        window = Clamp(revolutions);
+    }
+
+    // ### `Tachometer.Read()`
+    // Takes the edges queued by the interrupt handler, and makes and emits the estimates for each.
+    // Event times are the edges' own, converted to `ClockMicros()` time.
+    void Read() override {
+        uint32_t now_cycles = ClockCycles();
+        uint32_t now = ClockMicros();
+        const uint32_t* edge;
+        while ((edge = queue.Peek()) != nullptr) {
+            uint32_t time = *edge;
+            queue.Pop();
+            if (count > 0 && time - Edge(0) >= (uint32_t)TACHOMETER_STALL_TIME * CLOCK_CYCLES_PER_US) {
+                count = 0;      // First edge after a stall
+            }
+            newest = (newest + 1) % (TACHOMETER_MAX_WINDOW + 1);
+            edges[newest] = time;
+            count += count <= TACHOMETER_MAX_WINDOW ? 1 : 0;
+            if (count >= 2) {
+                Estimate(now - (now_cycles - time) / CLOCK_CYCLES_PER_US);
+            }
+        }
+        if (count > 0 && now_cycles - Edge(0) >= (uint32_t)TACHOMETER_STALL_TIME * CLOCK_CYCLES_PER_US) {
+            count = 0;
+            periods = 0;
+            if (rpm != 0) {
+                rpm = 0;
+                acceleration = 0;
+                emitter.EmitEvent({EventType::TACHOMETER_RPM, rpm, EventTypeName(EventType::TACHOMETER_RPM), now});
+            }
+        }
+        if (dropped != dropped_counted || rejected != rejected_counted) {
+            uint32_t d = dropped, r = rejected;
+            Metrics::Increment(Counter::TACHOMETER_EDGES_DROPPED, d - dropped_counted);
+            Metrics::Increment(Counter::TACHOMETER_EDGES_REJECTED, r - rejected_counted);
+            dropped_counted = d;
+            rejected_counted = r;
+        }
+    }
+};
+
+
+
+#endif // TACHOMETER_HPP
\ No newline at end of file
@@ -0,0 +1,26 @@
+/****************************************************************
+*                                                               *
+*   Telemetry.h                                                 *
+*                                                               *
+*   Include file for:                                           *
+*     - Metrics.hpp                                             *
+*     - Protocol.hpp                                            *
+*     - LockFreeRing.hpp                                        *
+*     - SerialTelemetry.hpp                                     *
+*     - RunLogFormat.hpp                                        *
+*     - RunLog.hpp                                              *
+*     - RunLogReplay.hpp                                        *
+*                                                               *
+*****************************************************************/
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "Telemetry/Metrics.hpp"
+#include "Telemetry/Protocol.hpp"
+#include "Telemetry/LockFreeRing.hpp"
+#include "Telemetry/SerialTelemetry.hpp"
+#include "Telemetry/RunLogFormat.hpp"
+#include "Telemetry/RunLog.hpp"
+#include "Telemetry/RunLogReplay.hpp"
+
+#endif // TELEMETRY_H
\ No newline at end of file
@@ -0,0 +1,73 @@
+/****************************************************************
+*                                                               *
+*   LockFreeRing.hpp                                            *
+*                                                               *
+*   Single-producer/single-consumer lock-free queue.            *
+*                                                               *
+*****************************************************************/
+#ifndef LOCK_FREE_RING_HPP
+#define LOCK_FREE_RING_HPP
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+// ## LockFreeRing
+// A fixed-capacity, single-producer/single-consumer queue that never blocks and never allocates.
+// The producer (e.g. a sensor `Ticker` callback) and the consumer (e.g. `loop()`) each own one index,
+// so neither ever waits for the other: a full queue makes `Push()` fail instead of blocking.
+// ### Parameters
+// - `T` - The element type.
+// - `N` - The capacity (must be a power of two).
+template <typename T, size_t N>
+class LockFreeRing {
+    static_assert((N & (N - 1)) == 0, "LockFreeRing capacity must be a power of two");
+
+private:
+    T items[N];
+    std::atomic<uint32_t> head{0};      // Next slot to write (owned by the producer).
+    std::atomic<uint32_t> tail{0};      // Next slot to read (owned by the consumer).
+
+public:
+    // ### `LockFreeRing.Push()`
+    // Appends an element. Returns `false` (and drops the element) if the queue is full.
+    // Always inlined, so an interrupt handler in IRAM can push (e.g. `Tachometer.OnEdge()`) without calling into
+    // flash: the indexes are plain 32-bit loads and stores (the orderings only add barriers), and `N` is a power of two.
+    __attribute__((always_inline)) inline bool Push(const T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= N) {
+            return false;
+        }
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // ### `LockFreeRing.Peek()`
+    // Returns a pointer to the oldest element without removing it, or `nullptr` if the queue is empty.
+    const T* Peek() const {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &items[t & (N - 1)];
+    }
+
+    // ### `LockFreeRing.Pop()`
+    // Removes the oldest element (the one returned by `Peek()`).
+    void Pop() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // ### `LockFreeRing.Size()`
+    // Returns the number of elements currently queued.
+    size_t Size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+};
+
+
+
+#endif // LOCK_FREE_RING_HPP
\ No newline at end of file
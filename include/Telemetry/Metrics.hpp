@@ -0,0 +1,252 @@
+/****************************************************************
+*                                                               *
+*   Metrics.hpp                                                 *
+*                                                               *
+*   Registry of runtime counters/gauges (Prometheus format).    *
+*                                                               *
+*****************************************************************/
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <stdint.h>
+#include <Arduino.h>
+#include "Events/Event.hpp"
+
+// ### `METRICS_STORAGE`
+// Storage class of the values kept by `Metrics`: process-wide by default. The host build defines it as
+// `thread_local`, so that simulated sessions running in parallel (one per thread) each count their own.
+#ifndef METRICS_STORAGE
+#define METRICS_STORAGE
+#endif
+
+
+
+// ## Counter
+// Monotonically increasing runtime counters kept by `Metrics`.
+// ### Defined counters:
+// - `TICKER_CALLBACKS` - Number of sensor `Ticker` callbacks run.
+// - `SSE_FRAMES_SENT` - Number of data frames pushed to `/events`.
+// - `SSE_FRAMES_DROPPED` - Number of data frames skipped because the `/events` clients were backlogged.
+// - `I2C_ERRORS` - Number of failed I2C transactions with the INA219.
+// - `LOOP_ITERATIONS` - Number of `loop()` iterations.
+// - `TELEMETRY_PACKETS_SENT` - Number of packets written by the serial telemetry sink.
+// - `TELEMETRY_PACKETS_DROPPED` - Number of packets dropped because the serial telemetry queue was full.
+// - `RUN_LOG_BYTES_WRITTEN` - Number of bytes of run log records written to flash.
+// - `RUN_LOG_RECORDS_DROPPED` - Number of run log records dropped because both write buffers were full.
+// - `TACHOMETER_EDGES_DROPPED` - Number of tachometer edges dropped because its queue was full.
+// - `TACHOMETER_EDGES_REJECTED` - Number of tachometer edges rejected as contact bounce.
+// - `COIL_PULSES` - Number of coil pulses completed by the solenoid controller.
+// - `COIL_PULSES_LATE` - Number of coil pulses fired by a switch edge that came before their scheduled time.
+enum class Counter {
+    TICKER_CALLBACKS,
+    SSE_FRAMES_SENT,
+    SSE_FRAMES_DROPPED,
+    I2C_ERRORS,
+    LOOP_ITERATIONS,
+    TELEMETRY_PACKETS_SENT,
+    TELEMETRY_PACKETS_DROPPED,
+    RUN_LOG_BYTES_WRITTEN,
+    RUN_LOG_RECORDS_DROPPED,
+    TACHOMETER_EDGES_DROPPED,
+    TACHOMETER_EDGES_REJECTED,
+    COIL_PULSES,
+    COIL_PULSES_LATE,
+    COUNTER_COUNT,          // Number of counters (not a counter; must remain last).
+};
+
+
+
+// ## Gauge
+// Point-in-time runtime values kept by `Metrics`.
+// ### Defined gauges:
+// - `FREE_HEAP` - Free heap, in bytes.
+// - `MAX_FREE_BLOCK` - Largest contiguous free heap block, in bytes.
+// - `SSE_CLIENTS` - Number of clients connected to `/events`.
+// - `LOOP_RATE` - `loop()` iterations per second, over the last second.
+// - `COIL_LATENCY` - Mean delay of the solenoid controller's coil turn-ons behind their target times, over its last update, in `ns`.
+// - `COIL_LATENCY_MAX` - Longest such delay over its last update, in `ns`.
+enum class Gauge {
+    FREE_HEAP,
+    MAX_FREE_BLOCK,
+    SSE_CLIENTS,
+    LOOP_RATE,
+    COIL_LATENCY,
+    COIL_LATENCY_MAX,
+    GAUGE_COUNT,            // Number of gauges (not a gauge; must remain last).
+};
+
+
+
+// ## Metrics
+// Fixed-size registry of runtime counters and gauges, rendered on request in the Prometheus text exposition format.
+// All storage is static (see `METRICS_STORAGE`) and allocated up front; updating a value is a single relaxed atomic operation,
+// so it is cheap enough to do on every hot path (event emission, sensor polling, I2C reads, SSE pushes).
+// ```c++
+// Metrics::Increment(Counter::I2C_ERRORS);
+// Metrics::Set(Gauge::FREE_HEAP, ESP.getFreeHeap());
+// Metrics::Render(response);   // Any `Print`, e.g. an `AsyncResponseStream`
+// ```
+class Metrics {
+private:
+    static constexpr size_t counter_count = (size_t)Counter::COUNTER_COUNT;
+    static constexpr size_t gauge_count = (size_t)Gauge::GAUGE_COUNT;
+    static constexpr size_t event_type_count = (size_t)EventType::EVENT_TYPE_COUNT;
+
+    static inline METRICS_STORAGE std::atomic<uint32_t> counters[counter_count] = {};
+    static inline METRICS_STORAGE std::atomic<uint32_t> gauges[gauge_count] = {};
+    static inline METRICS_STORAGE std::atomic<uint32_t> events[event_type_count] = {};
+
+    // Loop-rate bookkeeping, only touched from `loop()` (via `UpdateLoopRate()`).
+    static inline METRICS_STORAGE uint32_t rate_window_start = 0;
+    static inline METRICS_STORAGE uint32_t rate_window_iterations = 0;
+
+    // Prometheus metric name and help text of each counter/gauge.
+    static const char* CounterName(size_t i) {
+        static const char* const names[counter_count] = {
+            "solenoid_ticker_callbacks_total",
+            "solenoid_sse_frames_sent_total",
+            "solenoid_sse_frames_dropped_total",
+            "solenoid_i2c_errors_total",
+            "solenoid_loop_iterations_total",
+            "solenoid_telemetry_packets_sent_total",
+            "solenoid_telemetry_packets_dropped_total",
+            "solenoid_run_log_bytes_written_total",
+            "solenoid_run_log_records_dropped_total",
+            "solenoid_tachometer_edges_dropped_total",
+            "solenoid_tachometer_edges_rejected_total",
+            "solenoid_coil_pulses_total",
+            "solenoid_coil_pulses_late_total",
+        };
+        return names[i];
+    }
+    static const char* CounterHelp(size_t i) {
+        static const char* const help[counter_count] = {
+            "Sensor Ticker callbacks run.",
+            "Data frames pushed to /events.",
+            "Data frames skipped because /events clients were backlogged.",
+            "Failed I2C transactions with the INA219.",
+            "loop() iterations.",
+            "Packets written by the serial telemetry sink.",
+            "Packets dropped because the serial telemetry queue was full.",
+            "Run log bytes written to flash.",
+            "Run log records dropped because both write buffers were full.",
+            "Tachometer edges dropped because its queue was full.",
+            "Tachometer edges rejected as contact bounce.",
+            "Coil pulses completed by the solenoid controller.",
+            "Coil pulses fired by a switch edge that came before their scheduled time.",
+        };
+        return help[i];
+    }
+    static const char* GaugeName(size_t i) {
+        static const char* const names[gauge_count] = {
+            "solenoid_free_heap_bytes",
+            "solenoid_max_free_block_bytes",
+            "solenoid_sse_clients",
+            "solenoid_loop_rate_hz",
+            "solenoid_coil_latency_ns",
+            "solenoid_coil_latency_max_ns",
+        };
+        return names[i];
+    }
+    static const char* GaugeHelp(size_t i) {
+        static const char* const help[gauge_count] = {
+            "Free heap.",
+            "Largest contiguous free heap block.",
+            "Clients connected to /events.",
+            "loop() iterations per second over the last second.",
+            "Mean delay of coil turn-ons behind their target times, over the last controller update.",
+            "Longest delay of coil turn-ons behind their target times, over the last controller update.",
+        };
+        return help[i];
+    }
+
+public:
+    // ### `Metrics.Increment()`
+    // Adds `amount` (default `1`) to a counter.
+    static void Increment(Counter counter, uint32_t amount = 1) {
+        counters[(size_t)counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    // ### `Metrics.Increment()`
+    // Counts one emitted event of the given type.
+    static void Increment(EventType type) {
+        events[(size_t)type].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // ### `Metrics.Set()`
+    // Sets a gauge's current value.
+    static void Set(Gauge gauge, uint32_t value) {
+        gauges[(size_t)gauge].store(value, std::memory_order_relaxed);
+    }
+
+    // ### `Metrics.Get()`
+    // Returns a counter's/gauge's current value, or the number of emitted events of a type.
+    static uint32_t Get(Counter counter) {
+        return counters[(size_t)counter].load(std::memory_order_relaxed);
+    }
+    static uint32_t Get(Gauge gauge) {
+        return gauges[(size_t)gauge].load(std::memory_order_relaxed);
+    }
+    static uint32_t Get(EventType type) {
+        return events[(size_t)type].load(std::memory_order_relaxed);
+    }
+
+    // ### `Metrics.Reset()`
+    // Sets all counters, gauges and event counts back to zero (e.g. before a simulated session on the host).
+    static void Reset() {
+        for (size_t i = 0; i < counter_count; i++) {
+            counters[i].store(0, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < gauge_count; i++) {
+            gauges[i].store(0, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < event_type_count; i++) {
+            events[i].store(0, std::memory_order_relaxed);
+        }
+        rate_window_start = 0;
+        rate_window_iterations = 0;
+    }
+
+    // ### `Metrics.UpdateLoopRate()`
+    // Counts one `loop()` iteration and, once per second, updates the `LOOP_RATE` gauge.
+    // Meant to be called once at the top of `loop()`.
+    // ### Parameters
+    // - `now` - The current time (`millis()`), in `ms`.
+    static void UpdateLoopRate(uint32_t now) {
+        Increment(Counter::LOOP_ITERATIONS);
+        rate_window_iterations++;
+        uint32_t elapsed = now - rate_window_start;
+        if (elapsed >= 1000) {
+            Set(Gauge::LOOP_RATE, (uint32_t)(((uint64_t)rate_window_iterations * 1000) / elapsed));
+            rate_window_start = now;
+            rate_window_iterations = 0;
+        }
+    }
+
+    // ### `Metrics.Render()`
+    // Writes all counters, gauges and per-`EventType` event counts in the Prometheus text exposition format (version `0.0.4`).
+    // ### Parameters
+    // - `out` - Where to write the output (any Arduino `Print`, e.g. an `AsyncResponseStream` or `Serial`).
+    static void Render(Print& out) {
+        for (size_t i = 0; i < counter_count; i++) {
+            out.printf("# HELP %s %s\n# TYPE %s counter\n%s %lu\n",
+                CounterName(i), CounterHelp(i), CounterName(i), CounterName(i),
+                (unsigned long)counters[i].load(std::memory_order_relaxed));
+        }
+        for (size_t i = 0; i < gauge_count; i++) {
+            out.printf("# HELP %s %s\n# TYPE %s gauge\n%s %lu\n",
+                GaugeName(i), GaugeHelp(i), GaugeName(i), GaugeName(i),
+                (unsigned long)gauges[i].load(std::memory_order_relaxed));
+        }
+        out.print("# HELP solenoid_events_total Events emitted, by type.\n# TYPE solenoid_events_total counter\n");
+        for (size_t i = 0; i < event_type_count; i++) {
+            out.printf("solenoid_events_total{type=\"%s\"} %lu\n",
+                EventTypeName((EventType)i), (unsigned long)events[i].load(std::memory_order_relaxed));
+        }
+    }
+};
+
+
+
+#endif // METRICS_HPP
\ No newline at end of file
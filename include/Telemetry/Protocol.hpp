@@ -0,0 +1,221 @@
+/****************************************************************
+*                                                               *
+*   Protocol.hpp                                                *
+*                                                               *
+*   Binary telemetry packets, CRC-16 and COBS framing.          *
+*   Platform-independent (shared with the host decoder).        *
+*                                                               *
+*****************************************************************/
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+
+// ## PacketType
+// Types of telemetry packets.
+// ### Defined packet types:
+// - `SAMPLE` - One complete INA219 reading (`SamplePayload`).
+// - `EDGE` - A switch state change (`EdgePayload`).
+// - `BAND` - One band of the coil current's spectrum, at the end of a block (`BandPayload`).
+enum class PacketType : uint8_t {
+    SAMPLE = 1,
+    EDGE = 2,
+    BAND = 3,
+};
+
+
+
+// ## SamplePayload
+// Payload of a `PacketType::SAMPLE` packet (little-endian `float`s, see `Sample`).
+struct SamplePayload {
+    float voltage;
+    float current;
+    float power;
+    float resistance;
+    float temperature;
+};
+
+// ## EdgePayload
+// Payload of a `PacketType::EDGE` packet.
+// - `state` - The switch's new state (`0` / `1`).
+struct EdgePayload {
+    uint8_t state;
+};
+
+// ## BandPayload
+// Payload of a `PacketType::BAND` packet (see `SpectralBand`).
+// - `order` - The band's frequency, in multiples of the rotation frequency.
+// - `frequency` - Its frequency over the block, in `Hz` (`0` = not measured).
+// - `magnitude` / `baseline` - Amplitude of the current at that frequency, and what it usually is, in `A`.
+// - `band` - The band's index.
+// - `exceeded` - Whether the magnitude exceeds the baseline (`0` / `1`).
+// - `blocks` - Blocks the baseline has been learned from.
+struct BandPayload {
+    float order;
+    float frequency;
+    float magnitude;
+    float baseline;
+    uint8_t band;
+    uint8_t exceeded;
+    uint16_t blocks;
+};
+static_assert(sizeof(BandPayload) <= sizeof(SamplePayload), "PACKET_MAX_SIZE assumes SamplePayload is the largest payload");
+
+
+
+// ## Packet
+// A telemetry packet before framing.
+// On the wire (before COBS encoding) a packet is `type` (1 byte), `sequence` (2 bytes), `time` (4 bytes),
+// the payload (`PacketPayloadSize(type)` bytes) and a CRC-16 of all of the preceding bytes (2 bytes), all little-endian.
+// ### Defined properties:
+// - `type` (`PacketType`) - The packet type, which determines the payload.
+// - `sequence` (`uint16_t`) - Incremented for every packet produced (including dropped ones), so gaps reveal lost packets.
+// - `time` (`uint32_t`) - Timestamp of the sample/edge/block end (`micros()`), in `µs`.
+// - `sample` / `edge` / `band` - The payload.
+struct Packet {
+    PacketType type;
+    uint16_t sequence;
+    uint32_t time;
+    union {
+        SamplePayload sample;
+        EdgePayload edge;
+        BandPayload band;
+    };
+};
+
+// ### `PACKET_HEADER_SIZE`
+// Size of the `type`, `sequence` and `time` fields on the wire, in bytes.
+#define PACKET_HEADER_SIZE 7
+
+// ### `PACKET_MAX_SIZE`
+// Size of the largest unframed packet on the wire (header, largest payload and CRC), in bytes.
+#define PACKET_MAX_SIZE (PACKET_HEADER_SIZE + sizeof(SamplePayload) + 2)
+
+// ### `FRAME_MAX_SIZE`
+// Size of the largest COBS-encoded frame, including its `0x00` delimiter, in bytes.
+#define FRAME_MAX_SIZE (PACKET_MAX_SIZE + PACKET_MAX_SIZE / 254 + 2)
+
+
+
+// ### `PacketPayloadSize()`
+// Returns the size of the payload of a packet type on the wire, in bytes (`0` for unknown types).
+inline size_t PacketPayloadSize(PacketType type) {
+    switch (type) {
+        case PacketType::SAMPLE:    return sizeof(SamplePayload);
+        case PacketType::EDGE:      return sizeof(EdgePayload);
+        case PacketType::BAND:      return sizeof(BandPayload);
+        default:                    return 0;
+    }
+}
+
+// ### `Crc16()`
+// Computes the CRC-16/CCITT-FALSE (polynomial `0x1021`, initial value `0xFFFF`) of `length` bytes.
+inline uint16_t Crc16(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// ### `CobsEncode()`
+// COBS-encodes `length` bytes from `input` into `output` (which must hold `length + length / 254 + 1` bytes).
+// The result contains no `0x00` bytes, so `0x00` can delimit frames. Returns the encoded length.
+inline size_t CobsEncode(const uint8_t* input, size_t length, uint8_t* output) {
+    size_t code_index = 0;
+    size_t out = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (input[i] == 0) {
+            output[code_index] = code;
+            code_index = out++;
+            code = 1;
+            continue;
+        }
+        output[out++] = input[i];
+        if (++code == 0xFF) {
+            output[code_index] = code;
+            code_index = out++;
+            code = 1;
+        }
+    }
+    output[code_index] = code;
+    return out;
+}
+
+// ### `CobsDecode()`
+// Decodes a COBS-encoded frame (without its `0x00` delimiter) of `length` bytes into `output` (which must hold `length` bytes).
+// Returns the decoded length, or `0` if the frame is malformed.
+inline size_t CobsDecode(const uint8_t* input, size_t length, uint8_t* output) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < length) {
+        uint8_t code = input[in++];
+        if (code == 0 || in + code - 1 > length) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            output[out++] = input[in++];
+        }
+        if (code != 0xFF && in < length) {
+            output[out++] = 0;
+        }
+    }
+    return out;
+}
+
+// ### `EncodeFrame()`
+// Serializes, checksums and COBS-encodes a packet into `frame` (at least `FRAME_MAX_SIZE` bytes), including the trailing `0x00` delimiter.
+// Returns the frame length.
+inline size_t EncodeFrame(const Packet& packet, uint8_t* frame) {
+    uint8_t raw[PACKET_MAX_SIZE];
+    size_t payload_size = PacketPayloadSize(packet.type);
+    raw[0] = (uint8_t)packet.type;
+    memcpy(raw + 1, &packet.sequence, 2);
+    memcpy(raw + 3, &packet.time, 4);
+    memcpy(raw + PACKET_HEADER_SIZE, &packet.sample, payload_size);
+    uint16_t crc = Crc16(raw, PACKET_HEADER_SIZE + payload_size);
+    memcpy(raw + PACKET_HEADER_SIZE + payload_size, &crc, 2);
+    size_t length = CobsEncode(raw, PACKET_HEADER_SIZE + payload_size + 2, frame);
+    frame[length++] = 0;
+    return length;
+}
+
+// ### `DecodeFrame()`
+// Decodes a COBS-encoded frame (without its `0x00` delimiter) into `packet`.
+// Returns `false` if the frame is malformed, has an unknown type or wrong length, or fails its CRC check.
+inline bool DecodeFrame(const uint8_t* frame, size_t length, Packet& packet) {
+    uint8_t raw[FRAME_MAX_SIZE];
+    if (length > sizeof(raw)) {
+        return false;
+    }
+    size_t raw_length = CobsDecode(frame, length, raw);
+    if (raw_length < PACKET_HEADER_SIZE + 2) {
+        return false;
+    }
+    size_t payload_size = PacketPayloadSize((PacketType)raw[0]);
+    if (payload_size == 0 || raw_length != PACKET_HEADER_SIZE + payload_size + 2) {
+        return false;
+    }
+    uint16_t crc;
+    memcpy(&crc, raw + PACKET_HEADER_SIZE + payload_size, 2);
+    if (crc != Crc16(raw, PACKET_HEADER_SIZE + payload_size)) {
+        return false;
+    }
+    packet.type = (PacketType)raw[0];
+    memcpy(&packet.sequence, raw + 1, 2);
+    memcpy(&packet.time, raw + 3, 4);
+    memcpy(&packet.sample, raw + PACKET_HEADER_SIZE, payload_size);
+    return true;
+}
+
+
+
+#endif // PROTOCOL_HPP
\ No newline at end of file
@@ -0,0 +1,348 @@
+/****************************************************************
+*                                                               *
+*   RunLog.hpp                                                  *
+*                                                               *
+*   Append-only binary recorder of engine runs on flash.        *
+*                                                               *
+*****************************************************************/
+#ifndef RUN_LOG_HPP
+#define RUN_LOG_HPP
+
+#include <FS.h>
+#include <Arduino.h>
+#include "Metrics.hpp"
+#include "RunLogFormat.hpp"
+#include "Clock/Clock.hpp"
+#include "Events/Event.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Sensors/Sample.hpp"
+#include "Sensors/Responder.hpp"
+#include "Sensors/SampleListener.hpp"
+#include "WebServer/Data.hpp"
+
+// ### `RUN_LOG_DIRECTORY`
+// Directory holding the run log files (`<RUN_LOG_DIRECTORY>/00001.bin`, ...).
+#ifndef RUN_LOG_DIRECTORY
+#define RUN_LOG_DIRECTORY "/runs"
+#endif
+
+// ### `RUN_LOG_BLOCK_SIZE`
+// Size of each of the two RAM write buffers, in bytes. Half a flash sector (LittleFS programs whole 256-byte pages, so
+// a flush still writes whole pages), which holds about a second of strokes and edges; with `RUN_LOG_SAMPLES`, it
+// fills in ~0.1 s, so a build recording readings may want `4096` (one sector) or more.
+#ifndef RUN_LOG_BLOCK_SIZE
+#define RUN_LOG_BLOCK_SIZE 2048
+#endif
+
+// ### `RUN_LOG_SYNC_INTERVAL`
+// A `SYNC` record is written before every `RUN_LOG_SYNC_INTERVAL`-th record.
+#ifndef RUN_LOG_SYNC_INTERVAL
+#define RUN_LOG_SYNC_INTERVAL 256
+#endif
+
+// ### `RUN_LOG_MIN_FREE`
+// Free filesystem space, in bytes, below which the oldest finished run is deleted before writing.
+#ifndef RUN_LOG_MIN_FREE
+#define RUN_LOG_MIN_FREE (64 * 1024)
+#endif
+
+// ### `RUN_LOG_IDLE_FLUSH_MS`
+// A partly filled buffer is written out once no record has been added for this long (e.g. after the engine stops), in `ms`.
+#ifndef RUN_LOG_IDLE_FLUSH_MS
+#define RUN_LOG_IDLE_FLUSH_MS 2000
+#endif
+
+
+
+// ## RunLog
+// Records the engine's switch edges, per-stroke values and (optionally) raw INA219 readings to flash in the append-only
+// format described in `RunLogFormat.hpp`, one file per run.
+// Records are appended to one of two RAM buffers from the sensor callbacks; full buffers are written out from `loop()` by `Service()`,
+// so flash erase/program latency never delays the sensors' `Ticker`s. If both buffers are full, new records are dropped (and counted).
+// When free space runs low, the oldest finished runs are deleted.
+// ### Parameters
+// - `e` - The global `EventEmitter` object.
+// ```c++
+// RunLog run_log(event_emitter);
+// LittleFS.begin();
+// run_log.Begin(LittleFS, true);           // In setup()
+// ina219.AddSampleListener(&run_log);
+// run_log.Service();                       // In loop()
+// ```
+class RunLog : public Responder, public SampleListener {
+private:
+    static constexpr size_t block_records = RUN_LOG_BLOCK_SIZE / sizeof(RunLogRecord);
+
+    fs::FS* fs = nullptr;               // Filesystem holding the runs (`nullptr` until `Begin()`).
+    fs::File file;                      // The current run's file (closed when not recording).
+    uint32_t run = 0;                   // The current run's number.
+    bool log_samples = false;           // Whether raw INA219 readings are recorded.
+
+    RunLogRecord buffers[2][block_records];     // Double write buffer.
+    size_t fill[2] = {0, 0};                    // Records in each buffer.
+    volatile bool pending[2] = {false, false};  // Whether each buffer is waiting to be written by `Service()`.
+    uint8_t active = 0;                         // Buffer currently being appended to.
+
+    uint16_t sequence = 0;              // Sequence number of the next record.
+    uint32_t index = 0;                 // Index in the file of the next record.
+    uint32_t dropped = 0;               // Records dropped in this run.
+    uint32_t last_append = 0;           // Time of the last append (`ClockMillis()`), in `ms`.
+
+    // ### `RunLog.Path()`
+    // Writes the path of run `number` into `path`.
+    static void Path(uint32_t number, char* path, size_t length) {
+        snprintf(path, length, RUN_LOG_DIRECTORY "/%05lu.bin", (unsigned long)number);
+    }
+
+    // ### `RunLog.Swap()`
+    // Hands the active buffer to `Service()` and starts filling the other one.
+    // Returns `false` if the other buffer has not been written out yet.
+    bool Swap() {
+        uint8_t other = active ^ 1;
+        if (pending[other]) {
+            return false;
+        }
+        pending[active] = true;
+        active = other;
+        fill[active] = 0;
+        return true;
+    }
+
+    // ### `RunLog.AppendRecord()`
+    // Stamps and appends one record to the active buffer, swapping buffers when it is full.
+    void AppendRecord(RunLogRecord& record) {
+        if (fill[active] == block_records && !Swap()) {
+            dropped++;
+            Metrics::Increment(Counter::RUN_LOG_RECORDS_DROPPED);
+            return;
+        }
+        record.reserved = 0;
+        record.sequence = sequence++;
+        buffers[active][fill[active]++] = record;
+        index++;
+    }
+
+    // ### `RunLog.Append()`
+    // Appends a record (preceded by a `SYNC` record when one is due) if a run is being recorded.
+    void Append(RunLogRecord& record) {
+        if (!file) {
+            return;
+        }
+        if (index % RUN_LOG_SYNC_INTERVAL == 0) {
+            RunLogRecord sync;
+            memset(&sync, 0, sizeof(sync));
+            sync.type = RunLogRecordType::SYNC;
+            sync.time = record.time;
+            sync.sync.magic = RUN_LOG_SYNC_MAGIC;
+            sync.sync.index = index;
+            sync.sync.dropped = dropped;
+            AppendRecord(sync);
+        }
+        AppendRecord(record);
+        last_append = ClockMillis();
+    }
+
+    // ### `RunLog.DeleteOldestRun()`
+    // Deletes the lowest-numbered run other than the current one. Returns `false` if there is none.
+    bool DeleteOldestRun() {
+        uint32_t oldest = 0;
+        fs::Dir dir = fs->openDir(RUN_LOG_DIRECTORY);
+        while (dir.next()) {
+            uint32_t number = strtoul(dir.fileName().c_str(), nullptr, 10);
+            if (number != 0 && number != run && (oldest == 0 || number < oldest)) {
+                oldest = number;
+            }
+        }
+        if (oldest == 0) {
+            return false;
+        }
+        char path[32];
+        Path(oldest, path, sizeof(path));
+        return fs->remove(path);
+    }
+
+    // ### `RunLog.EnsureSpace()`
+    // Deletes old runs until at least `RUN_LOG_MIN_FREE` bytes are free. Returns `false` if that is not possible.
+    bool EnsureSpace() {
+        fs::FSInfo info;
+        while (fs->info(info) && info.totalBytes - info.usedBytes < RUN_LOG_MIN_FREE) {
+            if (!DeleteOldestRun()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // ### `RunLog.Write()`
+    // Writes out buffer `b` and marks it free again. Stops recording if the filesystem is full.
+    void Write(uint8_t b) {
+        if (file && EnsureSpace()) {
+            size_t length = fill[b] * sizeof(RunLogRecord);
+            size_t written = file.write((const uint8_t*)buffers[b], length);
+            file.flush();
+            Metrics::Increment(Counter::RUN_LOG_BYTES_WRITTEN, written);
+            if (written != length) {
+                file.close();
+            }
+        }
+        else if (file) {
+            file.close();
+        }
+        fill[b] = 0;
+        pending[b] = false;
+    }
+
+public:
+    // ## RunLog
+    // Records the engine's switch edges, per-stroke values and (optionally) raw INA219 readings to flash.
+    // ### Parameters
+    // - `e` - The global `EventEmitter` object.
+    RunLog(EventEmitter& e)
+        : Responder(e, {EventType::SWITCH1_STATE_CHANGE_TO_LOW, EventType::SWITCH1_STATE_CHANGE_TO_HIGH}) {
+        SetOnEvent([this](const Event& event) {
+            RunLogRecord record;
+            memset(&record, 0, sizeof(record));
+            record.type = RunLogRecordType::EDGE;
+            record.time = event.time;
+            record.edge.state = (uint8_t)event.value;
+            Append(record);
+        });
+    }
+
+    // ### `RunLog.Begin()`
+    // Starts recording a new run (numbered one past the highest existing run) on a mounted filesystem.
+    // Returns `false` if the run's file could not be created.
+    // ### Parameters
+    // - `filesystem` - The mounted filesystem to record to (e.g. `LittleFS`).
+    // - `samples` - Whether to also record every raw INA219 reading (requires adding this object with `INA219.AddSampleListener()`).
+    bool Begin(fs::FS& filesystem, bool samples) {
+        fs = &filesystem;
+        log_samples = samples;
+        fs->mkdir(RUN_LOG_DIRECTORY);
+
+        uint32_t highest = 0;
+        fs::Dir dir = fs->openDir(RUN_LOG_DIRECTORY);
+        while (dir.next()) {
+            uint32_t number = strtoul(dir.fileName().c_str(), nullptr, 10);
+            if (number > highest) {
+                highest = number;
+            }
+        }
+        return StartRun(highest + 1);
+    }
+
+    // ### `RunLog.StartRun()`
+    // Finishes the current run (if any) and starts recording run `number`.
+    // Returns `false` if the run's file could not be created.
+    bool StartRun(uint32_t number) {
+        End();
+        run = number;
+        sequence = 0;
+        index = 0;
+        dropped = 0;
+        if (!EnsureSpace()) {
+            return false;
+        }
+        char path[32];
+        Path(run, path, sizeof(path));
+        file = fs->open(path, "w");
+        if (!file) {
+            return false;
+        }
+        RunLogHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "SERL", 4);
+        header.version = RUN_LOG_VERSION;
+        header.record_size = sizeof(RunLogRecord);
+        header.run = run;
+        header.sync_interval = RUN_LOG_SYNC_INTERVAL;
+        header.flags = log_samples ? RUN_LOG_FLAG_SAMPLES : 0;
+        file.write((const uint8_t*)&header, sizeof(header));
+        return true;
+    }
+
+    // ### `RunLog.End()`
+    // Writes out everything buffered and closes the current run.
+    void End() {
+        if (!file) {
+            return;
+        }
+        for (uint8_t i = 0; i < 2; i++) {
+            uint8_t b = active ^ 1 ^ i;     // Older (pending) buffer first
+            if (pending[b] || (b == active && fill[b] > 0)) {
+                Write(b);
+            }
+        }
+        file.close();
+    }
+
+    // ### `RunLog.IsRecording()`
+    // Checks if a run is currently being recorded.
+    bool IsRecording() {
+        return (bool)file;
+    }
+
+    // ### `RunLog.GetRun()`
+    // Returns the number of the current (or last) run.
+    uint32_t GetRun() const {
+        return run;
+    }
+
+    // ### `RunLog.LogStroke()`
+    // Records the values computed at the end of a stroke.
+    // ### Parameters
+    // - `time` - Timestamp of the end of the stroke (`micros()`), in `µs`.
+    // - `data` - The values computed for the stroke.
+    void LogStroke(uint32_t time, const Data& data) {
+        RunLogRecord record;
+        record.type = RunLogRecordType::STROKE;
+        record.time = time;
+        record.stroke.speed = data.speed;
+        record.stroke.torque = data.torque;
+        record.stroke.voltage = data.voltage;
+        record.stroke.current = data.current;
+        record.stroke.powerin = data.powerin;
+        record.stroke.powerout = data.powerout;
+        record.stroke.efficiency = data.efficiency;
+        record.stroke.temperature = data.temperature;
+        Append(record);
+    }
+
+    // ### `RunLog.OnSample()`
+    // Records a raw INA219 reading (if enabled in `Begin()`). Called by the INA219 this recorder was added to.
+    void OnSample(const Sample& sample) override {
+        if (!log_samples) {
+            return;
+        }
+        RunLogRecord record;
+        memset(&record, 0, sizeof(record));
+        record.type = RunLogRecordType::SAMPLE;
+        record.time = sample.time;
+        record.sample.voltage = sample.voltage;
+        record.sample.current = sample.current;
+        record.sample.power = sample.power;
+        record.sample.resistance = sample.resistance;
+        record.sample.temperature = sample.temperature;
+        Append(record);
+    }
+
+    // ### `RunLog.Service()`
+    // Writes out any full buffer (and a partly filled one once recording has been idle for `RUN_LOG_IDLE_FLUSH_MS`).
+    // Meant to be called on every `loop()` iteration; this is the only place flash is written while recording.
+    void Service() {
+        if (!file) {
+            return;
+        }
+        if (!pending[active] && fill[active] > 0 && Clock::Elapsed(last_append, ClockMillis()) >= RUN_LOG_IDLE_FLUSH_MS) {
+            Swap();
+        }
+        uint8_t older = active ^ 1;
+        if (pending[older]) {
+            Write(older);
+        }
+    }
+};
+
+
+
+#endif // RUN_LOG_HPP
\ No newline at end of file
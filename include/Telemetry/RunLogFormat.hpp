@@ -0,0 +1,132 @@
+/****************************************************************
+*                                                               *
+*   RunLogFormat.hpp                                            *
+*                                                               *
+*   On-flash format of recorded engine runs.                    *
+*   Platform-independent (shared with host-side tools).         *
+*                                                               *
+*****************************************************************/
+#ifndef RUN_LOG_FORMAT_HPP
+#define RUN_LOG_FORMAT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+
+// ### `RUN_LOG_VERSION`
+// Version of the run log format, written in `RunLogHeader.version`.
+#define RUN_LOG_VERSION 1
+
+// ### `RUN_LOG_SYNC_MAGIC`
+// Value of `RunLogRecord.sync.magic` (`"SYNC"` in little-endian byte order).
+#define RUN_LOG_SYNC_MAGIC 0x434E5953u
+
+
+
+// ## RunLogHeader
+// Header at the start of every run log file, followed by `RunLogRecord`s (little-endian, `record_size` bytes each) until the end of the file.
+// ### Defined properties:
+// - `magic` (`char[4]`) - Always `"SERL"`.
+// - `version` (`uint16_t`) - The format version (`RUN_LOG_VERSION`).
+// - `record_size` (`uint16_t`) - Size of each record, in bytes (`sizeof(RunLogRecord)`).
+// - `run` (`uint32_t`) - The run's number (also its file name).
+// - `sync_interval` (`uint32_t`) - A `SYNC` record is written before every `sync_interval`-th record.
+// - `flags` (`uint32_t`) - `RUN_LOG_FLAG_*` bits describing what was recorded.
+struct RunLogHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t run;
+    uint32_t sync_interval;
+    uint32_t flags;
+    uint32_t reserved[3];
+};
+
+// ### `RUN_LOG_FLAG_SAMPLES`
+// `RunLogHeader.flags` bit set when raw INA219 readings (`SAMPLE` records) were recorded.
+#define RUN_LOG_FLAG_SAMPLES 0x1
+
+
+
+// ## RunLogRecordType
+// Types of run log records.
+// ### Defined record types:
+// - `SYNC` - Resynchronization marker (`sync`), written at fixed record intervals.
+// - `EDGE` - A switch state change (`edge`).
+// - `SAMPLE` - One complete INA219 reading (`sample`).
+// - `STROKE` - The values computed at the end of a stroke (`stroke`).
+enum class RunLogRecordType : uint8_t {
+    SYNC = 0,
+    EDGE = 1,
+    SAMPLE = 2,
+    STROKE = 3,
+};
+
+
+
+// ## RunLogRecord
+// A fixed-size (`40` byte) run log record. `time` is the `micros()` timestamp of the record's contents.
+// Every record gets the next `sequence` number (wrapping at `65536`), so readers can detect missing records.
+struct RunLogRecord {
+    RunLogRecordType type;
+    uint8_t reserved;
+    uint16_t sequence;
+    uint32_t time;
+    union {
+        // ### `RunLogRecord.sync`
+        // - `magic` - Always `RUN_LOG_SYNC_MAGIC`.
+        // - `index` - Index of this record in the file (`0` = first record after the header).
+        // - `dropped` - Records dropped so far in this run (because the write buffers were full).
+        struct {
+            uint32_t magic;
+            uint32_t index;
+            uint32_t dropped;
+        } sync;
+        // ### `RunLogRecord.edge`
+        // - `state` - The switch's new state (`0` / `1`).
+        struct {
+            uint8_t state;
+        } edge;
+        // ### `RunLogRecord.sample`
+        // Same fields as `Sample` (`V`, `A`, `W`, `Ω`, `°F`).
+        struct {
+            float voltage;
+            float current;
+            float power;
+            float resistance;
+            float temperature;
+        } sample;
+        // ### `RunLogRecord.stroke`
+        // Same fields as `Data`, except `elapsed` (which follows from `time`).
+        struct {
+            float speed;
+            float torque;
+            float voltage;
+            float current;
+            float powerin;
+            float powerout;
+            float efficiency;
+            float temperature;
+        } stroke;
+        uint8_t payload[32];
+    };
+};
+
+static_assert(sizeof(RunLogHeader) == 32, "RunLogHeader must be 32 bytes");
+static_assert(sizeof(RunLogRecord) == 40, "RunLogRecord must be 40 bytes");
+
+
+
+// ### `IsRunLogHeader()`
+// Checks that `header` is a run log header of a version and record size this code can read.
+inline bool IsRunLogHeader(const RunLogHeader& header) {
+    return memcmp(header.magic, "SERL", 4) == 0
+        && header.version == RUN_LOG_VERSION
+        && header.record_size == sizeof(RunLogRecord);
+}
+
+
+
+#endif // RUN_LOG_FORMAT_HPP
\ No newline at end of file
@@ -0,0 +1,120 @@
+/****************************************************************
+*                                                               *
+*   RunLogReplay.hpp                                            *
+*                                                               *
+*   Plays recorded runs back through the event pipeline.        *
+*                                                               *
+*****************************************************************/
+#ifndef RUN_LOG_REPLAY_HPP
+#define RUN_LOG_REPLAY_HPP
+
+#include <stdint.h>
+#include "RunLogFormat.hpp"
+#include "Events/Event.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Sensors/Sample.hpp"
+#include "Sensors/INA219.hpp"
+
+
+
+// ## RunLogReplay
+// Plays a recorded run (see `RunLogFormat.hpp`) back through the event pipeline in place of the hardware:
+// `EDGE` records are emitted through the `EventEmitter` as switch events stamped with their recorded `time`,
+// and `SAMPLE` records are fed to the INA219 with `AddSample()`, so every listener sees the run as it happened.
+// Records are applied as soon as they are given (nothing waits on the clock), so runs replay much faster than real time.
+// Reproducing stroke values requires a run recorded with samples (`RUN_LOG_FLAG_SAMPLES`) and no dropped records.
+// ### Parameters
+// - `e` - The `EventEmitter` to emit the recorded switch edges through.
+// - `sensor` - The INA219 to feed the recorded readings to (it should not be polling).
+// ```c++
+// RunLogReplay replay(event_emitter, ina219);
+// replay.Begin(header);
+// while (ReadRecord(record)) {
+//     replay.Play(record);
+// }
+// ```
+class RunLogReplay {
+private:
+    EventEmitter& emitter;
+    INA219& ina219;
+
+    bool started = false;               // Whether a record has been played since `Begin()`.
+    uint16_t expected = 0;              // Sequence number of the next record.
+    uint32_t last_time = 0;             // `time` of the last record played, in `µs`.
+
+public:
+    // ### `RunLogReplay.edges`
+    // Number of switch edges emitted since `Begin()`.
+    uint32_t edges = 0;
+
+    // ### `RunLogReplay.samples`
+    // Number of INA219 readings fed since `Begin()`.
+    uint32_t samples = 0;
+
+    // ### `RunLogReplay.missing`
+    // Number of records missing from the recording (gaps in the sequence numbers) since `Begin()`.
+    uint32_t missing = 0;
+
+    // ### `RunLogReplay.elapsed`
+    // Time from the first record played to the last, in `µs` (does not wrap with `micros()`).
+    uint64_t elapsed = 0;
+
+    // ## RunLogReplay
+    // Plays a recorded run back through the event pipeline in place of the hardware.
+    // ### Parameters
+    // - `e` - The `EventEmitter` to emit the recorded switch edges through.
+    // - `sensor` - The INA219 to feed the recorded readings to.
+    RunLogReplay(EventEmitter& e, INA219& sensor) : emitter(e), ina219(sensor) { }
+
+    // ### `RunLogReplay.Begin()`
+    // Starts replaying a run. Returns `false` if `header` is not a run log header this code can read.
+    // ### Parameters
+    // - `header` - The header read from the start of the run log file.
+    bool Begin(const RunLogHeader& header) {
+        started = false;
+        expected = 0;
+        last_time = 0;
+        edges = samples = missing = 0;
+        elapsed = 0;
+        return IsRunLogHeader(header);
+    }
+
+    // ### `RunLogReplay.Play()`
+    // Applies one record, in file order. `SYNC` and `STROKE` records only advance the replay's bookkeeping;
+    // the caller can compare the latter with what the pipeline computes.
+    // Returns the record's type.
+    // ### Parameters
+    // - `record` - The next record read from the run log file.
+    RunLogRecordType Play(const RunLogRecord& record) {
+        if (started) {
+            missing += (uint16_t)(record.sequence - expected);
+            elapsed += (uint32_t)(record.time - last_time);
+        }
+        started = true;
+        expected = record.sequence + 1;
+        last_time = record.time;
+
+        if (record.type == RunLogRecordType::EDGE) {
+            EventType type = record.edge.state ? EventType::SWITCH1_STATE_CHANGE_TO_HIGH : EventType::SWITCH1_STATE_CHANGE_TO_LOW;
+            Event event = {type, static_cast<float>(record.edge.state), EventTypeName(type), record.time};
+            emitter.EmitEvent(event);
+            edges++;
+        }
+        else if (record.type == RunLogRecordType::SAMPLE) {
+            Sample sample;
+            sample.time = record.time;
+            sample.voltage = record.sample.voltage;
+            sample.current = record.sample.current;
+            sample.power = record.sample.power;
+            sample.resistance = record.sample.resistance;
+            sample.temperature = record.sample.temperature;
+            ina219.AddSample(sample);
+            samples++;
+        }
+        return record.type;
+    }
+};
+
+
+
+#endif // RUN_LOG_REPLAY_HPP
\ No newline at end of file
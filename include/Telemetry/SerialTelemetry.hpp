@@ -0,0 +1,141 @@
+/****************************************************************
+*                                                               *
+*   SerialTelemetry.hpp                                         *
+*                                                               *
+*   Framed binary telemetry sink over a hardware serial port.   *
+*                                                               *
+*****************************************************************/
+#ifndef SERIAL_TELEMETRY_HPP
+#define SERIAL_TELEMETRY_HPP
+
+#include <Arduino.h>
+#include "Metrics.hpp"
+#include "Protocol.hpp"
+#include "LockFreeRing.hpp"
+#include "Events/Event.hpp"
+#include "Events/EventEmitter.hpp"
+#include "Sensors/Sample.hpp"
+#include "Sensors/Responder.hpp"
+#include "Sensors/SampleListener.hpp"
+#include "Engine/SpectralMonitor.hpp"
+
+// ### `SERIAL_TELEMETRY_BAUD`
+// Baud rate of the serial port while the telemetry sink is enabled (a full-rate INA219 stream needs ~160 kbaud).
+#ifndef SERIAL_TELEMETRY_BAUD
+#define SERIAL_TELEMETRY_BAUD 921600
+#endif
+
+// ### `SERIAL_TELEMETRY_QUEUE_SIZE`
+// Number of packets (`sizeof(Packet)` each, `28` bytes) the telemetry queue can hold between `Flush()` calls. Must be a
+// power of two.
+#ifndef SERIAL_TELEMETRY_QUEUE_SIZE
+#define SERIAL_TELEMETRY_QUEUE_SIZE 64
+#endif
+
+
+
+// ## SerialTelemetry
+// Streams every INA219 reading and switch edge (and, given them by `OnBand()`, the bands of a `SpectralMonitor`) over a
+// serial port as COBS-framed, CRC-checked binary packets (see `Protocol.hpp`).
+// Packets are produced from the sensors' callbacks into a `LockFreeRing` and written out from `loop()` by `Flush()`,
+// which only writes as much as the UART can take without blocking; if the queue is full, packets are dropped (and counted)
+// rather than delaying the sensors. The `sequence` field of each packet makes any loss visible to the host decoder.
+// ### Parameters
+// - `e` - The global `EventEmitter` object.
+// - `port` - The serial port to write to (e.g. `Serial`).
+// ```c++
+// SerialTelemetry telemetry(event_emitter, Serial);
+// telemetry.Begin();                       // In setup()
+// ina219.AddSampleListener(&telemetry);
+// spectral.SetOnBand([](const SpectralBand& band, size_t index) { telemetry.OnBand(band, index); });
+// telemetry.Flush();                       // In loop()
+// ```
+class SerialTelemetry : public Responder, public SampleListener {
+private:
+    // ### `SerialTelemetry.port`
+    // The serial port packets are written to.
+    HardwareSerial& port;
+
+    // ### `SerialTelemetry.queue`
+    // Packets produced but not yet written.
+    LockFreeRing<Packet, SERIAL_TELEMETRY_QUEUE_SIZE> queue;
+
+    // ### `SerialTelemetry.next_sequence`
+    // Sequence number of the next packet produced.
+    uint16_t next_sequence = 0;
+
+    // ### `SerialTelemetry.Enqueue()`
+    // Stamps a packet with the next sequence number and queues it, counting it as dropped if the queue is full.
+    void Enqueue(Packet& packet) {
+        packet.sequence = next_sequence++;
+        if (!queue.Push(packet)) {
+            Metrics::Increment(Counter::TELEMETRY_PACKETS_DROPPED);
+        }
+    }
+
+public:
+    // ## SerialTelemetry
+    // Streams every INA219 reading and switch edge over a serial port as COBS-framed, CRC-checked binary packets.
+    // ### Parameters
+    // - `e` - The global `EventEmitter` object.
+    // - `port` - The serial port to write to (e.g. `Serial`).
+    SerialTelemetry(EventEmitter& e, HardwareSerial& port)
+        : Responder(e, {EventType::SWITCH1_STATE_CHANGE_TO_LOW, EventType::SWITCH1_STATE_CHANGE_TO_HIGH}),
+          port(port) {
+        SetOnEvent([this](const Event& event) {
+            Packet packet;
+            packet.type = PacketType::EDGE;
+            packet.time = event.time;
+            packet.edge.state = (uint8_t)event.value;
+            Enqueue(packet);
+        });
+    }
+
+    // ### `SerialTelemetry.Begin()`
+    // Opens the serial port at the telemetry baud rate.
+    // ### Parameters
+    // - `baud` - The baud rate (optional, default = `SERIAL_TELEMETRY_BAUD`).
+    void Begin(unsigned long baud = SERIAL_TELEMETRY_BAUD) {
+        port.begin(baud);
+    }
+
+    // ### `SerialTelemetry.OnSample()`
+    // Queues a `PacketType::SAMPLE` packet for a reading. Called by the INA219 this sink was added to.
+    void OnSample(const Sample& sample) override {
+        Packet packet;
+        packet.type = PacketType::SAMPLE;
+        packet.time = sample.time;
+        packet.sample = {sample.voltage, sample.current, sample.power, sample.resistance, sample.temperature};
+        Enqueue(packet);
+    }
+
+    // ### `SerialTelemetry.OnBand()`
+    // Queues a `PacketType::BAND` packet for a band of a `SpectralMonitor` (from its `SetOnBand()` function).
+    void OnBand(const SpectralBand& band, size_t index) {
+        Packet packet;
+        packet.type = PacketType::BAND;
+        packet.time = band.time;
+        packet.band = {band.order, band.frequency, band.magnitude, band.baseline, (uint8_t)index, band.exceeded, band.blocks};
+        Enqueue(packet);
+    }
+
+    // ### `SerialTelemetry.Flush()`
+    // Writes queued packets to the serial port for as long as its transmit buffer has room for a whole frame.
+    // Never blocks; meant to be called on every `loop()` iteration.
+    void Flush() {
+        uint8_t frame[FRAME_MAX_SIZE];
+        while (const Packet* packet = queue.Peek()) {
+            size_t length = EncodeFrame(*packet, frame);
+            if ((size_t)port.availableForWrite() < length) {
+                break;
+            }
+            port.write(frame, length);
+            queue.Pop();
+            Metrics::Increment(Counter::TELEMETRY_PACKETS_SENT);
+        }
+    }
+};
+
+
+
+#endif // SERIAL_TELEMETRY_HPP
\ No newline at end of file
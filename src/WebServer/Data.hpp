@@ -8,8 +8,9 @@
 #ifndef DATA_HPP
 #define DATA_HPP
 
-#include <Arduino.h>
-#include <Arduino_JSON.h>
+#include <stdint.h>
+#include "Sensors/RingBuffer.hpp"
+#include "Sensors/AggregatedHistory.hpp"
 
 
 
@@ -101,6 +102,85 @@ typedef struct Data {
 
 
 
+// ### `STROKE_HISTORY_SIZE`
+// Number of raw per-stroke records kept in `WebServer.stroke_history` (`40` bytes each).
+#ifndef STROKE_HISTORY_SIZE
+#define STROKE_HISTORY_SIZE 64
+#endif
+
+// ### `STROKE_HISTORY_LEVEL1`
+// Aggregate level 1 of `WebServer.stroke_history`: strokes per bucket, and buckets kept (`108` bytes each).
+#ifndef STROKE_HISTORY_FACTOR1
+#define STROKE_HISTORY_FACTOR1 32
+#endif
+#ifndef STROKE_HISTORY_LEVEL1_SIZE
+#define STROKE_HISTORY_LEVEL1_SIZE 16
+#endif
+
+// ### `STROKE_HISTORY_LEVEL2`
+// Aggregate level 2 of `WebServer.stroke_history`: level-1 buckets per bucket, and buckets kept (`108` bytes each).
+// Off (`0` buckets) unless built with e.g. `-D STROKE_HISTORY_LEVEL2_SIZE=32`, which spans the last `1024 * 32` strokes
+// (30 minutes at ~1100 RPM) for `3.4 KB` of RAM; without it, `/history` reaches back 512 strokes (~30 seconds).
+#ifndef STROKE_HISTORY_FACTOR2
+#define STROKE_HISTORY_FACTOR2 32
+#endif
+#ifndef STROKE_HISTORY_LEVEL2_SIZE
+#define STROKE_HISTORY_LEVEL2_SIZE 0
+#endif
+
+// ## StrokeRecord
+// Struct pairing the `Data` computed at the end of a stroke with the time it was computed.
+// Its layout has no padding, so it is also the on-the-wire record of the packed binary history export.
+// ### Defined properties:
+// - `time` (`uint32_t`) - Timestamp of the end of the stroke (`micros()`), in `µs`.
+// - `data` (`Data`) - The values computed for the stroke.
+struct StrokeRecord {
+    uint32_t time;
+    Data data;
+};
+
+// ## RecordChannels<StrokeRecord>
+// Channels of a `StrokeRecord` summarized by downsampled history queries (every `Data` value except `elapsed`).
+template <>
+struct RecordChannels<StrokeRecord> {
+    static constexpr size_t count = 8;
+    typedef float Value;
+    typedef float Sum;
+    static const char* const* Names() {
+        static const char* const names[count] = {
+            "speed", "torque", "voltage", "current", "powerin", "powerout", "efficiency", "temperature"
+        };
+        return names;
+    }
+    static float Scale(size_t) {
+        return 1.f;
+    }
+    static uint32_t Time(const StrokeRecord& record) {
+        return record.time;
+    }
+    static void Extract(const StrokeRecord& record, float* values) {
+        values[0] = record.data.speed;
+        values[1] = record.data.torque;
+        values[2] = record.data.voltage;
+        values[3] = record.data.current;
+        values[4] = record.data.powerin;
+        values[5] = record.data.powerout;
+        values[6] = record.data.efficiency;
+        values[7] = record.data.temperature;
+    }
+};
+
+// ## StrokeHistory
+// The most recent per-stroke records, plus precomputed min/max/mean buckets over longer spans.
+typedef AggregatedHistory<
+    StrokeRecord,
+    STROKE_HISTORY_SIZE,
+    STROKE_HISTORY_FACTOR1, STROKE_HISTORY_LEVEL1_SIZE,
+    STROKE_HISTORY_FACTOR2, STROKE_HISTORY_LEVEL2_SIZE
+> StrokeHistory;
+
+
+
 
 // class Data {
 // private:
@@ -0,0 +1,203 @@
+/****************************************************************
+*                                                               *
+*   DownsampleStream.hpp                                        *
+*                                                               *
+*   Incremental JSON export of a downsampled history range.     *
+*                                                               *
+*****************************************************************/
+#ifndef DOWNSAMPLE_STREAM_HPP
+#define DOWNSAMPLE_STREAM_HPP
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include "Sensors/AggregatedHistory.hpp"
+#include "Serialize.hpp"
+
+
+
+// ### `DOWNSAMPLE_MAX_POINTS`
+// Upper limit on the `points` parameter of a downsampled history query.
+#define DOWNSAMPLE_MAX_POINTS 1000
+
+
+
+// ## DownsampleStream
+// Summarizes the `[from, to]` range (`ms` since boot) of an `AggregatedHistory` into at most `points` equal-width buckets,
+// each holding the min/max/mean of every channel, and generates the result as JSON a piece at a time (for a chunked HTTP response):
+// ```json
+// {"from":0,"to":60000,"points":2,"level":1,"channels":["voltage",...],
+//  "buckets":[{"t":0,"n":412,"min":[...],"max":[...],"mean":[...]},{"t":30000,...}]}
+// ```
+// The source level is chosen by `AggregatedHistory.SelectLevel()`, so the work done per query is bounded by the
+// (fixed) size of one level no matter how long the range is. Buckets with no records are omitted.
+// ### Parameters
+// - `T`, `H` - The record type and the `AggregatedHistory` type holding it.
+template <typename T, typename H>
+class DownsampleStream {
+private:
+    static constexpr size_t C = H::channels;
+    typedef typename H::Aggregate Aggregate;
+
+    const H* history;                   // The history being summarized.
+    uint32_t from;                      // Start of the queried range, in `ms`.
+    uint32_t range;                     // Length of the queried range (`to - from + 1`), in `ms`.
+    uint32_t points;                    // Number of output buckets the range is divided into.
+    size_t level;                       // Source level selected for the query.
+    uint32_t next;                      // Sequence number of the next entry to read at `level`.
+    size_t tail_level;                  // Next lower level whose partial bucket still has to be read (`0` = none).
+    bool header_written;                // Whether the JSON preamble has been generated.
+    bool first_bucket;                  // Whether no bucket has been generated yet (for comma placement).
+    bool finished;                      // Whether the closing brackets have been generated.
+    uint32_t current_index;             // Output bucket index of `current`.
+    Aggregate current;                  // Output bucket being accumulated.
+    char pending[64 + C * 48];          // Output generated but not yet copied out.
+    size_t pending_length;              // Number of bytes in `pending`.
+    size_t pending_offset;              // Number of bytes of `pending` already copied out.
+
+    // Appends formatted text to `pending`.
+    void Append(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(pending + pending_length, sizeof(pending) - pending_length, format, args);
+        va_end(args);
+        if (written > 0) {
+            pending_length += ((size_t)written < sizeof(pending) - pending_length) ? written : sizeof(pending) - pending_length - 1;
+        }
+    }
+
+    // Appends one array of per-channel statistics (`0` = min, `1` = max, `2` = mean) of `current`, in the channels'
+    // units.
+    void AppendStatistic(const char* name, int statistic) {
+        Append(",\"%s\":[", name);
+        for (size_t i = 0; i < C; i++) {
+            float value = (statistic == 0 ? (float)current.min[i]
+                        : statistic == 1 ? (float)current.max[i]
+                        : (float)current.sum[i] / current.count) * RecordChannels<T>::Scale(i);
+            Append(i == 0 ? "%s" : ",%s", SerializedNumber(value, "null").text);
+        }
+        Append("]");
+    }
+
+    // Generates the accumulated output bucket into `pending` and empties it.
+    void EmitCurrent() {
+        uint32_t start = from + (uint32_t)(((uint64_t)current_index * range) / points);
+        Append("%s{\"t\":%lu,\"n\":%lu", first_bucket ? "" : ",", (unsigned long)start, (unsigned long)current.count);
+        AppendStatistic("min", 0);
+        AppendStatistic("max", 1);
+        AppendStatistic("mean", 2);
+        Append("}");
+        first_bucket = false;
+        current.Clear();
+    }
+
+    // Reads the next entry of the selected level (or a lower level's partial bucket).
+    // Returns `false` once there are no entries left.
+    bool NextEntry(Aggregate& entry) {
+        if (next < history->Oldest(level)) {
+            next = history->Oldest(level);  // Skip entries overwritten since the query began
+        }
+        uint32_t last = history->Newest(level) + (level == 0 ? 0 : 1);
+        if (next < last) {
+            entry = history->Entry(level, next++);
+            return true;
+        }
+        if (tail_level > 0) {
+            entry = history->Partial(tail_level--);
+            return true;
+        }
+        return false;
+    }
+
+    // Generates the next piece of output into `pending`.
+    // Returns `false` once the whole document has been generated.
+    bool Generate() {
+        pending_offset = 0;
+        pending_length = 0;
+        if (!header_written) {
+            header_written = true;
+            Append("{\"from\":%lu,\"to\":%lu,\"points\":%lu,\"level\":%u,\"channels\":[",
+                (unsigned long)from, (unsigned long)(from + range - 1), (unsigned long)points, (unsigned)level);
+            const char* const* names = RecordChannels<T>::Names();
+            for (size_t i = 0; i < C; i++) {
+                Append(i == 0 ? "\"%s\"" : ",\"%s\"", names[i]);
+            }
+            Append("],\"buckets\":[");
+            return true;
+        }
+        if (finished) {
+            return false;
+        }
+        Aggregate entry;
+        while (NextEntry(entry)) {
+            if (entry.count == 0 || (int32_t)(entry.first - from) < 0 || (uint32_t)(entry.first - from) >= range) {
+                continue;   // Empty, or outside the queried range
+            }
+            uint32_t index = (uint32_t)(((uint64_t)(entry.first - from) * points) / range);
+            if (current.count > 0 && index != current_index) {
+                EmitCurrent();
+                current_index = index;
+                current.Merge(entry);
+                return true;
+            }
+            current_index = index;
+            current.Merge(entry);
+        }
+        if (current.count > 0) {
+            EmitCurrent();
+        }
+        Append("]}");
+        finished = true;
+        return true;
+    }
+
+public:
+    // ## DownsampleStream
+    // Summarizes the `[from, to]` range of an `AggregatedHistory` into at most `points` buckets, generated as JSON.
+    // ### Parameters
+    // - `history` - The history to summarize.
+    // - `from` - Start of the range, in `ms` since boot.
+    // - `to` - End of the range (inclusive), in `ms` since boot.
+    // - `points` - The maximum number of buckets to generate (clamped to `1`..`DOWNSAMPLE_MAX_POINTS`).
+    DownsampleStream(const H& history, uint32_t from, uint32_t to, uint32_t points)
+        : history(&history), from(from), header_written(false), first_bucket(true), finished(false),
+          current_index(0), pending_length(0), pending_offset(0) {
+        range = (to >= from) ? to - from + 1 : 1;
+        this->points = points < 1 ? 1 : (points > DOWNSAMPLE_MAX_POINTS ? DOWNSAMPLE_MAX_POINTS : points);
+        if (this->points > range) {
+            this->points = range;
+        }
+        level = history.SelectLevel(from, range / this->points);
+        next = history.Oldest(level);
+        tail_level = level > 0 ? level - 1 : 0;
+        current.Clear();
+    }
+
+    // ### `DownsampleStream.Fill()`
+    // Copies as much of the remaining output as fits into `buffer`.
+    // Returns the number of bytes written; `0` means the output is complete.
+    // ### Parameters
+    // - `buffer` - Destination buffer (provided by the chunked response).
+    // - `max_length` - Size of `buffer`, in bytes.
+    size_t Fill(uint8_t* buffer, size_t max_length) {
+        size_t filled = 0;
+        while (filled < max_length) {
+            if (pending_offset == pending_length && !Generate()) {
+                break;
+            }
+            size_t count = pending_length - pending_offset;
+            if (count > max_length - filled) {
+                count = max_length - filled;
+            }
+            memcpy(buffer + filled, pending + pending_offset, count);
+            pending_offset += count;
+            filled += count;
+        }
+        return filled;
+    }
+};
+
+
+
+#endif // DOWNSAMPLE_STREAM_HPP
\ No newline at end of file
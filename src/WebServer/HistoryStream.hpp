@@ -0,0 +1,161 @@
+/****************************************************************
+*                                                               *
+*   HistoryStream.hpp                                           *
+*                                                               *
+*   Incremental CSV/binary export of a `RingBuffer` history.    *
+*                                                               *
+*****************************************************************/
+#ifndef HISTORY_STREAM_HPP
+#define HISTORY_STREAM_HPP
+
+#include <string.h>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include "Data.hpp"
+#include "Serialize.hpp"
+#include "Sensors/Sample.hpp"
+#include "Sensors/RingBuffer.hpp"
+
+
+
+// ### `HISTORY_FORMAT_VERSION`
+// Version of the packed binary history export, written in `HistoryHeader.version`.
+#define HISTORY_FORMAT_VERSION 1
+
+
+
+// ## HistoryHeader
+// Header written once at the start of a packed binary history export, followed by `record_size`-byte records (little-endian, no padding).
+// ### Defined properties:
+// - `magic` (`char[4]`) - Always `"SEHX"`.
+// - `version` (`uint8_t`) - The export format version (`HISTORY_FORMAT_VERSION`).
+// - `record_type` (`uint8_t`) - `1` for `Sample` records, `2` for `StrokeRecord` records.
+// - `record_size` (`uint16_t`) - Size of each record that follows, in bytes.
+struct HistoryHeader {
+    char magic[4];
+    uint8_t version;
+    uint8_t record_type;
+    uint16_t record_size;
+};
+
+// ### `HistoryRecordType()`
+// Returns the `HistoryHeader.record_type` value for the record type of the pointer's target.
+inline uint8_t HistoryRecordType(const Sample*) { return 1; }
+inline uint8_t HistoryRecordType(const StrokeRecord*) { return 2; }
+
+// ### `ExportRecord()`
+// Returns a history record as exported: unchanged, except for an INA219 reading, kept in scaled integers
+// (`FixedSample`) and exported as the `Sample` it converts to.
+template <typename T>
+inline const T& ExportRecord(const T& record) { return record; }
+inline Sample ExportRecord(const FixedSample& fixed) { return fixed.ToSample(); }
+
+
+
+// ## HistoryStream
+// Generates an export of a `RingBuffer` a piece at a time, for use as the filler of a chunked HTTP response.
+// The range of records to export is fixed when the stream is created; records overwritten while the export is in progress are skipped.
+// At most one record's worth of output is buffered at once, so exporting the whole history never needs a response-sized allocation.
+// ### Parameters
+// - `history` - The ring buffer to export.
+// - `binary` - Whether to export packed binary records (`true`) or CSV rows (`false`).
+// ```c++
+// HistoryStream<FixedSample, SAMPLE_HISTORY_SIZE> stream(ina219.history.Records(), false);
+// request->send(request->beginChunkedResponse("text/csv",
+//     [stream](uint8_t* buffer, size_t max_length, size_t index) mutable {
+//         return stream.Fill(buffer, max_length);
+//     }));
+// ```
+template <typename T, size_t N>
+class HistoryStream {
+private:
+    typedef typename std::decay<decltype(ExportRecord(std::declval<const T&>()))>::type Exported;
+
+    const RingBuffer<T, N>* history;    // The ring buffer being exported.
+    uint32_t next;                      // Sequence number of the next record to export.
+    uint32_t end;                       // Sequence number one past the last record to export.
+    bool binary;                        // Packed binary (`true`) or CSV (`false`) export.
+    bool header_written;                // Whether the CSV header line / `HistoryHeader` has been generated.
+    char pending[SERIALIZED_DATA_MAX_LENGTH + 16];  // Output generated but not yet copied out.
+    size_t pending_length;              // Number of bytes in `pending`.
+    size_t pending_offset;              // Number of bytes of `pending` already copied out.
+
+    // Generates the next piece of output (header or one record) into `pending`.
+    // Returns `false` once there is nothing left to export.
+    bool Generate() {
+        pending_offset = 0;
+        pending_length = 0;
+        if (!header_written) {
+            header_written = true;
+            if (binary) {
+                HistoryHeader header = {
+                    {'S', 'E', 'H', 'X'},
+                    HISTORY_FORMAT_VERSION,
+                    HistoryRecordType((const Exported*)nullptr),
+                    (uint16_t)sizeof(Exported)
+                };
+                memcpy(pending, &header, sizeof(header));
+                pending_length = sizeof(header);
+            }
+            else {
+                const char* header = RecordCSVHeader((const Exported*)nullptr);
+                pending_length = strlen(header);
+                memcpy(pending, header, pending_length);
+            }
+            return true;
+        }
+        if (next < history->Oldest()) {
+            next = history->Oldest();   // Skip records overwritten since the export began
+        }
+        if (next >= end) {
+            return false;
+        }
+        const Exported& record = ExportRecord(history->At(next++));
+        if (binary) {
+            memcpy(pending, &record, sizeof(Exported));
+            pending_length = sizeof(Exported);
+        }
+        else {
+            pending_length = SerializeRecordCSV(record, pending, sizeof(pending));
+        }
+        return true;
+    }
+
+public:
+    // ## HistoryStream
+    // Generates an export of a `RingBuffer` a piece at a time, for use as the filler of a chunked HTTP response.
+    // ### Parameters
+    // - `history` - The ring buffer to export.
+    // - `binary` - Whether to export packed binary records (`true`) or CSV rows (`false`).
+    HistoryStream(const RingBuffer<T, N>& history, bool binary)
+        : history(&history), next(history.Oldest()), end(history.Newest()), binary(binary),
+          header_written(false), pending_length(0), pending_offset(0) { }
+
+    // ### `HistoryStream.Fill()`
+    // Copies as much of the remaining export as fits into `buffer`.
+    // Returns the number of bytes written; `0` means the export is complete.
+    // ### Parameters
+    // - `buffer` - Destination buffer (provided by the chunked response).
+    // - `max_length` - Size of `buffer`, in bytes.
+    size_t Fill(uint8_t* buffer, size_t max_length) {
+        size_t filled = 0;
+        while (filled < max_length) {
+            if (pending_offset == pending_length && !Generate()) {
+                break;
+            }
+            size_t count = pending_length - pending_offset;
+            if (count > max_length - filled) {
+                count = max_length - filled;
+            }
+            memcpy(buffer + filled, pending + pending_offset, count);
+            pending_offset += count;
+            filled += count;
+        }
+        return filled;
+    }
+};
+
+
+
+#endif // HISTORY_STREAM_HPP
\ No newline at end of file
@@ -8,8 +8,6 @@
 #ifndef INDEX_HTML_HPP
 #define INDEX_HTML_HPP
 
-#include <Arduino_JSON.h>
-
 
 
 const char index_html[] PROGMEM = R"rawliteral(
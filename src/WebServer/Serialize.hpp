@@ -0,0 +1,140 @@
+/****************************************************************
+*                                                               *
+*   Serialize.hpp                                               *
+*                                                               *
+*   Fixed-buffer JSON/CSV serialization of `Data` snapshots.    *
+*                                                               *
+*****************************************************************/
+#ifndef SERIALIZE_HPP
+#define SERIALIZE_HPP
+
+#include <stdio.h>
+#include <stddef.h>
+#include <math.h>
+#include "Data.hpp"
+#include "Sensors/Sample.hpp"
+
+
+
+// ### `SERIALIZED_DATA_MAX_LENGTH`
+// Size of a buffer large enough to hold any serialized `Data` object (JSON or CSV, including the terminating null).
+#define SERIALIZED_DATA_MAX_LENGTH 256
+
+// ### `DATA_CSV_HEADER`
+// Column header line written ahead of CSV-serialized `Data` rows.
+#define DATA_CSV_HEADER "speed,torque,voltage,current,powerin,powerout,efficiency,temperature,elapsed\n"
+
+// ### `SAMPLE_CSV_HEADER`
+// Column header line written ahead of CSV-serialized `Sample` rows.
+#define SAMPLE_CSV_HEADER "time,voltage,current,power,resistance,temperature\n"
+
+// ### `STROKE_CSV_HEADER`
+// Column header line written ahead of CSV-serialized `StrokeRecord` rows.
+#define STROKE_CSV_HEADER "time," DATA_CSV_HEADER
+
+
+
+// ## SerializedNumber
+// A `float` formatted with `%.7g`, or as `otherwise` if it isn't finite (`printf` would write `nan` or `inf`, which
+// aren't valid JSON): `"null"` in JSON, `""` (an empty field) in CSV. Meant to be passed straight to a `%s` conversion:
+// ```cpp
+// snprintf(buffer, length, "{\"efficiency\":%s}", SerializedNumber(data.efficiency, "null").text);
+// ```
+struct SerializedNumber {
+    char text[16];                      // Longest `%.7g` output is `-1.234567e-38` (13 characters).
+
+    SerializedNumber(float value, const char* otherwise) {
+        if (isfinite(value)) {
+            snprintf(text, sizeof(text), "%.7g", value);
+        } else {
+            snprintf(text, sizeof(text), "%s", otherwise);
+        }
+    }
+};
+
+
+
+// ### `SerializeDataJSON()`
+// Writes a `Data` object as a JSON object (same keys as the dashboard's `new_data` events) into `buffer`.
+// Returns the number of characters written (excluding the terminating null), or `0` if `buffer` is too small.
+// ### Parameters
+// - `data` - The `Data` object to serialize.
+// - `buffer` - Destination character buffer.
+// - `length` - Size of `buffer`, in bytes.
+inline size_t SerializeDataJSON(const Data& data, char* buffer, size_t length) {
+    int written = snprintf(
+        buffer, length,
+        "{\"speed\":%s,\"torque\":%s,\"voltage\":%s,\"current\":%s,\"powerin\":%s,"
+        "\"powerout\":%s,\"efficiency\":%s,\"temperature\":%s,\"elapsed\":%s}",
+        SerializedNumber(data.speed, "null").text, SerializedNumber(data.torque, "null").text,
+        SerializedNumber(data.voltage, "null").text, SerializedNumber(data.current, "null").text,
+        SerializedNumber(data.powerin, "null").text, SerializedNumber(data.powerout, "null").text,
+        SerializedNumber(data.efficiency, "null").text, SerializedNumber(data.temperature, "null").text,
+        SerializedNumber(data.elapsed, "null").text
+    );
+    if (written < 0 || (size_t)written >= length) {
+        return 0;
+    }
+    return (size_t)written;
+}
+
+// ### `SerializeDataCSV()`
+// Writes a `Data` object as a single CSV row (columns in `DATA_CSV_HEADER` order, newline-terminated) into `buffer`.
+// Returns the number of characters written (excluding the terminating null), or `0` if `buffer` is too small.
+// ### Parameters
+// - `data` - The `Data` object to serialize.
+// - `buffer` - Destination character buffer.
+// - `length` - Size of `buffer`, in bytes.
+inline size_t SerializeDataCSV(const Data& data, char* buffer, size_t length) {
+    int written = snprintf(
+        buffer, length,
+        "%s,%s,%s,%s,%s,%s,%s,%s,%s\n",
+        SerializedNumber(data.speed, "").text, SerializedNumber(data.torque, "").text,
+        SerializedNumber(data.voltage, "").text, SerializedNumber(data.current, "").text,
+        SerializedNumber(data.powerin, "").text, SerializedNumber(data.powerout, "").text,
+        SerializedNumber(data.efficiency, "").text, SerializedNumber(data.temperature, "").text,
+        SerializedNumber(data.elapsed, "").text
+    );
+    if (written < 0 || (size_t)written >= length) {
+        return 0;
+    }
+    return (size_t)written;
+}
+
+// ### `SerializeRecordCSV()`
+// Writes a `Sample` as a single CSV row (columns in `SAMPLE_CSV_HEADER` order, newline-terminated) into `buffer`.
+// Returns the number of characters written (excluding the terminating null), or `0` if `buffer` is too small.
+inline size_t SerializeRecordCSV(const Sample& sample, char* buffer, size_t length) {
+    int written = snprintf(
+        buffer, length,
+        "%lu,%s,%s,%s,%s,%s\n",
+        (unsigned long)sample.time, SerializedNumber(sample.voltage, "").text,
+        SerializedNumber(sample.current, "").text, SerializedNumber(sample.power, "").text,
+        SerializedNumber(sample.resistance, "").text, SerializedNumber(sample.temperature, "").text
+    );
+    if (written < 0 || (size_t)written >= length) {
+        return 0;
+    }
+    return (size_t)written;
+}
+
+// ### `SerializeRecordCSV()`
+// Writes a `StrokeRecord` as a single CSV row (columns in `STROKE_CSV_HEADER` order, newline-terminated) into `buffer`.
+// Returns the number of characters written (excluding the terminating null), or `0` if `buffer` is too small.
+inline size_t SerializeRecordCSV(const StrokeRecord& record, char* buffer, size_t length) {
+    int prefix = snprintf(buffer, length, "%lu,", (unsigned long)record.time);
+    if (prefix < 0 || (size_t)prefix >= length) {
+        return 0;
+    }
+    size_t row = SerializeDataCSV(record.data, buffer + prefix, length - prefix);
+    return row == 0 ? 0 : prefix + row;
+}
+
+// ### `RecordCSVHeader()`
+// Returns the CSV column header line for the record type of the pointer's target (`Sample` or `StrokeRecord`).
+inline const char* RecordCSVHeader(const Sample*) { return SAMPLE_CSV_HEADER; }
+inline const char* RecordCSVHeader(const StrokeRecord*) { return STROKE_CSV_HEADER; }
+
+
+
+#endif // SERIALIZE_HPP
\ No newline at end of file
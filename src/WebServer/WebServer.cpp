@@ -8,6 +8,8 @@
 #include "Data.hpp"
 #include "WebServer.h"
 #include "IndexHTML.hpp"
+#include "Telemetry/RunLog.hpp"
+#include "Clock/Clock.hpp"
 
 
 
@@ -24,6 +26,16 @@ WebServer::WebServer(int port, const char* ssid, const char* password)
     incoming_data.efficiency   = 0.0;
     incoming_data.temperature  = 0.0;
     incoming_data.elapsed      = 0.0;
+    sample_history = nullptr;
+    run_logs = nullptr;
+    crank_profile = nullptr;
+    spectral_monitor = nullptr;
+    burst_capture = nullptr;
+    timing_tuner = nullptr;
+    snapshot_version = 0;
+    pushed_version = 0;
+    boot_nonce = ESP.random();
+    snapshot_etag[0] = '\0';
 }
 
 
@@ -51,12 +63,48 @@ void WebServer::Start()
     server.on("/", HTTP_GET, [this](AsyncWebServerRequest* request) {
         this->OnRoot(request);
     });
+    server.on("/data", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        this->OnData(request, false);
+    });
+    server.on("/data.csv", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        this->OnData(request, true);
+    });
+    server.on("/history", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        this->OnHistory(request);
+    });
+    server.on("/metrics", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        this->OnMetrics(request);
+    });
+    server.on("/profile", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        this->OnProfile(request);
+    });
+    server.on("/spectrum", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        this->OnSpectrum(request);
+    });
+    server.on("/capture", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        this->OnCapture(request, false);
+    });
+    server.on("/capture", HTTP_POST, [this](AsyncWebServerRequest* request) {
+        this->OnCapture(request, true);
+    });
+    server.on("/timing", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        this->OnTiming(request);
+    });
+    if (run_logs != nullptr) {
+        // Registered before `/runs`, whose handler would otherwise also match `/runs/<name>`
+        server.serveStatic(RUN_LOG_DIRECTORY "/", *run_logs, RUN_LOG_DIRECTORY "/");
+        server.on(RUN_LOG_DIRECTORY, HTTP_GET, [this](AsyncWebServerRequest* request) {
+            this->OnRuns(request);
+        });
+    }
     events.onConnect([](AsyncEventSourceClient* client){
-        if (client->lastId()) {
+#ifndef SERIAL_TELEMETRY
+        if (client->lastId()) {     // Not with telemetry: it would corrupt the binary stream
             Serial.printf("Client reconnected! Last message ID that it got is: %u\n", client->lastId());
         }
+#endif
         // client->send("Hello!", NULL, millis(), 5000);
-        client->send("Hello!", NULL, millis());
+        client->send("Hello!", NULL, ClockMillis());
     });
     server.addHandler(&events);
 
@@ -73,63 +121,285 @@ void WebServer::Start()
 
 
 
-JSONVar WebServer::ToJSON(const Data* data)
+void WebServer::OnData(AsyncWebServerRequest* request, bool csv)
 {
-    JSONVar json_data;
+    RefreshSnapshot();
+
+    AsyncWebServerResponse* response;
+    if (request->hasHeader("If-None-Match")
+        && strstr(request->header("If-None-Match").c_str(), snapshot_etag) != nullptr) {
+        // Client already holds this version, so only the headers are sent
+        response = request->beginResponse(304);
+    }
+    else {
+        response = request->beginResponse(
+            200,
+            csv ? "text/csv" : "application/json",
+            csv ? snapshot_csv : snapshot_json
+        );
+    }
+    response->addHeader("ETag", snapshot_etag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
+
 
-    json_data["speed"] = (*data).speed;
-    json_data["torque"] = (*data).torque;
-    json_data["voltage"] = (*data).voltage;
-    json_data["current"] = (*data).current;
-    json_data["powerin"] = (*data).powerin;
-    json_data["powerout"] = (*data).powerout;
-    json_data["efficiency"] = (*data).efficiency;
-    json_data["temperature"] = (*data).temperature;
-    json_data["elapsed"] = (*data).elapsed;
 
-    return json_data;
+void WebServer::ServeSampleHistory(const SampleHistory& history)
+{
+    sample_history = &history;
 }
 
 
 
-void WebServer::UpdateWithStoredData()
+void WebServer::ServeRunLogs(fs::FS& filesystem)
+{
+    run_logs = &filesystem;
+}
+
+
+
+void WebServer::ServeCrankProfile(const CrankProfile& profile)
+{
+    crank_profile = &profile;
+}
+
+
+
+void WebServer::ServeSpectralMonitor(const SpectralMonitor& monitor)
+{
+    spectral_monitor = &monitor;
+}
+
+
+
+void WebServer::ServeBurstCapture(BurstCapture& capture)
+{
+    burst_capture = &capture;
+}
+
+
+
+void WebServer::ServeTimingTuner(const TimingTuner& tuner)
+{
+    timing_tuner = &tuner;
+}
+
+
+
+void WebServer::OnRuns(AsyncWebServerRequest* request)
+{
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->print("[");
+    bool first = true;
+    fs::Dir dir = run_logs->openDir(RUN_LOG_DIRECTORY);
+    while (dir.next()) {
+        response->printf("%s{\"name\":\"%s\",\"size\":%lu}",
+            first ? "" : ",", dir.fileName().c_str(), (unsigned long)dir.fileSize());
+        first = false;
+    }
+    response->print("]");
+    request->send(response);
+}
+
+
+
+void WebServer::OnHistory(AsyncWebServerRequest* request)
+{
+    bool strokes = request->hasParam("type") && request->getParam("type")->value() == "strokes";
+    bool binary = request->hasParam("format") && request->getParam("format")->value() == "bin";
+    const char* content_type = binary ? "application/octet-stream" : "text/csv";
+    bool downsample = request->hasParam("from") || request->hasParam("to") || request->hasParam("points");
+
+    if (!strokes && sample_history == nullptr) {
+        request->send(404, "text/plain", "No sample history");
+        return;
+    }
+
+    if (downsample) {
+        uint32_t newest = strokes ? stroke_history.NewestTime() : sample_history->NewestTime();
+        uint32_t from = request->hasParam("from") ? request->getParam("from")->value().toInt() : 0;
+        uint32_t to = request->hasParam("to") ? request->getParam("to")->value().toInt() : newest;
+        uint32_t points = request->hasParam("points") ? request->getParam("points")->value().toInt() : 100;
+        if (strokes) {
+            DownsampleStream<StrokeRecord, StrokeHistory> stream(stroke_history, from, to, points);
+            request->send(request->beginChunkedResponse("application/json",
+                [stream](uint8_t* buffer, size_t max_length, size_t index) mutable {
+                    return stream.Fill(buffer, max_length);
+                }));
+        }
+        else {
+            DownsampleStream<FixedSample, SampleHistory> stream(*sample_history, from, to, points);
+            request->send(request->beginChunkedResponse("application/json",
+                [stream](uint8_t* buffer, size_t max_length, size_t index) mutable {
+                    return stream.Fill(buffer, max_length);
+                }));
+        }
+    }
+    else if (strokes) {
+        HistoryStream<StrokeRecord, STROKE_HISTORY_SIZE> stream(stroke_history.Records(), binary);
+        request->send(request->beginChunkedResponse(content_type,
+            [stream](uint8_t* buffer, size_t max_length, size_t index) mutable {
+                return stream.Fill(buffer, max_length);
+            }));
+    }
+    else {
+        HistoryStream<FixedSample, SAMPLE_HISTORY_SIZE> stream(sample_history->Records(), binary);
+        request->send(request->beginChunkedResponse(content_type,
+            [stream](uint8_t* buffer, size_t max_length, size_t index) mutable {
+                return stream.Fill(buffer, max_length);
+            }));
+    }
+}
+
+
+
+void WebServer::OnMetrics(AsyncWebServerRequest* request)
+{
+    Metrics::Set(Gauge::FREE_HEAP, ESP.getFreeHeap());
+    Metrics::Set(Gauge::MAX_FREE_BLOCK, ESP.getMaxFreeBlockSize());
+    Metrics::Set(Gauge::SSE_CLIENTS, events.count());
+
+    AsyncResponseStream* response = request->beginResponseStream("text/plain; version=0.0.4");
+    Metrics::Render(*response);
+    request->send(response);
+}
+
+
+
+void WebServer::OnProfile(AsyncWebServerRequest* request)
+{
+    if (crank_profile == nullptr) {
+        request->send(404, "text/plain", "No crank profile");
+        return;
+    }
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->addHeader("Cache-Control", "no-cache");
+    crank_profile->Render(*response);
+    request->send(response);
+}
+
+
+
+void WebServer::OnSpectrum(AsyncWebServerRequest* request)
+{
+    if (spectral_monitor == nullptr) {
+        request->send(404, "text/plain", "No spectral monitor");
+        return;
+    }
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->addHeader("Cache-Control", "no-cache");
+    spectral_monitor->Render(*response);
+    request->send(response);
+}
+
+
+
+void WebServer::OnTiming(AsyncWebServerRequest* request)
+{
+    if (timing_tuner == nullptr) {
+        request->send(404, "text/plain", "No timing tuner");
+        return;
+    }
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->addHeader("Cache-Control", "no-cache");
+    timing_tuner->Render(*response);
+    request->send(response);
+}
+
+
+
+void WebServer::OnCapture(AsyncWebServerRequest* request, bool arm)
+{
+    if (burst_capture == nullptr) {
+        request->send(404, "text/plain", "No burst capture");
+        return;
+    }
+
+    if (!arm) {
+        if (burst_capture->State() != CaptureState::COMPLETE) {
+            request->send(404, "text/plain", CaptureStateName(burst_capture->State()));
+            return;
+        }
+        const BurstCapture* capture = burst_capture;
+        request->send(request->beginChunkedResponse("application/octet-stream",
+            [capture](uint8_t* buffer, size_t max_length, size_t index) {
+                return capture->Copy(index, buffer, max_length);
+            }));
+        return;
+    }
+
+    String name = request->hasParam("trigger") ? request->getParam("trigger")->value() : String("");
+    BurstTrigger trigger;
+    bool done;
+    if (name == "off") {
+        burst_capture->Disarm();
+        done = true;
+    }
+    else if (name == "force") {
+        done = burst_capture->Trigger();
+    }
+    else if (ParseBurstTrigger(name.c_str(), trigger)) {
+        float level = request->hasParam("level") ? request->getParam("level")->value().toFloat() : 0;
+        int32_t scaled = trigger == BurstTrigger::OVER_TEMPERATURE ? level * 100 : level * 1e6f;
+        size_t pre = request->hasParam("pre") ? request->getParam("pre")->value().toInt() : BURST_CAPTURE_PRE_TRIGGER;
+        done = burst_capture->Arm(trigger, scaled, pre);
+    }
+    else {
+        request->send(400, "text/plain", "Unknown trigger");
+        return;
+    }
+    request->send(done ? 200 : 409, "text/plain", CaptureStateName(burst_capture->State()));
+}
+
+
+
+void WebServer::PushSnapshot()
 {
-    JSONVar json_data;
+    if (events.count() > 0 && events.avgPacketsWaiting() >= SSE_MAX_WAITING) {
+        Metrics::Increment(Counter::SSE_FRAMES_DROPPED);
+        return;
+    }
+    events.send(snapshot_json, "new_data", ClockMillis());
+    pushed_version = snapshot_version;
+    Metrics::Increment(Counter::SSE_FRAMES_SENT);
+}
 
-    json_data["speed"] = incoming_data.speed;
-    json_data["torque"] = incoming_data.torque;
-    json_data["voltage"] = incoming_data.voltage;
-    json_data["current"] = incoming_data.current;
-    json_data["powerin"] = incoming_data.powerin;
-    json_data["powerout"] = incoming_data.powerout;
-    json_data["efficiency"] = incoming_data.efficiency;
-    json_data["temperature"] = incoming_data.temperature;
-    json_data["elapsed"] = incoming_data.elapsed;
 
-    String jsonString = JSON.stringify(json_data);
-    events.send(jsonString.c_str(), "new_data", millis());
+
+void WebServer::RefreshSnapshot()
+{
+    if (snapshot_version != 0 && memcmp(&snapshot_data, &incoming_data, sizeof(Data)) == 0) {
+        return;
+    }
+    memcpy(&snapshot_data, &incoming_data, sizeof(Data));
+    snapshot_version++;
+    snprintf(snapshot_etag, sizeof(snapshot_etag), "\"%08lx-%lu\"",
+             (unsigned long)boot_nonce, (unsigned long)snapshot_version);
+
+    SerializeDataJSON(snapshot_data, snapshot_json, sizeof(snapshot_json));
+    size_t header_length = sizeof(DATA_CSV_HEADER) - 1;
+    memcpy(snapshot_csv, DATA_CSV_HEADER, header_length);
+    SerializeDataCSV(snapshot_data, snapshot_csv + header_length, sizeof(snapshot_csv) - header_length);
+}
+
+
+
+void WebServer::UpdateWithStoredData()
+{
+    RefreshSnapshot();
+    PushSnapshot();
 }
 
 
 
 void WebServer::UpdateData(const Data* data)
 {
-    JSONVar json_data;
     const uint8_t* data_obj = (uint8_t*) data;
     memcpy(&incoming_data, data_obj, sizeof(incoming_data));
 
-    json_data["speed"] = incoming_data.speed;
-    json_data["torque"] = incoming_data.torque;
-    json_data["voltage"] = incoming_data.voltage;
-    json_data["current"] = incoming_data.current;
-    json_data["powerin"] = incoming_data.powerin;
-    json_data["powerout"] = incoming_data.powerout;
-    json_data["efficiency"] = incoming_data.efficiency;
-    json_data["temperature"] = incoming_data.temperature;
-    json_data["elapsed"] = incoming_data.elapsed;
-
-    String jsonString = JSON.stringify(json_data);
-    events.send(jsonString.c_str(), "new_data", millis());
+    RefreshSnapshot();
+    PushSnapshot();
 }
 
 
@@ -145,4 +415,14 @@ void WebServer::ScheduleUpdates(float update_interval)
 void WebServer::StopUpdates()
 {
     timer.detach();
+}
+
+
+
+void WebServer::PushChanges()
+{
+    RefreshSnapshot();
+    if (snapshot_version != pushed_version) {
+        PushSnapshot();
+    }
 }
\ No newline at end of file
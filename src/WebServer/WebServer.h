@@ -8,12 +8,27 @@
 #ifndef WEB_SERVER_H
 #define WEB_SERVER_H
 
+#include <FS.h>
 #include <Ticker.h>
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
-#include <Arduino_JSON.h>
 #include <ESPAsyncWebServer.h>
 #include "Data.hpp"
+#include "Serialize.hpp"
+#include "HistoryStream.hpp"
+#include "DownsampleStream.hpp"
+#include "Sensors/INA219.hpp"
+#include "Sensors/BurstCapture.hpp"
+#include "Engine/CrankProfile.hpp"
+#include "Engine/SpectralMonitor.hpp"
+#include "Controllers/TimingTuner.hpp"
+#include "Telemetry/Metrics.hpp"
+
+// ### `SSE_MAX_WAITING`
+// Average number of messages queued per `/events` client above which new data frames are dropped instead of queued.
+#ifndef SSE_MAX_WAITING
+#define SSE_MAX_WAITING 8
+#endif
 
 
 
@@ -55,6 +70,61 @@ private:
     // Protected `Ticker` object that the webserver can bind its `UpdateData` method to, to enable continous/scheduled updating.
     Ticker timer;
 
+    // ### `WebServer.snapshot_data`
+    // Copy of the `Data` object that the cached snapshot bodies were last serialized from.
+    // Compared against `WebServer.incoming_data` to detect when the cache is stale.
+    Data snapshot_data;
+
+    // ### `WebServer.snapshot_version`
+    // Incremented each time `WebServer.incoming_data` changes and the snapshot cache is re-serialized (`0` = never serialized).
+    uint32_t snapshot_version;
+
+    // ### `WebServer.pushed_version`
+    // `WebServer.snapshot_version` last pushed to `/events` (`0` = none yet), for `WebServer.PushChanges()`.
+    uint32_t pushed_version;
+
+    // ### `WebServer.boot_nonce`
+    // Random number drawn at construction and prefixed to every `ETag`, so that a version number from before a reboot
+    // (which restarts `WebServer.snapshot_version` at `1`) can't match a different snapshot with the same number.
+    uint32_t boot_nonce;
+
+    // ### `WebServer.snapshot_etag`
+    // Quoted entity tag (e.g. `"5f3a09c2-42"`, quotes included) identifying `WebServer.snapshot_version` of this boot
+    // (`WebServer.boot_nonce`), sent in the `ETag` header.
+    char snapshot_etag[24];
+
+    // ### `WebServer.snapshot_json`
+    // Cached JSON serialization of `WebServer.snapshot_data`, served by `/data` and pushed to `/events`.
+    char snapshot_json[SERIALIZED_DATA_MAX_LENGTH];
+
+    // ### `WebServer.snapshot_csv`
+    // Cached CSV serialization (header + one row) of `WebServer.snapshot_data`, served by `/data.csv`.
+    char snapshot_csv[sizeof(DATA_CSV_HEADER) + SERIALIZED_DATA_MAX_LENGTH];
+
+    // ### `WebServer.sample_history`
+    // Pointer to the INA219's sample history exported by `/history`, set via `WebServer.ServeSampleHistory()` (`nullptr` if not set).
+    const SampleHistory* sample_history;
+
+    // ### `WebServer.run_logs`
+    // Pointer to the filesystem holding recorded runs, set via `WebServer.ServeRunLogs()` (`nullptr` if not set).
+    fs::FS* run_logs;
+
+    // ### `WebServer.crank_profile`
+    // Pointer to the current-vs-crank-angle profile served by `/profile`, set via `WebServer.ServeCrankProfile()` (`nullptr` if not set).
+    const CrankProfile* crank_profile;
+
+    // ### `WebServer.spectral_monitor`
+    // Pointer to the coil current's spectral monitor served by `/spectrum`, set via `WebServer.ServeSpectralMonitor()` (`nullptr` if not set).
+    const SpectralMonitor* spectral_monitor;
+
+    // ### `WebServer.burst_capture`
+    // Pointer to the burst capture armed and exported through `/capture`, set via `WebServer.ServeBurstCapture()` (`nullptr` if not set).
+    BurstCapture* burst_capture;
+
+    // ### `WebServer.timing_tuner`
+    // Pointer to the coil timing tuner whose table is served by `/timing`, set via `WebServer.ServeTimingTuner()` (`nullptr` if not set).
+    const TimingTuner* timing_tuner;
+
     // ### `WebServer.OnRoot()`
     // Private function defining what happens when a client visits the root ("/") of the dashboard.
     // This isn't ever called manually (called in `WebServer.Start()`), and simply serves the `index_html` page defined in `IndexHTML.hpp`.
@@ -62,11 +132,86 @@ private:
     // - `request` - A pointer to an `AsyncWebServerRequest` object.
     void OnRoot(AsyncWebServerRequest* request);
 
-    // ### `WebServer.ToJSON()`
-    // Private function that converts the contents of a `Data` object to a JSON variable.
+    // ### `WebServer.OnData()`
+    // Private function defining what happens when a client requests `/data` or `/data.csv`.
+    // Serves the cached snapshot of `WebServer.incoming_data`, or an empty `304` if the client's `If-None-Match` matches the current `ETag`.
     // ### Parameters
-    // - `data` - A pointer to a `Data` object containing the data to convert.
-    JSONVar ToJSON(const Data* data);
+    // - `request` - A pointer to an `AsyncWebServerRequest` object.
+    // - `csv` - Whether to serve the CSV (`true`) or JSON (`false`) serialization.
+    void OnData(AsyncWebServerRequest* request, bool csv);
+
+    // ### `WebServer.OnHistory()`
+    // Private function defining what happens when a client requests `/history`.
+    // Streams the buffered history as a chunked response, generated record by record from the ring buffer.
+    // Query parameters:
+    // - `type` - `samples` (default, raw INA219 readings) or `strokes` (per-stroke records).
+    // - `format` - `csv` (default) or `bin` (a `HistoryHeader` followed by packed records).
+    // 
+    // If any of the following are given, the range is instead summarized as JSON by a `DownsampleStream`:
+    // - `from` / `to` - The time range to summarize, in `ms` since boot (default: all history).
+    // - `points` - The maximum number of min/max/mean buckets to return (default `100`).
+    // ### Parameters
+    // - `request` - A pointer to an `AsyncWebServerRequest` object.
+    void OnHistory(AsyncWebServerRequest* request);
+
+    // ### `WebServer.OnMetrics()`
+    // Private function defining what happens when a client requests `/metrics`.
+    // Samples the heap and SSE gauges, then renders all `Metrics` in the Prometheus text format.
+    // ### Parameters
+    // - `request` - A pointer to an `AsyncWebServerRequest` object.
+    void OnMetrics(AsyncWebServerRequest* request);
+
+    // ### `WebServer.OnRuns()`
+    // Private function defining what happens when a client requests `/runs`.
+    // Lists the recorded run log files as JSON (`[{"name":"00001.bin","size":1234},...]`); each is downloadable from `/runs/<name>`.
+    // ### Parameters
+    // - `request` - A pointer to an `AsyncWebServerRequest` object.
+    void OnRuns(AsyncWebServerRequest* request);
+
+    // ### `WebServer.OnProfile()`
+    // Private function defining what happens when a client requests `/profile`.
+    // Renders the `CrankProfile` as JSON: the mean and peak current at each crank-angle bin, over all strokes so far.
+    // ### Parameters
+    // - `request` - A pointer to an `AsyncWebServerRequest` object.
+    void OnProfile(AsyncWebServerRequest* request);
+
+    // ### `WebServer.OnSpectrum()`
+    // Private function defining what happens when a client requests `/spectrum`.
+    // Renders the `SpectralMonitor`'s bands as JSON: the magnitude of the coil current at each order over the last block, and its baseline.
+    // ### Parameters
+    // - `request` - A pointer to an `AsyncWebServerRequest` object.
+    void OnSpectrum(AsyncWebServerRequest* request);
+
+    // ### `WebServer.OnCapture()`
+    // Private function defining what happens when a client requests `/capture`.
+    // `GET` exports the complete capture as a `BurstHeader` followed by its raw records (streamed straight from the
+    // capture's ring), or answers `404` with the capture's state (`idle`, `armed`, `triggered`) until it is complete.
+    // `POST` arms or controls it, with the query parameters:
+    // - `trigger` - `rising`, `falling`, `edge`, `current` or `temperature` to arm, `force` to fire the trigger now,
+    //   or `off` to disarm.
+    // - `level` - The `current` (`A`) or `temperature` (`°F`) trigger level.
+    // - `pre` - Readings to keep from before the trigger (default `BURST_CAPTURE_PRE_TRIGGER`).
+    // ### Parameters
+    // - `request` - A pointer to an `AsyncWebServerRequest` object.
+    // - `arm` - Whether it was a `POST` (`true`) or a `GET` (`false`).
+    void OnCapture(AsyncWebServerRequest* request, bool arm);
+
+    // ### `WebServer.OnTiming()`
+    // Private function defining what happens when a client requests `/timing`.
+    // Renders the `TimingTuner`'s best timing and its table of the best timing per speed as JSON.
+    // ### Parameters
+    // - `request` - A pointer to an `AsyncWebServerRequest` object.
+    void OnTiming(AsyncWebServerRequest* request);
+
+    // ### `WebServer.PushSnapshot()`
+    // Private function that pushes the cached JSON snapshot to `/events` clients as a `new_data` event.
+    // The frame is dropped (and counted in `Metrics`) if the clients' queues are backlogged.
+    void PushSnapshot();
+
+    // ### `WebServer.RefreshSnapshot()`
+    // Private function that re-serializes the snapshot cache if `WebServer.incoming_data` changed since it was last serialized.
+    // Serialization therefore happens at most once per data version, no matter how many clients poll or how often updates are pushed.
+    void RefreshSnapshot();
 
     // ### `WebServer.UpdateWithStoredData()`
     // Private function that updates the contents of the webserver using data stored in `WebServer.incoming_data`.
@@ -108,11 +253,53 @@ public:
     // This variable always stores the data that was most recently sent to the dashboard.
     Data incoming_data;
 
+    // ### `WebServer.stroke_history`
+    // The most recent per-stroke records, exported by `/history?type=strokes`.
+    // A record should be pushed each time a stroke's values are stored in `WebServer.incoming_data`.
+    StrokeHistory stroke_history;
+
     // ### `Webserver.Start()`
     // Public function that sets up the webserver and gets it ready for receiving new data.
     // This function needs to be called in `void setup()` prior to the main loop code beginning.
     void Start();
 
+    // ### `WebServer.ServeSampleHistory()`
+    // Makes an INA219's sample history available for export through `/history?type=samples`.
+    // ### Parameters
+    // - `history` - A reference to the `SampleHistory` to export (e.g. `ina219.history`).
+    void ServeSampleHistory(const SampleHistory& history);
+
+    // ### `WebServer.ServeRunLogs()`
+    // Makes the run logs recorded by a `RunLog` listable at `/runs` and downloadable from `/runs/<name>`.
+    // Must be called before `WebServer.Start()`.
+    // ### Parameters
+    // - `filesystem` - The mounted filesystem the runs are recorded to (e.g. `LittleFS`).
+    void ServeRunLogs(fs::FS& filesystem);
+
+    // ### `WebServer.ServeCrankProfile()`
+    // Makes a `CrankProfile` available at `/profile`.
+    // ### Parameters
+    // - `profile` - A reference to the `CrankProfile` to serve.
+    void ServeCrankProfile(const CrankProfile& profile);
+
+    // ### `WebServer.ServeSpectralMonitor()`
+    // Makes a `SpectralMonitor`'s bands available at `/spectrum`.
+    // ### Parameters
+    // - `monitor` - A reference to the `SpectralMonitor` to serve.
+    void ServeSpectralMonitor(const SpectralMonitor& monitor);
+
+    // ### `WebServer.ServeBurstCapture()`
+    // Makes a `BurstCapture` armable and exportable through `/capture`.
+    // ### Parameters
+    // - `capture` - A reference to the `BurstCapture` to serve.
+    void ServeBurstCapture(BurstCapture& capture);
+
+    // ### `WebServer.ServeTimingTuner()`
+    // Makes a `TimingTuner`'s timing table available at `/timing`.
+    // ### Parameters
+    // - `tuner` - A reference to the `TimingTuner` to serve.
+    void ServeTimingTuner(const TimingTuner& tuner);
+
     // ### `WebServer.UpdateData()`
     // Public function updates the dashboard with new data.
     // This function should be called by a type of `Controller` whose sole purpose is to create `data_struct` objects after events for updating the dashboard.
@@ -129,6 +316,11 @@ public:
     // ### `WebServer.StopUpdates()`
     // Stops scheduled updates of the webserver's content.
     void StopUpdates();
+
+    // ### `WebServer.PushChanges()`
+    // Pushes the data stored in `WebServer.incoming_data` to `/events` only if it changed since the last push (the
+    // `/data` version moved on), for when updates aren't scheduled. Call it after storing new data.
+    void PushChanges();
 };
 
 
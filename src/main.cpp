@@ -6,10 +6,15 @@
 *                                                               *
 *****************************************************************/
 #include <Arduino.h>
+#include <LittleFS.h>
 #include <ESP8266WiFi.h>
 #include "LEDs.h"
+#include "Clock.h"
+#include "Engine.h"
 #include "Events.h"
 #include "Sensors.h"
+#include "Controllers.h"
+#include "Telemetry.h"
 #include "WebServer/Data.hpp"
 #include "WebServer/WebServer.h"
 
@@ -17,24 +22,117 @@
 #define SWITCH2_PIN 16  // D0
 #define INA_SDA_PIN  4  // D2
 #define INA_SCL_PIN  5  // D1
+#define COIL_PIN    12  // D6
+
+// Record raw INA219 readings (not just strokes and edges) to the run log
+#ifndef RUN_LOG_SAMPLES
+#define RUN_LOG_SAMPLES false
+#endif
 
 
 // Global objects
 EventEmitter event_emitter;
 BuiltinLED board_led = BuiltinLED();
 Switch switch1(event_emitter, SWITCH1_PIN);
+Tachometer tachometer(event_emitter, SWITCH1_PIN);
 // Switch switch2(event_emitter, SWITCH2_PIN);
+
+// Engine state machine (constructed before the objects whose handlers read its state, so it sees each edge first),
+// and the listener applying each state's polling and update rates
+EngineStateMachine engine(event_emitter);
+Responder engine_listener(event_emitter, {EventType::ENGINE_STATE_CHANGE});
+
 INA219 ina219(event_emitter, INA_SDA_PIN, INA_SCL_PIN);
+StrokeAnalyzer stroke_analyzer(event_emitter);
+CrankProfile crank_profile(event_emitter);
+
+// Stall and fault detection (stops INA219 polling while the engine is stalled; faults are counted in /metrics)
+Watchdog watchdog(event_emitter, ina219);
+
+// Coil thermal model (its filtered temperature drives the engine state; predicted overheating raises an event)
+ThermalModel thermal(event_emitter);
+
+// Coil current spectrum at multiples of the rotation frequency (served by /spectrum, and streamed with the telemetry;
+// a band exceeding its baseline, e.g. the crank binding, is counted in /metrics)
+SpectralMonitor spectral(event_emitter);
+
+// Triggered INA219 burst capture (armed and downloaded through /capture; build with -D BURST_CAPTURE, its ring takes
+// 6 KB of RAM)
+#ifdef BURST_CAPTURE
+BurstCapture burst_capture(event_emitter, ina219);
+#endif
+
+// Coil driven through a MOSFET on COIL_PIN instead of by the switch, its timing tuned for efficiency
+// (build with -D SOLENOID_CONTROLLER)
+#ifdef SOLENOID_CONTROLLER
+SolenoidController controller(event_emitter, SWITCH1_PIN, COIL_PIN);
+TimingTuner tuner(event_emitter, controller);
+Responder thermal_listener(event_emitter, {EventType::OVERHEAT_PREDICTED, EventType::OVERHEAT_CLEARED});
+#endif
 
 // Web server object
 WebServer server(80, "esp8266", "12345678");
 
-// Global variables
-double x_avg = 0.01346962;      // m
-unsigned long t0 = millis();    // ms
+// Binary telemetry over Serial (replaces debug prints; build with -D SERIAL_TELEMETRY)
+#ifdef SERIAL_TELEMETRY
+SerialTelemetry telemetry(event_emitter, Serial);
+#endif
+
+// Run recorder (one file per boot on LittleFS, downloadable from /runs)
+RunLog run_log(event_emitter);
+
+// Sample listeners setup() adds to the INA219: the telemetry (if built in), stroke_analyzer, crank_profile, watchdog,
+// thermal, spectral and run_log (if LittleFS mounts). AddSampleListener() refuses any over the array's size, which
+// would silently starve a listener, so they are counted here
+#ifdef SERIAL_TELEMETRY
+constexpr size_t SAMPLE_LISTENERS = 7;
+#else
+constexpr size_t SAMPLE_LISTENERS = 6;
+#endif
+static_assert(SAMPLE_LISTENERS <= INA219_MAX_SAMPLE_LISTENERS, "Raise INA219_MAX_SAMPLE_LISTENERS");
 
 
 // Event handlers
+void engine_OnEvent(const Event& event) {
+    // Responding to ENGINE_STATE_CHANGE (`engine` is already in the new state)
+    const EngineStateProfile& profile = engine.Profile();
+    switch1.Begin(profile.switch_interval);
+    if (profile.sample_interval == 0) {
+        ina219.StopPolling();
+    }
+    if (profile.update_interval != 0) {
+        server.ScheduleUpdates(profile.update_interval);
+    }
+    else {
+        server.StopUpdates();
+        server.PushChanges();
+    }
+#ifdef SOLENOID_CONTROLLER
+    tachometer.Begin(profile.tachometer_interval, false);
+#else
+    tachometer.Begin(profile.tachometer_interval);
+#endif
+    if (profile.watchdog_interval == 0) {
+        watchdog.StopPolling();
+    }
+    else if (!watchdog.IsPolling()) {
+        watchdog.Begin(profile.watchdog_interval);
+    }
+    thermal.Begin(profile.thermal_interval);
+    crank_profile.enabled = profile.accumulate;
+    spectral.enabled = profile.accumulate;
+#ifdef SOLENOID_CONTROLLER
+    tuner.enabled = profile.accumulate;
+#endif
+}
+
+#ifdef SOLENOID_CONTROLLER
+void thermal_OnEvent(const Event& event) {
+    // Responding to OVERHEAT_PREDICTED / OVERHEAT_CLEARED (backs the coil's duty off before it overheats)
+    tuner.SetDwellLimit(event.type == EventType::OVERHEAT_PREDICTED ? TIMING_TUNER_HOT_DWELL : TIMING_TUNER_MAX_DWELL);
+}
+#endif
+
 // void ina219_OnEvent(const Event& event) {
 //     // Responding to SWITCH1_STATE_CHANGE_TO_LOW / SWITCH1_STATE_CHANGE_TO_HIGH
 //     if (event.type == EventType::SWITCH1_STATE_CHANGE_TO_LOW) {
@@ -73,38 +171,44 @@ unsigned long t0 = millis();    // ms
 // }
 void ina219_OnEvent(const Event& event) {
     // Responding to SWITCH1_STATE_CHANGE_TO_LOW / SWITCH1_STATE_CHANGE_TO_HIGH
+    // (the stroke's values are accumulated and computed by `stroke_analyzer`; with the controller, the coil isn't
+    // only on while the switch is closed, so the INA219 is polled continuously instead, from the first edge after
+    // `watchdog` stopped it on a stall)
     if (event.type == EventType::SWITCH1_STATE_CHANGE_TO_LOW) {
         // State changed from HIGH to LOW
         board_led.Off();
+#ifndef SOLENOID_CONTROLLER
         ina219.StopPolling();
-        float dt = (millis() - ina219.reading_began) / 1000.0;
-        float rpm = 30.0 / dt;
-        float force = 1 / (212.86 * dt * dt);
-        float torque = force * x_avg;
-        float voltage = ina219.measurements.voltage.GetAverage();
-        float current = ina219.measurements.current.GetAverage();
-        float powerin = voltage * current;
-        float powerout = (rpm * rpm * rpm) * (x_avg / 1829397.0);
-        float efficiency = powerout / powerin;
-        float temperature = ina219.measurements.temperature.GetAverage();
-        float elapsed = (millis() - t0) / 1000.0;
-
-        server.incoming_data.speed = rpm;
-        server.incoming_data.torque = torque * 1000.0;          // N·m -> N·mm
-        server.incoming_data.voltage = voltage;
-        server.incoming_data.current = current;
-        server.incoming_data.powerin = powerin;
-        server.incoming_data.powerout = powerout;
-        server.incoming_data.efficiency = efficiency * 100.0;   // .% -> %
-        server.incoming_data.temperature = temperature;
-        server.incoming_data.elapsed = elapsed;
+#endif
     }
     else if (event.type == EventType::SWITCH1_STATE_CHANGE_TO_HIGH) {
         // State changed from LOW to HIGH
         board_led.On();
-        ina219.reading_began = millis();
-        ina219.Begin(2);
+        ina219.reading_began = event.time;
+#ifndef SOLENOID_CONTROLLER
+        if (engine.Profile().sample_interval != 0) {
+            ina219.Begin(engine.Profile().sample_interval);
+        }
+#endif
     }
+#ifdef SOLENOID_CONTROLLER
+    if (!ina219.IsPolling() && engine.Profile().sample_interval != 0) {
+        ina219.Begin(engine.Profile().sample_interval);
+    }
+#endif
+}
+
+void stroke_analyzer_OnStroke(const StrokeAnalysis& stroke) {
+    server.incoming_data = stroke.data;
+    if (engine.Profile().update_interval == 0) {
+        server.PushChanges();
+    }
+    server.stroke_history.Push({stroke.time, stroke.data});
+    run_log.LogStroke(stroke.time, stroke.data);
+    engine.OnTemperature(thermal.Temperature(), stroke.time);
+#ifdef SOLENOID_CONTROLLER
+    tuner.OnStroke(stroke);
+#endif
 }
 
 
@@ -114,7 +218,16 @@ void ina219_OnEvent(const Event& event) {
 void setup()
 {
     board_led.Initialize();
+#ifdef SERIAL_TELEMETRY
+    telemetry.Begin();
+    ina219.AddSampleListener(&telemetry);
+    spectral.SetOnBand([](const SpectralBand& band, size_t index) { telemetry.OnBand(band, index); });
+#else
     Serial.begin(115200);
+#endif
+
+    // Set up the I2C bus and the INA219's calibration (its readings are then read register by register)
+    ina219.Initialize();
     
     // Register events & set callback
     ina219.RegisterForEvents({
@@ -122,20 +235,73 @@ void setup()
         EventType::SWITCH1_STATE_CHANGE_TO_HIGH
     });
     ina219.SetOnEvent(ina219_OnEvent);
+    ina219.AddSampleListener(&stroke_analyzer);
+    stroke_analyzer.SetOnStroke(stroke_analyzer_OnStroke);
+    ina219.AddSampleListener(&crank_profile);
+    ina219.AddSampleListener(&watchdog);
+    ina219.AddSampleListener(&thermal);
+    ina219.AddSampleListener(&spectral);
+    engine_listener.SetOnEvent(engine_OnEvent);
+    crank_profile.enabled = engine.Profile().accumulate;
+    spectral.enabled = engine.Profile().accumulate;
+
+    // Start switch polling (at the stopped engine's rate, until it turns)
+    switch1.Begin(engine.Profile().switch_interval);
 
-    // Start switch polling
-    switch1.Begin(1);
+    // Start timing switch1's rising edges (with the controller, from its interrupt on the same pin: the ESP8266 keeps
+    // one handler per pin)
+#ifdef SOLENOID_CONTROLLER
+    controller.SetTachometer(&tachometer);
+    tachometer.Begin(engine.Profile().tachometer_interval, false);
+#else
+    tachometer.Begin(engine.Profile().tachometer_interval);
+#endif
+
+    // Start watching for stalls and sensor faults (a stopped engine has nothing to watch until its first edge)
+    if (engine.Profile().watchdog_interval != 0) {
+        watchdog.Begin(engine.Profile().watchdog_interval);
+    }
+
+    // Start stepping the coil's thermal model
+    thermal.Begin(engine.Profile().thermal_interval);
+
+#ifdef SOLENOID_CONTROLLER
+    // Start driving the coil, and tuning its timing (from the centre of the range it searches)
+    controller.Begin(1000);
+    tuner.enabled = engine.Profile().accumulate;
+    tuner.Begin(100);
+    thermal_listener.SetOnEvent(thermal_OnEvent);
+    server.ServeTimingTuner(tuner);
+#endif
+
+    // Start recording this run
+    if (LittleFS.begin() && run_log.Begin(LittleFS, RUN_LOG_SAMPLES)) {
+        ina219.AddSampleListener(&run_log);
+        server.ServeRunLogs(LittleFS);
+    }
 
     // Start webserver
+    server.ServeSampleHistory(ina219.history);
+    server.ServeCrankProfile(crank_profile);
+    server.ServeSpectralMonitor(spectral);
+#ifdef BURST_CAPTURE
+    server.ServeBurstCapture(burst_capture);
+#endif
     server.Start();
 
-    // Schedule webserver updates
-    server.ScheduleUpdates(250);
+    // Schedule webserver updates (at the stopped engine's rate, until it turns: none, only pushing changes)
+    if (engine.Profile().update_interval != 0) {
+        server.ScheduleUpdates(engine.Profile().update_interval);
+    }
 
-    // Start INA219 polling if switch1 state is HIGH
+    // Start INA219 polling if switch1 state is HIGH (taken as an edge, so the watchdog stops it if the engine doesn't
+    // turn)
     if (switch1.last_state == 1) {
-        ina219.reading_began = millis();
-        ina219.Begin(2);
+        ina219.reading_began = ClockMicros();
+        engine.Input(EngineInput::EDGE, ina219.reading_began);
+        stroke_analyzer.Open(ina219.reading_began);
+        crank_profile.Open(ina219.reading_began);
+        ina219.Begin(engine.Profile().sample_interval);
     }
 }
 
@@ -145,6 +311,10 @@ void setup()
 
 void loop()
 {
+    Metrics::UpdateLoopRate(ClockMillis());
+#ifdef SERIAL_TELEMETRY
+    telemetry.Flush();
+#endif
+    run_log.Service();
     yield();
 }
-
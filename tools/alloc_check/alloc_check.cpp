@@ -0,0 +1,184 @@
+/****************************************************************
+*                                                               *
+*   alloc_check.cpp                                             *
+*                                                               *
+*   Checks that the running firmware never touches the heap.    *
+*                                                               *
+*****************************************************************/
+// Runs the firmware pipeline against the simulated engine (`host/sim/Session.hpp`) and, once it has warmed up
+// (`--warmup` strokes: buffers filled, listeners registered, tickers attached), counts every heap allocation
+// (`operator new`) until the end of the run, as the engine keeps running. Each stroke also goes through what
+// `main.cpp` does with it on the ESP8266: pushed into a `StrokeHistory` and serialized as the web server's snapshot.
+// The ESP8266's heap fragments and never compacts, so the steady state must not allocate at all: the program exits
+// with status `1` if anything did, listing where (the first call sites, as return addresses with symbols; build with
+// debug info and pass them to `addr2line -Cfe alloc_check` for file and line).
+//
+// Build and run (or use the `alloc_check` target, and `alloc_check_run` to run it with telemetry enabled):
+// ```
+// g++ -std=c++17 -O2 -g -rdynamic -I host/include -I host/sim -I include -I src -D METRICS_STORAGE=thread_local tools/alloc_check/alloc_check.cpp -o alloc_check
+// ./alloc_check --duration 20 --telemetry 921600
+// ```
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <execinfo.h>
+#include "Session.hpp"
+#include "WebServer/Serialize.hpp"
+
+// ### `ALLOC_CHECK_FRAMES`
+// Return addresses recorded per allocation call site.
+#ifndef ALLOC_CHECK_FRAMES
+#define ALLOC_CHECK_FRAMES 8
+#endif
+
+// ### `ALLOC_CHECK_SITES`
+// Distinct call sites recorded (further ones are only counted).
+#ifndef ALLOC_CHECK_SITES
+#define ALLOC_CHECK_SITES 16
+#endif
+
+
+
+// ## AllocationSite
+// Where allocations came from: the call stack of the first one, and how many came from the same stack.
+struct AllocationSite {
+    void* frames[ALLOC_CHECK_FRAMES];
+    int depth;
+    uint64_t count;
+    uint64_t bytes;
+};
+
+// Allocation tracking. Recording uses only static storage, so it can't allocate itself.
+static bool armed = false;
+static uint64_t allocations = 0;
+static uint64_t allocated_bytes = 0;
+static AllocationSite sites[ALLOC_CHECK_SITES];
+static size_t site_count = 0;
+
+static void Record(size_t size) {
+    allocations++;
+    allocated_bytes += size;
+    void* frames[ALLOC_CHECK_FRAMES + 2];
+    int depth = backtrace(frames, ALLOC_CHECK_FRAMES + 2) - 2;      // Minus `Record()` and `Allocate()`
+    depth = depth < 0 ? 0 : depth;
+    for (size_t i = 0; i < site_count; i++) {
+        if (sites[i].depth == depth && memcmp(sites[i].frames, frames + 2, depth * sizeof(void*)) == 0) {
+            sites[i].count++;
+            sites[i].bytes += size;
+            return;
+        }
+    }
+    if (site_count < ALLOC_CHECK_SITES) {
+        AllocationSite& site = sites[site_count++];
+        memcpy(site.frames, frames + 2, depth * sizeof(void*));
+        site.depth = depth;
+        site.count = 1;
+        site.bytes = size;
+    }
+}
+
+static void* Allocate(size_t size) {
+    if (armed) {
+        armed = false;      // No recursion if the unwinder allocates
+        Record(size);
+        armed = true;
+    }
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new(size_t size) { return Allocate(size); }
+void* operator new[](size_t size) { return Allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return malloc(size == 0 ? 1 : size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return malloc(size == 0 ? 1 : size); }
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete[](void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { free(pointer); }
+
+
+
+static void Usage() {
+    fprintf(stderr,
+        "Usage: alloc_check [options]\n"
+        "  --duration S        Simulated time, in s (default 20)\n"
+        "  --warmup N          Strokes before counting starts (default 10)\n"
+        "  --supply V          Supply voltage (default 6.6)\n"
+        "  --sample-ms MS      INA219 polling interval (default 2)\n"
+        "  --buffer N          SensorBuffer size (default 20)\n"
+        "  --telemetry BAUD    Enable serial telemetry at BAUD\n");
+}
+
+
+
+int main(int argc, char** argv)
+{
+    SessionConfig config;
+    config.duration = 20;
+    uint32_t warmup = 10;
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        const char* value = i + 1 < argc ? argv[++i] : nullptr;
+        bool valid = value != nullptr;
+        if (!valid) { }
+        else if (strcmp(option, "--duration") == 0)     valid = (config.duration = atof(value)) > 0;
+        else if (strcmp(option, "--warmup") == 0)       warmup = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--supply") == 0)       config.engine.supply_voltage = atof(value);
+        else if (strcmp(option, "--sample-ms") == 0)    valid = (config.sample_interval = atoi(value)) > 0;
+        else if (strcmp(option, "--buffer") == 0)       config.sensor_buffer_size = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--telemetry") == 0) {
+            config.telemetry = true;
+            config.telemetry_baud = strtoul(value, nullptr, 10);
+        }
+        else                                            valid = false;
+        if (!valid) {
+            Usage();
+            return 2;
+        }
+    }
+
+    // The first `backtrace()` loads the unwinder, which allocates
+    void* frames[1];
+    backtrace(frames, 1);
+
+    // What `main.cpp` keeps per stroke (`server.stroke_history`, `server.snapshot_json`/`snapshot_csv`)
+    static StrokeHistory history;
+    static char json[256], csv[256];
+    uint32_t strokes = 0;
+
+    Session session(config);
+    session.on_stroke = [&](const SimulatedStroke& stroke) {
+        history.Push(stroke.record);
+        SerializeDataJSON(stroke.record.data, json, sizeof(json));
+        SerializeDataCSV(stroke.record.data, csv, sizeof(csv));
+        if (++strokes == warmup) {
+            armed = true;
+        }
+    };
+    SessionStats stats = session.Run();
+    armed = false;
+
+    printf("%lu strokes (%lu counted after %lu warm-up strokes), %llu ticker callbacks\n",
+        (unsigned long)stats.strokes, (unsigned long)(strokes > warmup ? strokes - warmup : 0), (unsigned long)warmup,
+        (unsigned long long)stats.ticker_callbacks);
+    if (strokes < warmup + 1) {
+        fprintf(stderr, "The engine made too few strokes to check the steady state (raise --duration)\n");
+        return 2;
+    }
+    printf("%llu allocations (%llu bytes) in the steady state\n",
+        (unsigned long long)allocations, (unsigned long long)allocated_bytes);
+    if (allocations == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < site_count; i++) {
+        fprintf(stderr, "\n%llu allocation(s), %llu bytes, from:\n",
+            (unsigned long long)sites[i].count, (unsigned long long)sites[i].bytes);
+        fflush(stderr);
+        backtrace_symbols_fd(sites[i].frames, sites[i].depth, 2);
+    }
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,402 @@
+/****************************************************************
+*                                                               *
+*   analyze.cpp                                                 *
+*                                                               *
+*   Parallel offline analysis of recorded engine runs.          *
+*                                                               *
+*****************************************************************/
+// Memory-maps a run log downloaded from the firmware's `/runs` endpoint, splits it into strokes at the recorded
+// switch edges (rising to falling edge, as the firmware's `StrokeAnalyzer` does), and computes per-stroke metrics
+// with `ComputeStrokeData()`, plus the electrical energy (zero-order hold of the recorded power) and the peak
+// current of every stroke: the same values as `StrokeAnalyzer`, computed in floats from the recorded readings.
+//
+// The file is cut into fixed-size chunks of records, analyzed in parallel by a `WorkStealingPool`; a chunk owns the
+// strokes that begin in it and reads past its end to finish the last one. Results are merged in file order, so the
+// output doesn't depend on the number of threads. By default summary tables (overall and per rpm band) are written
+// on stdout; with `--strokes`, every stroke is written as CSV instead.
+//
+// Build and run (or use the `analyze` CMake target):
+// ```
+// g++ -std=c++17 -O2 -pthread -I host/include -I host/sim -I include -I src -D METRICS_STORAGE=thread_local tools/analyze/analyze.cpp -o analyze
+// ./analyze run.bin
+// ./analyze --band 50 --strokes run.bin > strokes.csv
+// ```
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <map>
+#include <vector>
+#include "Engine/StrokeMath.hpp"
+#include "Telemetry/RunLogFormat.hpp"
+#include "WebServer/Data.hpp"
+#include "Statistic.hpp"
+#include "WorkStealingPool.hpp"
+
+
+
+// ### `ANALYZE_CHUNK_SIZE`
+// Default number of bytes of records analyzed by one task.
+#define ANALYZE_CHUNK_SIZE (16 * 1024 * 1024)
+
+
+
+// ## AnalyzedStroke
+// One stroke and its metrics.
+struct AnalyzedStroke {
+    uint32_t time;              // Time (`micros()`) of the falling edge, in `µs`.
+    uint64_t elapsed;           // Time from the first record of the file to the falling edge, in `µs`.
+    uint32_t duration;          // Time from the rising to the falling edge, in `µs`.
+    uint32_t samples;           // INA219 readings during the stroke.
+    Data data;                  // As computed by `ComputeStrokeData()` (`elapsed` is filled in last).
+    float energy;               // Electrical energy drawn during the stroke, in `J`.
+    float peak_current;         // Highest current read during the stroke, in `A`.
+};
+
+
+
+// ## Metric
+// Per-stroke values summarized by `Summary`.
+enum Metric {
+    SPEED, TORQUE, VOLTAGE, CURRENT, POWERIN, POWEROUT, EFFICIENCY, TEMPERATURE, ENERGY, PEAK_CURRENT, DURATION, SAMPLES,
+    METRIC_COUNT,
+};
+
+static const char* const metric_names[METRIC_COUNT] = {
+    "speed [RPM]", "torque [N*mm]", "voltage [V]", "current [A]", "powerin [W]", "powerout [W]", "efficiency [%]",
+    "temperature [F]", "energy [J]", "peak current [A]", "duration [ms]", "readings",
+};
+
+
+
+// ## Summary
+// Statistics of every metric over a set of strokes.
+struct Summary {
+    Statistic metrics[METRIC_COUNT];
+
+    void Add(const AnalyzedStroke& stroke) {
+        const Data& d = stroke.data;
+        double values[METRIC_COUNT] = {
+            d.speed, d.torque, d.voltage, d.current, d.powerin, d.powerout, d.efficiency, d.temperature,
+            stroke.energy, stroke.peak_current, stroke.duration / 1000.0, (double)stroke.samples,
+        };
+        for (size_t i = 0; i < METRIC_COUNT; i++) {
+            metrics[i].Add(values[i]);
+        }
+    }
+
+    void Merge(const Summary& other) {
+        for (size_t i = 0; i < METRIC_COUNT; i++) {
+            metrics[i].Merge(other.metrics[i]);
+        }
+    }
+};
+
+
+
+// ## ChunkResult
+// What one task found in its chunk of records.
+struct ChunkResult {
+    uint64_t span = 0;                  // Time from the chunk's first record to the next chunk's first record, in `µs`.
+    uint32_t edges = 0;
+    uint32_t samples = 0;
+    uint32_t missing = 0;               // Records missing (gaps in the sequence numbers).
+    uint32_t incomplete = 0;            // Strokes skipped because records were missing or an edge was.
+    double energy = 0;                  // Total energy of the complete strokes, in `J`.
+    Summary summary;
+    std::map<long, Summary> bands;      // By rpm band (`floor(speed / band)`).
+    std::vector<AnalyzedStroke> strokes;    // Only kept when they are written out.
+};
+
+
+
+// ## StrokeAccumulator
+// Collects the readings of the stroke in progress.
+struct StrokeAccumulator {
+    bool active = false;
+    bool gap = false;                   // Whether records went missing during the stroke.
+    uint32_t began = 0;                 // Time of the rising edge, in `µs`.
+    uint32_t last_time = 0;             // Time of the last reading (or the rising edge), in `µs`.
+    float last_power = 0;
+    uint32_t samples = 0;
+    double voltage = 0, current = 0, temperature = 0, energy = 0;
+    float peak_current = 0;
+
+    void Begin(uint32_t time) {
+        *this = StrokeAccumulator();
+        active = true;
+        began = last_time = time;
+    }
+
+    void Add(const RunLogRecord& record) {
+        // Each reading's power is held until the next one; the first also covers the time since the rising edge
+        float power = samples == 0 ? record.sample.power : last_power;
+        energy += power * (double)(uint32_t)(record.time - last_time) / 1000000.0;
+        last_time = record.time;
+        last_power = record.sample.power;
+        samples++;
+        voltage += record.sample.voltage;
+        current += record.sample.current;
+        temperature += record.sample.temperature;
+        peak_current = record.sample.current > peak_current ? record.sample.current : peak_current;
+    }
+
+    AnalyzedStroke End(uint32_t time, uint64_t elapsed) {
+        AnalyzedStroke stroke;
+        stroke.time = time;
+        stroke.elapsed = elapsed;
+        stroke.duration = time - began;
+        stroke.samples = samples;
+        stroke.energy = energy + (samples > 0 ? last_power * (double)(uint32_t)(time - last_time) / 1000000.0 : 0);
+        stroke.peak_current = peak_current;
+        stroke.data = ComputeStrokeData(
+            stroke.duration,
+            samples > 0 ? voltage / samples : 0.f,
+            samples > 0 ? current / samples : 0.f,
+            samples > 0 ? temperature / samples : 0.f,
+            0
+        );
+        active = false;
+        return stroke;
+    }
+};
+
+
+
+// ### `AnalyzeChunk()`
+// Analyzes the strokes that begin in `records[begin, end)`, reading on past `end` to finish the last one.
+// `elapsed` values are relative to `records[begin]` until `main()` offsets them.
+static void AnalyzeChunk(const RunLogRecord* records, size_t count, size_t begin, size_t end,
+                         double band, bool keep, ChunkResult& result) {
+    StrokeAccumulator stroke;
+    uint64_t elapsed = 0;
+    uint32_t last_time = records[begin].time;
+    uint16_t expected = records[begin].sequence;
+    size_t i = begin;
+    for (; i < count; i++) {
+        const RunLogRecord& record = records[i];
+        elapsed += (uint32_t)(record.time - last_time);
+        last_time = record.time;
+        uint16_t gap = record.sequence - expected;
+        expected = record.sequence + 1;
+        if (i <= end) {
+            result.missing += gap;      // The gap before `records[end]` is this chunk's; the next chunk starts there
+        }
+        if (gap != 0) {
+            stroke.gap = true;
+        }
+        if (i == end) {
+            result.span = elapsed;
+        }
+        if (i >= end && !stroke.active) {
+            break;
+        }
+
+        if (record.type == RunLogRecordType::EDGE) {
+            if (record.edge.state) {
+                if (i >= end) {
+                    result.incomplete++;        // The next chunk's first stroke begins; this one never ended
+                    break;
+                }
+                result.edges++;
+                if (stroke.active) {
+                    result.incomplete++;
+                }
+                stroke.Begin(record.time);
+                continue;
+            }
+            if (i < end) {
+                result.edges++;
+            }
+            if (!stroke.active) {
+                continue;                       // Falling edge of a stroke that began before this chunk
+            }
+            bool gap = stroke.gap;
+            AnalyzedStroke analyzed = stroke.End(record.time, elapsed);
+            if (gap) {
+                result.incomplete++;
+            }
+            else {
+                result.energy += analyzed.energy;
+                result.summary.Add(analyzed);
+                if (isfinite(analyzed.data.speed)) {
+                    result.bands[(long)floor(analyzed.data.speed / band)].Add(analyzed);
+                }
+                if (keep) {
+                    result.strokes.push_back(analyzed);
+                }
+            }
+            if (i >= end) {
+                break;
+            }
+        }
+        else if (record.type == RunLogRecordType::SAMPLE) {
+            if (i < end) {
+                result.samples++;
+            }
+            if (stroke.active) {
+                stroke.Add(record);
+            }
+        }
+    }
+    if (i == count) {
+        result.span = elapsed;
+        if (stroke.active) {
+            result.incomplete++;                // Still running when the recording ended
+        }
+    }
+}
+
+static void PrintStatistic(const char* name, const Statistic& statistic) {
+    printf("  %-18s %8lu %12.5g %12.5g %12.5g %12.5g\n", name, (unsigned long)statistic.count, statistic.mean,
+        statistic.Deviation(), statistic.count ? statistic.min : 0, statistic.count ? statistic.max : 0);
+}
+
+static void Usage() {
+    fprintf(stderr,
+        "Usage: analyze [options] RUN_LOG\n"
+        "  --band RPM          Width of the rpm bands of the summary (default 100)\n"
+        "  --strokes           Write every stroke as CSV instead of the summary\n"
+        "  --threads N         Worker threads (default: one per core)\n"
+        "  --chunk BYTES       Bytes of records per task (default 16 MiB)\n");
+}
+
+
+
+int main(int argc, char** argv)
+{
+    const char* path = nullptr;
+    double band = 100;
+    bool strokes = false;
+    unsigned long threads = 0, chunk_bytes = ANALYZE_CHUNK_SIZE;
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        if (strcmp(option, "--strokes") == 0) {
+            strokes = true;
+            continue;
+        }
+        if (strncmp(option, "--", 2) != 0 && path == nullptr) {
+            path = option;
+            continue;
+        }
+        const char* value = i + 1 < argc ? argv[++i] : nullptr;
+        bool valid = value != nullptr;
+        if (!valid) { }
+        else if (strcmp(option, "--band") == 0)     valid = (band = atof(value)) > 0;
+        else if (strcmp(option, "--threads") == 0)  threads = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--chunk") == 0)    valid = (chunk_bytes = strtoul(value, nullptr, 10)) >= sizeof(RunLogRecord);
+        else                                        valid = false;
+        if (!valid) {
+            Usage();
+            return 2;
+        }
+    }
+    if (path == nullptr) {
+        Usage();
+        return 2;
+    }
+
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return 2;
+    }
+    size_t size = (size_t)info.st_size;
+    if (size < sizeof(RunLogHeader)) {
+        fprintf(stderr, "Not a run log (version %d)\n", RUN_LOG_VERSION);
+        return 2;
+    }
+    const uint8_t* file = (const uint8_t*)mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (file == MAP_FAILED) {
+        fprintf(stderr, "Cannot map %s\n", path);
+        return 2;
+    }
+    madvise((void*)file, size, MADV_SEQUENTIAL);
+    close(fd);
+
+    RunLogHeader header;
+    memcpy(&header, file, sizeof(header));
+    if (!IsRunLogHeader(header)) {
+        fprintf(stderr, "Not a run log (version %d)\n", RUN_LOG_VERSION);
+        return 2;
+    }
+    const RunLogRecord* records = (const RunLogRecord*)(file + sizeof(RunLogHeader));
+    size_t count = (size_t)(size - sizeof(RunLogHeader)) / sizeof(RunLogRecord);
+    size_t per_chunk = chunk_bytes / sizeof(RunLogRecord);
+    size_t chunk_count = (count + per_chunk - 1) / per_chunk;
+
+    auto began = std::chrono::steady_clock::now();
+    std::vector<ChunkResult> results(chunk_count);
+    {
+        WorkStealingPool pool(threads);
+        for (size_t c = 0; c < chunk_count; c++) {
+            pool.Submit([=, &results] {
+                size_t begin = c * per_chunk;
+                size_t end = begin + per_chunk < count ? begin + per_chunk : count;
+                AnalyzeChunk(records, count, begin, end, band, strokes, results[c]);
+            });
+        }
+        pool.Wait();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+
+    // Merge in file order
+    ChunkResult total;
+    uint64_t offset = 0;
+    if (strokes) {
+        printf("time,elapsed,duration,samples,speed,torque,voltage,current,powerin,powerout,efficiency,temperature,energy,peak_current\n");
+    }
+    for (ChunkResult& result : results) {
+        for (AnalyzedStroke& stroke : result.strokes) {
+            stroke.elapsed += offset;
+            stroke.data.elapsed = stroke.elapsed / 1000000.0;
+            const Data& d = stroke.data;
+            printf("%lu,%.6f,%lu,%lu,%.7g,%.7g,%.7g,%.7g,%.7g,%.7g,%.7g,%.7g,%.7g,%.7g\n",
+                (unsigned long)stroke.time, d.elapsed, (unsigned long)stroke.duration, (unsigned long)stroke.samples,
+                d.speed, d.torque, d.voltage, d.current, d.powerin, d.powerout, d.efficiency, d.temperature,
+                stroke.energy, stroke.peak_current);
+        }
+        offset += result.span;
+        total.edges += result.edges;
+        total.samples += result.samples;
+        total.missing += result.missing;
+        total.incomplete += result.incomplete;
+        total.energy += result.energy;
+        total.summary.Merge(result.summary);
+        for (const auto& entry : result.bands) {
+            total.bands[entry.first].Merge(entry.second);
+        }
+    }
+
+    if (!strokes) {
+        printf("Run %lu: %lu records, %.3f s recorded%s\n", (unsigned long)header.run, (unsigned long)count,
+            offset / 1000000.0, header.flags & RUN_LOG_FLAG_SAMPLES ? "" : " (without samples)");
+        printf("  %lu edges, %lu samples, %lu strokes (%lu incomplete), %lu records missing, %.6g J drawn\n\n",
+            (unsigned long)total.edges, (unsigned long)total.samples,
+            (unsigned long)(total.summary.metrics[SPEED].count + total.incomplete), (unsigned long)total.incomplete,
+            (unsigned long)total.missing, total.energy);
+        printf("  %-18s %8s %12s %12s %12s %12s\n", "per stroke", "strokes", "mean", "sd", "min", "max");
+        for (size_t i = 0; i < METRIC_COUNT; i++) {
+            PrintStatistic(metric_names[i], total.summary.metrics[i]);
+        }
+        printf("\n  %-17s %8s %10s %10s %10s %10s %10s %10s %10s\n", "rpm band", "strokes", "torque", "powerin",
+            "powerout", "effic. %", "energy J", "peak A", "temp F");
+        for (const auto& entry : total.bands) {
+            const Statistic* m = entry.second.metrics;
+            printf("  %7.0f - %-7.0f %8lu %10.4g %10.4g %10.4g %10.4g %10.4g %10.4g %10.4g\n",
+                entry.first * band, (entry.first + 1) * band, (unsigned long)m[SPEED].count, m[TORQUE].mean,
+                m[POWERIN].mean, m[POWEROUT].mean, m[EFFICIENCY].mean, m[ENERGY].mean, m[PEAK_CURRENT].max,
+                m[TEMPERATURE].mean);
+        }
+    }
+    fprintf(stderr, "Analyzed %.1f MB in %.3f s (%.0f MB/s) in %lu chunks\n",
+        size / 1e6, wall, size / 1e6 / wall, (unsigned long)chunk_count);
+    munmap((void*)file, size);
+    return 0;
+}
\ No newline at end of file
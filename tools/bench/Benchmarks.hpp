@@ -0,0 +1,225 @@
+/****************************************************************
+*                                                               *
+*   Benchmarks.hpp                                              *
+*                                                               *
+*   Benchmarks of the firmware's hot paths.                     *
+*   Shared by the host (bench.cpp) and on-target builds.        *
+*                                                               *
+*****************************************************************/
+// Every benchmark is one call of `runner.Run(name, body)`, where `body()` performs one operation. The runner decides
+// how to time it: `bench.cpp` in wall-clock nanoseconds with allocation counting, `target/main.cpp` in CPU cycles on
+// the ESP8266. Benchmark names are the keys of the stored baseline (`baseline.csv`), so renaming one resets it.
+#ifndef BENCHMARKS_HPP
+#define BENCHMARKS_HPP
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "Events.h"
+#include "Sensors.h"
+#include "Engine/StrokeMath.hpp"
+#include "Engine/StrokeAnalyzer.hpp"
+#include "Engine/CrankProfile.hpp"
+#include "Engine/Watchdog.hpp"
+#include "Engine/ThermalModel.hpp"
+#include "Engine/SpectralMonitor.hpp"
+#include "WebServer/Data.hpp"
+#include "WebServer/Serialize.hpp"
+
+
+
+// ### `BenchKeep()`
+// Makes the compiler assume `value` is read (and may be changed) here, so the work producing it isn't optimized away
+// and its inputs aren't folded into constants.
+template <typename T>
+inline void BenchKeep(T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+
+
+// ## BenchFixture
+// The objects the benchmarks run against, set up as in `main.cpp`: a switch, an INA219 registered for its edges,
+// a stroke analyzer, a crank profile, a serial-telemetry-like listener, a watchdog, a thermal model and a spectral
+// monitor (on an emitter of their own, so they don't add to the other benchmarks; two edges give the monitor a
+// speed). Nothing is polling; the benchmarks call the hot paths directly.
+struct BenchFixture {
+    EventEmitter event_emitter;
+    Switch switch1{event_emitter, 14};
+    INA219 ina219{event_emitter, 4, 5};
+    StrokeAnalyzer stroke_analyzer{event_emitter};
+    CrankProfile crank_profile{event_emitter};
+    Responder telemetry{event_emitter, {EventType::SWITCH1_STATE_CHANGE_TO_LOW, EventType::SWITCH1_STATE_CHANGE_TO_HIGH}};
+    EventEmitter watchdog_emitter;
+    Watchdog watchdog{watchdog_emitter, ina219};
+    ThermalModel thermal{watchdog_emitter};
+    SpectralMonitor spectral{watchdog_emitter};
+    SensorBuffer buffer;
+    uint32_t handled = 0;       // Events received by the listeners.
+
+    BenchFixture() {
+        ina219.RegisterForEvents({EventType::SWITCH1_STATE_CHANGE_TO_LOW, EventType::SWITCH1_STATE_CHANGE_TO_HIGH});
+        ina219.SetOnEvent([this](const Event&) { handled++; });
+        telemetry.SetOnEvent([this](const Event&) { handled++; });
+        ina219.AddSampleListener(&stroke_analyzer);
+        stroke_analyzer.SetOnStroke([this](const StrokeAnalysis&) { handled++; });
+        for (int i = 0; i < 20; i++) {
+            Sample sample = {(uint32_t)i * 2000, 5.f + i * 0.01f, 1.2f, 6.f, 4.2f, 75.f};
+            ina219.AddSample(sample);
+            buffer.Add(sample.voltage);
+        }
+        for (uint32_t time = 0; time <= 54545; time += 54545) {     // One revolution at 1100 RPM
+            watchdog_emitter.EmitEvent({EventType::SWITCH1_STATE_CHANGE_TO_HIGH, 1, EventTypeName(EventType::SWITCH1_STATE_CHANGE_TO_HIGH), time});
+        }
+    }
+};
+
+
+
+// ### `RunBenchmarks()`
+// Runs every benchmark with `runner` (any object with a `Run(const char* name, Body&& body)` template method).
+template <typename Runner>
+void RunBenchmarks(Runner& runner) {
+    BenchFixture fixture;
+    uint32_t i = 0;
+
+    // A switch edge as `Switch::Read()` builds and emits it, delivered to the registered listeners
+    runner.Run("EventEmitter.EmitEvent", [&] {
+        uint32_t now = i++;
+        int state = now & 1;
+        EventType type = state ? EventType::SWITCH1_STATE_CHANGE_TO_HIGH : EventType::SWITCH1_STATE_CHANGE_TO_LOW;
+        fixture.event_emitter.EmitEvent({type, (float)state, EventTypeName(type), now});
+    });
+
+    // A full (default-size) buffer, as the INA219's `measurements` are while the engine runs
+    runner.Run("SensorBuffer.Add", [&] {
+        float value = 5.f + (i++ & 7) * 0.01f;
+        BenchKeep(value);
+        fixture.buffer.Add(value);
+    });
+
+    runner.Run("SensorBuffer.GetAverage", [&] {
+        float average = fixture.buffer.GetAverage();
+        BenchKeep(average);
+    });
+
+    // `INA219::Read()`'s unit conversions and derivations, from raw register values (in scaled integers)
+    runner.Run("INA219.Derive", [&] {
+        int32_t power_raw = 3000 + (i++ & 15), current_raw = 12000, bus_mV = 5000, shunt_raw = 12000;
+        BenchKeep(power_raw);
+        BenchKeep(current_raw);
+        BenchKeep(bus_mV);
+        BenchKeep(shunt_raw);
+        FixedSample sample;
+        sample.power = power_raw * INA219_POWER_LSB;
+        sample.current = current_raw * INA219_CURRENT_LSB;
+        sample.voltage = bus_mV * 1000 + shunt_raw * 10;
+        sample.resistance = INA219::InferResistanceFixed(sample.voltage, sample.power);
+        sample.temperature = INA219::InferTemperatureFixed(sample.resistance);
+        BenchKeep(sample);
+    });
+
+    // The same in floats, from the driver's float getters (what `INA219::Read()` did before). On a host with an FPU
+    // this is as fast as `INA219.Derive` or faster; only the ESP8266's cycle counts (`pio run -e bench`) measure the
+    // fixed-point derivation's gain.
+    runner.Run("INA219.DeriveFloat", [&] {
+        float power_mW = 6000.f + (i++ & 15), current_mA = 1200.f, bus_V = 5.f, shunt_mV = 120.f;
+        BenchKeep(power_mW);
+        BenchKeep(current_mA);
+        BenchKeep(bus_V);
+        BenchKeep(shunt_mV);
+        Sample sample;
+        sample.power = power_mW / 1000.f;
+        sample.current = current_mA / 1000.f;
+        sample.voltage = bus_V + shunt_mV / 1000.f;
+        sample.resistance = INA219::InferResistance(sample.voltage, sample.power);
+        sample.temperature = INA219::InferTemperature(sample.resistance);
+        BenchKeep(sample);
+    });
+
+    // Recording a complete reading (`measurements`, `history`, sample listeners)
+    runner.Run("INA219.AddSample", [&] {
+        FixedSample sample = {i++ * 2000, 5120000, 1200000, 6000000, 4369067, 7729};
+        BenchKeep(sample);
+        fixture.ina219.AddSample(sample);
+    });
+
+    // A reading added to the stroke in progress (what `INA219.AddSample()` costs on top of the above during a stroke)
+    fixture.stroke_analyzer.Open(0);
+    runner.Run("StrokeAnalyzer.OnReading", [&] {
+        FixedSample sample = {i++ * 2000, 5120000, 1200000 + (int32_t)(i & 255), 6000000, 4369067, 7729};
+        BenchKeep(sample);
+        fixture.stroke_analyzer.OnReading(sample);
+    });
+
+    // A falling edge finalizing a stroke (opened and given one reading first, so the means are computed)
+    runner.Run("StrokeAnalyzer.Close", [&] {
+        uint32_t began = i++ * 30000;
+        FixedSample sample = {began + 2000, 5120000, 1200000, 6000000, 4369067, 7729};
+        BenchKeep(sample);
+        fixture.stroke_analyzer.Open(began);
+        fixture.stroke_analyzer.OnReading(sample);
+        fixture.stroke_analyzer.Close(began + 27000 + (i & 255));
+    });
+
+    // A reading pushing the watchdog's silent timeout back (relinked in its timer wheel)
+    runner.Run("Watchdog.OnReading", [&] {
+        FixedSample sample = {i++ * 2000, 5120000, 1200000, 6000000, 4369067, 7729};
+        BenchKeep(sample);
+        fixture.watchdog.OnReading(sample);
+    });
+
+    // One reading taken by the thermal model (its power held, and its settled current's resistance summed)
+    runner.Run("ThermalModel.OnReading", [&] {
+        FixedSample sample = {i++ * 2000, 5120000, 1200000 + (int32_t)(i & 1023), 6000000, 4369067, 7729};
+        BenchKeep(sample);
+        fixture.thermal.OnReading(sample);
+    });
+
+    // One reading run through the spectral monitor's filters (and every 256th, a block's magnitudes and baselines)
+    runner.Run("SpectralMonitor.OnReading", [&] {
+        FixedSample sample = {i++ * 2000, 5120000, 1200000 + (int32_t)((i & 31) << 12), 6000000, 4369067, 7729};
+        BenchKeep(sample);
+        fixture.spectral.OnReading(sample);
+    });
+
+    // A whole stroke's readings (at 1100 RPM) stored and resampled onto the crank-angle bins
+    runner.Run("CrankProfile.Stroke", [&] {
+        uint32_t began = i++ * 30000;
+        fixture.crank_profile.Open(began);
+        for (uint32_t reading = 0; reading < 13; reading++) {
+            FixedSample sample = {began + 1000 + reading * 2000, 5120000, 1200000 + (int32_t)(reading << 12), 6000000, 4369067, 7729};
+            BenchKeep(sample);
+            fixture.crank_profile.OnReading(sample);
+        }
+        fixture.crank_profile.Close(began + 27000 + (i & 255));
+    });
+
+    // The stroke computation in floats, averaging float buffers (what `ina219_OnEvent()` did before fixed point)
+    runner.Run("ina219_OnEvent.StrokeFloat", [&] {
+        uint32_t duration = 27000 + (i++ & 255);
+        BenchKeep(duration);
+        float voltage = fixture.buffer.GetAverage();
+        BenchKeep(fixture.buffer);      // Three averages, as over the three buffers
+        float current = fixture.buffer.GetAverage() * 0.25f;
+        BenchKeep(fixture.buffer);
+        float temperature = fixture.buffer.GetAverage() * 15.f;
+        Data data = ComputeStrokeData(duration, voltage, current, temperature, 123.456f);
+        BenchKeep(data);
+    });
+
+    // What `WebServer::UpdateWithStoredData()` serializes for a new stroke (`RefreshSnapshot()`)
+    char json[256], csv[256];
+    runner.Run("WebServer.SerializeSnapshot", [&] {
+        Data data(1105.f + (i++ & 15), 95.1f, 5.02f, 1.26f, 6.3f, 11.9f, 189.f, 71.5f, 123.456f);
+        BenchKeep(data);
+        size_t length = SerializeDataJSON(data, json, sizeof(json));
+        length += SerializeDataCSV(data, csv, sizeof(csv));
+        BenchKeep(length);
+    });
+
+    BenchKeep(fixture.handled);
+}
+
+
+
+#endif // BENCHMARKS_HPP
\ No newline at end of file
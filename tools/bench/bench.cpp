@@ -0,0 +1,326 @@
+/****************************************************************
+*                                                               *
+*   bench.cpp                                                   *
+*                                                               *
+*   Host benchmarks of the firmware's hot paths.                *
+*                                                               *
+*****************************************************************/
+// Runs the benchmarks of `Benchmarks.hpp` against the host shim, reporting the time per operation (the median of
+// `--passes` passes, each the best of `--repetitions` runs, so that a run slowed down by the scheduler or another
+// process doesn't count), its spread over the passes, and the heap allocations (`operator new`) per operation. Results
+// can be written as CSV with `--csv`, and checked against a stored baseline with `--baseline`: the program exits with
+// status `1` if any benchmark got slower than its baseline time by more than `--tolerance`, and by more than three
+// standard errors of the two medians (from the spread and passes stored with the baseline, so that each benchmark is
+// held to its own run-to-run variance), or allocates more than its baseline did (by over `0.01` allocations per
+// operation, which absorbs amortized container growth).
+// Times are only comparable on the machine the baseline was written on; refresh it with `--write-baseline`.
+// The ESP8266 counterpart, reporting CPU cycles over Serial, is `target/main.cpp` (`pio run -e bench`).
+//
+// Build and run (or use the `bench` target, and `bench_check` to check against `tools/bench/baseline.csv`):
+// ```
+// g++ -std=c++17 -O2 -I host/include -I include -I src -D METRICS_STORAGE=thread_local tools/bench/bench.cpp -o bench
+// ./bench --csv results.csv
+// ./bench --baseline tools/bench/baseline.csv
+// ./bench --write-baseline tools/bench/baseline.csv
+// ```
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+#include "Benchmarks.hpp"
+
+
+
+// Heap allocation counting: every `operator new` is counted while `counting` is set
+static bool counting = false;
+static uint64_t allocations = 0;
+static uint64_t allocated_bytes = 0;
+
+static void* Allocate(size_t size) {
+    if (counting) {
+        allocations++;
+        allocated_bytes += size;
+    }
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new(size_t size) { return Allocate(size); }
+void* operator new[](size_t size) { return Allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return malloc(size == 0 ? 1 : size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return malloc(size == 0 ? 1 : size); }
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete[](void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { free(pointer); }
+
+
+
+// ## BenchResult
+// One benchmark's result.
+struct BenchResult {
+    std::string name;
+    uint64_t iterations;            // Per timed run.
+    double ns_per_op;               // Median of the passes.
+    double spread;                  // Relative standard deviation of the passes.
+    int passes;
+    double allocs_per_op;
+    double bytes_per_op;
+    std::vector<double> times;      // Each pass's time (best of its runs), in `ns/op` (not stored).
+
+    // Returns the relative standard error of `ns_per_op` (that of a median being 1.25 times that of a mean).
+    double Error() const {
+        return passes > 1 ? 1.25 * spread / sqrt((double)passes) : 0;
+    }
+};
+
+
+
+// ## HostRunner
+// Times each benchmark body with the steady clock: in its first pass, the iteration count is doubled until a run takes
+// `min_time / repetitions`; in every pass, `repetitions` runs of that many iterations are timed and the fastest is
+// kept. `RunBenchmarks()` is run once per pass, so a benchmark's passes are several seconds apart: a burst of load on
+// the machine can slow down every run of one pass, but rarely the same benchmark in most passes, which the median
+// leaves out.
+struct HostRunner {
+    double min_time = 0.05;         // In `s`, per benchmark and pass.
+    int repetitions = 9;            // Timed runs per benchmark and pass.
+    double tolerance = 0.15;        // Allowed relative slowdown over the baseline.
+    const std::vector<BenchResult>* baseline = nullptr;
+    std::vector<BenchResult> results;
+
+    // Returns the result of the benchmark called `name` in `list`, or `nullptr` if it isn't there.
+    template <typename List>
+    static auto* Find(List& list, const std::string& name) {
+        for (auto& result : list) {
+            if (result.name == name) {
+                return &result;
+            }
+        }
+        return (decltype(&list[0]))nullptr;
+    }
+
+    // Returns whether `result` is slower than its baseline by more than `tolerance` and than three standard errors of
+    // their difference.
+    bool Slower(const BenchResult& result) const {
+        const BenchResult* base = baseline == nullptr ? nullptr : Find(*baseline, result.name);
+        if (base == nullptr) {
+            return false;
+        }
+        double error = sqrt(base->Error() * base->Error() + result.Error() * result.Error());
+        return result.ns_per_op > base->ns_per_op * (1 + (tolerance > 3 * error ? tolerance : 3 * error));
+    }
+
+    template <typename Body>
+    void Run(const char* name, Body&& body) {
+        BenchResult* result = Find(results, name);
+        if (result == nullptr) {
+            results.push_back({name, 1, 0, 0, 0, 0, 0, {}});
+            result = &results.back();
+        }
+
+        using Clock = std::chrono::steady_clock;
+        double best = 0;
+        bool first = result->times.empty();
+        while (first) {
+            auto began = Clock::now();
+            for (uint64_t i = 0; i < result->iterations; i++) {
+                body();
+            }
+            best = std::chrono::duration<double>(Clock::now() - began).count();
+            if (best >= min_time / repetitions || result->iterations >= (1ull << 40)) {
+                break;
+            }
+            result->iterations *= 2;
+        }
+
+        uint64_t iterations = result->iterations;
+        allocations = allocated_bytes = 0;
+        counting = first;               // Allocations are counted in the first pass only
+        for (int run = 0; run < repetitions; run++) {
+            auto began = Clock::now();
+            for (uint64_t i = 0; i < iterations; i++) {
+                body();
+            }
+            double elapsed = std::chrono::duration<double>(Clock::now() - began).count();
+            best = run == 0 || elapsed < best ? elapsed : best;
+        }
+        counting = false;
+        if (first) {
+            result->allocs_per_op = (double)allocations / ((double)repetitions * iterations);
+            result->bytes_per_op = (double)allocated_bytes / ((double)repetitions * iterations);
+        }
+
+        result->times.push_back(best * 1e9 / iterations);
+        std::vector<double> sorted = result->times;
+        std::sort(sorted.begin(), sorted.end());
+        size_t count = sorted.size();
+        result->passes = (int)count;
+        result->ns_per_op = count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+        double mean = 0, squares = 0;
+        for (double time : sorted) {
+            mean += time / count;
+        }
+        for (double time : sorted) {
+            squares += (time - mean) * (time - mean);
+        }
+        result->spread = count > 1 ? sqrt(squares / (count - 1)) / mean : 0;
+    }
+
+    // ### `HostRunner.Print()`
+    // Prints every result (after the last pass).
+    void Print() const {
+        printf("%-30s %12s %12s %8s %12s %12s\n", "benchmark", "iterations", "ns/op", "spread", "allocs/op", "bytes/op");
+        for (const BenchResult& result : results) {
+            printf("%-30s %12llu %12.1f %7.1f%% %12.2f %12.1f\n", result.name.c_str(),
+                (unsigned long long)result.iterations, result.ns_per_op, result.spread * 100, result.allocs_per_op,
+                result.bytes_per_op);
+        }
+    }
+};
+
+
+
+static bool WriteCSV(const char* path, const std::vector<BenchResult>& results) {
+    FILE* file = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "name,iterations,ns_per_op,spread,passes,allocs_per_op,bytes_per_op\n");
+    for (const BenchResult& result : results) {
+        fprintf(file, "%s,%llu,%.3f,%.4f,%d,%.4f,%.2f\n", result.name.c_str(), (unsigned long long)result.iterations,
+            result.ns_per_op, result.spread, result.passes, result.allocs_per_op, result.bytes_per_op);
+    }
+    if (file != stdout) {
+        fclose(file);
+    }
+    return true;
+}
+
+static bool ReadCSV(const char* path, std::vector<BenchResult>& results) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char line[256];
+    bool header = true;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (header) {
+            header = false;
+            continue;
+        }
+        char name[128];
+        unsigned long long iterations;
+        BenchResult result;
+        if (sscanf(line, "%127[^,],%llu,%lf,%lf,%d,%lf,%lf", name, &iterations, &result.ns_per_op, &result.spread,
+                   &result.passes, &result.allocs_per_op, &result.bytes_per_op) == 7) {
+            result.name = name;
+            result.iterations = iterations;
+            results.push_back(result);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static void Usage() {
+    fprintf(stderr,
+        "Usage: bench [options]\n"
+        "  --csv FILE             Write the results as CSV (- for stdout)\n"
+        "  --baseline FILE        Fail if a benchmark regressed from this baseline\n"
+        "  --tolerance F          Allowed slowdown over the baseline time, or three standard errors if more\n"
+        "                         (default 0.15, i.e. +15%%)\n"
+        "  --write-baseline FILE  Write the results as the new baseline\n"
+        "  --min-time S           Time spent per benchmark and pass, in s (default 0.05)\n"
+        "  --repetitions N        Timed runs per benchmark and pass, the fastest of which is kept (default 9)\n"
+        "  --passes N             Passes over all the benchmarks, the median of which is kept (default 11)\n");
+}
+
+
+
+int main(int argc, char** argv)
+{
+    const char* csv = nullptr;
+    const char* baseline = nullptr;
+    const char* write_baseline = nullptr;
+    HostRunner runner;
+    int passes = 11;
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        const char* value = i + 1 < argc ? argv[++i] : nullptr;
+        bool valid = value != nullptr;
+        if (!valid) { }
+        else if (strcmp(option, "--csv") == 0)              csv = value;
+        else if (strcmp(option, "--baseline") == 0)         baseline = value;
+        else if (strcmp(option, "--write-baseline") == 0)   write_baseline = value;
+        else if (strcmp(option, "--tolerance") == 0)        valid = (runner.tolerance = atof(value)) >= 0;
+        else if (strcmp(option, "--min-time") == 0)         valid = (runner.min_time = atof(value)) > 0;
+        else if (strcmp(option, "--repetitions") == 0)      valid = (runner.repetitions = atoi(value)) > 0;
+        else if (strcmp(option, "--passes") == 0)           valid = (passes = atoi(value)) > 0;
+        else                                                valid = false;
+        if (!valid) {
+            Usage();
+            return 2;
+        }
+    }
+
+    std::vector<BenchResult> expected;
+    if (baseline != nullptr && !ReadCSV(baseline, expected)) {
+        fprintf(stderr, "Cannot read %s\n", baseline);
+        return 2;
+    }
+    runner.baseline = baseline != nullptr ? &expected : nullptr;
+
+    for (int pass = 0; pass < passes; pass++) {
+        printf("# pass %d of %d\n", pass + 1, passes);
+        fflush(stdout);
+        RunBenchmarks(runner);
+    }
+    runner.Print();
+
+    if (csv != nullptr && !WriteCSV(csv, runner.results)) {
+        fprintf(stderr, "Cannot write %s\n", csv);
+        return 2;
+    }
+    if (write_baseline != nullptr && !WriteCSV(write_baseline, runner.results)) {
+        fprintf(stderr, "Cannot write %s\n", write_baseline);
+        return 2;
+    }
+    if (baseline == nullptr) {
+        return 0;
+    }
+
+    size_t regressions = 0;
+    for (const BenchResult& base : expected) {
+        const BenchResult* result = nullptr;
+        for (const BenchResult& r : runner.results) {
+            if (r.name == base.name) {
+                result = &r;
+            }
+        }
+        if (result == nullptr) {
+            fprintf(stderr, "%s: in the baseline but not run\n", base.name.c_str());
+            continue;
+        }
+        if (runner.Slower(*result)) {
+            fprintf(stderr, "%s: REGRESSED, %.1f ns/op (baseline %.1f, spreads %.1f%% and %.1f%%)\n",
+                base.name.c_str(), result->ns_per_op, base.ns_per_op, base.spread * 100, result->spread * 100);
+            regressions++;
+        }
+        if (result->allocs_per_op > base.allocs_per_op + 0.01) {
+            fprintf(stderr, "%s: REGRESSED, %.2f allocations/op (baseline %.2f)\n",
+                base.name.c_str(), result->allocs_per_op, base.allocs_per_op);
+            regressions++;
+        }
+    }
+    fprintf(stderr, "%lu regression(s) against %s\n", (unsigned long)regressions, baseline);
+    return regressions > 0 ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+/****************************************************************
+*                                                               *
+*   fixed_check.cpp                                             *
+*                                                               *
+*   Bounds the error of the fixed-point derivations.            *
+*                                                               *
+*****************************************************************/
+// Compares the firmware's scaled-integer derivations with their floating-point references over the whole range
+// of the INA219's registers and of stroke durations from `1 ms` to `2 s`:
+// - `INA219::Read()` (`InferResistanceFixed()`, `InferTemperatureFixed()`) against the float chain it replaced,
+//   from the same raw register values (as the Adafruit driver's float getters scale them)
+// - `ComputeStrokeDataFixed()` against `ComputeStrokeData()`, from the same averages
+// - `FixedSample::FromSample(fixed.ToSample())` giving `fixed` back (what keeps replays of recorded runs exact)
+// For every quantity, the difference closest to its bound, `absolute + relative × |reference|`, is printed with the
+// reference value it was seen at and the percentage of the bound it used.
+// The program exits with status `1` if any bound is exceeded.
+//
+// Build and run (or use the `fixed_check` target, and `fixed_check_run` to run it):
+// ```
+// g++ -std=c++17 -O2 -I host/include -I include -I src -D METRICS_STORAGE=thread_local tools/fixed_check/fixed_check.cpp -o fixed_check
+// ./fixed_check
+// ```
+#include <stdio.h>
+#include <math.h>
+#include "Engine.h"
+#include "Sensors.h"
+
+
+
+// ## ErrorBound
+// The difference closest to (or furthest over) its bound, `absolute + relative × |reference|`, seen for one quantity.
+struct ErrorBound {
+    const char* name;
+    const char* unit;
+    double absolute;
+    double relative;
+    double worst = 0;               // The difference, in `unit`.
+    double worst_reference = 0;     // The reference value it was seen at.
+    double worst_ratio = 0;         // The difference over its bound (> 1 if exceeded).
+    uint64_t checks = 0;
+
+    ErrorBound(const char* name, const char* unit, double absolute, double relative)
+        : name(name), unit(unit), absolute(absolute), relative(relative) { }
+
+    // ### `ErrorBound.Check()`
+    // Compares `value` with `reference`, allowing `extra` more relative error for this one.
+    void Check(double value, double reference, double extra = 0) {
+        checks++;
+        if (!isfinite(reference) && (value == reference || (isnan(value) && isnan(reference)))) {
+            return;
+        }
+        double difference = fabs(value - reference);
+        double bound = absolute + (relative + extra) * fabs(reference);
+        double ratio = difference == 0 ? 0 : (isnan(difference) || bound == 0) ? INFINITY : difference / bound;
+        if (ratio > worst_ratio || checks == 1) {
+            worst_ratio = ratio;
+            worst = difference;
+            worst_reference = reference;
+        }
+    }
+
+    bool Print() const {
+        bool passed = worst_ratio <= 1;
+        printf("%-22s %9llu  %10.3g %-4s at %-12.6g %5.0f%%   %g %s + %g × |x|  %s\n",
+            name, (unsigned long long)checks, worst, unit, worst_reference, worst_ratio * 100, absolute, unit, relative,
+            passed ? "ok" : "EXCEEDED");
+        return passed;
+    }
+};
+
+
+
+int main()
+{
+    // `INA219::Read()`: the float chain works from registers the driver already scaled to floats, so the fixed
+    // chain can only differ by its own rounding (half a `µΩ`, half a hundredth of a °F) and the float's
+    ErrorBound power("INA219 power", "W", 1e-9, 2.5e-7);
+    ErrorBound current("INA219 current", "A", 1e-9, 2.5e-7);
+    ErrorBound voltage("INA219 voltage", "V", 4e-6, 2.5e-7);         // The float sum's rounding, up to 32 V
+    ErrorBound resistance("INA219 resistance", "Ω", 0.5e-6, 2e-6);
+    ErrorBound temperature("INA219 temperature", "°F", 0.0055, 1e-6);
+    for (int32_t bus = 0; bus <= 8191; bus++) {                         // Bus voltage register (4 mV units)
+        for (int32_t power_raw = 1; power_raw <= 32767; power_raw += 1 + power_raw / 8) {
+            for (int32_t shunt_raw = -32000; shunt_raw <= 32000; shunt_raw += 8000) {
+                int32_t current_raw = shunt_raw;     // 0.1 Ω shunt
+                float bus_V = bus * 4 * 0.001f, shunt_mV = shunt_raw * 0.01f;
+                float power_mW = power_raw * 2.f, current_mA = current_raw / 10.f;
+
+                Sample reference;
+                reference.power = power_mW / 1000.f;
+                reference.current = current_mA / 1000.f;
+                reference.voltage = bus_V + shunt_mV / 1000.f;
+                reference.resistance = INA219::InferResistance(reference.voltage, reference.power);
+                reference.temperature = INA219::InferTemperature(reference.resistance);
+
+                FixedSample fixed;
+                fixed.power = power_raw * INA219_POWER_LSB;
+                fixed.current = current_raw * INA219_CURRENT_LSB;
+                fixed.voltage = bus * 4 * 1000 + shunt_raw * 10;
+                fixed.resistance = INA219::InferResistanceFixed(fixed.voltage, fixed.power);
+                fixed.temperature = INA219::InferTemperatureFixed(fixed.resistance);
+                if (fixed.resistance == INT32_MAX) {
+                    continue;       // Saturated (over 2147 Ω)
+                }
+
+                Sample sample = fixed.ToSample();
+                power.Check(sample.power, reference.power);
+                current.Check(sample.current, reference.current);
+                voltage.Check(sample.voltage, reference.voltage);
+                resistance.Check(fixed.resistance * 1e-6, reference.resistance);
+                temperature.Check(fixed.temperature * 0.01, reference.temperature);
+            }
+        }
+    }
+
+    // `ComputeStrokeDataFixed()`: speed is rounded to 1/128 RPM, and the quantities computed from it (∝ RPM² and RPM³)
+    // also carry 2 and 3 times its relative rounding (`1/256 RPM ÷ speed`, e.g. `3.6e-6` at 1100 RPM), which each
+    // check allows on top of its bound; efficiency also carries powerin's rounding to the µW, so it is only compared
+    // from 10 mW in
+    ErrorBound speed("Stroke speed", "RPM", 1.0 / 256, 1e-6);
+    ErrorBound torque("Stroke torque", "N·mm", 0.0005, 2e-6);
+    ErrorBound powerin("Stroke powerin", "W", 0.5e-6, 1e-6);
+    ErrorBound powerout("Stroke powerout", "W", 0.5e-6 / 256, 2e-6);
+    ErrorBound efficiency("Stroke efficiency", "%", 1e-4, 2e-6);
+    ErrorBound stroke_temperature("Stroke temperature", "°F", 0, 1e-7);
+    const int32_t voltages[] = {0, 1000, 3300000, 5120000, 6600000, 12000000, 18000000, 32000000};
+    const int32_t currents[] = {-3200000, -500, 0, 700, 250000, 1200000, 3200000};
+    for (uint32_t duration = 1000; duration <= 2000000; duration += 1 + duration / 1000) {
+        for (int32_t v : voltages) {
+            for (int32_t c : currents) {
+                int32_t t = 6800 + (int32_t)(duration % 20000);
+                Data fixed = ComputeStrokeDataFixed(duration, v, c, t, 1.f);
+                Data reference = ComputeStrokeData(duration, v * 1e-6f, c * 1e-6f, t * 0.01f, 1.f);
+                double rounding = (1.0 / 256) / reference.speed;
+                speed.Check(fixed.speed, reference.speed);
+                torque.Check(fixed.torque, reference.torque, 2 * rounding);
+                powerin.Check(fixed.powerin, reference.powerin);
+                powerout.Check(fixed.powerout, reference.powerout, 3 * rounding);
+                if (fabs(reference.powerin) >= 0.01) {
+                    efficiency.Check(fixed.efficiency, reference.efficiency, 3 * rounding + 0.5e-6 / fabs(reference.powerin));
+                }
+                stroke_temperature.Check(fixed.temperature, reference.temperature);
+            }
+        }
+    }
+
+    // Round trip of recorded readings: exact up to 2^22 units, within the float conversions' rounding above
+    ErrorBound round_trip_small("Round trip <= 2^22", "unit", 0, 0);
+    ErrorBound round_trip_large("Round trip > 2^22", "unit", 0, 2e-7);
+    for (int64_t value = -(1 << 25); value <= (1 << 25); value += 1 + (value < 0 ? -value : value) / 4096) {
+        FixedSample fixed = {0, (int32_t)value, (int32_t)value, (int32_t)value, (int32_t)value, (int32_t)value};
+        FixedSample back = FixedSample::FromSample(fixed.ToSample());
+        ErrorBound& bound = (value < 0 ? -value : value) <= (1 << 22) ? round_trip_small : round_trip_large;
+        bound.Check(back.voltage, value);
+        bound.Check(back.temperature, value);
+    }
+
+    printf("%-22s %9s  %-32s %6s   %s\n", "quantity", "checks", "error", "bound", "allowed");
+    bool passed = true;
+    for (const ErrorBound* bound : {&power, &current, &voltage, &resistance, &temperature, &speed, &torque,
+                                    &powerin, &powerout, &efficiency, &stroke_temperature,
+                                    &round_trip_small, &round_trip_large}) {
+        passed &= bound->Print();
+    }
+    return passed ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,165 @@
+/****************************************************************
+*                                                               *
+*   replay.cpp                                                  *
+*                                                               *
+*   Host-side replay of recorded engine runs.                   *
+*                                                               *
+*****************************************************************/
+// Plays a run log downloaded from the firmware's `/runs` endpoint back through the same event pipeline and
+// stroke analysis the firmware uses (`EventEmitter`, `INA219`, `StrokeAnalyzer`), as fast as the
+// file can be read, and writes the recomputed strokes as CSV on stdout (`STROKE_CSV_HEADER` columns).
+// Two builds given the same run produce identical CSV unless the pipeline's results changed, so diffing their
+// output is a regression check. With `--compare`, the recomputed strokes are also checked against the strokes
+// the firmware recorded, and the program exits with status `1` if any differ.
+//
+// Build and run:
+// ```
+// g++ -std=c++17 -O2 -I host/include -I include -I src tools/replay/replay.cpp -o replay
+// curl -o run.bin http://192.168.4.1/runs/00001.bin
+// ./replay run.bin > strokes.csv
+// ./replay --compare run.bin > /dev/null
+// ```
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "Events.h"
+#include "Engine/StrokeAnalyzer.hpp"
+#include "Sensors/INA219.hpp"
+#include "Telemetry/RunLogFormat.hpp"
+#include "Telemetry/RunLogReplay.hpp"
+#include "WebServer/Data.hpp"
+#include "WebServer/Serialize.hpp"
+
+
+
+// ### `SameStroke()`
+// Checks that two strokes agree on every recorded value (`elapsed` is not recorded).
+static bool SameStroke(const Data& a, const Data& b) {
+    return a.speed == b.speed && a.torque == b.torque && a.voltage == b.voltage && a.current == b.current
+        && a.powerin == b.powerin && a.powerout == b.powerout && a.efficiency == b.efficiency
+        && a.temperature == b.temperature;
+}
+
+
+
+int main(int argc, char** argv)
+{
+    bool compare = false;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--compare") == 0) {
+            compare = true;
+        }
+        else {
+            path = argv[i];
+        }
+    }
+
+    FILE* input = stdin;
+    if (path != nullptr) {
+        input = fopen(path, "rb");
+        if (input == nullptr) {
+            fprintf(stderr, "Cannot open %s\n", path);
+            return 2;
+        }
+    }
+
+    EventEmitter event_emitter;
+    INA219 ina219(event_emitter, 0, 0);
+    RunLogReplay replay(event_emitter, ina219);
+
+    RunLogHeader header;
+    if (fread(&header, sizeof(header), 1, input) != 1 || !replay.Begin(header)) {
+        fprintf(stderr, "Not a run log (version %d)\n", RUN_LOG_VERSION);
+        return 2;
+    }
+    if (!(header.flags & RUN_LOG_FLAG_SAMPLES)) {
+        fprintf(stderr, "Run %lu was recorded without samples; stroke averages will be 0\n", (unsigned long)header.run);
+    }
+
+    // Same stroke analysis as the firmware's `stroke_analyzer`, which skips strokes whose rising edge was not
+    // recorded (e.g. the switch was already HIGH at boot)
+    std::vector<StrokeRecord> recorded, replayed;
+    bool have_rise = false;
+    uint32_t first_rise = 0;
+    StrokeAnalyzer stroke_analyzer(event_emitter);
+    ina219.AddSampleListener(&stroke_analyzer);
+    stroke_analyzer.SetOnStroke([&](const StrokeAnalysis& stroke) {
+        Data data = stroke.data;
+        data.elapsed = replay.elapsed / 1000000.0;
+        replayed.push_back({stroke.time, data});
+    });
+    ina219.RegisterForEvents({EventType::SWITCH1_STATE_CHANGE_TO_HIGH});
+    ina219.SetOnEvent([&](const Event& event) {
+        if (!have_rise) {
+            first_rise = event.time;
+            have_rise = true;
+        }
+    });
+
+    printf("%s", STROKE_CSV_HEADER);
+    char row[SERIALIZED_DATA_MAX_LENGTH];
+    size_t printed = 0;
+    RunLogRecord record;
+    while (fread(&record, sizeof(record), 1, input) == 1) {
+        if (replay.Play(record) == RunLogRecordType::STROKE) {
+            Data data;
+            data.speed = record.stroke.speed;
+            data.torque = record.stroke.torque;
+            data.voltage = record.stroke.voltage;
+            data.current = record.stroke.current;
+            data.powerin = record.stroke.powerin;
+            data.powerout = record.stroke.powerout;
+            data.efficiency = record.stroke.efficiency;
+            data.temperature = record.stroke.temperature;
+            data.elapsed = 0;
+            recorded.push_back({record.time, data});
+        }
+        for (; printed < replayed.size(); printed++) {
+            if (SerializeRecordCSV(replayed[printed], row, sizeof(row)) > 0) {
+                fputs(row, stdout);
+            }
+        }
+    }
+
+    fprintf(stderr, "Run %lu: %lu edges, %lu samples, %lu strokes replayed in %.1f s of recording",
+        (unsigned long)header.run, (unsigned long)replay.edges, (unsigned long)replay.samples,
+        (unsigned long)replayed.size(), replay.elapsed / 1000000.0);
+    if (replay.missing > 0) {
+        fprintf(stderr, ", %lu records missing", (unsigned long)replay.missing);
+    }
+    fprintf(stderr, "\n");
+    if (!compare) {
+        return 0;
+    }
+
+    // Pair replayed and recorded strokes by their end time (the falling edge's `time`)
+    size_t matched = 0, differing = 0, unmatched = 0;
+    size_t r = 0;
+    for (const StrokeRecord& stroke : recorded) {
+        if (!have_rise || (int32_t)(stroke.time - first_rise) < 0) {
+            continue;       // Started before the recording did
+        }
+        while (r < replayed.size() && (int32_t)(replayed[r].time - stroke.time) < 0) {
+            r++;
+        }
+        if (r == replayed.size() || replayed[r].time != stroke.time) {
+            unmatched++;
+            continue;
+        }
+        if (SameStroke(replayed[r].data, stroke.data)) {
+            matched++;
+        }
+        else {
+            differing++;
+            if (differing <= 10) {
+                fprintf(stderr, "Stroke at %lu differs: recorded speed %.7g, replayed %.7g\n",
+                    (unsigned long)stroke.time, stroke.data.speed, replayed[r].data.speed);
+            }
+        }
+        r++;
+    }
+    fprintf(stderr, "%lu recorded strokes: %lu identical, %lu differ, %lu not replayed\n",
+        (unsigned long)recorded.size(), (unsigned long)matched, (unsigned long)differing, (unsigned long)unmatched);
+    return (differing > 0 || unmatched > 0) ? 1 : 0;
+}
\ No newline at end of file
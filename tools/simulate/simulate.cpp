@@ -0,0 +1,290 @@
+/****************************************************************
+*                                                               *
+*   simulate.cpp                                                *
+*                                                               *
+*   Runs the firmware pipeline against a simulated engine.      *
+*                                                               *
+*****************************************************************/
+// Drives the real `Switch`, `INA219`, `StrokeAnalyzer` and (optionally) `SerialTelemetry` with a physics model of the
+// engine (`host/sim/EngineModel.hpp`) on a virtual clock, and reports how well the firmware kept up: detected vs
+// true strokes, rpm error (of the strokes and of the `Tachometer`), edge detection delay, INA219 readings per stroke and telemetry packets dropped.
+// With `--strokes`, every stroke is also written as CSV on stdout, and with `--profile`, the run's `CrankProfile`
+// (after the strokes, if both are given). With `--capture`, a `BurstCapture` is armed and its readings are written as
+// CSV on stdout last (and the exported capture to a file with `--capture-out`). With `--controller`, a
+// `SolenoidController` drives the coil instead of the switch, with the advance and dwell given in degrees, and with
+// `--tune`, a `TimingTuner` searches for the most efficient ones (starting from them), and its table is reported.
+// The `Watchdog`'s faults and the time in each `EngineState` are reported; `--jam` and `--i2c-fail` cause a stall or
+// I2C failure to check them. The `ThermalModel`'s error is reported next to that of the strokes' inferred
+// temperature it filters, with how long before the coil reached the limit it predicted it would. The
+// `SpectralMonitor`'s bands are reported as of its last block; `--foul` fouls the switch's contact, to check that it notices.
+//
+// Build and run (or use the `simulate` CMake target):
+// ```
+// g++ -std=c++17 -O2 -I host/include -I host/sim -I include -I src -D METRICS_STORAGE=thread_local tools/simulate/simulate.cpp -o simulate
+// ./simulate --duration 60                                         # Bench engine, ~740 RPM
+// ./simulate --supply 9 --tune --duration 120                      # Finds the most efficient timing itself
+// ./simulate --supply 18 --load 1e-7 --telemetry 921600            # ~10000 RPM, 13x the bench engine's stroke rate
+// ./simulate --supply 18 --load 1e-7 --controller --advance 60     # ~12000 RPM, with the coil timed 60° early
+// ./simulate --duration 10 --jam 5                                 # Stalls with the coil on halfway through
+// ./simulate --supply 12 --duration 600                            # Heats the coil past the over-temperature limit
+// ./simulate --duration 60 --foul 30                               # Fouls the switch halfway through (the even orders grow)
+// ```
+// The reported efficiency is only the model's with the default `--load` (the one the firmware's power-out formula
+// assumes); the light loads above are for the firmware's timing at high stroke rates.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Session.hpp"
+
+
+
+static void Usage() {
+    fprintf(stderr,
+        "Usage: simulate [options]\n"
+        "  --duration S        Simulated time, in s (default 60)\n"
+        "  --supply V          Supply voltage (default 6.6)\n"
+        "  --inductance H      Coil inductance (default 0.005)\n"
+        "  --inertia KGM2      Crank inertia (default 1e-4)\n"
+        "  --load NMS2         Load torque per speed squared (default 6.4e-6, as the firmware's power-out formula)\n"
+        "  --friction NMS      Viscous friction on top of the load (default 0)\n"
+        "  --temperature C     Initial coil temperature (default 20)\n"
+        "  --switch-ms MS      Switch polling interval (default 1)\n"
+        "  --sample-ms MS      INA219 polling interval (default 1.5)\n"
+        "  --buffer N          SensorBuffer size (default 20)\n"
+        "  --tach-window N     Tachometer window, in revolutions (default 8)\n"
+        "  --telemetry BAUD    Enable serial telemetry at BAUD\n"
+        "  --start US          Initial clock value, in us (e.g. 4294000000 to cross the micros() wrap)\n"
+        "  --seed N            Noise seed (default 1)\n"
+        "  --strokes           Write every stroke as CSV on stdout\n"
+        "  --profile           Write the current vs crank angle profile as CSV on stdout\n"
+        "  --capture TRIGGER   Arm a burst capture (rising, falling, edge, current, temperature) and write it as CSV\n"
+        "  --capture-level X   Its current (A) or temperature (F) trigger level\n"
+        "  --capture-at S      When to arm it, in s (default 1)\n"
+        "  --capture-out FILE  Also write the exported capture (as served by /capture) to FILE\n"
+        "  --controller        Drive the coil with a SolenoidController instead of the switch\n"
+        "  --advance DEG       Its advance, in crank degrees before the switch closes (default 0)\n"
+        "  --dwell DEG         Its dwell, in crank degrees (default 180)\n"
+        "  --tune              Tune the controller's timing for efficiency (implies --controller), from --advance and\n"
+        "                      --dwell if given (default -30 and 120, the centre of the tuner's range)\n"
+        "  --jam S             Jam the crank at the first rising edge after S seconds\n"
+        "  --i2c-fail S        Make the INA219's I2C transactions fail from S seconds on\n"
+        "  --foul S            Foul the switch's contact over the middle of the stroke from S seconds on\n"
+        "  --foul-ohms OHM     Its added resistance, in ohms (default 2)\n");
+}
+
+static void Print(const char* name, const Statistic& statistic, const char* unit) {
+    fprintf(stderr, "  %-18s mean %10.3f  sd %9.3f  min %10.3f  max %10.3f %s\n",
+        name, statistic.mean, statistic.Deviation(),
+        statistic.count ? statistic.min : 0, statistic.count ? statistic.max : 0, unit);
+}
+
+
+
+int main(int argc, char** argv)
+{
+    SessionConfig config;
+    bool strokes = false;
+    bool profile = false;
+    double capture_level = 0;
+    const char* capture_out = nullptr;
+    const char* advance = nullptr;
+    const char* dwell = nullptr;
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(option, "--strokes") == 0) {
+            strokes = true;
+            continue;
+        }
+        if (strcmp(option, "--profile") == 0) {
+            profile = true;
+            continue;
+        }
+        if (strcmp(option, "--controller") == 0) {
+            config.controller = true;
+            continue;
+        }
+        if (strcmp(option, "--tune") == 0) {
+            config.controller = config.tuner = true;
+            continue;
+        }
+        if (value == nullptr) {
+            Usage();
+            return 2;
+        }
+        i++;
+        if (strcmp(option, "--duration") == 0)          config.duration = atof(value);
+        else if (strcmp(option, "--supply") == 0)       config.engine.supply_voltage = atof(value);
+        else if (strcmp(option, "--inductance") == 0)   config.engine.coil_inductance = atof(value);
+        else if (strcmp(option, "--inertia") == 0)      config.engine.inertia = atof(value);
+        else if (strcmp(option, "--load") == 0)         config.engine.load_coefficient = atof(value);
+        else if (strcmp(option, "--friction") == 0)     config.engine.viscous_friction = atof(value);
+        else if (strcmp(option, "--temperature") == 0)  config.engine.initial_temperature = atof(value);
+        else if (strcmp(option, "--switch-ms") == 0)    config.switch_interval = atoi(value);
+        else if (strcmp(option, "--sample-ms") == 0)    config.sample_interval = atoi(value);
+        else if (strcmp(option, "--tach-window") == 0)  config.tachometer_window = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--buffer") == 0)       config.sensor_buffer_size = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--start") == 0)        config.start_time = strtoull(value, nullptr, 10);
+        else if (strcmp(option, "--seed") == 0)         config.engine.seed = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--capture-level") == 0) capture_level = atof(value);
+        else if (strcmp(option, "--capture-at") == 0)   config.capture_at = atof(value);
+        else if (strcmp(option, "--capture-out") == 0)  capture_out = value;
+        else if (strcmp(option, "--advance") == 0)      advance = value;
+        else if (strcmp(option, "--dwell") == 0)        dwell = value;
+        else if (strcmp(option, "--jam") == 0)          config.jam_at = atof(value);
+        else if (strcmp(option, "--i2c-fail") == 0)     config.i2c_fail_at = atof(value);
+        else if (strcmp(option, "--foul") == 0)         config.foul_at = atof(value);
+        else if (strcmp(option, "--foul-ohms") == 0)    config.foul_resistance = atof(value);
+        else if (strcmp(option, "--capture") == 0) {
+            config.capture = true;
+            if (!ParseBurstTrigger(value, config.capture_trigger)) {
+                Usage();
+                return 2;
+            }
+        }
+        else if (strcmp(option, "--telemetry") == 0) {
+            config.telemetry = true;
+            config.telemetry_baud = strtoul(value, nullptr, 10);
+        }
+        else {
+            Usage();
+            return 2;
+        }
+    }
+
+    // The controller's timing, or the tuner's start (from the centre of its range unless given)
+    config.controller_advance = advance ? atof(advance) : config.tuner ? TIMING_TUNER_START_ADVANCE : 0;
+    config.controller_dwell = dwell ? atof(dwell) : config.tuner ? TIMING_TUNER_START_DWELL : 180;
+    config.capture_level = (int32_t)lround(capture_level * (config.capture_trigger == BurstTrigger::OVER_TEMPERATURE ? 100 : 1e6));
+
+    Session session(config);
+    if (strokes) {
+        printf("time,true_rpm,speed,edge_delay,samples,torque,voltage,current,powerin,powerout,efficiency,temperature,elapsed\n");
+        session.on_stroke = [](const SimulatedStroke& stroke) {
+            const Data& data = stroke.record.data;
+            printf("%lu,%.7g,%.7g,%.1f,%lu,%.7g,%.7g,%.7g,%.7g,%.7g,%.7g,%.7g,%.7g\n",
+                (unsigned long)stroke.record.time, stroke.true_rpm, data.speed, stroke.edge_delay,
+                (unsigned long)stroke.samples, data.torque, data.voltage, data.current, data.powerin,
+                data.powerout, data.efficiency, data.temperature, data.elapsed);
+        };
+    }
+    uint32_t profile_strokes = 0, profile_skipped = 0;
+    session.on_profile = [&](const CrankProfile& crank_profile) {
+        profile_strokes = crank_profile.strokes;
+        profile_skipped = crank_profile.skipped;
+        if (profile) {
+            printf("angle,mean,peak\n");
+            for (size_t bin = 0; bin < CRANK_PROFILE_BINS; bin++) {
+                printf("%g,%.6g,%.6g\n", CrankProfile::Angle(bin), crank_profile.Mean(bin), crank_profile.Peak(bin));
+            }
+        }
+    };
+    CaptureState capture_state = CaptureState::IDLE;
+    size_t capture_count = 0, capture_pre = 0;
+    session.on_capture = [&](const BurstCapture& capture) {
+        capture_state = capture.State();
+        capture_count = capture.Count();
+        capture_pre = capture.PreTrigger();
+        BurstHeader header = capture.Header();
+        printf("index,time,since_trigger,voltage,current,power\n");
+        for (size_t i = 0; i < capture.Count(); i++) {
+            FixedSample sample = INA219::Derive(capture.At(i));
+            printf("%ld,%lu,%ld,%.6f,%.4f,%.3f\n", (long)i - (long)capture_pre, (unsigned long)sample.time,
+                (long)(int32_t)(sample.time - header.trigger_time), sample.voltage * 1e-6, sample.current * 1e-6,
+                sample.power * 1e-6);
+        }
+        if (capture_out != nullptr) {
+            FILE* file = fopen(capture_out, "wb");
+            if (file == nullptr) {
+                fprintf(stderr, "Cannot write %s\n", capture_out);
+                return;
+            }
+            uint8_t buffer[500];        // Copied out in pieces, as a chunked response would
+            size_t copied;
+            for (size_t offset = 0; (copied = capture.Copy(offset, buffer, sizeof(buffer))) > 0; offset += copied) {
+                fwrite(buffer, 1, copied, file);
+            }
+            fclose(file);
+        }
+    };
+    TimingEntry timing_table[TIMING_TUNER_BINS] = {};
+    session.on_tuner = [&](const TimingTuner& tuner) {
+        for (size_t bin = 0; bin < TIMING_TUNER_BINS; bin++) {
+            timing_table[bin] = tuner.Entry(bin);
+        }
+    };
+    SessionStats stats = session.Run();
+
+    fprintf(stderr, "Simulated %.1f s: %lu strokes, %lu detected (%lu missed)\n",
+        config.duration, (unsigned long)stats.true_strokes, (unsigned long)stats.strokes,
+        (unsigned long)(stats.true_strokes > stats.strokes ? stats.true_strokes - stats.strokes : 0));
+    Print("true rpm", stats.true_rpm, "RPM");
+    Print("measured rpm", stats.rpm, "RPM");
+    Print("rpm error", stats.rpm_error, "%");
+    Print("tachometer rpm", stats.tachometer_rpm, "RPM");
+    Print("tachometer error", stats.tachometer_rpm_error, "%");
+    Print("acceleration", stats.tachometer_acceleration, "rad/s2");
+    Print("edge delay", stats.edge_delay, "us");
+    Print("readings/stroke", stats.samples, "");
+    Print("efficiency", stats.efficiency, "%");
+    Print("thermal error", stats.temperature_error, "C");
+    Print("stroke temp error", stats.stroke_temperature_error, "C");
+    fprintf(stderr, "  crank profile: %lu strokes, %lu skipped\n",
+        (unsigned long)profile_strokes, (unsigned long)profile_skipped);
+    if (config.capture) {
+        fprintf(stderr, "  burst capture: %s, %lu readings (%lu before the trigger)\n",
+            CaptureStateName(capture_state), (unsigned long)capture_count, (unsigned long)capture_pre);
+    }
+    if (config.controller) {
+        fprintf(stderr, "  controller: %lu coil pulses (%lu late), latency up to %lu ns\n",
+            (unsigned long)stats.coil_pulses, (unsigned long)stats.coil_pulses_late, (unsigned long)stats.coil_latency_max);
+    }
+    if (config.tuner) {
+        fprintf(stderr, "  tuner: advance %g, dwell %g degrees after %lu windows (%lu improvements)\n",
+            stats.tuned_advance, stats.tuned_dwell, (unsigned long)stats.tuner_windows,
+            (unsigned long)stats.tuner_improvements);
+        for (size_t bin = 0; bin < TIMING_TUNER_BINS; bin++) {
+            const TimingEntry& entry = timing_table[bin];
+            if (entry.updates > 0) {
+                fprintf(stderr, "    %5lu RPM up: advance %g, dwell %g degrees, efficiency %.3f%% (%lu updates)\n",
+                    (unsigned long)TimingTuner::BinSpeed(bin), entry.advance, entry.dwell, entry.efficiency,
+                    (unsigned long)entry.updates);
+            }
+        }
+    }
+    fprintf(stderr, "  watchdog: %lu stalls, %lu over-runs, %lu silences, %lu I2C failures; INA219 %s at the end\n",
+        (unsigned long)stats.stalls, (unsigned long)stats.overruns, (unsigned long)stats.silences,
+        (unsigned long)stats.i2c_faults, stats.polling ? "polling" : "stopped");
+    fprintf(stderr, "  engine states (%lu changes):", (unsigned long)stats.state_changes);
+    for (size_t state = 0; state < (size_t)EngineState::ENGINE_STATE_COUNT; state++) {
+        fprintf(stderr, " %s %.2f s%s", EngineStateName((EngineState)state), stats.state_time[state],
+            state + 1 < (size_t)EngineState::ENGINE_STATE_COUNT ? "," : "\n");
+    }
+    if (stats.stall_delay >= 0) {
+        fprintf(stderr, "  stall detected %.1f ms after the jam\n", stats.stall_delay * 1000);
+    }
+    if (stats.overheat_warnings > 0 || stats.overheat_at >= 0) {
+        fprintf(stderr, "  overheat: %lu warnings, first at %.1f s; coil at the limit %s%.1f s\n",
+            (unsigned long)stats.overheat_warnings, stats.overheat_predicted_at,
+            stats.overheat_at >= 0 ? "at " : "never in ", stats.overheat_at >= 0 ? stats.overheat_at : config.duration);
+    }
+    fprintf(stderr, "  spectrum: %lu blocks, %lu bands exceeded",
+        (unsigned long)stats.spectral_blocks, (unsigned long)stats.spectral_alerts);
+    if (stats.spectral_alert_at >= 0) {
+        fprintf(stderr, ", first order %g at %.1f s", stats.spectral_alert_order, stats.spectral_alert_at);
+    }
+    fprintf(stderr, "\n");
+    for (size_t band = 0; band < SPECTRAL_BANDS; band++) {
+        const SpectralBand& b = stats.spectral_bands[band];
+        fprintf(stderr, "    order %-4g %7.2f Hz: %8.4f A (baseline %8.4f A)%s\n",
+            b.order, b.frequency, b.magnitude, b.baseline, b.exceeded ? ", exceeded" : "");
+    }
+    fprintf(stderr, "  final: %.0f RPM, coil %.1f C (%.1f C estimated); %lu ticker callbacks\n",
+        stats.final_rpm, stats.final_temperature, stats.estimated_temperature, (unsigned long)stats.ticker_callbacks);
+    if (config.telemetry) {
+        fprintf(stderr, "  telemetry: %lu packets sent, %lu dropped\n",
+            (unsigned long)stats.telemetry_sent, (unsigned long)stats.telemetry_dropped);
+    }
+    return 0;
+}
\ No newline at end of file
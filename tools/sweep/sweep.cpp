@@ -0,0 +1,186 @@
+/****************************************************************
+*                                                               *
+*   sweep.cpp                                                   *
+*                                                               *
+*   Parallel parameter sweep over the engine simulator.         *
+*                                                               *
+*****************************************************************/
+// Runs one simulated session (`host/sim/Session.hpp`) for every combination of the given supply voltages, initial
+// coil temperatures, INA219 polling intervals, `SensorBuffer` sizes and telemetry baud rates (times `--repeats`),
+// spread over all cores by a `WorkStealingPool`, and writes one CSV row of rpm, efficiency and timing-error
+// statistics per session on stdout, in configuration order. Each session's seed is derived from `--seed` and the
+// session's index only, so the output is identical whatever the number of threads; besides the measurement noise, it
+// sets the crank's initial angle and the switch polling's phase, so the `--repeats` of a configuration differ in
+// timing too.
+//
+// Each parameter takes a comma-separated list of values and `start:stop:step` ranges. Build and run (or use the
+// `sweep` CMake target):
+// ```
+// g++ -std=c++17 -O2 -pthread -I host/include -I host/sim -I include -I src -D METRICS_STORAGE=thread_local tools/sweep/sweep.cpp -o sweep
+// ./sweep --supply 5:9:0.5 --temperature 20,60,100 --sample-ms 1,2,5 --buffer 5,20,50 --telemetry 0,921600 > sweep.csv
+// ```
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "Session.hpp"
+#include "WorkStealingPool.hpp"
+
+
+
+// ### `ParseList()`
+// Parses a comma-separated list of values and `start:stop:step` ranges (inclusive).
+static bool ParseList(const char* text, std::vector<double>& values) {
+    values.clear();
+    std::string list(text);
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        size_t end = list.find(',', begin);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string item = list.substr(begin, end - begin);
+        double start, stop, step;
+        if (sscanf(item.c_str(), "%lf:%lf:%lf", &start, &stop, &step) == 3) {
+            if (step <= 0 || stop < start) {
+                return false;
+            }
+            size_t count = (size_t)floor((stop - start) / step + 1e-9) + 1;
+            for (size_t i = 0; i < count; i++) {
+                values.push_back(start + i * step);
+            }
+        }
+        else {
+            char* rest;
+            double value = strtod(item.c_str(), &rest);
+            if (item.empty() || *rest != '\0') {
+                return false;
+            }
+            values.push_back(value);
+        }
+        begin = end + 1;
+    }
+    return !values.empty();
+}
+
+// ### `SessionSeed()`
+// Derives the noise seed of session `index` from the sweep's seed (SplitMix64).
+static uint32_t SessionSeed(uint64_t seed, uint64_t index) {
+    uint64_t z = seed + (index + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return (uint32_t)(z ^ (z >> 31));
+}
+
+static void Usage() {
+    fprintf(stderr,
+        "Usage: sweep [options]\n"
+        "  --supply LIST       Supply voltages (default 6.6)\n"
+        "  --temperature LIST  Initial coil temperatures, in C (default 20)\n"
+        "  --sample-ms LIST    INA219 polling intervals (default 2)\n"
+        "  --buffer LIST       SensorBuffer sizes (default 20)\n"
+        "  --telemetry LIST    Telemetry baud rates, 0 = off (default 0)\n"
+        "  --repeats N         Sessions per configuration, with different seeds (default 1)\n"
+        "  --duration S        Simulated time per session, in s (default 10)\n"
+        "  --seed N            Sweep seed (default 1)\n"
+        "  --threads N         Worker threads (default: one per core)\n"
+        "LIST is comma-separated values and start:stop:step ranges, e.g. 5:9:0.5,12\n");
+}
+
+
+
+int main(int argc, char** argv)
+{
+    std::vector<double> supplies = {6.6}, temperatures = {20}, sample_intervals = {2}, buffers = {20}, bauds = {0};
+    unsigned long repeats = 1, threads = 0;
+    unsigned long long seed = 1;
+    double duration = 10;
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        const char* value = i + 1 < argc ? argv[++i] : nullptr;
+        bool valid = value != nullptr;
+        if (!valid) { }
+        else if (strcmp(option, "--supply") == 0)       valid = ParseList(value, supplies);
+        else if (strcmp(option, "--temperature") == 0)  valid = ParseList(value, temperatures);
+        else if (strcmp(option, "--sample-ms") == 0)    valid = ParseList(value, sample_intervals);
+        else if (strcmp(option, "--buffer") == 0)       valid = ParseList(value, buffers);
+        else if (strcmp(option, "--telemetry") == 0)    valid = ParseList(value, bauds);
+        else if (strcmp(option, "--repeats") == 0)      valid = (repeats = strtoul(value, nullptr, 10)) > 0;
+        else if (strcmp(option, "--duration") == 0)     valid = (duration = atof(value)) > 0;
+        else if (strcmp(option, "--seed") == 0)         seed = strtoull(value, nullptr, 10);
+        else if (strcmp(option, "--threads") == 0)      threads = strtoul(value, nullptr, 10);
+        else                                            valid = false;
+        if (!valid) {
+            Usage();
+            return 2;
+        }
+    }
+
+    // Every combination, in a fixed order (the last parameter varies fastest)
+    std::vector<SessionConfig> configs;
+    for (double supply : supplies)
+    for (double temperature : temperatures)
+    for (double sample_interval : sample_intervals)
+    for (double buffer : buffers)
+    for (double baud : bauds)
+    for (unsigned long repeat = 0; repeat < repeats; repeat++) {
+        SessionConfig config;
+        config.duration = duration;
+        config.engine.supply_voltage = supply;
+        config.engine.initial_temperature = temperature;
+        config.engine.seed = SessionSeed(seed, configs.size());
+        std::mt19937 random(config.engine.seed);
+        config.engine.initial_angle = std::uniform_real_distribution<float>(0, 2 * M_PI)(random);
+        config.switch_phase = random() % (config.switch_interval * 1000);
+        config.sample_interval = sample_interval < 1 ? 1 : (uint32_t)sample_interval;
+        config.sensor_buffer_size = buffer < 1 ? 1 : (size_t)buffer;
+        config.telemetry = baud > 0;
+        config.telemetry_baud = baud > 0 ? (unsigned long)baud : SERIAL_TELEMETRY_BAUD;
+        configs.push_back(config);
+    }
+
+    std::vector<SessionStats> results(configs.size());
+    auto began = std::chrono::steady_clock::now();
+    uint64_t steals;
+    size_t workers;
+    {
+        WorkStealingPool pool(threads);
+        for (size_t i = 0; i < configs.size(); i++) {
+            pool.Submit([&configs, &results, i] { results[i] = Session(configs[i]).Run(); });
+        }
+        pool.Wait();
+        steals = pool.Steals();
+        workers = pool.Size();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+
+    printf("session,seed,supply,temperature,sample_ms,buffer,telemetry_baud,true_strokes,strokes,missed,"
+           "true_rpm,rpm,rpm_sd,rpm_error,rpm_error_sd,rpm_error_min,rpm_error_max,edge_delay,edge_delay_max,"
+           "readings_per_stroke,efficiency,efficiency_sd,telemetry_sent,telemetry_dropped,final_rpm,final_temperature\n");
+    for (size_t i = 0; i < configs.size(); i++) {
+        const SessionConfig& c = configs[i];
+        const SessionStats& s = results[i];
+        printf("%lu,%lu,%.6g,%.6g,%lu,%lu,%lu,%lu,%lu,%lu,"
+               "%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,"
+               "%.6g,%.6g,%.6g,%lu,%lu,%.6g,%.6g\n",
+            (unsigned long)i, (unsigned long)c.engine.seed, c.engine.supply_voltage, c.engine.initial_temperature,
+            (unsigned long)c.sample_interval, (unsigned long)c.sensor_buffer_size,
+            c.telemetry ? c.telemetry_baud : 0UL, (unsigned long)s.true_strokes, (unsigned long)s.strokes,
+            (unsigned long)(s.true_strokes > s.strokes ? s.true_strokes - s.strokes : 0),
+            s.true_rpm.mean, s.rpm.mean, s.rpm.Deviation(),
+            s.rpm_error.mean, s.rpm_error.Deviation(),
+            s.rpm_error.count ? s.rpm_error.min : 0, s.rpm_error.count ? s.rpm_error.max : 0,
+            s.edge_delay.mean, s.edge_delay.count ? s.edge_delay.max : 0,
+            s.samples.mean, s.efficiency.mean, s.efficiency.Deviation(),
+            (unsigned long)s.telemetry_sent, (unsigned long)s.telemetry_dropped, s.final_rpm, s.final_temperature);
+    }
+
+    fprintf(stderr, "%lu sessions (%.0f simulated s) on %lu threads in %.2f s: %.0fx real time, %lu steals\n",
+        (unsigned long)configs.size(), configs.size() * duration, (unsigned long)workers, wall,
+        configs.size() * duration / wall, (unsigned long)steals);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+/****************************************************************
+*                                                               *
+*   telemetry_decode.cpp                                        *
+*                                                               *
+*   Host-side decoder for captured serial telemetry streams.    *
+*                                                               *
+*****************************************************************/
+// Turns a raw capture of the firmware's serial telemetry (built with `-D SERIAL_TELEMETRY`) into CSV on stdout,
+// one row per valid packet (the spectral bands' columns empty for samples and edges, and the other way around). Corrupt frames and gaps in the packet sequence numbers are reported on stderr,
+// followed by a summary. Exits with status `1` if any packets were lost or corrupt.
+// 
+// Build and run:
+// ```
+// g++ -std=c++17 -O2 -I include tools/telemetry_decode/telemetry_decode.cpp -o telemetry_decode
+// stty -F /dev/ttyUSB0 921600 raw && cat /dev/ttyUSB0 > capture.bin
+// ./telemetry_decode capture.bin > capture.csv       # or: ./telemetry_decode < capture.bin
+// ```
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "Telemetry/Protocol.hpp"
+
+
+
+int main(int argc, char** argv)
+{
+    FILE* input = stdin;
+    if (argc > 1) {
+        input = fopen(argv[1], "rb");
+        if (input == nullptr) {
+            fprintf(stderr, "Cannot open %s\n", argv[1]);
+            return 2;
+        }
+    }
+
+    uint8_t frame[FRAME_MAX_SIZE];
+    size_t length = 0;
+    bool overflow = false;
+    bool synced = false;            // Whether a delimiter has been seen (the first frame may be partial)
+    bool have_sequence = false;
+    uint16_t expected = 0;
+    unsigned long packets = 0, corrupt = 0, dropped = 0;
+
+    printf("sequence,type,time,state,voltage,current,power,resistance,temperature,band,order,frequency,magnitude,baseline,exceeded,blocks\n");
+
+    int c;
+    while ((c = fgetc(input)) != EOF) {
+        if (c != 0) {
+            if (length < sizeof(frame)) {
+                frame[length++] = (uint8_t)c;
+            }
+            else {
+                overflow = true;
+            }
+            continue;
+        }
+        Packet packet;
+        bool valid = length > 0 && !overflow && DecodeFrame(frame, length, packet);
+        bool first = !synced;
+        synced = true;
+        if (!valid && (first || length == 0)) {
+            // Capture started mid-frame, or back-to-back delimiters
+        }
+        else if (!valid) {
+            corrupt++;
+            fprintf(stderr, "corrupt frame (%zu bytes) after sequence %u\n", length, (unsigned)(uint16_t)(expected - 1));
+        }
+        else {
+            if (have_sequence && packet.sequence != expected) {
+                uint16_t gap = (uint16_t)(packet.sequence - expected);
+                dropped += gap;
+                fprintf(stderr, "dropped %u packet(s): expected sequence %u, got %u\n", (unsigned)gap, (unsigned)expected, (unsigned)packet.sequence);
+            }
+            have_sequence = true;
+            expected = (uint16_t)(packet.sequence + 1);
+            packets++;
+
+            if (packet.type == PacketType::SAMPLE) {
+                printf("%u,sample,%lu,,%.7g,%.7g,%.7g,%.7g,%.7g,,,,,,,\n",
+                    (unsigned)packet.sequence, (unsigned long)packet.time,
+                    packet.sample.voltage, packet.sample.current, packet.sample.power,
+                    packet.sample.resistance, packet.sample.temperature);
+            }
+            else if (packet.type == PacketType::BAND) {
+                printf("%u,band,%lu,,,,,,,%u,%g,%.7g,%.7g,%.7g,%u,%u\n",
+                    (unsigned)packet.sequence, (unsigned long)packet.time, (unsigned)packet.band.band,
+                    packet.band.order, packet.band.frequency, packet.band.magnitude, packet.band.baseline,
+                    (unsigned)packet.band.exceeded, (unsigned)packet.band.blocks);
+            }
+            else {
+                printf("%u,edge,%lu,%u,,,,,,,,,,,,\n",
+                    (unsigned)packet.sequence, (unsigned long)packet.time, (unsigned)packet.edge.state);
+            }
+        }
+        length = 0;
+        overflow = false;
+    }
+
+    if (input != stdin) {
+        fclose(input);
+    }
+    fprintf(stderr, "%lu packets decoded, %lu dropped, %lu corrupt frames\n", packets, dropped, corrupt);
+    return (dropped > 0 || corrupt > 0) ? 1 : 0;
+}
\ No newline at end of file